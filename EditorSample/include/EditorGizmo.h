@@ -31,6 +31,7 @@ http://www.gnu.org/copyleft/lesser.txt.
 #include <OIS/OIS.h>
 //#include "OIS/oismouse.h"
 #include "OgreVector3.h"
+#include <vector>
 namespace Ogre
 {
 	class Camera;
@@ -47,9 +48,9 @@ public:
 
 	/// changes distance of metaball to cam depending on z-axis (mouse wheel)
 	bool mouseMoved( const OIS::MouseState &ms );
-	/// changes color of sphere or something(?)
+	/// starts recording a stroke
 	bool mousePressed( OIS::MouseButtonID id );
-	/// adds meta ball to scene
+	/// adds the recorded stroke (or a meta ball for a click) to scene
 	bool mouseReleased( OIS::MouseButtonID id );
 	Real getRadius() {return mRadius;}
 	void setRadius(Real radius);
@@ -66,6 +67,10 @@ protected :
 	Entity *mInnerEnt, *mOuterEnt;
 	/// whether the metaball digs (true), or constructs overhangs (false).
 	bool excavator;
+	/// Path of the gizmo while a button is held
+	std::vector<Vector3> mStrokePoints;
+	/// Whether a button is held
+	bool mStroking;
 
 
 	void createSphere(const std::string& strName, const float r, const int nRings = 16, const int nSegments = 16);
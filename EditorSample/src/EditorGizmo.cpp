@@ -36,7 +36,8 @@ namespace Ogre
 {
 EditorGizmo::EditorGizmo(Camera *cam, OverhangTerrainSceneManager *sm, Real radius, Real maxDistToCam)
 : mCamera(cam), mOTSceneMgr(sm), mMaxDistToCam(maxDistToCam), mDistToCam(40.0f),
-  mRadius(radius), mMetaBallPosition(Vector3::ZERO), mSceneNode(0), mInnerEnt(0), mOuterEnt(0)
+  mRadius(radius), mMetaBallPosition(Vector3::ZERO), mSceneNode(0), mInnerEnt(0), mOuterEnt(0),
+  mStroking(false)
 {
 	createSphere("myInnerSphereMesh", mRadius/4.0f, 32, 32);
 	createSphere("myOuterSphereMesh", mRadius, 32, 32);
@@ -58,6 +59,10 @@ void EditorGizmo::update()
 	Vector3 pos = mCamera->getPosition();
 	mMetaBallPosition = pos + dir * mDistToCam;
 	mSceneNode->setPosition(mMetaBallPosition);
+
+	// Sample the drag path about every half radius
+	if (mStroking && mStrokePoints.back().squaredDistance(mMetaBallPosition) > 0.25f*mRadius*mRadius)
+		mStrokePoints.push_back(mMetaBallPosition);
 }
 
 bool EditorGizmo::mouseMoved( const OIS::MouseState &ms )
@@ -69,7 +74,9 @@ bool EditorGizmo::mouseMoved( const OIS::MouseState &ms )
 
 bool EditorGizmo::mousePressed( OIS::MouseButtonID id )
 {
-	/// do nothing, for now
+	mStrokePoints.clear();
+	mStrokePoints.push_back(mMetaBallPosition);
+	mStroking = true;
 	return true;
 }
 
@@ -77,10 +84,17 @@ bool EditorGizmo::mouseReleased( OIS::MouseButtonID id )
 {
 	std::cout << "Mouse Button Released.\n";
 
+	if(!mStroking)
+		return true;
+	mStroking = false;
+	if(mStrokePoints.back() != mMetaBallPosition)
+		mStrokePoints.push_back(mMetaBallPosition);
+
+	// One object (and one remesh per fragment) for the whole drag
 	if(id == OIS::MB_Left)
-		mOTSceneMgr->addMetaBall(mMetaBallPosition, mRadius, true);
+		mOTSceneMgr->addMetaStroke(mStrokePoints, mRadius, true);
 	else if(id == OIS::MB_Right)
-		mOTSceneMgr->addMetaBall(mMetaBallPosition, mRadius, false);
+		mOTSceneMgr->addMetaStroke(mStrokePoints, mRadius, false);
 	return true;
 }
 
@@ -66,6 +66,8 @@ public:
 	size_t getNumCellsY() const {return mNumCellsY; }
 	/// Returns the number of grid cells along the z axis.
 	size_t getNumCellsZ() const {return mNumCellsZ; }
+	/// Returns the total number of grid points.
+	size_t getNumGridPoints() const {return mNumGridPoints; }
 	/// Returns the grid scale (i.e. the distance along the axes between grid points).
 	Real getGridScale() const {return mGridScale; }
 	/// Returns the grids position in space.
@@ -53,12 +53,21 @@ public:
 	virtual Real getBoundingRadius(void) const;
 	/// Implementation of Ogre::SimpleRenderable
 	virtual Real getSquaredViewDepth(const Camera* cam) const;
+	/// Notes the frame the renderable was queued in
+	virtual void _updateRenderQueue(RenderQueue* queue);
+
+	/// Returns the bytes held by the vertex and index buffers, including their shadow copies.
+	size_t getMemoryUsage() const;
+	/// Returns the number of the last frame the renderable was queued for rendering in.
+	unsigned long getLastVisibleFrame() const {return mLastVisibleFrame;}
 
 protected:
 	/// Maximum capacity of the currently allocated vertex buffer.
 	size_t mVertexBufferCapacity;
 	/// Maximum capacity of the currently allocated index buffer.
 	size_t mIndexBufferCapacity;
+	/// Frame number of the last _updateRenderQueue() call.
+	unsigned long mLastVisibleFrame;
 
 	/// Creates the vertex declaration.
 	virtual void createVertexDeclaration() = 0;
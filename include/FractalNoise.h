@@ -0,0 +1,89 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef FRACTAL_NOISE_H
+#define FRACTAL_NOISE_H
+
+#include "OverhangTerrainPrerequisites.h"
+
+namespace Ogre
+{
+/** Seeded fractal (fBm) gradient noise for procedural terrain.
+	@remarks
+		Lattice gradients come from an integer hash of the lattice point and the
+		seed rather than from a permutation table, so the same seed gives the
+		same terrain on every run and platform. fillRow() evaluates four samples
+		at a time with SSE2 where available; the scalar path performs the same 
+		float operations in the same order, so both give identical results.
+	@par
+		2D sample coordinates are integers in sample units, converted to float
+		before scaling, so neighbouring pages agree on their shared edges. The
+		3D variants (used by MetaNoise) take world positions.
+*/
+class _OverhangTerrainPluginExport FractalNoise
+{
+public:
+	/** @param seed Seed of the first octave, octave i uses seed + i.
+		@param octaves Number of octaves summed.
+		@param frequency Lattice cells per unit (sample or world unit) of the first octave.
+		@param lacunarity Frequency factor between octaves.
+		@param gain Amplitude factor between octaves. */
+	FractalNoise(uint32 seed = 0, ushort octaves = 6, float frequency = 1.0f / 256.0f,
+		float lacunarity = 2.0f, float gain = 0.5f);
+
+	/// Returns the noise at a sample position, in [-1, 1].
+	float getValue(float x, float z) const;
+	/** Evaluates count samples of row z starting at column x0.
+		@param out Receives the values, in [-1, 1]. */
+	void fillRow(int x0, int z, size_t count, float* out) const;
+	/// Returns the 3D noise at a position, in [-1, 1].
+	float getValue(float x, float y, float z) const;
+	/** Evaluates the 3D noise at count positions (x0 + i * dx, y, z).
+		@param out Receives the values, in [-1, 1]. */
+	void fillRow(float x0, float dx, float y, float z, size_t count, float* out) const;
+
+	/// Single octave gradient noise at a lattice position, in [-1, 1].
+	static float gradientNoise(float x, float z, uint32 seed);
+	/// Single octave 3D gradient noise at a lattice position, in [-1, 1].
+	static float gradientNoise(float x, float y, float z, uint32 seed);
+	/// Whether fillRow() uses the SSE2 kernel in this build.
+	static bool isVectorised();
+
+	uint32 getSeed() const {return mSeed; }
+	ushort getOctaves() const {return mOctaves; }
+	float getFrequency() const {return mFrequency; }
+	float getLacunarity() const {return mLacunarity; }
+	float getGain() const {return mGain; }
+
+protected:
+	uint32 mSeed;
+	ushort mOctaves;
+	float mFrequency;
+	float mLacunarity;
+	float mGain;
+	/// One over the sum of the octave amplitudes
+	float mInvAmplitude;
+};
+
+}// namespace Ogre
+#endif // FRACTAL_NOISE_H
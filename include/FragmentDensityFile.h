@@ -0,0 +1,199 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef FRAGMENT_DENSITY_FILE_H
+#define FRAGMENT_DENSITY_FILE_H
+
+#include "OverhangTerrainPrerequisites.h"
+#include "MappedFile.h"
+
+namespace Ogre
+{
+/** Binary file holding the baked density grids of MetaWorldFragments.
+	@remarks
+		Layout (native byte order, checked on load):
+		<ul>
+			<li>Header - magic, version, data grid dimensions and scale, entry count,
+			the offset of the index and the last TerrainEditJournal sequence number 
+			included in the densities.</li>
+			<li>Density blocks - one per fragment, either raw 32-bit floats or
+			run-length encoded (see ENTRY_COMPRESSED), optionally followed by the 
+			fragment's carved columns (see ENTRY_HAS_COLUMNS).</li>
+			<li>Tile blocks - data kept per tile rather than per fragment (see 
+			ENTRY_TILE_EDITS and ENTRY_TILE_HEIGHTS), indexed like fragments at y level
+			TILE_LEVEL.</li>
+			<li>Index - one IndexEntry per fragment, sorted by (tile x, tile z, y level),
+			so the fragments of a tile are found by binary search in the mapping.</li>
+		</ul>
+		The file is memory mapped when opened; blocks are only decoded when the tile
+		they belong to is loaded.
+*/
+class _OverhangTerrainPluginExport FragmentDensityFile
+{
+public:
+	enum EntryFlags
+	{
+		/// The density block is run-length encoded.
+		ENTRY_COMPRESSED = 0x01,
+		/// The fragment took over (part of) the heightfield of the owning tile.
+		ENTRY_HIDES_HEIGHTFIELD = 0x02,
+		/** One byte per data grid column (numCells x * numCells z) follows the density
+			block, padded to 4 bytes; see MetaWorldFragment::carveColumns. */
+		ENTRY_HAS_COLUMNS = 0x04,
+		/** No fragment, but MetaObjects added to the tile while its page was not loaded,
+			as records of TerrainEditJournal::writeRecords padded to 4 bytes. */
+		ENTRY_TILE_EDITS = 0x08,
+		/** No fragment, but the height changes of the tile's vertices (tileSize * tileSize
+			32-bit floats), see TerrainTile::getHeightDeltas. */
+		ENTRY_TILE_HEIGHTS = 0x10,
+		/// Flags of tile blocks, which findFragments() leaves out
+		ENTRY_TILE_BLOCK = ENTRY_TILE_EDITS | ENTRY_TILE_HEIGHTS
+	};
+	/// y level of the index entries of tile blocks, ahead of all fragments of the tile
+	static const int32 TILE_LEVEL;
+
+	/// File header.
+	struct Header
+	{
+		char magic[4];
+		uint32 version;
+		uint32 byteOrder;
+		uint32 numCells[3];
+		float gridScale;
+		uint32 numEntries;
+		uint64 indexOffset;
+		/// Last edit journal record contained in the densities (0 = none).
+		uint64 sequence;
+	};
+
+	/// Index entry describing one fragment.
+	struct IndexEntry
+	{
+		int32 tileX;
+		int32 tileZ;
+		int32 yLevel;
+		uint32 flags;
+		/// Centre of the fragment's data grid.
+		float position[3];
+		/// Size of the density block in bytes.
+		uint32 size;
+		/// Offset of the density block from the start of the file.
+		uint64 offset;
+	};
+
+	/// A fragment handed to save().
+	struct Fragment
+	{
+		int tileX, tileZ, yLevel;
+		uint32 flags;
+		Vector3 position;
+		/// One value per data grid point.
+		const Real* values;
+		/// One byte per data grid column, or 0 if the fragment has no carved columns.
+		const uchar* columns;
+	};
+	typedef std::vector<Fragment> FragmentList;
+	/// A tile block handed to save().
+	struct TileBlock
+	{
+		int tileX, tileZ;
+		/// One of the ENTRY_TILE_BLOCK flags
+		uint32 flags;
+		const uint32* words;
+		size_t numWords;
+	};
+	typedef std::vector<TileBlock> TileBlockList;
+	typedef std::vector<const IndexEntry*> EntryList;
+
+	FragmentDensityFile();
+	~FragmentDensityFile();
+
+	/** Writes a density file.
+		@param filename The file to (over)write.
+		@param fragments The fragments to store; sorted on the way.
+		@param numCellsX, numCellsY, numCellsZ, gridScale The data grid the densities belong to.
+		@param compress Run-length encode blocks (only kept where it actually saves space).
+		@param sequence Last edit journal record contained in the densities.
+		@param tileBlocks Tile blocks to store, or 0. */
+	static void save(const String& filename, FragmentList& fragments, 
+		size_t numCellsX, size_t numCellsY, size_t numCellsZ, Real gridScale, bool compress = true,
+		uint64 sequence = 0, const TileBlockList* tileBlocks = 0);
+
+	/// Maps and validates a density file.
+	void open(const String& filename);
+	/// Unmaps the file.
+	void close();
+	bool isOpen() const {return mFile.isOpen(); }
+	const String& getFilename() const {return mFile.getFilename(); }
+
+	/// Returns true if the file was written for a data grid of this layout.
+	bool matchesGrid(size_t numCellsX, size_t numCellsY, size_t numCellsZ, Real gridScale) const;
+	/// Number of density values stored per fragment.
+	size_t getNumGridPoints() const {return mNumGridPoints; }
+	/// Number of fragments and tile blocks in the file.
+	size_t getNumEntries() const {return mHeader ? mHeader->numEntries : 0; }
+	/// Returns the last edit journal sequence number contained in the densities.
+	uint64 getSequence() const {return mHeader ? mHeader->sequence : 0; }
+	/// Returns the i-th index entry.
+	const IndexEntry& getEntry(size_t i) const {assert(i < getNumEntries()); return mIndex[i]; }
+
+	/** Collects the index entries of all fragments of a tile.
+		@returns The number of entries found. */
+	size_t findFragments(int tileX, int tileZ, EntryList& entries) const;
+	/// Decodes the density block of an entry into values (getNumGridPoints() values).
+	void readDensities(const IndexEntry& entry, Real* values) const;
+	/// Returns the tile block of a tile with the given ENTRY_TILE_BLOCK flag, or 0 if it has none.
+	const IndexEntry* findTileBlock(int tileX, int tileZ, uint32 flag) const;
+	/// Returns the words of a tile block inside the mapping (entry.size bytes).
+	const uint32* getTileBlock(const IndexEntry& entry) const;
+	/// Number of carved column bytes stored with ENTRY_HAS_COLUMNS.
+	size_t getNumColumns() const {return mHeader ? size_t(mHeader->numCells[0])*mHeader->numCells[2] : 0; }
+	/// Returns the carved columns of an entry inside the mapping (getNumColumns() bytes), or 0 if it has none.
+	const uchar* getColumns(const IndexEntry& entry) const;
+	/** Starts paging in the density blocks of a tile ahead of readDensities().
+		@returns The number of fragments of the tile. */
+	size_t prefetchFragments(int tileX, int tileZ) const;
+
+	/** Encodes a density block the way save() stores it.
+		@param compress Try run-length encoding.
+		@returns True if out holds a run-length encoded block, false if it holds the raw floats. */
+	static bool encodeBlock(const Real* values, size_t numGridPoints, bool compress, std::vector<uint32>& out);
+	/** Decodes a block written by encodeBlock().
+		@returns False if the block is corrupt. */
+	static bool decodeBlock(const uint32* block, size_t numWords, bool compressed, 
+		Real* values, size_t numGridPoints);
+
+	static const uint32 VERSION;
+
+protected:
+	MappedFile mFile;
+	const Header* mHeader;
+	const IndexEntry* mIndex;
+	size_t mNumGridPoints;
+
+	/// Run-length encodes 32-bit words; returns false if that does not save space.
+	static bool compressBlock(const uint32* words, size_t count, std::vector<uint32>& out);
+};
+
+}// namespace Ogre
+#endif // FRAGMENT_DENSITY_FILE_H
@@ -0,0 +1,144 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef FRAGMENT_MESH_CACHE_H
+#define FRAGMENT_MESH_CACHE_H
+
+#include "OverhangTerrainPrerequisites.h"
+#include "MappedFile.h"
+
+namespace Ogre
+{
+/** On-disk cache of the meshes generated for MetaWorldFragments.
+	@remarks
+		Each entry holds the final hardware vertex and index data of one fragment,
+		keyed by a hash of the density grid the mesh was built from. Since IsoSurface 
+		vertices are relative to the data grid centre, equal densities give equal meshes,
+		so a lookup only needs the hash. The tile and y-level of each entry are stored
+		as well, to carry entries of unloaded tiles over when the cache is rewritten.
+	@par
+		The file is memory mapped; cached buffers are uploaded straight from the mapping.
+*/
+class _OverhangTerrainPluginExport FragmentMeshCache
+{
+public:
+	/// File header.
+	struct Header
+	{
+		char magic[4];
+		uint32 version;
+		uint32 byteOrder;
+		/// Size of one vertex in bytes.
+		uint32 vertexSize;
+		uint32 numEntries;
+		uint32 reserved;
+		uint64 indexOffset;
+	};
+
+	/// Index entry describing one cached mesh.
+	struct IndexEntry
+	{
+		uint64 hash;
+		int32 tileX;
+		int32 tileZ;
+		int32 yLevel;
+		uint32 vertexCount;
+		uint32 indexCount;
+		uint32 reserved;
+		/// Offset of the vertex data; the 16 bit indices follow it.
+		uint64 offset;
+	};
+
+	/// A mesh handed to save().
+	struct Mesh
+	{
+		uint64 hash;
+		int tileX, tileZ, yLevel;
+		const uchar* vertices;
+		size_t vertexCount;
+		const uint16* indices;
+		size_t indexCount;
+	};
+	typedef std::vector<Mesh> MeshList;
+
+	FragmentMeshCache();
+	~FragmentMeshCache();
+
+	/// Hashes the density values of a data grid.
+	static uint64 hashDensities(const Real* values, size_t count);
+
+	/** Writes a mesh cache file.
+		@param filename The file to (over)write.
+		@param meshes The meshes to store; sorted on the way.
+		@param vertexSize Size of one vertex in bytes. */
+	static void save(const String& filename, MeshList& meshes, size_t vertexSize);
+
+	/// Maps and validates a mesh cache file.
+	void open(const String& filename);
+	/// Unmaps the file.
+	void close();
+	bool isOpen() const {return mFile.isOpen(); }
+	const String& getFilename() const {return mFile.getFilename(); }
+
+	/// Size of one vertex in bytes.
+	size_t getVertexSize() const {return mHeader ? mHeader->vertexSize : 0; }
+	/// Number of meshes in the file.
+	size_t getNumEntries() const {return mHeader ? mHeader->numEntries : 0; }
+	/// Returns the i-th index entry.
+	const IndexEntry& getEntry(size_t i) const {assert(i < getNumEntries()); return mIndex[i]; }
+
+	/// Returns the mesh built from densities with the given hash, or 0 if it is not cached.
+	const IndexEntry* find(uint64 hash) const;
+	/** Starts paging in the meshes stored for the tiles in [minTileX, maxTileX] x [minTileZ, maxTileZ],
+		ahead of the lookups of their fragments.
+		@remarks
+			The index is sorted by hash, so this is one pass over it; meant for whole pages.
+		@returns The number of meshes of the tiles. */
+	size_t prefetchMeshes(int minTileX, int minTileZ, int maxTileX, int maxTileZ) const;
+	/// Returns the vertex data of an entry (in the mapping).
+	const uchar* getVertices(const IndexEntry& entry) const {return mFile.getData() + entry.offset; }
+	/// Returns the index data of an entry (in the mapping).
+	const uint16* getIndices(const IndexEntry& entry) const
+	{
+		return reinterpret_cast<const uint16*>(getVertices(entry) + entry.vertexCount*getVertexSize());
+	}
+
+	/// Number of fragments uploaded from the cache since it was opened.
+	size_t getNumHits() const {return mNumHits; }
+	/// Number of fragments which had to be rebuilt since the cache was opened.
+	size_t getNumMisses() const {return mNumMisses; }
+	/// Counts a lookup for the hit/miss statistics.
+	void _notifyLookup(bool hit) const {if (hit) ++mNumHits; else ++mNumMisses; }
+
+	static const uint32 VERSION;
+
+protected:
+	MappedFile mFile;
+	const Header* mHeader;
+	const IndexEntry* mIndex;
+	mutable size_t mNumHits;
+	mutable size_t mNumMisses;
+};
+
+}// namespace Ogre
+#endif // FRAGMENT_MESH_CACHE_H
@@ -0,0 +1,145 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+#ifndef INTERSECTION_TESTS_H
+#define INTERSECTION_TESTS_H
+
+#include "OverhangTerrainPrerequisites.h"
+#include "OgreVector3.h"
+#include <algorithm>
+
+namespace Ogre
+{
+/// Ray and sweep tests shared by the heightfield trace and the fragment BVHs.
+namespace IntersectionTests
+{
+	/** Narrows [ta, tb] to the part of the line o + t * d within [lo, hi].
+	@returns false if nothing is left
+	*/
+	inline bool clipSlab( Real o, Real d, Real lo, Real hi, Real& ta, Real& tb )
+	{
+		if ( d == 0 )
+			return o >= lo && o <= hi && ta <= tb;
+
+		Real t0 = ( lo - o ) / d;
+		Real t1 = ( hi - o ) / d;
+		if ( t0 > t1 )
+			std::swap( t0, t1 );
+		ta = std::max( ta, t0 );
+		tb = std::min( tb, t1 );
+		return ta <= tb;
+	}
+
+	/** Narrows [ta, tb] to the part of the ray inside the box [lo, hi].
+	@returns false if the ray misses the box within [ta, tb]
+	*/
+	inline bool rayBox( const Vector3& origin, const Vector3& dir, 
+		const Vector3& lo, const Vector3& hi, Real& ta, Real& tb )
+	{
+		return clipSlab( origin.x, dir.x, lo.x, hi.x, ta, tb ) &&
+			clipSlab( origin.y, dir.y, lo.y, hi.y, ta, tb ) &&
+			clipSlab( origin.z, dir.z, lo.z, hi.z, ta, tb );
+	}
+
+	/** Intersects the line origin + t * dir with triangle abc from either side (Moller-Trumbore).
+	@param t Receives the line parameter of the hit, which may be negative
+	@returns false if the line misses the triangle or runs parallel to it
+	*/
+	inline bool rayTriangle( const Vector3& origin, const Vector3& dir, 
+		const Vector3& a, const Vector3& b, const Vector3& c, Real& t )
+	{
+		const Vector3 e1 = b - a, e2 = c - a;
+		const Vector3 p = dir.crossProduct( e2 );
+		const Real det = e1.dotProduct( p );
+		if ( det == 0 )
+			return false;
+
+		const Real inv = 1 / det;
+		const Vector3 s = origin - a;
+		const Real u = s.dotProduct( p ) * inv;
+		if ( u < 0 || u > 1 )
+			return false;
+
+		const Vector3 q = s.crossProduct( e1 );
+		const Real v = dir.dotProduct( q ) * inv;
+		if ( v < 0 || u + v > 1 )
+			return false;
+
+		t = e2.dotProduct( q ) * inv;
+		return true;
+	}
+
+	/** A sphere or capsule moving along a ray.
+	@remarks
+		The capsule's axis runs from origin to origin + axis, a zero axis gives a sphere.
+		Sweeping the shape against a triangle equals casting a ray from origin against
+		the triangle grown by the shape (its Minkowski sum with the mirrored shape), 
+		which is what the tests below do.
+	*/
+	struct Sweep
+	{
+		Vector3 origin;
+		/// Normalised direction of the motion
+		Vector3 dir;
+		Vector3 axis;
+		Real radius;
+		/// Offsets growing a box into the one origin enters when the shape touches the box
+		Vector3 growLo, growHi;
+
+		Sweep( const Vector3& o, const Vector3& d, const Vector3& a, Real r )
+			: origin( o ), dir( d ), axis( a ), radius( r )
+		{
+			Vector3 extent( r, r, r );
+			growLo = -extent;
+			growLo.makeFloor( -axis - extent );
+			growHi = extent;
+			growHi.makeCeil( -axis + extent );
+		}
+
+		/// As rayBox, for the shape against the box [lo, hi]
+		bool hitsBox( const Vector3& lo, const Vector3& hi, Real& ta, Real& tb ) const
+		{
+			return rayBox( origin, dir, lo + growLo, hi + growHi, ta, tb );
+		}
+	};
+
+	/** Intersects the ray origin + t * dir with the sphere, for t in [0, maxT]. A ray starting
+	inside hits at t = 0.
+	@param normal Receives the outward normal of the sphere at the hit
+	*/
+	bool raySphere( const Vector3& origin, const Vector3& dir, const Vector3& centre, Real radius, 
+		Real maxT, Real& t, Vector3& normal );
+
+	/// As raySphere, for the capsule around the segment [p, q]
+	bool rayCapsule( const Vector3& origin, const Vector3& dir, const Vector3& p, const Vector3& q,
+		Real radius, Real maxT, Real& t, Vector3& normal );
+
+	/** Finds when the swept shape first touches triangle abc, for t in [0, maxT]. 
+	A shape touching it at the start hits at t = 0.
+	@param normal Receives the contact normal, pointing from the triangle towards the shape
+	*/
+	bool sweepTriangle( const Sweep& sweep, const Vector3& a, const Vector3& b, const Vector3& c, 
+		Real maxT, Real& t, Vector3& normal );
+}
+}
+
+#endif
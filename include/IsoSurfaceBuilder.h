@@ -90,6 +90,16 @@ public:
 	NormalType getNormalType() const {return mNormalType; }
 	/// Sets the method used for normal generation.
 	void setNormalType(NormalType normalType) {mNormalType = normalType; }
+	/** Restricts buildIsoSurface() to some columns of grid cells.
+		@param mask One byte per column (x + z*numCellsX), cells of columns holding 0 
+			produce no triangles; 0 builds all cells. The mask is not copied. */
+	void setColumnMask(const uchar* mask) {mColumnMask = mask; }
+	const uchar* getColumnMask() const {return mColumnMask; }
+	/** Sets the function update() passes every iso vertex through before filling the
+		hardware buffers, e.g. to close seams with neighbouring geometry.
+		@param snap Receives world space positions; 0 leaves the vertices alone. Not copied. */
+	void setVertexSnap(const VertexSnap* snap) {mVertexSnap = snap; }
+	const VertexSnap* getVertexSnap() const {return mVertexSnap; }
 
 	/// Returns the total number of iso vertices to be allocated.
 	virtual size_t getNumIsoVertices();
@@ -148,6 +158,10 @@ protected:
 	bool mFlipNormals;
 	/// The method used for normal generation.
 	NormalType mNormalType;
+	/// Columns of grid cells to build, or 0 for all (see setColumnMask).
+	const uchar* mColumnMask;
+	/// Applied to the used iso vertices by update(), or 0 (see setVertexSnap).
+	const VertexSnap* mVertexSnap;
 	/** Hardware vertex buffer indices for all iso vertices.
 		@remarks
 			A value of ~0 means that the iso vertex is not used. During iso surface generation all
@@ -218,6 +232,8 @@ protected:
 	size_t useIsoVertex(size_t isoVertex, size_t corner0, size_t corner1);
 	/// ...
 	void addIsoTriangle(const IsoTriangle& isoTriangle);
+	/// Passes the positions of all used iso vertices through mVertexSnap.
+	void snapIsoVertices();
 };
 
 //inline functions
@@ -28,6 +28,7 @@ http://www.gnu.org/copyleft/lesser.txt.
 #define _ISO_SURFACE_RENDERABLE_H_
 
 #include "DynamicRenderable.h"
+#include "TriangleBVH.h"
 
 namespace Ogre
 {
@@ -41,6 +42,33 @@ public:
 	void createVertexDeclaration();
 	void initialize(IsoSurfaceBuilder *builder);
 	virtual void fillHardwareBuffers(IsoSurfaceBuilder *surf);
+	/** Fills the hardware buffers with previously generated data (see FragmentMeshCache).
+		@param vertices Vertices in the layout of this renderable's vertex declaration.
+		@param indices 16 bit triangle list indices.
+		@param box Bounding box of the data grid the mesh was built in. */
+	void fillHardwareBuffers(const uchar *vertices, size_t vertexCount, const uint16 *indices, size_t indexCount,
+		const AxisAlignedBox &box);
+	/// Reads the current vertex and index data back from the (shadowed) hardware buffers.
+	void readHardwareBuffers(std::vector<uchar> &vertices, std::vector<uint16> &indices) const;
+	/// Returns the size of one vertex in bytes.
+	size_t getVertexSize() const {return mRenderOp.vertexData->vertexDeclaration->getVertexSize(0);}
+	/// Returns the number of vertices currently in use.
+	size_t getVertexCount() const {return mRenderOp.vertexData->vertexCount;}
+	/** Finds the nearest triangle the ray origin + t * dir hits, for t in [0, maxT].
+		@remarks
+			The ray is in the local space of the data grid. The triangles are kept in a 
+			TriangleBVH, rebuilt from the shadow buffers on the first query after the 
+			hardware buffers were refilled, so only remeshed surfaces pay for it.
+		@param t Receives the distance of the hit along dir */
+	bool intersectRay(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t);
+	/// As intersectRay, for a sphere or capsule sweep (see TriangleBVH::sweep).
+	bool sweep(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal);
+	/** Rebuilds the TriangleBVH if the hardware buffers were refilled since it was built.
+		@remarks
+			intersectRay does this itself; call it first if rays are cast from several threads. */
+	void updateBVH();
+	/// Returns the bytes held by the hardware buffers and the TriangleBVH.
+	size_t getMemoryUsage() const {return DynamicRenderable::getMemoryUsage() + mBVH.getMemoryUsage();}
 	virtual bool getNormaliseNormals(void) const {return true; }
 //	virtual const AxisAlignedBox &getBoundingBox(void) const {return mDataGridPtr->getBoundingBox();}
 	virtual const AxisAlignedBox &getBoundingBox(void) const {return mAABB;}
@@ -65,6 +93,10 @@ protected:
 		@remarks
 			The pointer is only valid if GEN_TEX_COORDS is set in IsoSurface::mSurfaceFlags. */
 	const VertexElement* mTexCoordsElement;
+	/// Triangles of the current mesh, for intersectRay().
+	TriangleBVH mBVH;
+	/// Whether the buffers changed since mBVH was built.
+	bool mBVHDirty;
 
 };
 }/// namespace Ogre
@@ -0,0 +1,81 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "OverhangTerrainPrerequisites.h"
+
+namespace Ogre
+{
+/** Read-only memory mapping of a whole file.
+	@remarks
+		Used by the terrain data files (densities, mesh cache, RAW heightmaps) so that
+		their contents can be read in place and paged in by the OS on demand, instead
+		of being streamed into freshly allocated buffers.
+*/
+class _OverhangTerrainPluginExport MappedFile
+{
+public:
+	MappedFile();
+	/// Unmaps the file, if it is open.
+	~MappedFile();
+
+	/** Maps the given file.
+		@remarks
+			Any previously mapped file is closed first. Throws if the file does not
+			exist, is empty or cannot be mapped. */
+	void open(const String& filename);
+	/// Unmaps the file.
+	void close();
+	/// Returns true if a file is mapped.
+	bool isOpen() const {return mData != 0; }
+	/// Returns a pointer to the first byte of the mapping.
+	const uchar* getData() const {return mData; }
+	/// Returns the size of the mapping in bytes.
+	size_t getSize() const {return mSize; }
+	/// Returns the name of the mapped file.
+	const String& getFilename() const {return mFilename; }
+	/** Asks the OS to start reading a range of the file into memory, so that a later
+		access does not stall on the disk. Does nothing where that is not supported. */
+	void prefetch(size_t offset, size_t size) const;
+
+protected:
+	String mFilename;
+	const uchar* mData;
+	size_t mSize;
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	void* mFileHandle;
+	void* mMappingHandle;
+#else
+	int mFileDescriptor;
+#endif
+
+private:
+	/// Not copyable, the mapping is owned.
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+}// namespace Ogre
+#endif // MAPPED_FILE_H
@@ -50,8 +50,11 @@ public:
 	Real getRadius() const {return mRadius; }
 	/// Sets the radius of the meta ball.
 	void setRadius(Real radius) {mRadius = radius; }
-	void setExcavating(bool e) {mExcavating = true;}
+	void setExcavating(bool e) {mExcavating = e;}
+	/// Returns true if the meta ball removes material.
+	virtual bool isExcavating() const {return mExcavating;}
 	virtual AxisAlignedBox getAABB() const;
+	virtual MetaObjectType getType() const {return MOT_BALL;}
 	
 
 protected:
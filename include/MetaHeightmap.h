@@ -28,6 +28,7 @@ http://www.gnu.org/copyleft/lesser.txt.
 #define _META_HEIGTHMAP_H_
 
 #include "MetaObject.h"
+#include "MetaWorldFragment.h"
 #include "OgreAxisAlignedBox.h"
 
 namespace Ogre
@@ -47,12 +48,21 @@ public:
 	/// Sets the fallof range. A fallof range less than the dataGrids gridsize 
 	/// will make the algorithm fail.
 	void setFallofRange(Real fallof) {mFallofRange = fallof; }
+	/** Returns the band in which the field varies: the tile's extents, from the 
+		lowest height minus twice the fallof range to the highest plus the fallof range.
+		Below it the field is uniformly solid, above it zero. */
 	virtual AxisAlignedBox getAABB() const;
+	/// Classifies a box (e.g. a fragment's data grid) against the band of getAABB().
+	MetaWorldFragment::Classification classify(const AxisAlignedBox& box) const;
+	virtual MetaObjectType getType() const {return MOT_HEIGHTMAP;}
 	
 
 protected:
 	TerrainTile *mTerrainTile;
 	Real mFallofRange, mGroundThreshold, mGradient;
+
+	/// Returns the fallof range, the fragment grid scale until the first update sets it
+	Real getEffectiveFallofRange() const {return mFallofRange ? mFallofRange : MetaWorldFragment::getScale(); }
 };
 
 }/// namespace Ogre
@@ -0,0 +1,97 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/phpBB2/viewtopic.php?t=32486
+
+Copyright (c) 2007 Martin Enge. Based on code from DWORD, released into public domain.
+martin.enge@gmail.com
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef META_NOISE_H
+#define META_NOISE_H
+
+#include "MetaObject.h"
+#include "FractalNoise.h"
+#include "OgreAxisAlignedBox.h"
+
+namespace Ogre
+{
+/** Bounded, seeded 3D noise field carving caves into a box shaped region.
+	@remarks
+		One MetaNoise replaces the thousands of MetaBalls needed to dig a cave 
+		network by hand, and is stored (and journaled) as a handful of parameters.
+		Tunnels follow the zero crossings of the noise: CT_RIDGED carves sheet like 
+		caverns along one noise field, CT_WORMS carves tubes where the crossings of
+		two fields meet. The field fades out towards the sides of the box, so the 
+		region can be placed anywhere without leaving walls behind.
+	@par
+		Noise rows are evaluated four grid points at a time (see FractalNoise).
+*/
+class MetaNoise : public MetaObject
+{
+public:
+	/// Shape of the carved tunnels (stored in files, do not renumber).
+	enum CaveType
+	{
+		CT_RIDGED = 0,
+		CT_WORMS = 1
+	};
+
+	/** Constructor
+		@param halfSize Half the extents of the region around position.
+		@param frequency Noise lattice cells per world unit.
+		@param threshold Width of the tunnels in noise units, about 0.02 to 0.2.
+		@param strength Field removed (or added) at the centre of a tunnel. */
+	MetaNoise(MetaWorldFragment *wf, const Vector3& position, const Vector3& halfSize, uint32 seed,
+		Real frequency, CaveType caveType = CT_WORMS, Real threshold = 0.08, Real strength = 0.5,
+		ushort octaves = 2, bool excavating = true);
+
+	/// Adds this meta noise to the data grid.
+	virtual void updateDataGrid(DataGrid* dataGrid);
+	virtual AxisAlignedBox getAABB() const;
+	virtual MetaObjectType getType() const {return MOT_NOISE;}
+
+	const Vector3& getHalfSize() const {return mHalfSize; }
+	uint32 getSeed() const {return mNoise.getSeed(); }
+	Real getFrequency() const {return mNoise.getFrequency(); }
+	ushort getOctaves() const {return mNoise.getOctaves(); }
+	CaveType getCaveType() const {return mCaveType; }
+	Real getThreshold() const {return mThreshold; }
+	Real getStrength() const {return mStrength; }
+	/// Returns true if the meta noise removes material.
+	virtual bool isExcavating() const {return mExcavating; }
+
+protected:
+	Vector3 mHalfSize;
+	CaveType mCaveType;
+	Real mThreshold;
+	Real mStrength;
+	bool mExcavating;
+	/// Field whose zero crossings form the tunnels
+	FractalNoise mNoise;
+	/// Second field crossed with the first for CT_WORMS
+	FractalNoise mNoise2;
+
+	/// Returns the fade factor (0..1) towards the sides of the region at a world position
+	Real getEdgeFade(const Vector3& pos) const;
+};
+
+} ///namespace Ogre
+#endif // META_NOISE_H
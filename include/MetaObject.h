@@ -40,9 +40,19 @@ class DataGrid;
 class MetaObject
 {
 public:
+	/// Concrete meta object types, used to identify objects in files (do not renumber).
+	enum MetaObjectType
+	{
+		MOT_HEIGHTMAP = 0,
+		MOT_BALL = 1,
+		MOT_NOISE = 2,
+		MOT_CAPSULE = 3,
+		MOT_STROKE = 4
+	};
+
 	/// Constructor
 	MetaObject(MetaWorldFragment *wf, const Vector3& position = Vector3::ZERO)
-		: mPosition(position), mMetaWorldFragment(wf) {;}
+		: mPosition(position), mMetaWorldFragment(wf), mRefCount(0) {;}
 	/// Virtual destructor
 	virtual ~MetaObject() {;}
 
@@ -58,10 +68,35 @@ public:
 	/// Checks for overlap with an AABB
 //	virtual bool intersects(const AxisAlignedBox aabb) const = 0;
 	virtual AxisAlignedBox getAABB() const = 0;
+	/// Returns the concrete type of the meta object.
+	virtual MetaObjectType getType() const = 0;
+	/** Returns true if the object only ever lowers the field, i.e. removes material.
+		@remarks
+			Digging where there is nothing but air changes nothing, which lets
+			fragments above the terrain skip such objects. */
+	virtual bool isExcavating() const {return false; }
+
+	/// Registers one more MetaWorldFragment holding on to this object.
+	void _addRef() {++mRefCount; }
+	/** Unregisters a MetaWorldFragment holding on to this object.
+		@remarks
+			A meta object spanning several tiles or y-levels is shared by all the
+			fragments it touches; it is deleted when the last of them lets go of it.
+		@returns
+			true if the object was deleted. */
+	bool _release()
+	{
+		if (--mRefCount > 0)
+			return false;
+		delete this;
+		return true;
+	}
 
 protected:
 	Vector3 mPosition;
 	MetaWorldFragment* mMetaWorldFragment;
+	/// Number of MetaWorldFragments referencing this object.
+	size_t mRefCount;
 };
 
 }//namespace Ogre
@@ -0,0 +1,95 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/phpBB2/viewtopic.php?t=32486
+
+Copyright (c) 2007 Martin Enge. Based on code from DWORD, released into public domain.
+martin.enge@gmail.com
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef META_STROKE_H
+#define META_STROKE_H
+
+#include "MetaObject.h"
+#include "OgreAxisAlignedBox.h"
+#include <vector>
+
+namespace Ogre
+{
+/** A sphere swept along a polyline, e.g. one drag of a digging tool.
+	@remarks
+		The field is that of a MetaBall of the same radius at the closest point
+		of the polyline, so a whole stroke digs a smooth tunnel in one object and
+		one remesh per touched fragment, where dropping balls along the path 
+		would create an object and a remesh each. Overlapping segments do not 
+		add up: every grid point only sees its nearest segment.
+	@par
+		Points are stored relative to the first one, which is the position of
+		the object, so setPosition() moves the whole stroke.
+*/
+class MetaStroke : public MetaObject
+{
+public:
+	/// Largest number of points of a stroke, longer paths are split (see OverhangTerrainSceneManager::addMetaStroke).
+	static const size_t MAX_POINTS = 256;
+
+	/// Constructor, points must not be empty.
+	MetaStroke(MetaWorldFragment *wf, const std::vector<Vector3>& points, Real radius = 30.0, bool excavating = true);
+
+	/// Adds this stroke to the data grid.
+	virtual void updateDataGrid(DataGrid* dataGrid);
+	virtual AxisAlignedBox getAABB() const;
+	virtual MetaObjectType getType() const {return MOT_STROKE;}
+
+	/// Returns the number of points of the polyline.
+	size_t getNumPoints() const {return mOffsets.size(); }
+	/// Returns a point of the polyline.
+	Vector3 getPoint(size_t i) const {return mPosition + mOffsets[i]; }
+	/// Returns the radius of the swept sphere.
+	Real getRadius() const {return mRadius; }
+	/// Returns true if the stroke removes material.
+	virtual bool isExcavating() const {return mExcavating; }
+
+protected:
+	/// Points relative to mPosition (mOffsets[0] is zero)
+	std::vector<Vector3> mOffsets;
+	Real mRadius;
+	bool mExcavating;
+
+	/// Constructor for subclasses setting up the points themselves
+	MetaStroke(MetaWorldFragment *wf, const Vector3& position, Real radius, bool excavating);
+};
+
+/// A sphere swept along a single segment.
+class MetaCapsule : public MetaStroke
+{
+public:
+	/// Constructor
+	MetaCapsule(MetaWorldFragment *wf, const Vector3& start, const Vector3& end, Real radius = 30.0, bool excavating = true);
+
+	virtual MetaObjectType getType() const {return MOT_CAPSULE;}
+	/// Returns the start of the segment (the position of the object).
+	const Vector3& getStart() const {return mPosition; }
+	/// Returns the end of the segment.
+	Vector3 getEnd() const {return mPosition + mOffsets[1]; }
+};
+
+} ///namespace Ogre
+#endif // META_STROKE_H
@@ -38,14 +38,28 @@ MetaWorldFragments for visibility culling (todo).
 
 #include <vector>
 #include "DataGrid.h"
+#include "IntersectionTests.h"
 
 namespace Ogre
 {
 class IsoSurfaceRenderable;
 class IsoSurfaceBuilder;
+class FragmentMeshCache;
 
 class MetaWorldFragment
 {
+public:
+	/// Where a fragment lies relative to the heightfield.
+	enum Classification
+	{
+		/// The heightfield surface passes through the fragment
+		FC_SURFACE = 0,
+		/// Entirely above the heightfield
+		FC_AIR,
+		/// Entirely below the heightfield
+		FC_SOLID
+	};
+
 protected:
 	IsoSurfaceRenderable *mSurf;
 	Vector3 mPosition;
@@ -62,19 +76,83 @@ protected:
 	/// position in y, counted in tile-sizes.
 	size_t mYLevel;
 	static std::string mMaterialName;
+
+	/** Density values of all MetaObjects that have been baked into this fragment, 
+		one per data grid point, or 0 if nothing has been baked yet. */
+	Real *mBakedValues;
+	/// Number of values in mBakedValues.
+	size_t mNumBakedValues;
+	/// Number of MetaObjects above which update() bakes the fragment automatically (0 = never).
+	static size_t mBakeThreshold;
+
+	/// Hash of the density grid the current IsoSurface was built from (see FragmentMeshCache).
+	uint64 mDensityHash;
+	/// Whether mDensityHash is up to date.
+	bool mDensityHashValid;
+	/// Cache of generated meshes consulted by update(), or 0.
+	static const FragmentMeshCache *mMeshCache;
+	/// Position relative to the heightfield, see setClassification().
+	Classification mClassification;
+	/** Data grid columns (x + z*numCells) whose surface the MetaObjects of this fragment
+		may have changed, one byte each; empty if none. */
+	std::vector<uchar> mCarvedColumns;
+	/// Columns update() builds, or 0 to build all (see setColumnMask).
+	const std::vector<uchar> *mColumnMask;
+	/// Snaps the border vertices of the IsoSurface onto the heightfield, or 0 (see setVertexSnap).
+	const VertexSnap *mVertexSnap;
 //	WfList mAdjacentFragments;
 
 public:
 	///Creates new MetaWorldFragment, as well as IsoSuface and grid as needed.
 	MetaWorldFragment(IsoSurfaceRenderable *is = 0, const Vector3 &position = Vector3::ZERO, int ylevel = 0);
+	///Releases the MetaObjects and the baked density grid.
+	~MetaWorldFragment();
 	///Adds MetaObject to mObjs, and to mMoDataGrid
 	void addMetaObject(MetaObject *mo);
 	///Updates IsoSurface
 	void update(IsoSurfaceBuilder *builder);
+	/** Bakes all MetaObjects into a stored density grid.
+		@remarks
+			The summed field of the baked layer and every MetaObject is evaluated once
+			and kept as the base layer of the fragment; the MetaObjects are released afterwards.
+			Later updates start from a copy of the baked layer instead of re-evaluating
+			the whole edit history. The IsoSurface is not rebuilt, since the field is unchanged.
+		@note
+			Gradient vectors are not baked - only the density values are kept. */
+	void bake(IsoSurfaceBuilder *builder);
+	/// Returns true if the fragment has a baked density layer.
+	bool isBaked() const {return mBakedValues != 0;}
+	/// Returns the baked density values (one per data grid point), or 0 if not baked.
+	const Real *getBakedValues() const {return mBakedValues;}
+	/** Replaces the field of the fragment with a copy of values (one per data grid point).
+		@remarks
+			Stored densities hold the complete field, so the MetaObjects not baked yet 
+			(e.g. the MetaHeightmap of a hole filler) are released rather than added again. */
+	void setBakedValues(const Real *values, size_t numGridPoints);
+	/** Adds values (one per data grid point) to the baked density layer, e.g. the change
+		of a field baked into it. */
+	void addBakedValues(const Real *values, size_t numGridPoints);
+	/// Returns true if a MetaHeightmap is among the MetaObjects not baked yet.
+	bool hasHeightmap() const;
+	/// Returns the bytes held by the fragment, its baked densities and its IsoSurface.
+	size_t getMemoryUsage() const;
+	/** Finds the nearest point the world space ray origin + t * dir hits the IsoSurface at,
+		for t in [0, maxT] (see IsoSurfaceRenderable::intersectRay).
+		@param t Receives the distance of the hit along dir */
+	bool intersectRay(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t) const;
+	/// As intersectRay, for a world space sphere or capsule sweep.
+	bool sweep(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal) const;
+	/// Returns the last frame the IsoSurface was queued for rendering in, 0 if it never was.
+	unsigned long getLastVisibleFrame() const;
+	/** Returns the hash of the fragment's density grid.
+		@remarks
+			Uses the value computed by the last update() if possible, otherwise the data grid
+			of the builder is refilled to compute it. */
+	uint64 getDensityHash(IsoSurfaceBuilder *builder);
 	int getNumMetaObjects() {return mObjs.size();} const
 	AxisAlignedBox getAABB() {return mAabb;} const
 	Vector3 getPosition() {return mPosition;} const
-	bool empty() {return mObjs.empty();}
+	bool empty() {return mObjs.empty() && !mBakedValues;}
 	static Real getScale() {return mGridScale;}
 	static Real getSize() {return mSize;}
 	static void setScale(Real s) {mGridScale = s;}
@@ -85,8 +163,48 @@ public:
 
 	static void setMaterialName(const std::string &name) {mMaterialName = name;}
 	static const std::string &getMaterialName() {return mMaterialName;}
+	/// Sets the number of MetaObjects that triggers an automatic bake (0 disables auto-baking).
+	static void setBakeThreshold(size_t n) {mBakeThreshold = n;}
+	static size_t getBakeThreshold() {return mBakeThreshold;}
+	/// Sets the cache update() takes meshes from when the density hash matches (0 disables it).
+	static void setMeshCache(const FragmentMeshCache *cache) {mMeshCache = cache;}
+	/** Sets where the fragment lies relative to the heightfield (see MetaHeightmap::classify).
+		@remarks
+			Air fragments holding nothing but excavating objects cannot contain a 
+			surface; update() then skips evaluating the field and meshing. */
+	void setClassification(Classification c) {mClassification = c;}
+	Classification getClassification() const {return mClassification;}
+	/// Returns true if the fragment cannot contain any surface, without evaluating its field.
+	bool isTriviallyEmpty() const;
+	/** Marks the data grid columns overlapping box in the xz-plane, grown by one cell, as carved.
+		@returns true if a column was not carved before. */
+	bool carveColumns(const AxisAlignedBox &box);
+	/// Replaces the carved columns with a copy of columns (getNumColumns() bytes), 0 clears them.
+	void setCarvedColumns(const uchar *columns);
+	/// Returns the carved columns, one byte per column, or an empty vector.
+	const std::vector<uchar>& getCarvedColumns() const {return mCarvedColumns;}
+	/** Restricts the IsoSurface to the columns set in mask (one byte per column, empty
+		for none), e.g. the holes of the heightfield below. 0 builds all columns (the default).
+		@remarks
+			The mask is not copied and has to stay valid while the fragment is updated. */
+	void setColumnMask(const std::vector<uchar> *mask) {mColumnMask = mask; mDensityHashValid = false;}
+	/** Sets the function update() snaps the vertices of the IsoSurface with, so its border
+		meets the heightfield next to it (see IsoSurfaceBuilder::setVertexSnap). 0 disables it.
+		@remarks
+			The function is not copied and has to stay valid while the fragment is updated. */
+	void setVertexSnap(const VertexSnap *snap) {mVertexSnap = snap; mDensityHashValid = false;}
+	/// Number of data grid columns, the size of carved column masks.
+	static size_t getNumColumns() {size_t n = getNumCells(); return n*n;}
+	/// Number of data grid cells along each side.
+	static size_t getNumCells() {return size_t(mSize/mGridScale + 0.5);}
 protected:
 	void addToWfList(MetaWorldFragment *wf);
+	/// Fills the data grid with the baked layer and the fields of all MetaObjects.
+	void fillDataGrid(DataGrid *dg);
+	/// Stores the current data grid values as the baked layer and releases the MetaObjects.
+	void bakeDataGrid(DataGrid *dg);
+	/// Hashes the densities in the data grid together with the column mask.
+	uint64 hashDataGrid(DataGrid *dg) const;
 
 };
 
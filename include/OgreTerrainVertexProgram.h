@@ -201,6 +201,48 @@ namespace Ogre {
     }
 
     @endcode
+    The compact variants are for tiles which only store their heights, the rest
+    of the position and the detail texture coords coming from a vertex grid shared
+    by all tiles (see OverhangTerrainOptions::compactVertices). They differ from
+    the above in how the position and main texture coords are found:
+    @code
+    // No fog morphing terrain, compact vertices
+    void terrain_vp_compact(
+	    float2 grid     : POSITION,
+	    float2 uv2	 	: TEXCOORD1,
+	    float height    : TEXCOORD2,
+	    float delta     : BLENDWEIGHT,
+
+	    out float4 oPosition : POSITION,
+	    out float2 oUv1		 : TEXCOORD0,
+	    out float2 oUv2		 : TEXCOORD1,
+	    out float4 colour    : COLOR,
+	    uniform float4x4 worldViewProj,
+	    uniform float morphFactor,
+	    // vertex of the tile start in its page, world offset of the page
+	    uniform float4 tileOrigin,
+	    // x / z scale, 1 / (page size - 1) 
+	    uniform float4 gridScale
+	    )
+    {
+	    // Vertex within the page
+	    float2 vertex = grid + tileOrigin.xy;
+	    float4 position = float4(0, 0, 0, 1);
+	    position.xz = vertex * gridScale.xy + tileOrigin.zw;
+	    // Apply morph
+	    position.y = height + (delta.x * morphFactor);
+	    // world / view / projection
+	    oPosition = mul(worldViewProj, position);
+	    // Main texture coords
+	    oUv1 = vertex * gridScale.zw;
+	    // Detail texture coords
+	    oUv2 = uv2;
+	    // Full bright (no lighting)
+	    colour = float4(1,1,1,1);
+    }
+    @endcode
+    The shadow receiver takes tileOrigin and gridScale after morphFactor, 
+    in c[14] and c[15].
     */
     class TerrainVertexProgram
     {
@@ -217,10 +259,30 @@ namespace Ogre {
         static String mExp2FogVs_1_1;
 		static String mShadowReceiverVs_1_1;
 
+        static String mCompactNoFogArbvp1;
+        static String mCompactLinearFogArbvp1;
+        static String mCompactExpFogArbvp1;
+        static String mCompactExp2FogArbvp1;
+        static String mCompactShadowReceiverArbvp1;
+
+        static String mCompactNoFogVs_1_1;
+        static String mCompactLinearFogVs_1_1;
+        static String mCompactExpFogVs_1_1;
+        static String mCompactExp2FogVs_1_1;
+        static String mCompactShadowReceiverVs_1_1;
+
+        /// The program sources for compact vertices
+        static const String& getCompactProgramSource(FogMode fogMode, 
+            const String syntax, bool shadowReceiver);
+
     public:
-        /// General purpose method to get any of the program sources
+        /** General purpose method to get any of the program sources
+        @param compact Whether the tiles use the compact vertex layout, with
+            tileOrigin in c[8] (c[14] for the shadow receiver) and gridScale 
+            in c[9] (c[15])
+        */
         static const String& getProgramSource(FogMode fogMode, 
-			const String syntax, bool shadowReceiver = false);
+			const String syntax, bool shadowReceiver = false, bool compact = false);
 
 
     };
@@ -35,14 +35,20 @@ Modified by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTer
 #include "OverhangTerrainPrerequisites.h"
 #include "OverhangTerrainPageSource.h"
 #include "OgreImage.h"
+#include "MappedFile.h"
 
 namespace Ogre {
 
     /** Specialisation of the TerrainPageSource class to provide tiles loaded
         from a 2D greyscale image.
     @remarks
-        This is a simple tile provider that does not support paging; it is
-        assumed that the entire heightmap is loaded as one page.
+        The heightmap may hold several pages: an image of (n * (pageSize-1)) + 1
+        samples a side provides n * n pages which share their edge samples.
+        When the scene manager asks for asynchronous loading, pages are 
+        prepared on its thread pool and attached by processPendingPages().
+    @par
+        RAW heightmaps found in a file system resource location are memory 
+        mapped, and tiles read their samples straight from the mapping.
     */	
     class _OverhangTerrainPluginExport OverhangHeightmapTerrainPageSource : public OverhangTerrainPageSource
     {
@@ -55,8 +61,12 @@ namespace Ogre {
         Image mImage;
         /// Arbitrary data loaded from RAW
         MemoryDataStreamPtr mRawData;
-        /// The (single) terrain page this source will provide
-        OverhangTerrainPage* mPage;
+        /// Mapping of the RAW file, used instead of mRawData where possible
+        MappedFile mRawFile;
+        /// Number of pages along each side of the heightmap
+        ushort mPagesPerSide;
+        /// Samples along each side of the heightmap
+        size_t mImageSize;
         /// Source file name
         String mSource;
         /// Manual size if source is RAW
@@ -66,6 +76,10 @@ namespace Ogre {
         
         /// Load a heightmap
         void loadHeightmap(void);
+        /// Returns the path of a resource in a file system location, or "" if it is elsewhere
+        String findFileSystemPath(const String& resource) const;
+        /// @see OverhangTerrainPageSource
+        OverhangTerrainPage* _preparePage(ushort x, ushort z);
     public:
         OverhangHeightmapTerrainPageSource();
         ~OverhangHeightmapTerrainPageSource();
@@ -76,6 +90,8 @@ namespace Ogre {
         /// @see TerrainPageSource
         void expirePage(ushort x, ushort y);
         /// @see TerrainPageSource
+        bool hasPage(ushort x, ushort y) const { return x < mPagesPerSide && y < mPagesPerSide; }
+        /// @see TerrainPageSource
         void initialise(OverhangTerrainSceneManager* tsm, 
             ushort tileSize, ushort pageSize, bool asyncLoading, 
             OverhangTerrainPageSourceOptionList& optionList);
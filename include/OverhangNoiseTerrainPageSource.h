@@ -0,0 +1,82 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+#ifndef __OverhangNoiseTerrainPageSource_H__
+#define __OverhangNoiseTerrainPageSource_H__
+
+#include "OverhangTerrainPrerequisites.h"
+#include "OverhangTerrainPageSource.h"
+#include "FractalNoise.h"
+
+namespace Ogre {
+
+    /** Page source generating page heights from seeded fractal noise.
+    @remarks
+        Nothing is read from disk; every page is a window onto one endless
+        noise field, so the same options always give the same world and pages 
+        can be expired and generated again at will. The rows of a page are 
+        split across the scene manager's thread pool when there is one.
+    @par
+        Heights are offset + amplitude * noise, clamped to 0..1 and scaled by 
+        the terrain scale as usual.
+    */
+    class _OverhangTerrainPluginExport OverhangNoiseTerrainPageSource : public OverhangTerrainPageSource
+    {
+    protected:
+        /// The noise field
+        FractalNoise mNoise;
+        /// Normalised height of noise value 0
+        Real mOffset;
+        /// Normalised height change per unit of noise
+        Real mAmplitude;
+        /// Samples generated so far and the time it took, for getSamplesPerSecond()
+        size_t mSamplesGenerated;
+        unsigned long mGenerationMicroseconds;
+        /// Guards the statistics, pages may be generated concurrently
+        boost::mutex mStatsMutex;
+
+        /// @see OverhangTerrainPageSource
+        OverhangTerrainPage* _preparePage(ushort x, ushort z);
+        /// Generates rows [begin, end) of page (x, z) into heights
+        void _generateRows(ushort x, ushort z, Real* heights, size_t begin, size_t end) const;
+    public:
+        OverhangNoiseTerrainPageSource();
+        ~OverhangNoiseTerrainPageSource();
+        /// @see TerrainPageSource
+        void shutdown(void);
+        /// @see TerrainPageSource
+        void requestPage(ushort x, ushort y);
+        /// @see TerrainPageSource
+        void expirePage(ushort x, ushort y);
+        /// @see TerrainPageSource
+        void initialise(OverhangTerrainSceneManager* tsm, 
+            ushort tileSize, ushort pageSize, bool asyncLoading, 
+            OverhangTerrainPageSourceOptionList& optionList);
+
+        /// Returns the noise field pages are generated from
+        const FractalNoise& getNoise(void) const { return mNoise; }
+        /// Average height samples generated per second so far, 0 before the first page
+        Real getSamplesPerSecond(void);
+    };
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef OVERHANG_TERRAIN_HEIGHT_DATA_H
+#define OVERHANG_TERRAIN_HEIGHT_DATA_H
+
+#include "OverhangTerrainPrerequisites.h"
+
+namespace Ogre
+{
+/** Read-only view of the normalised (0..1) height samples of a terrain page.
+	@remarks
+		Page sources hand this to OverhangTerrainPageSource::buildPage instead of a
+		converted Real array, so tiles can read 8 or 16 bit samples in place, e.g.
+		straight out of a memory mapped RAW file or a loaded Image. Samples are 
+		scaled to 0..1 as they are read. A view can cover one page of a larger
+		heightmap holding several pages.
+*/
+class OverhangTerrainHeightData
+{
+public:
+	/// View of pageSize*pageSize normalised heights.
+	OverhangTerrainHeightData(const Real* heights, size_t pageSize)
+		: mHeights(heights), mSamples(0), mPageSize(pageSize), mBytesPerSample(0), 
+		mFlip(false), mInvScale(1), mRowLength(pageSize), mOriginX(0), mOriginZ(0), mLittleEndian(false)
+	{
+	}
+	/** View of a page of unsigned samples.
+		@param bytesPerSample 1 or 2
+		@param flip Read the rows of the whole heightmap bottom up.
+		@param rowLength Samples per row of the (square) heightmap, 0 if it holds 
+			just this page.
+		@param originX, originZ First sample of the page within the heightmap.
+		@param littleEndian Whether 16 bit samples are stored little endian, as in RAW 
+			files, rather than in native byte order, as in a loaded Image. */
+	OverhangTerrainHeightData(const uchar* samples, size_t pageSize, uchar bytesPerSample, bool flip,
+		size_t rowLength = 0, size_t originX = 0, size_t originZ = 0, bool littleEndian = false)
+		: mHeights(0), mSamples(samples), mPageSize(pageSize), mBytesPerSample(bytesPerSample), 
+		mFlip(flip), mInvScale(bytesPerSample == 2 ? 1.0f / 65535.0f : 1.0f / 255.0f),
+		mRowLength(rowLength ? rowLength : pageSize), mOriginX(originX), mOriginZ(originZ),
+		mLittleEndian(littleEndian)
+	{
+		assert(bytesPerSample == 1 || bytesPerSample == 2);
+		assert(mOriginX + pageSize <= mRowLength && mOriginZ + pageSize <= mRowLength);
+	}
+
+	/// Returns the normalised height at vertex (x, z) of the page.
+	inline Real getHeight(size_t x, size_t z) const
+	{
+		if (mHeights)
+			return mHeights[z * mPageSize + x];
+		z += mOriginZ;
+		if (mFlip)
+			z = mRowLength - z - 1;
+		size_t i = z * mRowLength + x + mOriginX;
+		if (mBytesPerSample == 2)
+		{
+#if OGRE_ENDIAN == OGRE_ENDIAN_BIG
+			if (mLittleEndian)
+			{
+				const uchar* p = mSamples + 2 * i;
+				return Real(p[0] | (p[1] << 8)) * mInvScale;
+			}
+#endif
+			return Real(reinterpret_cast<const uint16*>(mSamples)[i]) * mInvScale;
+		}
+		return Real(mSamples[i]) * mInvScale;
+	}
+
+	/// Number of vertices along one edge of the page.
+	size_t getPageSize() const {return mPageSize; }
+
+	/** Converts all samples into heights (pageSize*pageSize Reals), for consumers 
+		that need a modifiable copy, such as page source listeners. */
+	void copyTo(Real* heights) const
+	{
+		for (size_t z = 0; z < mPageSize; ++z)
+			for (size_t x = 0; x < mPageSize; ++x)
+				*heights++ = getHeight(x, z);
+	}
+
+protected:
+	const Real* mHeights;
+	const uchar* mSamples;
+	size_t mPageSize;
+	uchar mBytesPerSample;
+	bool mFlip;
+	Real mInvScale;
+	size_t mRowLength;
+	size_t mOriginX;
+	size_t mOriginZ;
+	bool mLittleEndian;
+};
+
+}// namespace Ogre
+#endif // OVERHANG_TERRAIN_HEIGHT_DATA_H
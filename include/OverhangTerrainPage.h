@@ -33,7 +33,9 @@ Modified by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTer
 #define __OverhangTerrainPage_H__
 
 #include "OverhangTerrainPrerequisites.h"
+#include "TerrainTile.h"
 #include "OgreRenderQueue.h"
+#include "OgreHardwareVertexBuffer.h"
 
 namespace Ogre {
 
@@ -63,6 +65,8 @@ namespace Ogre {
         unsigned short tilesPerPage;
         /// The scene node to which all the tiles for this page are attached
         SceneNode* pageSceneNode;
+        /// Index of the page in the scene manager's page grid
+        ushort pageX, pageZ;
 
         /** The main constructor. 
         @param numTiles The number of terrain tiles (TerrainTile)
@@ -79,6 +83,18 @@ namespace Ogre {
             Should be called before adding the page to the scene manager.
         */
         void linkNeighbours(void);
+        /** Links the edge tiles of this page with those of an adjacent page,
+            in both directions.
+        @param side The side of this page the other page lies on.
+        @param page The adjacent page, or 0 to unlink this side.
+        */
+        void linkNeighbourPage(TerrainTile::Neighbor side, OverhangTerrainPage* page);
+        /// Recalculates the normals of the tiles along one side of the page
+        void calculateEdgeNormals(TerrainTile::Neighbor side);
+        /// Returns the bytes held by the tiles of this page
+        size_t getMemoryUsage(void) const;
+        /// Returns the last frame any tile of the page was queued for rendering in
+        unsigned long getLastVisibleFrame(void) const;
 
         /** Returns the TerrainTile that contains the given pt.
         If no tile exists at the point, it returns 0;
@@ -88,6 +104,52 @@ namespace Ogre {
 		/** Sets the render queue group which the tiles should be rendered in. */
 		void setRenderQueue(uint8 qid);
 
+        /** Calculates the vertex colours of all tiles: the ambient light, plus the sun
+            (OverhangTerrainOptions::sunDirection) on vertices it is above the horizon of.
+        @remarks
+            Horizons are found by sweeping each grid line running towards the sun once,
+            keeping the upper convex hull of the heights passed, instead of marching a 
+            ray per vertex. Only the two of the 8 grid directions either side of the sun 
+            are swept, and blended; the lines are split across pool. Terrain in other 
+            pages does not cast shadows.
+        @par
+            May be called before the tiles are loaded, the colours are staged then.
+            Does nothing if the terrain is not coloured.
+        @param pool Threads to split the work across, or 0
+        */
+        void calculateLighting(ThreadPool* pool = 0);
+        /** Recalculates the vertex colours after the heights inside the world space 
+            rectangle [minX, maxX] x [minZ, maxZ] changed.
+        @remarks
+            Only the lines through the rectangle are swept again, and only the vertices 
+            behind it as seen from the sun are coloured again. Falls back to 
+            calculateLighting if the sun moved since.
+        */
+        void updateLighting(Real minX, Real minZ, Real maxX, Real maxZ, ThreadPool* pool = 0);
+
+    protected:
+        /// Horizon slopes (rise over run) of each vertex, along the grid directions mHorizonDir
+        std::vector<float> mHorizons[2];
+        /// Grid directions swept for mHorizons, see calculateLighting
+        int mHorizonDir[2];
+        /// Weight of mHorizons[1] in the horizon of a vertex
+        Real mHorizonBlend;
+        /// Sun direction mHorizons were swept for
+        Vector3 mHorizonSun;
+
+        /// Returns the options shared by all tiles
+        const OverhangTerrainOptions& _getOptions(void) const;
+        /// Copies the heights of all vertices of the page into heights, row by row
+        void _getHeights(std::vector<float>& heights) const;
+        /** Sweeps horizons along the lines through the vertices [x0, x1] x [z0, z1], 
+            and colours the vertices whose horizon or normal may have changed. */
+        void _calculateLighting(int x0, int z0, int x1, int z1, ThreadPool* pool);
+        /** Sweeps the lines [begin, end) of starts along grid direction mHorizonDir[slot].
+        @param starts Index of the vertex each line starts at, the one nearest the sun */
+        void _sweepHorizons(const float* heights, int slot, const int* starts, size_t begin, size_t end);
+        /// Colours the rows [z0 + begin, z0 + end) of the vertices [x0, x1] into colours
+        void _shadeVertices(const float* heights, int x0, int z0, int x1, RGBA* colours, 
+            VertexElementType colourType, size_t begin, size_t end);
 
     };
 
@@ -36,6 +36,10 @@ Modified by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTer
 #include "OverhangTerrainPrerequisites.h"
 #include "OgreSingleton.h"
 
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+
 namespace Ogre {
 
     typedef std::pair<String, String> OverhangTerrainPageSourceOption;
@@ -48,6 +52,10 @@ namespace Ogre {
     {
     public:
         /** Listener method called when a new page is about to be constructed. 
+        @remarks
+            When pages are loaded in the background this is called on a loader
+            thread, so listeners must not touch the scene graph and must be safe
+            to call for several pages at once.
 		@param manager The manager in question
         @param pagex, pagez The index of the page being constructed
         @param heightData Array of normalised height data (0..1). The size of
@@ -82,6 +90,8 @@ namespace Ogre {
         */
         void removeListener(OverhangTerrainPageSourceListener* pl);
 		
+        /// Returns true if any listener is registered
+        bool hasListeners(void) const { return !mPageSourceListeners.empty(); }
         /// Fire pageContructed events
         void firePageConstructed(OverhangTerrainSceneManager* manager, size_t pagex, size_t pagez, Real* heightData);
 
@@ -132,9 +142,12 @@ namespace Ogre {
         them); it is up to the tile source whether that memory is actually freed
         or held for a while longer.
         </ol>
-    @note The comments on paging above are in principle, the implementation of
-    paging in this manager is not present yet but the system is designed to 
-    extend to it. For now, all tiles are requested up-front.
+    @par
+        Pages are built in two stages: preparePage() does all the CPU work and
+        may run on a loader thread, loadPage() creates the scene nodes and 
+        hardware buffers on the main thread. Sources loading in the background
+        hand prepared pages to _queuePreparedPage(), and the scene manager 
+        finishes and attaches them each frame through processPendingPages().
     */
     class _OverhangTerrainPluginExport OverhangTerrainPageSource
     {
@@ -151,6 +164,9 @@ namespace Ogre {
         /// Internal method for firing pageContructed events
         void firePageConstructed(size_t pagex, size_t pagez, Real* heightData);
 
+        /// Returns true if someone listens to pageConstructed events
+        bool hasPageListeners(void) const;
+
         /** Utility method for building a page of tiles based on some source
         data, wherever that may have come from.
         @remarks
@@ -159,11 +175,86 @@ namespace Ogre {
             creates.
         */
         virtual OverhangTerrainPage* buildPage(Real* heightData, const MaterialPtr& pMaterial);
+        /** Builds a page of tiles reading the heights through a view, which lets
+            sources hand out samples without converting them first.
+        */
+        virtual OverhangTerrainPage* buildPage(const OverhangTerrainHeightData& heightData, 
+            const MaterialPtr& pMaterial, ushort pageX = 0, ushort pageZ = 0);
+        /** Creates the tiles of a page and prepares them in system memory:
+            positions, bounds, LOD distances, normals and colours.
+        @remarks
+            Does not touch the scene graph or the render system, so it may be
+            called from a loader thread. The tiles are prepared across the scene 
+            manager's thread pool, if it has one. The page is not usable until 
+            it has been passed to loadPage().
+        */
+        virtual OverhangTerrainPage* preparePage(const OverhangTerrainHeightData& heightData, 
+            ushort pageX, ushort pageZ);
+        /// Prepares the tiles [begin, end) of page, counted row by row; parallelFor body of preparePage()
+        void _prepareTiles(OverhangTerrainPage* page, const OverhangTerrainHeightData* heightData, 
+            size_t begin, size_t end);
+        /// Stages the normals of the tiles [begin, end) of page; parallelFor body of preparePage()
+        void _calculateTileNormals(OverhangTerrainPage* page, size_t begin, size_t end);
+        /** Creates the scene nodes and hardware buffers of a prepared page.
+            Must be called on the main thread.
+        */
+        virtual void loadPage(OverhangTerrainPage* page, const MaterialPtr& pMaterial);
+
+        /** Queues a prepared page for processPendingPages(); may be called 
+            from any thread.
+        */
+        void _queuePreparedPage(OverhangTerrainPage* page);
+        /** Called by processPendingPages() once a queued page has been loaded,
+            before it is attached to the scene manager.
+        */
+        virtual void _notifyPageLoaded(OverhangTerrainPage* page);
+        /// Deletes queued pages which have not been loaded yet
+        void _discardPreparedPages(void);
+
+        /** Prepares page (x, z) in system memory for _loadPage().
+        @remarks
+            Runs on a loader thread when loading asynchronously. Sources using
+            _loadPage() override this; the default has no pages.
+        @returns The page, or 0 if it could not be built.
+        */
+        virtual OverhangTerrainPage* _preparePage(ushort x, ushort z) { return 0; }
+        /** Fires the listeners for a page and prepares it from the resulting heights.
+        @remarks
+            Listeners get a converted copy of the heights, since they may modify them.
+            Returns 0 without a scene manager.
+        */
+        OverhangTerrainPage* _preparePage(const OverhangTerrainHeightData& heightData, ushort x, ushort z);
+        /** Builds page (x, z) through _preparePage() and attaches it, on the thread 
+            pool when loading asynchronously. Does nothing if the page is loaded or loading.
+        */
+        void _loadPage(ushort x, ushort z);
+        /// Thread pool task of _loadPage()
+        void _preparePageTask(ushort x, ushort z);
+        /// Deletes a page loaded with _loadPage()
+        void _unloadPage(ushort x, ushort z);
+        /// Waits for the pages in flight and deletes all pages loaded with _loadPage()
+        void _unloadAllPages(void);
+
+        typedef std::pair<ushort, ushort> PageKey;
+        typedef std::map<PageKey, OverhangTerrainPage*> PageMap;
+        /// The pages loaded by _loadPage()
+        PageMap mPages;
+        /// Pages being prepared on the thread pool
+        std::set<PageKey> mLoadingPages;
+        /// The pool pages are prepared on, 0 when loading synchronously
+        ThreadPool* mThreadPool;
+
+        /// Prepared pages waiting for the main thread
+        std::vector<OverhangTerrainPage*> mPreparedPages;
+        /// Guards mPreparedPages
+        boost::mutex mPreparedPagesMutex;
+        /// Material used by processPendingPages()
+        MaterialPtr mPendingMaterial;
 
 
     public:
         OverhangTerrainPageSource(); 
-        virtual ~OverhangTerrainPageSource() { shutdown(); }
+        virtual ~OverhangTerrainPageSource() { shutdown(); _discardPreparedPages(); }
 
         /** Initialise this tile source based on a series of options as
             dictated by the scene manager. 
@@ -187,13 +278,7 @@ namespace Ogre {
         */
         virtual void initialise(OverhangTerrainSceneManager* tsm, 
             ushort tileSize, ushort pageSize, bool asyncLoading, 
-            OverhangTerrainPageSourceOptionList& optionList)
-        {
-            mSceneManager = tsm;
-            mTileSize = tileSize;
-            mPageSize = pageSize;
-            mAsyncLoading = asyncLoading;
-        }
+            OverhangTerrainPageSourceOptionList& optionList);
         /** Shut down this tile source, freeing all it's memory ready for 
             decommissioning.
         @remarks
@@ -241,6 +326,18 @@ namespace Ogre {
         @param z The z index of the page expired
         */
         virtual void expirePage(ushort x, ushort z) = 0;
+        /** Returns false if the source has no data for the page, so requesting
+            it would do nothing.
+        */
+        virtual bool hasPage(ushort x, ushort z) const { return true; }
+
+        /** Loads the pages prepared in the background since the last call and
+            attaches them to the scene manager.
+        @remarks
+            Called by the scene manager once per frame, on the main thread.
+        @returns The number of pages attached
+        */
+        virtual size_t processPendingPages(void);
         
         /** Register a class which will be called back whenever a new page is
             available.
@@ -35,6 +35,7 @@ Modified by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTer
 
 //#include "OgrePrerequisites.h"
 #include "Ogre.h"
+#include <boost/function.hpp>
 //-----------------------------------------------------------------------
 // Forward declarations
 //-----------------------------------------------------------------------
@@ -44,8 +45,11 @@ namespace Ogre
     class OverhangTerrainSceneManager;
     class OverhangTerrainPageSource;
     class OverhangTerrainRenderable;
+    class OverhangTerrainOptions;
 	class TerrainTile;
     class OverhangTerrainPage;
+    class OverhangTerrainHeightData;
+    class ThreadPool;
 
 	class DataGrid;
 	class MetaObjectDataGrid;
@@ -55,6 +59,17 @@ namespace Ogre
 	class MetaObject;
 	class MetaBall;
 	class MetaWorldFragment;
+	class FragmentDensityFile;
+	class FragmentMeshCache;
+	class TerrainEditJournal;
+
+	/** Height brush, see OverhangTerrainSceneManager::modifyHeights. Returns the new 
+		height of the vertex at world x, z, given its current height. */
+	typedef boost::function<Real (Real x, Real z, Real height)> HeightBrush;
+
+	/** Vertex snap, see IsoSurfaceBuilder::setVertexSnap. Moves a surface vertex given in 
+		world space onto a seam with the heightfield; returns false if it is not on a seam. */
+	typedef boost::function<bool (Vector3& position)> VertexSnap;
 
 }
 //-----------------------------------------------------------------------
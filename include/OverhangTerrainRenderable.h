@@ -48,17 +48,19 @@ Modified by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTer
 #include <OgreAxisAlignedBox.h>
 #include <OgreString.h>
 #include <OgreHardwareBufferManager.h>
+#include <OgreVector4.h>
+#include "IntersectionTests.h"
 
 #include <vector>
 
 #define MORPH_CUSTOM_PARAM_ID 77
+#define GRID_CUSTOM_PARAM_ID 78
 
 namespace Ogre
 {
 
     typedef std::map <unsigned int, IndexData* > IndexMap;
     typedef std::vector < IndexData* > IndexArray;
-    typedef std::vector < IndexMap* > LevelArray;
 
     /**
     * A cache of TerrainIndexBuffers.  Used to keep track of the buffers, and
@@ -105,9 +107,12 @@ namespace Ogre
             detailTile = 1;
             lit = false;
             coloured = false;
+            sunDirection = Vector3( 1, 1, 1 ).normalisedCopy();
+            ambientLight = ColourValue( 0.3, 0.3, 0.3 );
             lodMorph = false;
             lodMorphStart = 0.5;
             useTriStrips = false;
+            compactVertices = false;
             primaryCamera = 0;
             terrainMaterial.setNull();
         };
@@ -128,6 +133,10 @@ namespace Ogre
         size_t maxPixelError;
         /// Whether we should use triangle strips
         bool useTriStrips;
+        /** Whether tiles only store the heights of their vertices, the x / z and 
+        the detail texture coords coming from a vertex grid shared by all tiles. 
+        Only set along with the vertex program reading that layout. */
+        bool compactVertices;
         /// The number of times to repeat a detail texture over a tile
         size_t detailTile;
         /// Whether LOD morphing is enabled
@@ -138,6 +147,10 @@ namespace Ogre
         bool lit;
         /// Whether vertex colours are enabled
         bool coloured;
+        /// Unit direction towards the sun, for the vertex colours
+        Vector3 sunDirection;
+        /// Light added to every vertex colour, shadowed or not
+        ColourValue ambientLight;
         /// Pointer to the material to use to render the terrain
         MaterialPtr terrainMaterial;
 
@@ -184,8 +197,22 @@ namespace Ogre
         The starting points of the top-left of this tile, in terms of the
         number of vertices.
         @param pageHeightData The source height data for the entire parent page
+        @param originx, originz
+        The world position of the parent page, in vertices
         */
-        void initialise(int startx, int startz, Real* pageHeightData);
+        void initialise(int startx, int startz, const OverhangTerrainHeightData& pageHeightData,
+            int originx = 0, int originz = 0);
+        /** First half of initialise: computes vertices, bounds and LOD distances
+        in system memory.
+        @remarks
+        Does not touch the render system, so pages can be prepared on a loader thread.
+        */
+        void prepare(int startx, int startz, const OverhangTerrainHeightData& pageHeightData,
+            int originx = 0, int originz = 0);
+        /** Second half of initialise: creates the hardware buffers from the prepared
+        data. Must be called from the rendering thread.
+        */
+        void load(void);
 
         //movable object methods
 
@@ -210,6 +237,11 @@ namespace Ogre
 	/* added manually */
         virtual void _updateRenderQueue( RenderQueue* queue );
 
+        /// Returns the bytes held by the hardware buffers, the position copy and any staging data
+        size_t getMemoryUsage(void) const;
+        /// Returns the number of the last frame the tile was queued for rendering in
+        unsigned long getLastVisibleFrame(void) const { return mLastVisibleFrame; }
+
         /**
         Constructs a RenderOperation to render the TerrainRenderable.
         @remarks
@@ -247,16 +279,75 @@ namespace Ogre
 
         float getHeightAt( float x, float y );
 
-        /** Intersects the segment witht he terrain tile
+        /** Returns the heights at count points, as getHeightAt.
+        @remarks
+            Meant for points the caller has already sorted by tile (see 
+            OverhangTerrainSceneManager::getHeightsAt): points outside this tile are 
+            clamped onto its border rather than passed on to the neighbours, so the loop 
+            reads nothing but mPositionBuffer. With SSE2 it does four points at a time.
+        */
+        void getHeightsAt( const float* x, const float* z, float* heights, size_t count );
+
+        /** Returns the normals of the triangles under count points, clamped as for getHeightsAt.
+        @remarks
+            These are the exact face normals _getNormalAt approximates by differences.
+        */
+        void getNormalsAt( const float* x, const float* z, Vector3* normals, size_t count );
+
+        /** Intersects the segment with the heightfield, carrying on into neighbouring tiles.
+        @remarks
+            The quads are visited in the order the segment crosses them, skipping every
+            node of a min/max height quadtree it passes above, and each is tested exactly 
+            against the triangles drawn at the highest LOD. Holes and hidden tiles
+            are passed through, see OverhangTerrainSceneManager::intersectFragments.
+        @param result Receives the first point on the segment at or below the heightfield,
+            (-1, -1, -1) if there is none; may be 0
         */
         bool intersectSegment( const Vector3 & start, const Vector3 & end, Vector3 * result );
 
+        /// Maximum number of segments intersectSegments traces together
+        static const int RAY_PACKET_SIZE = 4;
+
+        /** Intersects up to RAY_PACKET_SIZE segments starting on this tile with the heightfield,
+        as intersectSegment does one at a time.
+        @remarks
+            The segments sharing a tile walk its quadtree together: each node is read once 
+            and clipped against all of them in one loop, and only the segments still 
+            below its maximum height descend. Segments from a small area in similar 
+            directions (line of sight fans, bursts of projectiles) share most nodes.
+        @param starts Segment starts
+        @param dirs Normalised segment directions
+        @param lengths Segment lengths
+        @param t Receives the distance of each hit along dirs, -1 if there is none
+        @returns the number of segments that hit the heightfield
+        */
+        int intersectSegments( int count, const Vector3* starts, const Vector3* dirs, 
+            const Real* lengths, Real* t );
+
+        /** Finds when a sphere or capsule sweeping across this tile first touches the heightfield.
+        @remarks
+            The sweep is tested against every node of the min/max height quadtree grown by
+            the shape, so only the quads close to its path are tested exactly. It does not
+            carry on into neighbouring tiles, see OverhangTerrainSceneManager::sweepCapsule.
+        @param t Receives the distance along the sweep direction
+        @param normal Receives the contact normal, pointing away from the heightfield
+        */
+        bool sweep( const IntersectionTests::Sweep& sweep, Real maxT, Real& t, Vector3& normal );
+
+        /** Intersects the segment with the heightfield by sampling it in unit steps, 
+        as intersectSegment used to.
+        @note Kept as the reference OverhangTerrainSceneManager::_benchmarkRayQueries 
+            measures against.
+        */
+        bool _marchSegment( const Vector3 & start, const Vector3 & end, Vector3 * result );
+
         /** Sets the appropriate neighbor for this TerrainRenderable.  Neighbors are necessary
         to know when to bridge between LODs.
         */
         void _setNeighbor( Neighbor n, OverhangTerrainRenderable *t )
         {
             mNeighbors[ n ] = t;
+            _clearSeamIndices();
         };
 
         /** Returns the neighbor TerrainRenderable
@@ -272,15 +363,85 @@ namespace Ogre
             mMaterial = m;
         };
 
-        /** Calculates static normals for lighting the terrain */
+        /** Calculates static normals for lighting the terrain.
+        @remarks
+            Goes to the staged vertices if the tile has not been loaded yet; the 
+            neighbours must have been prepared then, since normals read across edges.
+        */
         void _calculateNormals();
 
+        /** Applies brush to the vertices inside the world space rectangle 
+        [minX, maxX] x [minZ, maxZ].
+        @remarks
+            Only the rows holding the rectangle are locked in the vertex buffer. Bounds 
+            and LOD distances are recalculated if a height changed; normals are not, 
+            see _updateNormals.
+        @param deltas If given, the height changes are added up in it per vertex 
+            (see _index); it is sized on the first change.
+        @returns true if any height changed
+        */
+        bool _modifyHeights( Real minX, Real minZ, Real maxX, Real maxZ, const HeightBrush& brush,
+            std::vector<float>* deltas = 0 );
+
+        /** Clips the world space rectangle to this tile's vertices.
+        @returns false if no vertex lies inside the rectangle
+        */
+        bool _getVertexRect( Real minX, Real minZ, Real maxX, Real maxZ, 
+            int& x0, int& z0, int& x1, int& z1 );
+
+        /** Cuts holes into the heightfield, e.g. where MetaWorldFragments take over.
+        @param holes One byte per quad (x + z * (tileSize - 1)), non-zero quads are not drawn.
+        @remarks
+            Holes are rounded out to whole quads of the coarsest LOD, so every LOD leaves out
+            the same area; getHoles() returns the rounded mask. The rims of the holes are
+            always stitched to the coarsest LOD, see _snapToSeam.
+        @returns true if the rounded mask changed
+        */
+        bool _setHoles( const std::vector<uchar>& holes );
+
+        /** Moves a world space position lying on the rim of a hole, or on the edge of a 
+        hidden tile, onto the heightfield as it is drawn there.
+        @remarks
+            Rims are drawn with the vertices of the coarsest LOD only, whatever the LOD of 
+            this tile and its neighbours, so geometry filling a hole can meet the heightfield
+            without cracks once its border is snapped. Positions further than one coarse 
+            quad above or below the rim are left alone.
+        @returns true if position was moved
+        */
+        bool _snapToSeam( Vector3& position );
+
+        /** Drops the index buffers of this tile and its neighbours that depend on holes
+        or visibility, after either changed. */
+        void _notifySeamsChanged(void);
+
+        /// Returns the quads left out by _setHoles (one byte per quad), empty if there are none
+        const std::vector<uchar>& getHoles() const { return mHoles; }
+
+        /// Returns the options shared by all tiles
+        const OverhangTerrainOptions* getOptions() const { return mOptions; }
+
+        /** Recalculates the normals of the vertices inside the world space rectangle
+        [minX, maxX] x [minZ, maxZ], after heights in or next to it have changed.
+        Does nothing if the terrain is not lit. */
+        void _updateNormals( Real minX, Real minZ, Real maxX, Real maxZ );
 
 
 
-        /** Generates terrain shadows and lighting using vertex colors
+
+        /** Writes the vertex colours of the vertices [x0, x1] x [z0, z1] of this tile.
+        @param colours Packed colours, the one of vertex (x, z) at (x - x0) + (z - z0) * pitch.
+        @remarks
+            Goes to the staged vertices if the tile has not been loaded yet, so may be 
+            called from prepare(); otherwise only the rows holding the rectangle are locked.
+            Does nothing if the terrain is not coloured.
         */
-        void _generateVertexLighting( const Vector3 &sunlight, ColourValue ambient );
+        void _setVertexColours( int x0, int z0, int x1, int z1, const RGBA* colours, size_t pitch );
+
+        /// Returns the height of vertex (x, z) of this tile
+        float _getVertexHeight( int x, int z ) const
+        {
+            return mPositionBuffer[ ( x + z * mOptions->tileSize ) * 3 + 1 ];
+        }
 
 
         /** Overridden, see Renderable */
@@ -292,7 +453,7 @@ namespace Ogre
         /** @copydoc Renderable::getLights */
         const LightList& getLights(void) const;
 
-        /// Overridden from Renderable to allow the morph LOD entry to be set
+        /// Overridden from Renderable to allow the morph LOD and grid origin entries to be set
         void _updateCustomGpuParameter(
             const GpuProgramParameters::AutoConstantEntry& constantEntry,
             GpuProgramParameters* params) const;
@@ -301,6 +462,18 @@ namespace Ogre
 
 		Vector3 getCenter() const {return mCenter;}
 
+        /** Writes the indexes of a tile at LOD level, stitched to its neighbours as 
+        given by stitchFlags (see getIndexData), to pIdx.
+        @remarks
+            Reads nothing but options, so may run on any thread; the same indexes 
+            serve every tile.
+        @returns The number of indexes written, at most _getMaxIndexCount(options, level)
+        */
+        static size_t _buildIndexes(const OverhangTerrainOptions& options, int level, 
+            unsigned int stitchFlags, unsigned short* pIdx);
+        /// Returns the size of the buffer _buildIndexes needs at level
+        static size_t _getMaxIndexCount(const OverhangTerrainOptions& options, int level);
+
     protected:
 		/// Parent SceneManager
 		OverhangTerrainSceneManager* mSceneManager;
@@ -312,6 +485,11 @@ namespace Ogre
         {
             return ( x + z * mOptions->tileSize );
         };
+        /// As above, for the static index builders
+        static inline size_t _index( const OverhangTerrainOptions& options, int x, int z )
+        {
+            return ( x + z * options.tileSize );
+        };
 
         /** Returns the  vertex coord for the given coordinates */
         inline float _vertex( int x, int z, int n )
@@ -353,6 +531,46 @@ namespace Ogre
 
         Real _calculateCFactor();
 
+        /// Calculates mBounds, mCenter and mBoundingRadius from mPositionBuffer
+        void _calculateBounds();
+
+        /** Recalculates the nodes of mHeightTree over the vertices [x0, x1] x [z0, z1] 
+        and their parents */
+        void _updateHeightTree( int x0, int z0, int x1, int z1 );
+
+        /// Index of the min height of node (x, z) at the given level in mHeightTree, max follows
+        inline size_t _heightTreeIndex( int level, int x, int z ) const
+        {
+            return ( ( ( 1 << ( 2 * level ) ) - 1 ) / 3 + x + ( z << level ) ) * 2;
+        }
+
+        /** Finds the first hit of the ray start + t * dir, ta <= t <= tb, inside 
+        quadtree node (x, z) at the given level. 
+        @returns true and sets t on a hit */
+        bool _traceNode( int level, int x, int z, const Vector3& start, const Vector3& dir, 
+            Real ta, Real tb, Real& t );
+
+        /// The segments of a packet one component at a time, so four of them clip at once
+        struct SegmentPacket
+        {
+            Real ox[ RAY_PACKET_SIZE ], oy[ RAY_PACKET_SIZE ], oz[ RAY_PACKET_SIZE ];
+            Real dx[ RAY_PACKET_SIZE ], dy[ RAY_PACKET_SIZE ], dz[ RAY_PACKET_SIZE ];
+        };
+
+        /** As _traceNode, for the packet of segments in mask (bit i for segment i). 
+        t[ i ] is -1 until segment i hits, and shortens the range of the segment after.
+        ta, tb and t hold RAY_PACKET_SIZE values; lanes outside mask are ignored. */
+        void _traceNodePacket( int level, int x, int z, unsigned int mask, const SegmentPacket& packet, 
+            const Vector3* starts, const Vector3* dirs, const Real* ta, const Real* tb, Real* t );
+
+        /// Sweeps against quadtree node (x, z) at the given level, shortening best on hits
+        bool _sweepNode( int level, int x, int z, const IntersectionTests::Sweep& sweep, 
+            Real& best, Vector3& normal );
+
+        /// As _traceNode, for the two triangles of quad (x, z)
+        bool _traceQuad( int x, int z, const Vector3& start, const Vector3& dir, 
+            Real ta, Real tb, Real& t );
+
         VertexData* mTerrain;
 
         /// The current LOD level
@@ -381,12 +599,31 @@ namespace Ogre
         MaterialPtr mMaterial;    
         /// Whether this tile has been initialised    
         bool mInit;
-        /// The buffer with all the renderable geometry in it
+        /// The buffer with all the renderable geometry in it, the heights only with compact vertices
         HardwareVertexBufferSharedPtr mMainBuffer;
+        /// First vertex of this tile within its page and world offset of the page, for compact vertices
+        Vector4 mGridOrigin;
         /// Optional set of delta buffers, used to morph from one LOD to the next
         HardwareVertexBufferSharedPtr* mDeltaBuffers;
         /// System-memory buffer with just positions in it, for CPU operations
         float* mPositionBuffer;
+        /// Vertices computed by prepare(), waiting to be uploaded by load()
+        std::vector<uchar> mStagedVertices;
+        /// Size of a staged vertex
+        size_t mStagedVertexSize;
+        /// Morph deltas computed by prepare(), one set per LOD except the highest
+        std::vector<float> mStagedDeltas;
+        /// Frame number of the last _updateRenderQueue() call, or of load()
+        unsigned long mLastVisibleFrame;
+        /// Quads left out of the index buffers, see _setHoles
+        std::vector<uchar> mHoles;
+        /// Index buffers of this tile per LOD, by stitch flags, while _hasSeams() holds
+        std::vector<IndexMap> mSeamIndices;
+        /** Min and max height of the quads below each node of a quadtree over the tile, 
+        root first; the deepest level has nodes of 2x2 quads */
+        std::vector<float> mHeightTree;
+        /// Deepest level of mHeightTree
+        int mHeightTreeDepth;
         /// Forced rendering LOD level, optional
         int mForcedRenderLevel;
         /// Array of LOD indexes specifying which LOD is the next one down
@@ -394,11 +631,40 @@ namespace Ogre
         int mNextLevelDown[10];
         /// Gets the index data for this tile based on current settings
         IndexData* getIndexData(void);
-        /// Internal method for generating stripified terrain indexes
-        IndexData* generateTriStripIndexes(unsigned int stitchFlags);
-        /// Internal method for generating triangle list terrain indexes
-        IndexData* generateTriListIndexes(unsigned int stitchFlags);
+        /// Internal method for generating stripified terrain indexes, see _buildIndexes
+        static size_t _buildTriStripIndexes(const OverhangTerrainOptions& options, int level, 
+            unsigned int stitchFlags, unsigned short* pIdx);
+        /// Internal method for generating triangle list terrain indexes, see _buildIndexes
+        static size_t _buildTriListIndexes(const OverhangTerrainOptions& options, int level, 
+            unsigned int stitchFlags, unsigned short* pIdx);
+        /** Internal method for generating triangle list indexes of a tile with seams.
+        @remarks
+            The tile is built from blocks of the coarsest LOD; blocks next to a hole
+            or a hidden neighbour are stitched to the coarsest LOD on that side, and
+            holes are left out.
+        */
+        IndexData* generateSeamIndexes(void);
+        /// Frees the index buffers generated by generateSeamIndexes
+        void _clearSeamIndices(void);
+        /// Whether quad (x, z) is a hole
+        inline bool _isHole( int x, int z ) const
+        {
+            return mHoles[ x + z * ( mOptions->tileSize - 1 ) ] != 0;
+        }
+        /// Whether quad (x, z) is not drawn, being a hole or the whole tile hidden
+        inline bool _isCut( int x, int z ) const
+        {
+            return !getVisible() || ( !mHoles.empty() && _isHole( x, z ) );
+        }
+        /// Whether any quad along the given edge is not drawn
+        bool _cutsEdge( Neighbor edge ) const;
+        /// Whether this tile or the edge a neighbour shares with it is cut
+        bool _hasSeams(void) const;
+        /** Returns the LOD the block of the coarsest LOD at quad (x, z) has to be 
+        stitched to on the given side, mRenderLevel if it needs no stitching */
+        int _getSeamLOD( Neighbor side, int x, int z ) const;
         /** Utility method to generate stitching indexes on the edge of a tile
+        @param options The options of the terrain
         @param neighbor The neighbor direction to stitch
         @param hiLOD The LOD of this tile
         @param loLOD The LOD of the neighbor
@@ -410,13 +676,16 @@ namespace Ogre
         adjoining edge is also being stitched
         @param pIdx Pointer to a pointer to the index buffer to push the results 
         into (this pointer will be updated)
+        @param x, z The top-left quad of the square to stitch the edge of
+        @param span The size of the square in quads, 0 for the whole tile
         @returns The number of indexes added
         */
-        int stitchEdge(Neighbor neighbor, int hiLOD, int loLOD, 
-            bool omitFirstTri, bool omitLastTri, unsigned short** ppIdx);
+        static int stitchEdge(const OverhangTerrainOptions& options, Neighbor neighbor, int hiLOD, int loLOD, 
+            bool omitFirstTri, bool omitLastTri, unsigned short** ppIdx,
+            int x = 0, int z = 0, int span = 0);
 
-        /// Create a blank delta buffer for usein morphing
-        HardwareVertexBufferSharedPtr createDeltaBuffer(void);
+        /// Create a delta buffer for use in morphing, filled with the given deltas
+        HardwareVertexBufferSharedPtr createDeltaBuffer(const float* deltas);
 
     };
 
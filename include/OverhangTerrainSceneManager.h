@@ -48,6 +48,7 @@ OverhangTerrainSceneManager.h  -  description
 #include "TerrainTile.h"
 #include "OverhangTerrainRenderable.h"
 #include "OverhangTerrainPageSource.h"
+#include "MetaNoise.h"
 #include "OgreIteratorWrappers.h"
 
 
@@ -110,8 +111,92 @@ public:
     /** Returns the height at the given terrain coordinates. */
     float getHeightAt( float x, float y );
 
+    /** Returns the heights at count points, as getHeightAt.
+    @remarks
+        The points are binned by tile first, so each tile is looked up once and 
+        samples all of its points in one loop (see OverhangTerrainRenderable::getHeightsAt),
+        instead of walking the tiles of a page for every point.
+    @param heights Receives the height of each point, -1 outside the loaded terrain
+    */
+    void getHeightsAt( const float* x, const float* z, float* heights, size_t count );
+    /** Returns the heightfield normals at count points, binned as for getHeightsAt.
+    @param normals Receives the normal of each point, Vector3::ZERO outside the loaded terrain
+    */
+    void getNormalsAt( const float* x, const float* z, Vector3* normals, size_t count );
+
 
     bool intersectSegment( const Vector3 & start, const Vector3 & end, Vector3 * result );
+    /** Intersects the segment with the IsoSurfaces of the MetaWorldFragments of all loaded tiles.
+    @remarks
+        Finds the caves and overhangs intersectSegment passes through, the heightfield
+        trace ignoring the holes and hidden tiles they take over. Only the tiles the
+        segment crosses are visited, in order, up to the first one it hits fragments in.
+    @param result Receives the hit nearest to start; may be 0
+    */
+    bool intersectFragments( const Vector3 & start, const Vector3 & end, Vector3 * result );
+
+    /** Casts many rays against the terrain in one call, e.g. for line of sight or projectiles.
+    @remarks
+        Unlike ray scene queries no query objects are created and the octree is not searched
+        for movables; only terrain is hit. Consecutive rays starting on the same tile are traced
+        as packets (see OverhangTerrainRenderable::intersectSegments), so rays from one area 
+        should be passed next to each other. With a thread pool the rays are split across 
+        the workers.
+    @param origins, directions numRays rays; the directions need not be normalised
+    @param distances Receives the distance of each hit from its origin, -1 for misses
+    @param points Receives the hit points, may be 0
+    @param fragments Whether caves and overhangs are hit as well (see intersectFragments)
+    @param maxDistance Length of the rays
+    @returns the number of rays that hit the terrain
+    */
+    size_t castTerrainRays( const Vector3* origins, const Vector3* directions, size_t numRays, 
+        Real* distances, Vector3* points = 0, bool fragments = true, Real maxDistance = 100000 );
+
+    /** Sweeps a capsule from start to end against the heightfield and the fragments.
+    @remarks
+        The capsule's axis runs from its position to its position + axis, e.g. from the
+        centre of a character's lower to that of its upper hemisphere. Only the tiles 
+        under the swept bounds are visited, and within those the nodes of their min/max
+        height quadtrees the shape cannot touch are skipped.
+    @param distance Receives how far the capsule gets towards end before touching the
+        terrain, 0 if it touches it at start
+    @param normal Receives the contact normal, pointing away from the terrain
+    @returns false if the capsule gets to end
+    */
+    bool sweepCapsule( const Vector3& start, const Vector3& end, const Vector3& axis, Real radius, 
+        Real& distance, Vector3& normal );
+    /// As sweepCapsule, for a sphere
+    bool sweepSphere( const Vector3& start, const Vector3& end, Real radius, Real& distance, Vector3& normal )
+    {
+        return sweepCapsule( start, end, Vector3::ZERO, radius, distance, normal );
+    }
+    /** Sweeps count capsules of the same shape, e.g. the characters of a crowd, split across
+    the worker threads as castTerrainRays does.
+    @param distances Receives the distance of each sweep, -1 if it gets to its end
+    @param normals Receives the contact normals, may be 0
+    @returns the number of sweeps that touched the terrain
+    */
+    size_t sweepCapsules( const Vector3* starts, const Vector3* ends, size_t count, const Vector3& axis, 
+        Real radius, Real* distances, Vector3* normals = 0 );
+
+    /// Results of _benchmarkRayQueries
+    struct RayBenchmark
+    {
+        /// Segments per second intersected by intersectSegment
+        Real tracedPerSecond;
+        /// Segments per second intersected by the unit step marcher it replaced
+        Real marchedPerSecond;
+        /// Segments intersectSegment found a hit for
+        size_t hits;
+        /// Segments the two disagree on, about hitting or by more than the marcher's step
+        size_t mismatches;
+    };
+    /** Times intersectSegment against OverhangTerrainRenderable::_marchSegment.
+    @remarks
+        numRays segments as long as ray queries use are cast from above the loaded 
+        terrain towards random points on it. The results are logged as well.
+    */
+    RayBenchmark _benchmarkRayQueries( size_t numRays, uint32 seed = 1 );
 
     /** Sets the texture to use for the main world texture. */
     void setWorldTexture(const String& textureName);
@@ -161,6 +246,27 @@ public:
     void setUseVertexNormals(bool useNormals);
     /** Sets whether vertex colours will be used. */
     void setUseVertexColours(bool useColours);
+    /** Sets whether the indexes of every LOD and stitch combination are built when the
+        world geometry is set, instead of when a tile first needs them while rendering.
+    @remarks
+        Trades a longer start up for no hitches later on. Tiles with holes or hidden 
+        neighbours still build their own indexes on first use. The default is not.
+    */
+    void setPrecomputeLevelIndexes(bool precompute);
+    /** Sets whether tiles store just the heights of their vertices, the rest coming 
+        from a vertex grid shared by all tiles.
+    @remarks
+        Takes effect when the world geometry is set, and only with the built in 
+        material and LOD morphing, whose vertex program puts the positions together.
+        The default is not.
+    */
+    void setUseCompactVertices(bool compact);
+    /** Sets the light baked into the vertex colours, and recolours the loaded pages.
+    @param direction Direction towards the sun, need not be normalised
+    @param ambient Light added to every vertex, in the sun's shadow or not
+    @see OverhangTerrainPage::calculateLighting
+    */
+    void setSunLight(const Vector3& direction, const ColourValue& ambient);
 
     /** Sets the name of a custom material to use to shade the landcape.
     @remarks
@@ -277,11 +383,16 @@ public:
         "LodMorphStart", Real*;
         "VertexNormals", bool*;
         "VertexColours", bool*;
+        "CompactVertices", bool*;
         "MorphLODFactorParamName", String*;
         "MorphLODFactorParamIndex", size_t*;
         "CustomMaterialName", String*;
         "WorldTexture", String*;
         "DetailTexture", String*;
+        "MetaBakeThreshold", size_t*;
+        "EditJournalSnapshotInterval", size_t*;
+        "MemoryBudget", size_t*;
+        "PrefetchHorizon", Real*;
     */
     virtual bool setOption( const String &, const void * );
 
@@ -348,12 +459,26 @@ public:
 	/// Get the shared list of indexes cached (internal use only)
 	OverhangTerrainBufferCache& _getIndexCache(void) {return mIndexCache;}
 
-	/// Get the shared level index list (internal use only)
-	LevelArray& _getLevelIndex(void) { return mLevelIndex; }
+	/** Returns the indexes shared by tiles at LOD level, stitched to their neighbours
+		as given by stitchFlags (internal use only).
+	@remarks
+		Built on first use, unless setPrecomputeLevelIndexes asked for all of them 
+		to be built when the world geometry is set.
+	*/
+	IndexData* _getLevelIndex(int level, unsigned int stitchFlags);
+
+	/** Returns the vertex grid shared by the tiles when the vertices are compact 
+		(internal use only): per vertex its x / z in the tile and the detail 
+		texture coords. Created on first use. */
+	const HardwareVertexBufferSharedPtr& _getGridBuffer(void);
 
 	/// Get the current page count (internal use only)
 	size_t _getPageCount(void) { return mTerrainPages.size(); }
 
+	/** Get the pool used for background work, 0 if everything runs on the 
+		calling thread (internal use only) */
+	ThreadPool* _getThreadPool(void) { return mThreadPool; }
+
 	/// Shutdown cleanly before we get destroyed
 	void shutdown(void);
 
@@ -362,6 +487,132 @@ public:
 	void addMetaObject(MetaObject *mo);
 	/// Convenience function to add the most common MetaObject.
 	void addMetaBall(Vector3 position, Real radius, bool excavating = true);
+	/** Carves a seeded cave network into the box center +- halfSize.
+	@see MetaNoise
+	*/
+	void addMetaNoise(const Vector3& center, const Vector3& halfSize, uint32 seed, Real frequency,
+		MetaNoise::CaveType caveType = MetaNoise::CT_WORMS, Real threshold = 0.08, Real strength = 0.5);
+	/// Digs (or fills) a sphere swept from start to end.
+	void addMetaCapsule(const Vector3& start, const Vector3& end, Real radius, bool excavating = true);
+	/** Digs (or fills) a sphere swept along a polyline, e.g. one drag of a tool.
+	@remarks
+		Paths longer than MetaStroke::MAX_POINTS are split into several strokes.
+		A single point adds a MetaBall.
+	*/
+	void addMetaStroke(const std::vector<Vector3>& points, Real radius, bool excavating = true);
+	/** Changes the heightfield in place inside the world space rectangle [minX, maxX] x [minZ, maxZ].
+	@remarks
+		brush is called for every vertex in the rectangle. Unlike MetaObjects this keeps
+		the tiles on the geomipmap path, and only the touched rows of their vertex buffers
+		are rewritten, which makes it the cheap choice for shallow edits such as craters
+		and ramps. Only loaded tiles are changed; their height changes are journaled and
+		kept, like fragments, when their page is unloaded (see TerrainTile::getHeightDeltas).
+	*/
+	void modifyHeights(Real minX, Real minZ, Real maxX, Real maxZ, const HeightBrush& brush);
+	/// Raises (amount > 0) or lowers (amount < 0, e.g. craters) the heightfield around centre.
+	void raiseHeights(const Vector3& centre, Real radius, Real amount);
+	/// Pulls the heightfield within radius of centre towards centre.y, fading out towards radius.
+	void flattenHeights(const Vector3& centre, Real radius, Real strength = 1);
+	/// Lays a straight ramp of the given half width from start to end into the heightfield.
+	void rampHeights(const Vector3& start, const Vector3& end, Real halfWidth);
+	/** Bakes the MetaObjects of every MetaWorldFragment into stored density grids.
+	@remarks
+		Frees the MetaObjects accumulated by editing; the field they produce is kept
+		as the base layer of each fragment. See MetaWorldFragment::bake.
+	*/
+	void bakeMetaObjects(void);
+	/** Sets the number of MetaObjects a MetaWorldFragment may hold before it is 
+		baked automatically. 0 (the default) disables auto-baking.
+	*/
+	void setMetaBakeThreshold(size_t threshold);
+
+	/** Writes the densities of all MetaWorldFragments to a FragmentDensityFile.
+	@remarks
+		All fragments are baked first (see bakeMetaObjects).
+	@param filename The file to write.
+	@param compress Whether to run-length encode the density blocks.
+	*/
+	void saveFragmentDensities(const String& filename, bool compress = true);
+	/** Memory maps a FragmentDensityFile to restore edited terrain from.
+	@remarks
+		Fragments of pages which are already loaded are restored immediately; all
+		other fragments are paged in from the mapping when their tiles are loaded.
+	*/
+	void loadFragmentDensities(const String& filename);
+	/** Writes the meshes of all MetaWorldFragments to a FragmentMeshCache file.
+	@remarks
+		Cached meshes of tiles which are not loaded are kept.
+	*/
+	void saveFragmentMeshCache(const String& filename);
+	/** Memory maps a FragmentMeshCache file.
+	@remarks
+		From now on, fragments whose densities hash to a cached mesh upload that mesh
+		instead of running the IsoSurfaceBuilder. A missing file is not an error;
+		the cache simply starts out empty.
+	*/
+	void loadFragmentMeshCache(const String& filename);
+
+	/** Writes a density snapshot of the terrain and truncates the edit journal.
+	@remarks
+		The snapshot is a FragmentDensityFile recording the last journal record it
+		contains, so recovery only replays the edits made after it. It is written to a
+		temporary file first and renamed, so a crash never leaves a torn snapshot.
+		Does nothing if no edit journal is configured.
+	*/
+	void snapshotTerrainEdits(void);
+	/** Sets after how many journaled edits a snapshot is taken automatically.
+		0 (the default) leaves snapshots to snapshotTerrainEdits().
+	*/
+	void setEditJournalSnapshotInterval(size_t records);
+
+	/** Sets how many bytes the loaded terrain may use before pages are evicted.
+	@remarks
+		When paging, the least recently visible pages outside the live margin are
+		detached until the terrain fits the budget again; they are loaded again when
+		the camera comes back. 0 (the default) never evicts.
+	*/
+	void setMemoryBudget(size_t bytes);
+	/// Returns the memory budget set with setMemoryBudget()
+	size_t getMemoryBudget(void) const { return mMemoryBudget; }
+	/** Returns the bytes held by the loaded pages, their MetaWorldFragments and the 
+		densities kept for the fragments of evicted pages.
+	*/
+	size_t getMemoryUsage(void) const;
+	/** Detaches a page and hands it back to the page source with expirePage().
+	@remarks
+		The densities of its MetaWorldFragments are kept run-length encoded and
+		restored when the page is attached again. MetaObjects added while it is
+		detached are kept as well and added when it is attached again.
+	*/
+	void detachPage(ushort pageX, ushort pageZ);
+
+	/// Counters of the camera path prefetcher
+	struct PrefetchStats
+	{
+		/// Pages requested ahead of the camera
+		size_t pagesPrefetched;
+		/// Tiles whose stored densities were paged in ahead of the camera
+		size_t tilesPrefetched;
+		/// Cached fragment meshes paged in ahead of the camera
+		size_t meshesPrefetched;
+		/// Pages which were attached by the time they entered the live margin
+		size_t hits;
+		/// Pages which were still missing when they entered the live margin
+		size_t misses;
+	};
+	/** Sets how many seconds ahead the path of the camera is extrapolated when paging.
+	@remarks
+		Pages along the predicted path are requested in the order the camera is
+		expected to reach them, and the stored densities and cached meshes of their 
+		fragments are paged in. 0 (the default) only loads pages once they are within the live margin.
+	*/
+	void setPrefetchHorizon(Real seconds);
+	/// Returns the horizon set with setPrefetchHorizon()
+	Real getPrefetchHorizon(void) const { return mPrefetchHorizon; }
+	/// Returns the prefetch counters since the last resetPrefetchStats()
+	const PrefetchStats& getPrefetchStats(void) const { return mPrefetchStats; }
+	/// Zeroes the prefetch counters
+	void resetPrefetchStats(void);
 
 
 protected:
@@ -407,21 +658,57 @@ protected:
     unsigned short mBufferedPageMargin;
     /// Grid of buffered pages
     OverhangTerrainPage2D mTerrainPages;
+    /// Worker threads for page loading, 0 if "WorkerThreads" is 0
+    ThreadPool* mThreadPool;
+
+    /// Returns the attached page at the given index, 0 if there is none
+    OverhangTerrainPage* _getPage(int pageX, int pageZ) const;
+    /** Attaches the pages loaded in the background and requests those 
+        within the live margin around the camera */
+    void _updatePaging(Camera* cam);
 	//-- attributes to share across tiles
 	/// Shared list of index buffers
 	OverhangTerrainBufferCache mIndexCache;
-	/// Shared array of IndexData (reuse indexes across tiles)
-	LevelArray mLevelIndex;
+	/// Shared array of IndexData (reuse indexes across tiles), one per slot, see _getLevelSlot
+	IndexArray mLevelIndex;
+	/// Whether initLevelIndexes builds every LOD and stitch combination
+	bool mPrecomputeLevelIndexes;
+	/// Number of level indexes built on first use since initLevelIndexes
+	size_t mLateLevelIndexes;
+	/// Time spent building those, in microseconds
+	unsigned long mLateLevelIndexTime;
+	/// Whether compact vertices were asked for, see setUseCompactVertices
+	bool mCompactVertices;
+	/// Vertex grid shared by the tiles, see _getGridBuffer
+	HardwareVertexBufferSharedPtr mGridBuffer;
     
     /// Internal method for loading configurations settings
     void loadConfig(DataStreamPtr& stream);
 
     /// Sets up the terrain page slots
     void setupTerrainPages(void);
-	/// Initialise level indexes
+	/** Initialise level indexes
+	@remarks
+		If setPrecomputeLevelIndexes was set, all valid LOD and stitch combinations 
+		are built up front; the indexes across the thread pool, the buffers on this 
+		thread. The time taken is logged, as is the time spent building indexes on 
+		first use by destroyLevelIndexes.
+	*/
 	void initLevelIndexes(void);
 	/// Destroy level indexes
 	void destroyLevelIndexes(void);
+	/** Returns the slot in mLevelIndex of LOD level stitched as in stitchFlags: one 
+		digit for the level and one for the LOD difference to each neighbour, 
+		in base maxGeoMipMapLevel. */
+	size_t _getLevelSlot(int level, unsigned int stitchFlags) const;
+	/** Inverse of _getLevelSlot.
+	@returns false if the slot stitches to a neighbour coarser than the coarsest LOD */
+	bool _getLevelStitch(size_t slot, int& level, unsigned int& stitchFlags) const;
+	/// Builds the indexes of slots [begin, end); parallelFor body of initLevelIndexes
+	void _buildLevelIndexes(const size_t* slots, std::vector<unsigned short>* indexes, 
+		size_t begin, size_t end) const;
+	/// Creates and fills the index buffer of one mLevelIndex slot
+	IndexData* _createLevelIndexData(const std::vector<unsigned short>& indexes);
 
 
     /// Map of source type -> TerrainPageSource
@@ -432,6 +719,152 @@ protected:
 	DataGrid *mDataGrid;
 	IsoSurfaceBuilder *mIsoSurfaceBuilder;
 
+	/// Stored fragment densities, paged in as tiles are loaded
+	FragmentDensityFile *mFragmentDensityFile;
+	/// Name of the density file given in the configuration
+	String mFragmentDensityFileName;
+	/// Cached fragment meshes
+	FragmentMeshCache *mFragmentMeshCache;
+	/// Name of the mesh cache given in the configuration
+	String mFragmentMeshCacheName;
+
+	/// Returns the world tile index containing the given point
+	void _getTileIndex(const Vector3& pt, int& tileX, int& tileZ) const;
+	/// A run of points on one tile, see _binByTile
+	struct TileBin
+	{
+		/// The tile, 0 for points outside the loaded terrain
+		TerrainTile* tile;
+		size_t first;
+		size_t count;
+	};
+	/** Sorts count points by the tile containing them.
+	@param order Receives the indices of the points, those of each tile next to each other
+	@param bins Receives the runs of order that lie on one tile
+	*/
+	void _binByTile(const float* x, const float* z, size_t count, std::vector<size_t>& order, 
+		std::vector<TileBin>& bins);
+	/// Brings the BVHs of all fragments up to date before they are queried from several threads
+	void _updateFragmentBVHs();
+	/// Sweeps [begin, end) of sweepCapsules
+	void _sweepCapsules(const Vector3* starts, const Vector3* ends, const Vector3& axis, Real radius,
+		Real* distances, Vector3* normals, size_t begin, size_t end);
+	/// Casts rays [begin, end) of castTerrainRays
+	void _castTerrainRays(const Vector3* origins, const Vector3* directions, Real* distances, 
+		Vector3* points, bool fragments, Real maxDistance, size_t begin, size_t end);
+	/// Restores the fragments of all tiles of a page from mFragmentDensityFile
+	void _loadFragmentDensities(OverhangTerrainPage* page);
+
+	/// Journal of the edits made since the last snapshot
+	TerrainEditJournal *mEditJournal;
+	/// Name of the journal given in the configuration
+	String mEditJournalName;
+	/// Name of the density snapshot belonging to the journal
+	String mEditJournalSnapshotName;
+	/// Journaled edits after which a snapshot is taken (0 = never)
+	size_t mEditJournalSnapshotInterval;
+
+	/** Adds a MetaObject to the fragments of all loaded tiles it overlaps, and keeps it 
+		for the tiles of pages which are not loaded (see SpilledTile). */
+	void _applyMetaObject(MetaObject *mo);
+	/// Adds a MetaObject to the fragments of one tile
+	void _addMetaObjectToTile(MetaObject *mo, TerrainTile *tile, int tileX, int tileZ);
+	/** Loads the last snapshot and applies the journaled edits made after it; those 
+		for tiles which are not loaded yet are kept until they are. */
+	void _recoverTerrainEdits(void);
+	/** Reads the MetaObjects mFragmentDensityFile keeps for a tile (see
+		FragmentDensityFile::ENTRY_TILE_EDITS), created with new. */
+	void _readTileEdits(int tileX, int tileZ, std::vector<MetaObject*>& edits);
+	/** Reads the height deltas mFragmentDensityFile keeps for a tile (see
+		FragmentDensityFile::ENTRY_TILE_HEIGHTS); returns false if there are none. */
+	bool _readTileHeights(int tileX, int tileZ, std::vector<float>& deltas);
+
+	/** Updates normals, fragments and lighting of the loaded tiles after their heights 
+		changed inside [minX, maxX] x [minZ, maxZ]. */
+	void _notifyHeightsChanged(Real minX, Real minZ, Real maxX, Real maxZ);
+	/** Sets the height deltas (see TerrainTile::getHeightDeltas) of a rectangle of a loaded 
+		tile's vertices, width * depth values row by row, without _notifyHeightsChanged.
+	@returns true if any height changed
+	*/
+	bool _setHeightDeltas(TerrainTile *tile, int tileX, int tileZ, size_t x, size_t z, 
+		size_t width, size_t depth, const float *deltas);
+	/** As _setHeightDeltas, for height changes replayed from the journal; those of tiles 
+		which are not loaded are kept until they are. */
+	void _applyHeightDeltas(int tileX, int tileZ, size_t x, size_t z, size_t width, size_t depth, 
+		const float *deltas);
+	/// Sets the heights of a page being attached to those kept for it, or stored in mFragmentDensityFile
+	void _restoreHeights(OverhangTerrainPage* page);
+
+	/// Densities of a MetaWorldFragment whose page was evicted
+	struct SpilledFragment
+	{
+		int yLevel;
+		/// FragmentDensityFile::EntryFlags
+		uint32 flags;
+		Vector3 position;
+		/// Density block as written by FragmentDensityFile::encodeBlock
+		std::vector<uint32> block;
+		/// Carved columns (FragmentDensityFile::ENTRY_HAS_COLUMNS), empty if none
+		std::vector<uchar> columns;
+	};
+	typedef std::vector<SpilledFragment> SpilledFragmentList;
+	/** What is kept of a tile which is not loaded. 
+	@remarks
+		Tiles of evicted pages get one, as do tiles edited before their page is loaded.
+		It takes over the entries of the tile in mFragmentDensityFile, which are not 
+		read again.
+	*/
+	struct SpilledTile
+	{
+		SpilledFragmentList fragments;
+		/// MetaObjects added while the tile was not loaded, oldest first; each holds a reference
+		std::vector<MetaObject*> edits;
+		/// TerrainTile::getHeightDeltas of the tile, empty if its heights were not changed
+		std::vector<float> heightDeltas;
+	};
+	typedef std::map<std::pair<int, int>, SpilledTile> SpilledTileMap;
+	/// Tiles which are not loaded by world tile index
+	SpilledTileMap mSpilledTiles;
+	/// Bytes held by mSpilledTiles
+	size_t mSpilledBytes;
+	/// Bytes the terrain may use before pages are evicted (0 = unlimited)
+	size_t mMemoryBudget;
+
+	/// Keeps the densities of the MetaWorldFragments of a page about to be evicted
+	void _spillFragments(OverhangTerrainPage* page);
+	/** Restores the fragments kept by _spillFragments, then adds the MetaObjects kept 
+		for the tiles of the page. */
+	void _restoreSpilledFragments(OverhangTerrainPage* page);
+	/** Returns the SpilledTile of a tile which is not loaded, creating it if needed.
+		Only for tiles of pages the page source has, see _hasTilePage. */
+	SpilledTile& _getSpilledTile(int tileX, int tileZ);
+	/// Returns true if the page source has the page of a tile, i.e. the tile is inside the world
+	bool _hasTilePage(int tileX, int tileZ) const;
+	/// Drops all SpilledTiles
+	void _clearSpilledTiles(void);
+	/// Evicts the least recently visible pages outside the live margin until the budget is met
+	void _evictPages(int camPageX, int camPageZ);
+
+	/// Seconds the camera path is extrapolated ahead (0 = no prefetching)
+	Real mPrefetchHorizon;
+	/// Smoothed velocity of the paging camera, in units per second
+	Vector3 mCameraVelocity;
+	/// Position and time (ms) of the paging camera in the last frame
+	Vector3 mLastCameraPosition;
+	unsigned long mLastCameraTime;
+	/// Whether mLastCameraPosition and the camera page below are valid
+	bool mCameraTracked;
+	/// Page of the paging camera in the last frame
+	int mLastCameraPageX, mLastCameraPageZ;
+	/// Pages prefetched which have not been attached yet
+	std::set<std::pair<ushort, ushort> > mPrefetchedPages;
+	PrefetchStats mPrefetchStats;
+
+	/// Counts the pages entering the live margin as prefetch hits or misses
+	void _updatePrefetchStats(int camPageX, int camPageZ);
+	/// Updates the camera velocity and requests the pages along its predicted path
+	void _prefetchPages(const Vector3& cameraPosition);
+
 };
 /// Factory for OverhangTerrainSceneManager
 class OverhangTerrainSceneManagerFactory : public SceneManagerFactory
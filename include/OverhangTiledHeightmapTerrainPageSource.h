@@ -0,0 +1,78 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+#ifndef __OverhangTiledHeightmapTerrainPageSource_H__
+#define __OverhangTiledHeightmapTerrainPageSource_H__
+
+#include "OverhangTerrainPrerequisites.h"
+#include "OverhangTerrainPageSource.h"
+
+namespace Ogre {
+
+    /** Page source reading each page from its own RAW file in a directory.
+    @remarks
+        Files are named after a pattern in which {x} and {z} stand for the page
+        indices, e.g. page_{x}_{z}.raw, and hold PageSize * PageSize samples
+        in the format of the Heightmap source's RAW files. Adjacent pages must 
+        repeat their shared edge samples.
+    @par
+        Pages are mapped from disk only while they are being prepared, so any 
+        page may be expired and requested again later. Missing files are 
+        simply holes in the world.
+    */
+    class _OverhangTerrainPluginExport OverhangTiledHeightmapTerrainPageSource : public OverhangTerrainPageSource
+    {
+    protected:
+        /// Directory holding the page files
+        String mDirectory;
+        /// File name pattern with {x} and {z} placeholders
+        String mPattern;
+        /// Should we flip terrain vertically?
+        bool mFlipTerrain;
+        /// Bytes per sample of the page files
+        uchar mRawBpp;
+        /// Results of hasPage(), as looking for files is slow
+        mutable std::map<PageKey, bool> mPageExists;
+
+        /// Returns the path of the file holding page (x, z)
+        String getPageFileName(ushort x, ushort z) const;
+        /// @see OverhangTerrainPageSource
+        OverhangTerrainPage* _preparePage(ushort x, ushort z);
+    public:
+        OverhangTiledHeightmapTerrainPageSource();
+        ~OverhangTiledHeightmapTerrainPageSource();
+        /// @see TerrainPageSource
+        void shutdown(void);
+        /// @see TerrainPageSource
+        void requestPage(ushort x, ushort y);
+        /// @see TerrainPageSource
+        void expirePage(ushort x, ushort y);
+        /// @see TerrainPageSource
+        bool hasPage(ushort x, ushort y) const;
+        /// @see TerrainPageSource
+        void initialise(OverhangTerrainSceneManager* tsm, 
+            ushort tileSize, ushort pageSize, bool asyncLoading, 
+            OverhangTerrainPageSourceOptionList& optionList);
+    };
+}
+
+#endif
@@ -0,0 +1,187 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef TERRAIN_EDIT_JOURNAL_H
+#define TERRAIN_EDIT_JOURNAL_H
+
+#include "OverhangTerrainPrerequisites.h"
+#include <cstdio>
+
+namespace Ogre
+{
+/** Append-only log of the MetaObjects added to the terrain, and of heightfield edits.
+	@remarks
+		Every edit is written as one compact binary record (sequence number, timestamp,
+		MetaObject type, flags and type specific parameters, e.g. position and radius of
+		a MetaBall), protected by a CRC-32. Heightfield brushes are arbitrary functions,
+		so their result is written instead, as HeightDeltas of each tile they changed.
+	@par
+		Records are flushed and fsync'ed in batches, either after a number of records or
+		after some time, whichever comes first; the time limit needs syncIfDue() to be
+		called regularly, e.g. once a frame.
+	@par
+		Recovery loads the last density snapshot (a FragmentDensityFile, which stores the
+		sequence number of the last record it contains) and replays only the records 
+		written after it. Once a snapshot is safely on disk the journal is truncated, so 
+		replay stays bounded by the snapshot interval.
+*/
+class _OverhangTerrainPluginExport TerrainEditJournal
+{
+public:
+	/// Header of every record, followed by payloadSize bytes of parameters.
+	struct RecordHeader
+	{
+		uint64 sequence;
+		/// Milliseconds since the epoch.
+		uint64 timestamp;
+		/// MetaObject::MetaObjectType, or a type past them for HeightDeltas
+		uint16 type;
+		/// Type specific flags (e.g. excavating).
+		uint16 flags;
+		uint32 payloadSize;
+		/// CRC-32 of the header (with crc set to 0) and the payload.
+		uint32 crc;
+		uint32 reserved;
+	};
+
+	/// Height changes of a rectangle of the vertices of one tile.
+	struct HeightDeltas
+	{
+		/// World tile index
+		int tileX, tileZ;
+		/// First vertex and size of the rectangle, in vertices
+		size_t x, z, width, depth;
+		/// Row by row, the change of each vertex from the height of the page source
+		std::vector<float> deltas;
+	};
+
+	/// A record read back from a journal; either object or heights is set.
+	struct Record
+	{
+		uint64 sequence;
+		uint64 timestamp;
+		MetaObject *object;
+		HeightDeltas *heights;
+	};
+	typedef std::vector<Record> RecordList;
+
+	TerrainEditJournal();
+	/// Syncs and closes the journal.
+	~TerrainEditJournal();
+
+	/** Opens a journal for appending, creating it if needed.
+		@remarks
+			A record torn by a crash at the end of the file is cut off, as is everything
+			after a damaged record; the dropped bytes are appended to filename + ".corrupt".
+			The repaired journal replaces the old one only once it is safely on disk.
+		@exception Exception::ERR_INVALIDPARAMS if the file exists but is no journal of
+			this byte order and version; it is left untouched.
+		@param firstSequence Sequence numbers continue after this value, or after the
+			last record in the file if that is higher. */
+	void open(const String& filename, uint64 firstSequence = 0);
+	/// Syncs and closes the journal.
+	void close();
+	bool isOpen() const {return mFile != 0; }
+	const String& getFilename() const {return mFilename; }
+
+	/// Returns true if objects of this type can be journaled.
+	static bool isJournaled(const MetaObject *mo);
+	/** Appends a record for a MetaObject.
+		@returns The sequence number of the record, 0 if the type can not be journaled. */
+	uint64 append(const MetaObject *mo);
+	/** Appends a record for the heights of a tile changed by a brush.
+		@returns The sequence number of the record. */
+	uint64 append(const HeightDeltas& heights);
+	/// Flushes pending records and forces them to disk.
+	void sync();
+	/// Syncs if the oldest unsynced record has waited for the time set with setSyncBatch.
+	void syncIfDue();
+	/// Drops all records, after they have been captured by a snapshot.
+	void truncate();
+
+	/** Sets how often appended records are forced to disk.
+		@param records Sync after this many records (1 = every record).
+		@param milliseconds Sync once the oldest unsynced record is this old (checked by
+			append and syncIfDue). */
+	void setSyncBatch(size_t records, unsigned long milliseconds);
+	/// Sequence number of the last appended record.
+	uint64 getSequence() const {return mSequence; }
+	/// Number of records appended since the journal was opened or truncated.
+	size_t getNumRecords() const {return mNumRecords; }
+
+	/** Reads all records with a sequence number above afterSequence.
+		@remarks
+			The MetaObjects and HeightDeltas are created with new and owned by the caller.
+			Reading stops at the first incomplete record or checksum mismatch.
+		@exception Exception::ERR_INVALIDPARAMS as for open.
+		@returns The number of records read. */
+	static size_t read(const String& filename, uint64 afterSequence, RecordList& records);
+	/** Appends records for MetaObjects to buffer, e.g. to keep them in a FragmentDensityFile.
+		@remarks
+			Objects of types that can not be journaled are left out.
+		@returns The number of records written. */
+	static size_t writeRecords(const std::vector<MetaObject*>& objects, std::vector<uchar>& buffer);
+	/** Recreates the MetaObjects of records written by writeRecords.
+		@remarks
+			The MetaObjects are created with new and owned by the caller.
+			Reading stops at the first incomplete record or checksum mismatch.
+		@returns The number of objects read. */
+	static size_t readRecords(const uchar* data, size_t size, std::vector<MetaObject*>& objects);
+
+	/// Milliseconds since the epoch.
+	static uint64 getTimestamp();
+	/** Atomically replaces a file with another one (e.g. a freshly written snapshot).
+		@remarks
+			Either the old or the new file survives a crash, never a mix. */
+	static void replaceFile(const String& from, const String& to);
+
+protected:
+	String mFilename;
+	FILE *mFile;
+	uint64 mSequence;
+	size_t mNumRecords;
+	size_t mSyncRecords;
+	unsigned long mSyncMilliseconds;
+	size_t mUnsyncedRecords;
+	uint64 mFirstUnsyncedTime;
+
+	/** Scans a journal, returns the size of its valid part (0 if the file is too short 
+		for a header) and the last sequence number. */
+	static size_t scan(FILE *file, const String& filename, uint64 &lastSequence);
+	/** Reads the record at the current file position.
+		@returns false at the end of the valid part of the journal. */
+	static bool readRecord(FILE *file, RecordHeader &header, std::vector<uchar> &payload);
+	/// Appends a record with its checksum to buffer.
+	static void writeRecord(std::vector<uchar> &buffer, RecordHeader header, const std::vector<uchar> &payload);
+	/// Appends a serialised record to the journal and syncs if a batch is complete.
+	uint64 _append(RecordHeader &header, const std::vector<uchar> &payload);
+	/// Serialises a MetaObject; returns false for types that are not journaled.
+	static bool serialise(const MetaObject *mo, RecordHeader &header, std::vector<uchar> &payload);
+	/// Recreates a MetaObject from a record, or returns 0 for unknown types.
+	static MetaObject* deserialise(const RecordHeader &header, const uchar *payload);
+	/// Recreates the HeightDeltas of a record, or returns 0 if it holds none.
+	static HeightDeltas* deserialiseHeights(const RecordHeader &header, const uchar *payload);
+};
+
+}// namespace Ogre
+#endif // TERRAIN_EDIT_JOURNAL_H
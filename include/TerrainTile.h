@@ -35,6 +35,10 @@ namespace Ogre
 class IsoSurfaceRenderable;
 class IsoSurfaceBuilder;
 class AxisAlignedBox;
+namespace IntersectionTests
+{
+	struct Sweep;
+}
 
 class TerrainTile
 {
@@ -53,7 +57,7 @@ public:
 		HERE = 4
 	};
 
-	/// methods needed because they are called from OgreTerrainPage
+	/// methods needed because they are called from OgreTerrainPage; t may be 0 to unlink
 	void _setNeighbor(Neighbor n, TerrainTile * t );
 	TerrainTile* _getNeighbor( Neighbor n )
 	{
@@ -69,31 +73,114 @@ public:
 	The starting points of the top-left of this tile, in terms of the
 	number of vertices.
 	@param pageHeightData The source height data for the entire parent page
+	@param originx, originz The world position of the parent page, in vertices
+	*/
+    void initialise(int startx, int startz, const OverhangTerrainHeightData& pageHeightData,
+		int originx = 0, int originz = 0);
+	/// Prepares the tile in system memory, see OverhangTerrainRenderable::prepare.
+	void prepare(int startx, int startz, const OverhangTerrainHeightData& pageHeightData,
+		int originx = 0, int originz = 0);
+	/** Creates the hardware buffers of a prepared tile and attaches it.
+	@param c The scene node to attach to, if the tile was created without one.
 	*/
-    void initialise(int startx, int startz, Real* pageHeightData);
+	void load(SceneNode *c = 0);
 	void setMaterial(const MaterialPtr& m );
 	void _calculateNormals();
 	/** Intersects the segment witht he terrain tile */
 	bool intersectSegment( const Vector3 & start, const Vector3 & end, Vector3 * result );
+	/** Finds the nearest point the ray origin + t * dir hits the MetaWorldFragments at,
+		for t in [0, maxT].
+	@param t Receives the distance of the hit along dir
+	*/
+	bool intersectFragments(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t) const;
+	/** As intersectFragments, for a sphere or capsule sweep.
+	@param normal Receives the contact normal, pointing away from the surface
+	*/
+	bool sweepFragments(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal) const;
 	/** Returns the terrain height at the given coordinates */
 	float getHeightAt( float x, float y );
+	/** Applies a height brush to the heightfield inside [minX, maxX] x [minZ, maxZ].
+	@remarks
+		The heightmap field baked into MetaWorldFragments is swapped for that of the new heights.
+	@see OverhangTerrainRenderable::_modifyHeights
+	@returns true if any height changed
+	*/
+	bool modifyHeights(Real minX, Real minZ, Real maxX, Real maxZ, const HeightBrush& brush,
+		IsoSurfaceBuilder *isb);
+	/** Changes of the heights made by modifyHeights, one per vertex (x + z * tileSize),
+		or empty if the heights are those of the page source. */
+	inline std::vector<float>& getHeightDeltas() {return mHeightDeltas;}
+	/** Updates normals and MetaWorldFragments inside [minX, maxX] x [minZ, maxZ] after
+		modifyHeights has been applied to this tile and its neighbours.
+	@remarks
+		Fragments are classified again; those the heightfield now passes through take 
+		over from it, and levels it moved into get fragments filling its holes.
+	*/
+	void _notifyHeightsChanged(Real minX, Real minZ, Real maxX, Real maxZ, IsoSurfaceBuilder *isb);
 
 	OverhangTerrainRenderable* getTerrainRenderable() {return mTerrainRenderable;}
 	void addMetaObject(MetaObject *mo, int level, IsoSurfaceBuilder *isb, const Vector3 &pos);
+	/// Bakes the MetaObjects of all MetaWorldFragments of this tile into their density grids.
+	void bakeMetaWorldFragments(IsoSurfaceBuilder *isb);
+	/** Restores a MetaWorldFragment from stored densities (see FragmentDensityFile).
+	@remarks
+		An existing fragment, e.g. a hole filler, takes the stored field in place of its own.
+	@param level The y-level of the fragment.
+	@param pos The centre of the fragment's data grid.
+	@param values Baked density values, one per data grid point.
+	@param hideHeightfield Whether the fragment replaces the heightfield of this tile.
+	@param columns The data grid columns carved by the fragment (see MetaWorldFragment::carveColumns),
+		or 0 if they are not known, in which case the fragment takes over the whole tile.
+	*/
+	void addBakedMetaWorldFragment(int level, const Vector3 &pos, const Real *values, size_t numGridPoints,
+		IsoSurfaceBuilder *isb, bool hideHeightfield, const uchar *columns = 0);
+	/// Returns the MetaWorldFragment at the given y-level, or 0 if there is none.
+	MetaWorldFragment* getMetaWorldFragment(int level);
+	/// Returns true if the heightfield of this tile has been replaced by its MetaWorldFragments.
+	bool isHeightfieldHidden() const;
+	/** Returns true if MetaWorldFragments cut holes into the heightfield rather than hiding it.
+	@remarks
+		Needs the fragment data grid cells to line up with the heightfield quads.
+	*/
+	bool canCutHoles(IsoSurfaceBuilder *isb) const;
+	/// Returns true if MetaWorldFragments took over the heightfield in whole or in part (holes).
+	bool isHeightfieldReplaced() const;
+	/// Returns the bytes held by the heightfield and the MetaWorldFragments of this tile.
+	size_t getMemoryUsage() const;
+	/// Returns the last frame the heightfield or one of the fragments was queued for rendering in.
+	unsigned long getLastVisibleFrame() const;
 	SceneNode * getSceneNode() {return mSceneNode;}
 
 	inline std::vector<MetaWorldFragment *>& getMetaWorldFragments() {return mMetaWorldFragments;}
 	inline std::vector<IsoSurfaceRenderable *>& getMetaWorldRenderables() {return mMetaRenderables;}
 
 protected:
+	/// Adds the IsoSurface of a freshly created (and updated) fragment to the scene.
+	void _attachMetaWorldFragment(MetaWorldFragment *wf, const Vector3 &pos);
+	/// Hides the heightfield where MetaWorldFragments take over.
+	void _hideHeightfield();
+	/** Lets a fragment take over from the heightfield where box lies, by cutting holes
+		where possible and hiding the heightfield otherwise. */
+	void _cutHeightfield(MetaWorldFragment *wf, const AxisAlignedBox &box, IsoSurfaceBuilder *isb);
+	/** Cuts the columns carved by all fragments out of the heightfield and updates the 
+		fragments, except skip, if that changed the holes. */
+	void _updateHoles(MetaWorldFragment *skip, IsoSurfaceBuilder *isb);
+	/** Creates (without updating or attaching them) the fragments filling the holes at the 
+		levels the heightfield passes through which have none yet, other than that of skip. */
+	void _addHoleFillers(MetaWorldFragment *skip, std::vector<MetaWorldFragment*>& added);
+
 	OverhangTerrainRenderable *mTerrainRenderable;
 	/// MetaRenderables from bottom to top (y direction).
 	std::vector<IsoSurfaceRenderable *> mMetaRenderables;
 	/// WorldFragments from bottom to top (y direction).
 	std::vector<MetaWorldFragment *> mMetaWorldFragments;
+	/// See getHeightDeltas
+	std::vector<float> mHeightDeltas;
 
 	TerrainTile *mNeighbors [ 4 ];
 	SceneNode * mSceneNode;
+	/// Snaps the borders of fragments taking over from the heightfield onto it, see _snapToSeam
+	VertexSnap mSeamSnap;
 
 };
 
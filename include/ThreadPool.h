@@ -0,0 +1,110 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "OverhangTerrainPrerequisites.h"
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Ogre
+{
+/** A fixed set of worker threads for the CPU heavy parts of the terrain.
+	@remarks
+		Used for background page loading (submit) and for splitting loops over
+		tiles, vertices or rays across cores (parallelFor). Tasks must not touch
+		the render system or the scene graph; those stay on the main thread.
+*/
+class _OverhangTerrainPluginExport ThreadPool
+{
+public:
+	typedef boost::function<void ()> Task;
+	/// Body of a parallelFor, called with a sub range [begin, end).
+	typedef boost::function<void (size_t, size_t)> RangeTask;
+
+	/** Starts the workers.
+		@param numThreads Number of worker threads, 0 picks one less than the
+			number of hardware threads (at least one). */
+	ThreadPool(size_t numThreads = 0);
+	/// Finishes all queued tasks and joins the workers.
+	~ThreadPool();
+
+	/// Queues a task to be run by one of the workers.
+	void submit(const Task& task);
+	/// Blocks until all queued tasks have finished.
+	void waitIdle();
+	/** Runs body over [begin, end) split into chunks, and blocks until all chunks 
+		are done. The calling thread works on chunks as well.
+		@remarks
+			If a chunk throws, the chunks not started yet are skipped and the first
+			exception is rethrown once the chunks still running have finished.
+		@param grain Minimum number of items per chunk. */
+	void parallelFor(size_t begin, size_t end, const RangeTask& body, size_t grain = 1);
+
+	/// Number of worker threads.
+	size_t getNumThreads() const {return mThreads.size(); }
+
+protected:
+	/// Shared state of one parallelFor call
+	struct Range
+	{
+		const RangeTask* body;
+		size_t next;
+		size_t end;
+		size_t chunk;
+		size_t pending;
+		/// First exception thrown by a chunk
+		boost::exception_ptr error;
+		boost::mutex mutex;
+		boost::condition_variable done;
+	};
+
+	std::vector<boost::thread*> mThreads;
+	std::deque<Task> mTasks;
+	size_t mBusy;
+	bool mStop;
+	boost::mutex mMutex;
+	boost::condition_variable mWork;
+	boost::condition_variable mIdle;
+
+	/// Worker thread main loop
+	void run();
+	/** Takes chunks of a range until none are left.
+		@remarks
+			Helpers hold a reference, since they may only get to run after the
+			caller of parallelFor has already finished all chunks itself. */
+	static void runRange(boost::shared_ptr<Range> range);
+
+private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+}// namespace Ogre
+#endif // THREAD_POOL_H
@@ -0,0 +1,84 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include "OverhangTerrainPrerequisites.h"
+#include "IntersectionTests.h"
+#include <vector>
+
+namespace Ogre
+{
+/** Bounding volume hierarchy over the triangles of one mesh, for ray queries.
+	@remarks
+		The tree is built top down, splitting the triangles of a node at the median
+		of their centroids along the longest axis, until at most LEAF_SIZE are left.
+		Positions are copied out of the vertex data, so the tree stays valid after
+		the buffers it was built from change; it only has to be rebuilt when the
+		mesh itself does.
+*/
+class _OverhangTerrainPluginExport TriangleBVH
+{
+public:
+	/// Maximum number of triangles in a leaf.
+	static const size_t LEAF_SIZE = 4;
+
+	/// Builds the tree from float3 positions stride bytes apart and a 16 bit triangle list.
+	void build(const uchar *positions, size_t vertexCount, size_t stride, 
+		const uint16 *indices, size_t indexCount);
+	/// Releases the tree.
+	void clear();
+	/// Returns true if there are no triangles.
+	bool empty() const {return mNodes.empty();}
+	/** Finds the nearest triangle the ray origin + t * dir hits, for t in [0, maxT].
+		@param t Receives the distance of the hit along dir
+		@returns false if there is no hit */
+	bool intersect(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t) const;
+	/** As intersect, for a sphere or capsule sweep.
+		@param normal Receives the contact normal, pointing away from the triangle */
+	bool sweep(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal) const;
+	/// Returns the bytes held by the tree.
+	size_t getMemoryUsage() const;
+
+protected:
+	struct Node
+	{
+		Vector3 lo, hi;
+		/// First triangle of a leaf, or the left child of an inner node (the right one follows it).
+		uint32 first;
+		/// Number of triangles of a leaf, 0 for inner nodes.
+		uint32 count;
+	};
+
+	/// Sets the bounds of node and splits it if it holds more than LEAF_SIZE triangles.
+	void buildNode(size_t node, const uint16 *indices, std::vector<size_t> &order, 
+		const std::vector<Vector3> &centroids, size_t first, size_t count);
+
+	std::vector<Vector3> mVertices;
+	/// Triangle list, ordered so the triangles of each leaf are consecutive.
+	std::vector<uint16> mIndices;
+	/// Nodes, root first.
+	std::vector<Node> mNodes;
+};
+}/// namespace Ogre
+#endif
@@ -26,9 +26,11 @@ http://www.gnu.org/copyleft/lesser.txt.
 
 #include "DynamicRenderable.h"
 #include "OgreHardwareBufferManager.h"
+#include "OgreRoot.h"
 namespace Ogre
 {
 DynamicRenderable::DynamicRenderable()
+: mVertexBufferCapacity(0), mIndexBufferCapacity(0), mLastVisibleFrame(0)
 {
 }
 
@@ -55,6 +57,23 @@ void DynamicRenderable::initialize(RenderOperation::OperationType operationType,
 	createVertexDeclaration();
 }
 
+void DynamicRenderable::_updateRenderQueue(RenderQueue* queue)
+{
+	mLastVisibleFrame = Root::getSingleton().getNextFrameNumber();
+	SimpleRenderable::_updateRenderQueue(queue);
+}
+
+size_t DynamicRenderable::getMemoryUsage() const
+{
+	if (!mRenderOp.vertexData)
+		return 0;
+	// Both buffers are shadowed
+	size_t bytes = mVertexBufferCapacity*mRenderOp.vertexData->vertexDeclaration->getVertexSize(0);
+	if (mRenderOp.useIndexes)
+		bytes += mIndexBufferCapacity*sizeof(uint16);
+	return 2*bytes;
+}
+
 void DynamicRenderable::prepareHardwareBuffers(size_t vertexCount, size_t indexCount)
 {
 	// Prepare vertex buffer
@@ -0,0 +1,340 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "FractalNoise.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define FRACTAL_NOISE_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace Ogre
+{
+namespace
+{
+	const uint32 HASH_X = 0x8DA6B343u;
+	const uint32 HASH_Y = 0xCB1AB31Fu;
+	const uint32 HASH_Z = 0xD8163841u;
+	const uint32 HASH_MIX = 0x2C1B3C6Du;
+	/// Brings the 3D diagonal gradients (|g| = sqrt(3)) back to about [-1, 1]
+	const float GRADIENT3_SCALE = 2.0f / 3.0f;
+
+	inline uint32 hashLattice(int x, int z, uint32 seed)
+	{
+		uint32 h = seed ^ (uint32(x) * HASH_X) ^ (uint32(z) * HASH_Z);
+		h = (h ^ (h >> 15)) * HASH_MIX;
+		return h ^ (h >> 12);
+	}
+
+	inline uint32 hashLattice(int x, int y, int z, uint32 seed)
+	{
+		uint32 h = seed ^ (uint32(x) * HASH_X) ^ (uint32(y) * HASH_Y) ^ (uint32(z) * HASH_Z);
+		h = (h ^ (h >> 15)) * HASH_MIX;
+		return h ^ (h >> 12);
+	}
+
+	/// Dot product of a diagonal gradient picked by the low bits of h with (dx, dz)
+	inline float gradient(uint32 h, float dx, float dz)
+	{
+		return ((h & 1) ? -dx : dx) + ((h & 2) ? -dz : dz);
+	}
+
+	/// Dot product of a cube diagonal gradient picked by the low bits of h with (dx, dy, dz)
+	inline float gradient(uint32 h, float dx, float dy, float dz)
+	{
+		return ((h & 1) ? -dx : dx) + ((h & 2) ? -dy : dy) + ((h & 4) ? -dz : dz);
+	}
+
+	inline float lerp(float a, float b, float t)
+	{
+		return a + t * (b - a);
+	}
+
+	inline float fade(float t)
+	{
+		return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+	}
+
+	inline int floorToInt(float x)
+	{
+		int i = int(x);
+		return float(i) > x ? i - 1 : i;
+	}
+
+#ifdef FRACTAL_NOISE_SSE2
+	/// 32 bit multiply of each lane, SSE2 only has the unsigned 32x32->64 one
+	inline __m128i mullo32(__m128i a, __m128i b)
+	{
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	inline __m128i hashLattice4(__m128i x, __m128i z, __m128i seed)
+	{
+		__m128i h = _mm_xor_si128(seed, _mm_xor_si128(mullo32(x, _mm_set1_epi32(int(HASH_X))),
+			mullo32(z, _mm_set1_epi32(int(HASH_Z)))));
+		h = mullo32(_mm_xor_si128(h, _mm_srli_epi32(h, 15)), _mm_set1_epi32(int(HASH_MIX)));
+		return _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+	}
+
+	inline __m128i hashLattice4(__m128i x, __m128i y, __m128i z, __m128i seed)
+	{
+		__m128i h = _mm_xor_si128(seed, _mm_xor_si128(mullo32(x, _mm_set1_epi32(int(HASH_X))),
+			_mm_xor_si128(mullo32(y, _mm_set1_epi32(int(HASH_Y))), mullo32(z, _mm_set1_epi32(int(HASH_Z))))));
+		h = mullo32(_mm_xor_si128(h, _mm_srli_epi32(h, 15)), _mm_set1_epi32(int(HASH_MIX)));
+		return _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+	}
+
+	/// Negates the lanes of v whose hash has the given bit set
+	inline __m128 flipSign4(__m128 v, __m128i h, int bit)
+	{
+		// Move the bit into the sign bit
+		return _mm_xor_ps(v, _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, bit), 31)));
+	}
+
+	inline __m128 gradient4(__m128i h, __m128 dx, __m128 dz)
+	{
+		return _mm_add_ps(flipSign4(dx, h, 0), flipSign4(dz, h, 1));
+	}
+
+	inline __m128 gradient4(__m128i h, __m128 dx, __m128 dy, __m128 dz)
+	{
+		return _mm_add_ps(_mm_add_ps(flipSign4(dx, h, 0), flipSign4(dy, h, 1)), flipSign4(dz, h, 2));
+	}
+
+	/// floor() as truncation corrected for negative values
+	inline __m128i floor4(__m128 x)
+	{
+		__m128i i = _mm_cvttps_epi32(x);
+		return _mm_add_epi32(i, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(i), x)));
+	}
+
+	inline __m128 fade4(__m128 t)
+	{
+		__m128 p = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), 
+			_mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+		return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), p);
+	}
+
+	inline __m128 lerp4(__m128 a, __m128 b, __m128 t)
+	{
+		return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+	}
+
+	__m128 gradientNoise4(__m128 x, __m128 z, uint32 seed)
+	{
+		__m128i xi = floor4(x);
+		__m128i zi = floor4(z);
+		__m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(xi));
+		__m128 fz = _mm_sub_ps(z, _mm_cvtepi32_ps(zi));
+		__m128 fx1 = _mm_sub_ps(fx, _mm_set1_ps(1.0f));
+		__m128 fz1 = _mm_sub_ps(fz, _mm_set1_ps(1.0f));
+
+		__m128i one = _mm_set1_epi32(1);
+		__m128i xi1 = _mm_add_epi32(xi, one);
+		__m128i zi1 = _mm_add_epi32(zi, one);
+		__m128i s = _mm_set1_epi32(int(seed));
+
+		__m128 g00 = gradient4(hashLattice4(xi, zi, s), fx, fz);
+		__m128 g10 = gradient4(hashLattice4(xi1, zi, s), fx1, fz);
+		__m128 g01 = gradient4(hashLattice4(xi, zi1, s), fx, fz1);
+		__m128 g11 = gradient4(hashLattice4(xi1, zi1, s), fx1, fz1);
+
+		__m128 u = fade4(fx);
+		__m128 v = fade4(fz);
+		return lerp4(lerp4(g00, g10, u), lerp4(g01, g11, u), v);
+	}
+
+	__m128 gradientNoise4(__m128 x, __m128 y, __m128 z, uint32 seed)
+	{
+		__m128i xi = floor4(x);
+		__m128i yi = floor4(y);
+		__m128i zi = floor4(z);
+		__m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(xi));
+		__m128 fy = _mm_sub_ps(y, _mm_cvtepi32_ps(yi));
+		__m128 fz = _mm_sub_ps(z, _mm_cvtepi32_ps(zi));
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 fx1 = _mm_sub_ps(fx, one);
+		__m128 fy1 = _mm_sub_ps(fy, one);
+		__m128 fz1 = _mm_sub_ps(fz, one);
+
+		__m128i onei = _mm_set1_epi32(1);
+		__m128i xi1 = _mm_add_epi32(xi, onei);
+		__m128i yi1 = _mm_add_epi32(yi, onei);
+		__m128i zi1 = _mm_add_epi32(zi, onei);
+		__m128i s = _mm_set1_epi32(int(seed));
+
+		__m128 u = fade4(fx);
+		__m128 v = fade4(fy);
+		__m128 w = fade4(fz);
+		__m128 a = lerp4(lerp4(gradient4(hashLattice4(xi, yi, zi, s), fx, fy, fz),
+			gradient4(hashLattice4(xi1, yi, zi, s), fx1, fy, fz), u),
+			lerp4(gradient4(hashLattice4(xi, yi1, zi, s), fx, fy1, fz),
+			gradient4(hashLattice4(xi1, yi1, zi, s), fx1, fy1, fz), u), v);
+		__m128 b = lerp4(lerp4(gradient4(hashLattice4(xi, yi, zi1, s), fx, fy, fz1),
+			gradient4(hashLattice4(xi1, yi, zi1, s), fx1, fy, fz1), u),
+			lerp4(gradient4(hashLattice4(xi, yi1, zi1, s), fx, fy1, fz1),
+			gradient4(hashLattice4(xi1, yi1, zi1, s), fx1, fy1, fz1), u), v);
+		return _mm_mul_ps(lerp4(a, b, w), _mm_set1_ps(GRADIENT3_SCALE));
+	}
+#endif
+}
+//-----------------------------------------------------------------------
+FractalNoise::FractalNoise(uint32 seed, ushort octaves, float frequency, float lacunarity, float gain)
+: mSeed(seed), mOctaves(octaves ? octaves : 1), mFrequency(frequency), 
+mLacunarity(lacunarity), mGain(gain)
+{
+	float amplitude = 1.0f, sum = 0.0f;
+	for (ushort o = 0; o < mOctaves; ++o)
+	{
+		sum += amplitude;
+		amplitude *= mGain;
+	}
+	mInvAmplitude = 1.0f / sum;
+}
+//-----------------------------------------------------------------------
+float FractalNoise::gradientNoise(float x, float z, uint32 seed)
+{
+	int xi = floorToInt(x), zi = floorToInt(z);
+	float fx = x - float(xi), fz = z - float(zi);
+	float fx1 = fx - 1.0f, fz1 = fz - 1.0f;
+
+	float g00 = gradient(hashLattice(xi, zi, seed), fx, fz);
+	float g10 = gradient(hashLattice(xi + 1, zi, seed), fx1, fz);
+	float g01 = gradient(hashLattice(xi, zi + 1, seed), fx, fz1);
+	float g11 = gradient(hashLattice(xi + 1, zi + 1, seed), fx1, fz1);
+
+	float u = fade(fx), v = fade(fz);
+	return lerp(lerp(g00, g10, u), lerp(g01, g11, u), v);
+}
+//-----------------------------------------------------------------------
+float FractalNoise::gradientNoise(float x, float y, float z, uint32 seed)
+{
+	int xi = floorToInt(x), yi = floorToInt(y), zi = floorToInt(z);
+	float fx = x - float(xi), fy = y - float(yi), fz = z - float(zi);
+	float fx1 = fx - 1.0f, fy1 = fy - 1.0f, fz1 = fz - 1.0f;
+
+	float u = fade(fx), v = fade(fy), w = fade(fz);
+	float a = lerp(lerp(gradient(hashLattice(xi, yi, zi, seed), fx, fy, fz),
+		gradient(hashLattice(xi + 1, yi, zi, seed), fx1, fy, fz), u),
+		lerp(gradient(hashLattice(xi, yi + 1, zi, seed), fx, fy1, fz),
+		gradient(hashLattice(xi + 1, yi + 1, zi, seed), fx1, fy1, fz), u), v);
+	float b = lerp(lerp(gradient(hashLattice(xi, yi, zi + 1, seed), fx, fy, fz1),
+		gradient(hashLattice(xi + 1, yi, zi + 1, seed), fx1, fy, fz1), u),
+		lerp(gradient(hashLattice(xi, yi + 1, zi + 1, seed), fx, fy1, fz1),
+		gradient(hashLattice(xi + 1, yi + 1, zi + 1, seed), fx1, fy1, fz1), u), v);
+	return lerp(a, b, w) * GRADIENT3_SCALE;
+}
+//-----------------------------------------------------------------------
+float FractalNoise::getValue(float x, float z) const
+{
+	float sum = 0.0f, amplitude = 1.0f, frequency = mFrequency;
+	for (ushort o = 0; o < mOctaves; ++o)
+	{
+		sum += amplitude * gradientNoise(x * frequency, z * frequency, mSeed + o);
+		amplitude *= mGain;
+		frequency *= mLacunarity;
+	}
+	return sum * mInvAmplitude;
+}
+//-----------------------------------------------------------------------
+void FractalNoise::fillRow(int x0, int z, size_t count, float* out) const
+{
+	size_t i = 0;
+#ifdef FRACTAL_NOISE_SSE2
+	__m128 zf = _mm_set1_ps(float(z));
+	__m128i step = _mm_set_epi32(3, 2, 1, 0);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 xf = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x0 + int(i)), step));
+		__m128 sum = _mm_setzero_ps();
+		float amplitude = 1.0f, frequency = mFrequency;
+		for (ushort o = 0; o < mOctaves; ++o)
+		{
+			__m128 f = _mm_set1_ps(frequency);
+			__m128 n = gradientNoise4(_mm_mul_ps(xf, f), _mm_mul_ps(zf, f), mSeed + o);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), n));
+			amplitude *= mGain;
+			frequency *= mLacunarity;
+		}
+		_mm_storeu_ps(out + i, _mm_mul_ps(sum, _mm_set1_ps(mInvAmplitude)));
+	}
+#endif
+	// Remainder, or everything without SSE2
+	for (; i < count; ++i)
+		out[i] = getValue(float(x0 + int(i)), float(z));
+}
+//-----------------------------------------------------------------------
+float FractalNoise::getValue(float x, float y, float z) const
+{
+	float sum = 0.0f, amplitude = 1.0f, frequency = mFrequency;
+	for (ushort o = 0; o < mOctaves; ++o)
+	{
+		sum += amplitude * gradientNoise(x * frequency, y * frequency, z * frequency, mSeed + o);
+		amplitude *= mGain;
+		frequency *= mLacunarity;
+	}
+	return sum * mInvAmplitude;
+}
+//-----------------------------------------------------------------------
+void FractalNoise::fillRow(float x0, float dx, float y, float z, size_t count, float* out) const
+{
+	size_t i = 0;
+#ifdef FRACTAL_NOISE_SSE2
+	__m128 yf = _mm_set1_ps(y);
+	__m128 zf = _mm_set1_ps(z);
+	__m128 step = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 xf = _mm_add_ps(_mm_set1_ps(x0), 
+			_mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(i)), step), _mm_set1_ps(dx)));
+		__m128 sum = _mm_setzero_ps();
+		float amplitude = 1.0f, frequency = mFrequency;
+		for (ushort o = 0; o < mOctaves; ++o)
+		{
+			__m128 f = _mm_set1_ps(frequency);
+			__m128 n = gradientNoise4(_mm_mul_ps(xf, f), _mm_mul_ps(yf, f), _mm_mul_ps(zf, f), mSeed + o);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), n));
+			amplitude *= mGain;
+			frequency *= mLacunarity;
+		}
+		_mm_storeu_ps(out + i, _mm_mul_ps(sum, _mm_set1_ps(mInvAmplitude)));
+	}
+#endif
+	// Remainder, or everything without SSE2
+	for (; i < count; ++i)
+		out[i] = getValue(x0 + float(i) * dx, y, z);
+}
+//-----------------------------------------------------------------------
+bool FractalNoise::isVectorised()
+{
+#ifdef FRACTAL_NOISE_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
+
+}// namespace Ogre
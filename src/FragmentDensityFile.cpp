@@ -0,0 +1,402 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "FragmentDensityFile.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace Ogre
+{
+const uint32 FragmentDensityFile::VERSION = 4;
+const int32 FragmentDensityFile::TILE_LEVEL = std::numeric_limits<int32>::min();
+
+namespace
+{
+	const uint32 BYTE_ORDER_MARK = 0x01020304;
+	/// High bit of a control word marks a run, otherwise it counts literal words.
+	const uint32 RUN_FLAG = 0x80000000;
+	/// Runs shorter than this are stored as literals.
+	const size_t MIN_RUN = 3;
+	/** Oldest version that can still be read; version 2 files have no carved columns,
+		version 3 files no tile blocks. */
+	const uint32 MIN_VERSION = 2;
+
+	size_t paddedColumnBytes(size_t numColumns)
+	{
+		return (numColumns + 3) & ~size_t(3);
+	}
+
+	bool entryLess(const FragmentDensityFile::IndexEntry& a, const FragmentDensityFile::IndexEntry& b)
+	{
+		if (a.tileX != b.tileX)
+			return a.tileX < b.tileX;
+		if (a.tileZ != b.tileZ)
+			return a.tileZ < b.tileZ;
+		return a.yLevel < b.yLevel;
+	}
+
+	bool fragmentLess(const FragmentDensityFile::Fragment& a, const FragmentDensityFile::Fragment& b)
+	{
+		if (a.tileX != b.tileX)
+			return a.tileX < b.tileX;
+		if (a.tileZ != b.tileZ)
+			return a.tileZ < b.tileZ;
+		return a.yLevel < b.yLevel;
+	}
+
+	size_t runLength(const uint32* words, size_t i, size_t count)
+	{
+		size_t run = 1;
+		while (i + run < count && words[i + run] == words[i] && run < (RUN_FLAG - 1))
+			++run;
+		return run;
+	}
+}
+//-----------------------------------------------------------------------
+FragmentDensityFile::FragmentDensityFile()
+: mHeader(0), mIndex(0), mNumGridPoints(0)
+{
+}
+//-----------------------------------------------------------------------
+FragmentDensityFile::~FragmentDensityFile()
+{
+	close();
+}
+//-----------------------------------------------------------------------
+bool FragmentDensityFile::compressBlock(const uint32* words, size_t count, std::vector<uint32>& out)
+{
+	out.clear();
+	size_t i = 0;
+	while (i < count)
+	{
+		size_t run = runLength(words, i, count);
+		if (run >= MIN_RUN)
+		{
+			out.push_back(RUN_FLAG | uint32(run));
+			out.push_back(words[i]);
+			i += run;
+		}
+		else
+		{
+			// Gather literals until the next worthwhile run starts.
+			size_t start = i;
+			while (i < count && runLength(words, i, count) < MIN_RUN && i - start < RUN_FLAG - 1)
+				++i;
+			out.push_back(uint32(i - start));
+			out.insert(out.end(), words + start, words + i);
+		}
+		if (out.size() >= count)
+			return false;
+	}
+	return true;
+}
+//-----------------------------------------------------------------------
+void FragmentDensityFile::save(const String& filename, FragmentList& fragments, 
+	size_t numCellsX, size_t numCellsY, size_t numCellsZ, Real gridScale, bool compress,
+	uint64 sequence, const TileBlockList* tileBlocks)
+{
+	std::ofstream os(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!os)
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Cannot open " + filename + " for writing",
+			"FragmentDensityFile::save");
+	}
+
+	std::sort(fragments.begin(), fragments.end(), fragmentLess);
+	size_t numGridPoints = (numCellsX + 1)*(numCellsY + 1)*(numCellsZ + 1);
+	size_t numColumns = numCellsX*numCellsZ;
+	std::vector<uchar> columns(paddedColumnBytes(numColumns), 0);
+
+	Header header;
+	memcpy(header.magic, "OTFD", 4);
+	header.version = VERSION;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.numCells[0] = uint32(numCellsX);
+	header.numCells[1] = uint32(numCellsY);
+	header.numCells[2] = uint32(numCellsZ);
+	header.gridScale = float(gridScale);
+	size_t numTileBlocks = tileBlocks ? tileBlocks->size() : 0;
+	header.numEntries = uint32(fragments.size() + numTileBlocks);
+	header.indexOffset = 0;
+	header.sequence = sequence;
+	os.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	std::vector<IndexEntry> index(fragments.size());
+	std::vector<uint32> packed;
+	uint64 offset = sizeof(Header);
+	for (size_t f = 0; f < fragments.size(); ++f)
+	{
+		const Fragment& frag = fragments[f];
+
+		IndexEntry& e = index[f];
+		e.tileX = frag.tileX;
+		e.tileZ = frag.tileZ;
+		e.yLevel = frag.yLevel;
+		e.flags = frag.flags & ~(ENTRY_COMPRESSED | ENTRY_HAS_COLUMNS);
+		e.position[0] = frag.position.x;
+		e.position[1] = frag.position.y;
+		e.position[2] = frag.position.z;
+		e.offset = offset;
+
+		if (encodeBlock(frag.values, numGridPoints, compress, packed))
+			e.flags |= ENTRY_COMPRESSED;
+		e.size = uint32(packed.size()*sizeof(uint32));
+		os.write(reinterpret_cast<const char*>(&packed[0]), e.size);
+		offset += e.size;
+
+		if (frag.columns)
+		{
+			e.flags |= ENTRY_HAS_COLUMNS;
+			std::copy(frag.columns, frag.columns + numColumns, columns.begin());
+			os.write(reinterpret_cast<const char*>(&columns[0]), columns.size());
+			offset += columns.size();
+		}
+	}
+
+	for (size_t b = 0; b < numTileBlocks; ++b)
+	{
+		const TileBlock& block = (*tileBlocks)[b];
+		IndexEntry e;
+		e.tileX = block.tileX;
+		e.tileZ = block.tileZ;
+		e.yLevel = TILE_LEVEL;
+		e.flags = block.flags & ENTRY_TILE_BLOCK;
+		e.position[0] = e.position[1] = e.position[2] = 0;
+		e.offset = offset;
+		e.size = uint32(block.numWords*sizeof(uint32));
+		if (e.size)
+			os.write(reinterpret_cast<const char*>(block.words), e.size);
+		offset += e.size;
+		index.push_back(e);
+	}
+	// Tile blocks go ahead of the fragments of their tile
+	std::stable_sort(index.begin(), index.end(), entryLess);
+
+	// Keep the index 8 byte aligned, so it can be used in place from the mapping.
+	static const char padding[8] = {0};
+	size_t pad = size_t((8 - offset % 8) % 8);
+	os.write(padding, pad);
+	header.indexOffset = offset + pad;
+	if (!index.empty())
+		os.write(reinterpret_cast<const char*>(&index[0]), index.size()*sizeof(IndexEntry));
+
+	os.seekp(0);
+	os.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	if (!os)
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Error writing " + filename,
+			"FragmentDensityFile::save");
+	}
+}
+//-----------------------------------------------------------------------
+void FragmentDensityFile::open(const String& filename)
+{
+	close();
+	mFile.open(filename);
+
+	const Header* header = reinterpret_cast<const Header*>(mFile.getData());
+	if (mFile.getSize() < sizeof(Header) || memcmp(header->magic, "OTFD", 4) != 0)
+	{
+		close();
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, filename + " is not a fragment density file",
+			"FragmentDensityFile::open");
+	}
+	if (header->version < MIN_VERSION || header->version > VERSION || header->byteOrder != BYTE_ORDER_MARK)
+	{
+		close();
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, filename + " has an unsupported version or byte order",
+			"FragmentDensityFile::open");
+	}
+	if (header->indexOffset + uint64(header->numEntries)*sizeof(IndexEntry) > mFile.getSize())
+	{
+		close();
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, filename + " is truncated",
+			"FragmentDensityFile::open");
+	}
+
+	mHeader = header;
+	mIndex = reinterpret_cast<const IndexEntry*>(mFile.getData() + header->indexOffset);
+	mNumGridPoints = size_t(header->numCells[0] + 1)*(header->numCells[1] + 1)*(header->numCells[2] + 1);
+
+	LogManager::getSingleton().logMessage("FragmentDensityFile: Mapped " + filename + " with " +
+		StringConverter::toString(header->numEntries) + " fragments");
+}
+//-----------------------------------------------------------------------
+void FragmentDensityFile::close()
+{
+	mFile.close();
+	mHeader = 0;
+	mIndex = 0;
+	mNumGridPoints = 0;
+}
+//-----------------------------------------------------------------------
+bool FragmentDensityFile::matchesGrid(size_t numCellsX, size_t numCellsY, size_t numCellsZ, Real gridScale) const
+{
+	return mHeader && mHeader->numCells[0] == numCellsX && mHeader->numCells[1] == numCellsY &&
+		mHeader->numCells[2] == numCellsZ && Math::RealEqual(mHeader->gridScale, gridScale, 1e-4);
+}
+//-----------------------------------------------------------------------
+size_t FragmentDensityFile::findFragments(int tileX, int tileZ, EntryList& entries) const
+{
+	entries.clear();
+	if (!mHeader)
+		return 0;
+
+	IndexEntry key;
+	key.tileX = tileX;
+	key.tileZ = tileZ;
+	key.yLevel = std::numeric_limits<int32>::min();
+	const IndexEntry* end = mIndex + mHeader->numEntries;
+	for (const IndexEntry* e = std::lower_bound(mIndex, end, key, entryLess); 
+		e != end && e->tileX == tileX && e->tileZ == tileZ; ++e)
+	{
+		if (!(e->flags & ENTRY_TILE_BLOCK))
+			entries.push_back(e);
+	}
+	return entries.size();
+}
+//-----------------------------------------------------------------------
+const FragmentDensityFile::IndexEntry* FragmentDensityFile::findTileBlock(int tileX, int tileZ, uint32 flag) const
+{
+	if (!mHeader)
+		return 0;
+
+	IndexEntry key;
+	key.tileX = tileX;
+	key.tileZ = tileZ;
+	key.yLevel = TILE_LEVEL;
+	const IndexEntry* end = mIndex + mHeader->numEntries;
+	for (const IndexEntry* e = std::lower_bound(mIndex, end, key, entryLess); 
+		e != end && e->tileX == tileX && e->tileZ == tileZ && e->yLevel == TILE_LEVEL; ++e)
+	{
+		if (e->flags & flag)
+			return e;
+	}
+	return 0;
+}
+//-----------------------------------------------------------------------
+const uint32* FragmentDensityFile::getTileBlock(const IndexEntry& entry) const
+{
+	assert(mHeader && (entry.flags & ENTRY_TILE_BLOCK));
+	if (entry.offset + entry.size > mFile.getSize())
+	{
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, "Tile block outside of " + getFilename(),
+			"FragmentDensityFile::getTileBlock");
+	}
+	return reinterpret_cast<const uint32*>(mFile.getData() + entry.offset);
+}
+//-----------------------------------------------------------------------
+size_t FragmentDensityFile::prefetchFragments(int tileX, int tileZ) const
+{
+	EntryList entries;
+	findFragments(tileX, tileZ, entries);
+	for (EntryList::iterator it = entries.begin(); it != entries.end(); ++it)
+		mFile.prefetch(size_t((*it)->offset), (*it)->size + ((*it)->flags & ENTRY_HAS_COLUMNS ? getNumColumns() : 0));
+	return entries.size();
+}
+//-----------------------------------------------------------------------
+void FragmentDensityFile::readDensities(const IndexEntry& entry, Real* values) const
+{
+	assert(mHeader);
+	if (entry.offset + entry.size > mFile.getSize())
+	{
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, "Density block outside of " + getFilename(),
+			"FragmentDensityFile::readDensities");
+	}
+	const uint32* p = reinterpret_cast<const uint32*>(mFile.getData() + entry.offset);
+	if (!decodeBlock(p, entry.size/sizeof(uint32), (entry.flags & ENTRY_COMPRESSED) != 0, values, mNumGridPoints))
+	{
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, "Corrupt density block in " + getFilename(),
+			"FragmentDensityFile::readDensities");
+	}
+}
+//-----------------------------------------------------------------------
+const uchar* FragmentDensityFile::getColumns(const IndexEntry& entry) const
+{
+	assert(mHeader);
+	if (!(entry.flags & ENTRY_HAS_COLUMNS))
+		return 0;
+	if (entry.offset + entry.size + getNumColumns() > mFile.getSize())
+	{
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, "Column block outside of " + getFilename(),
+			"FragmentDensityFile::getColumns");
+	}
+	return mFile.getData() + entry.offset + entry.size;
+}
+//-----------------------------------------------------------------------
+bool FragmentDensityFile::encodeBlock(const Real* values, size_t numGridPoints, bool compress, 
+	std::vector<uint32>& out)
+{
+	std::vector<float> block(numGridPoints);
+	for (size_t i = 0; i < numGridPoints; ++i)
+		block[i] = float(values[i]);
+
+	const uint32* words = reinterpret_cast<const uint32*>(&block[0]);
+	if (compress && compressBlock(words, numGridPoints, out))
+		return true;
+	out.assign(words, words + numGridPoints);
+	return false;
+}
+//-----------------------------------------------------------------------
+bool FragmentDensityFile::decodeBlock(const uint32* p, size_t numWords, bool compressed, 
+	Real* values, size_t numGridPoints)
+{
+	const uint32* end = p + numWords;
+
+	if (!compressed)
+	{
+		if (numWords != numGridPoints)
+			return false;
+		const float* f = reinterpret_cast<const float*>(p);
+		for (size_t i = 0; i < numGridPoints; ++i)
+			values[i] = f[i];
+		return true;
+	}
+
+	size_t i = 0;
+	while (p < end && i < numGridPoints)
+	{
+		uint32 control = *p++;
+		size_t count = control & ~RUN_FLAG;
+		bool run = (control & RUN_FLAG) != 0;
+		if (i + count > numGridPoints || p + (run ? 1 : count) > end)
+			break;
+		const float* f = reinterpret_cast<const float*>(p);
+		if (run)
+		{
+			std::fill(values + i, values + i + count, Real(*f));
+			++p;
+		}
+		else
+		{
+			for (size_t k = 0; k < count; ++k)
+				values[i + k] = f[k];
+			p += count;
+		}
+		i += count;
+	}
+	return i == numGridPoints;
+}
+
+}// namespace Ogre
@@ -0,0 +1,206 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "FragmentMeshCache.h"
+#include <algorithm>
+#include <fstream>
+
+namespace Ogre
+{
+const uint32 FragmentMeshCache::VERSION = 1;
+
+namespace
+{
+	const uint32 BYTE_ORDER_MARK = 0x01020304;
+
+	bool meshLess(const FragmentMeshCache::Mesh& a, const FragmentMeshCache::Mesh& b)
+	{
+		return a.hash < b.hash;
+	}
+
+	bool entryLess(const FragmentMeshCache::IndexEntry& a, const FragmentMeshCache::IndexEntry& b)
+	{
+		return a.hash < b.hash;
+	}
+}
+//-----------------------------------------------------------------------
+FragmentMeshCache::FragmentMeshCache()
+: mHeader(0), mIndex(0), mNumHits(0), mNumMisses(0)
+{
+}
+//-----------------------------------------------------------------------
+FragmentMeshCache::~FragmentMeshCache()
+{
+	close();
+}
+//-----------------------------------------------------------------------
+uint64 FragmentMeshCache::hashDensities(const Real* values, size_t count)
+{
+	// FNV-1a, fed with 32 bit words rather than single bytes.
+	const uint32* words = reinterpret_cast<const uint32*>(values);
+	size_t numWords = count*sizeof(Real)/sizeof(uint32);
+	uint64 hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < numWords; ++i)
+	{
+		hash ^= words[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+//-----------------------------------------------------------------------
+void FragmentMeshCache::save(const String& filename, MeshList& meshes, size_t vertexSize)
+{
+	std::ofstream os(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!os)
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Cannot open " + filename + " for writing",
+			"FragmentMeshCache::save");
+	}
+
+	std::sort(meshes.begin(), meshes.end(), meshLess);
+
+	Header header;
+	memcpy(header.magic, "OTFM", 4);
+	header.version = VERSION;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.vertexSize = uint32(vertexSize);
+	header.numEntries = 0;
+	header.reserved = 0;
+	header.indexOffset = 0;
+	os.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	static const char padding[8] = {0};
+	std::vector<IndexEntry> index;
+	index.reserve(meshes.size());
+	uint64 offset = sizeof(Header);
+	for (size_t m = 0; m < meshes.size(); ++m)
+	{
+		const Mesh& mesh = meshes[m];
+		// Identical densities give identical meshes, one copy is enough.
+		if (!index.empty() && index.back().hash == mesh.hash)
+			continue;
+
+		IndexEntry e;
+		e.hash = mesh.hash;
+		e.tileX = mesh.tileX;
+		e.tileZ = mesh.tileZ;
+		e.yLevel = mesh.yLevel;
+		e.vertexCount = uint32(mesh.vertexCount);
+		e.indexCount = uint32(mesh.indexCount);
+		e.reserved = 0;
+		e.offset = offset;
+		index.push_back(e);
+
+		size_t vertexBytes = mesh.vertexCount*vertexSize;
+		size_t indexBytes = mesh.indexCount*sizeof(uint16);
+		if (vertexBytes)
+			os.write(reinterpret_cast<const char*>(mesh.vertices), vertexBytes);
+		if (indexBytes)
+			os.write(reinterpret_cast<const char*>(mesh.indices), indexBytes);
+		// Keep every block 8 byte aligned for the mapping.
+		size_t pad = (8 - (vertexBytes + indexBytes) % 8) % 8;
+		os.write(padding, pad);
+		offset += vertexBytes + indexBytes + pad;
+	}
+
+	header.numEntries = uint32(index.size());
+	header.indexOffset = offset;
+	if (!index.empty())
+		os.write(reinterpret_cast<const char*>(&index[0]), index.size()*sizeof(IndexEntry));
+
+	os.seekp(0);
+	os.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	if (!os)
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Error writing " + filename,
+			"FragmentMeshCache::save");
+	}
+}
+//-----------------------------------------------------------------------
+void FragmentMeshCache::open(const String& filename)
+{
+	close();
+	mFile.open(filename);
+
+	const Header* header = reinterpret_cast<const Header*>(mFile.getData());
+	if (mFile.getSize() < sizeof(Header) || memcmp(header->magic, "OTFM", 4) != 0 ||
+		header->version != VERSION || header->byteOrder != BYTE_ORDER_MARK ||
+		header->indexOffset + uint64(header->numEntries)*sizeof(IndexEntry) > mFile.getSize())
+	{
+		close();
+		OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, filename + " is not a valid fragment mesh cache",
+			"FragmentMeshCache::open");
+	}
+
+	mHeader = header;
+	mIndex = reinterpret_cast<const IndexEntry*>(mFile.getData() + header->indexOffset);
+	mNumHits = mNumMisses = 0;
+
+	LogManager::getSingleton().logMessage("FragmentMeshCache: Mapped " + filename + " with " +
+		StringConverter::toString(header->numEntries) + " meshes");
+}
+//-----------------------------------------------------------------------
+void FragmentMeshCache::close()
+{
+	mFile.close();
+	mHeader = 0;
+	mIndex = 0;
+}
+//-----------------------------------------------------------------------
+const FragmentMeshCache::IndexEntry* FragmentMeshCache::find(uint64 hash) const
+{
+	if (!mHeader)
+		return 0;
+
+	IndexEntry key;
+	key.hash = hash;
+	const IndexEntry* end = mIndex + mHeader->numEntries;
+	const IndexEntry* e = std::lower_bound(mIndex, end, key, entryLess);
+	if (e == end || e->hash != hash)
+		return 0;
+	// Do not trust blocks pointing outside of the mapping.
+	if (e->offset + uint64(e->vertexCount)*mHeader->vertexSize + uint64(e->indexCount)*sizeof(uint16) > mFile.getSize())
+		return 0;
+	return e;
+}
+//-----------------------------------------------------------------------
+size_t FragmentMeshCache::prefetchMeshes(int minTileX, int minTileZ, int maxTileX, int maxTileZ) const
+{
+	if (!mHeader)
+		return 0;
+
+	size_t count = 0;
+	for (const IndexEntry* e = mIndex; e != mIndex + mHeader->numEntries; ++e)
+	{
+		if (e->tileX < minTileX || e->tileX > maxTileX || e->tileZ < minTileZ || e->tileZ > maxTileZ)
+			continue;
+		uint64 size = uint64(e->vertexCount)*mHeader->vertexSize + uint64(e->indexCount)*sizeof(uint16);
+		if (e->offset + size > mFile.getSize())
+			continue;
+		mFile.prefetch(size_t(e->offset), size_t(size));
+		++count;
+	}
+	return count;
+}
+
+}// namespace Ogre
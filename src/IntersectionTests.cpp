@@ -0,0 +1,235 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "IntersectionTests.h"
+
+namespace Ogre
+{
+namespace IntersectionTests
+{
+namespace
+{
+	/** Intersects the ray with the slab of thickness 2 * radius around triangle abc, 
+		entering through one of its flat sides. Its rims are left to the edge capsules. */
+	bool raySlab(const Vector3& origin, const Vector3& dir, const Vector3& a, const Vector3& b, 
+		const Vector3& c, Real radius, Real maxT, Real& t, Vector3& normal)
+	{
+		Vector3 n = (b - a).crossProduct(c - a);
+		if (n.normalise() == 0)
+			return false;
+
+		Real d0 = n.dotProduct(origin - a);
+		Real dd = n.dotProduct(dir);
+		Real enter, side;
+		if (Math::Abs(d0) <= radius)
+		{
+			enter = 0;
+			side = d0 > 0 || (d0 == 0 && dd <= 0) ? 1 : -1;
+		}
+		else if (d0 > 0 && dd < 0)
+		{
+			enter = (radius - d0)/dd;
+			side = 1;
+		}
+		else if (d0 < 0 && dd > 0)
+		{
+			enter = (-radius - d0)/dd;
+			side = -1;
+		}
+		else
+			return false;
+		if (enter > maxT)
+			return false;
+
+		// The point in the plane below the entry has to lie within the triangle
+		Vector3 p = origin + dir*enter - n*(d0 + dd*enter);
+		if ((b - a).crossProduct(p - a).dotProduct(n) < 0 ||
+			(c - b).crossProduct(p - b).dotProduct(n) < 0 ||
+			(a - c).crossProduct(p - c).dotProduct(n) < 0)
+			return false;
+
+		t = enter;
+		normal = n*side;
+		return true;
+	}
+}
+
+bool raySphere(const Vector3& origin, const Vector3& dir, const Vector3& centre, Real radius, 
+	Real maxT, Real& t, Vector3& normal)
+{
+	Vector3 m = origin - centre;
+	Real c = m.squaredLength() - radius*radius;
+	if (c <= 0)
+	{
+		t = 0;
+		normal = m.isZeroLength() ? -dir : m.normalisedCopy();
+		return true;
+	}
+
+	Real a = dir.squaredLength();
+	Real b = m.dotProduct(dir);
+	Real disc = b*b - a*c;
+	if (b >= 0 || a == 0 || disc < 0)
+		return false;
+
+	Real hit = (-b - Math::Sqrt(disc))/a;
+	if (hit > maxT)
+		return false;
+
+	t = hit;
+	normal = (m + dir*hit)/radius;
+	return true;
+}
+
+bool rayCapsule(const Vector3& origin, const Vector3& dir, const Vector3& p, const Vector3& q,
+	Real radius, Real maxT, Real& t, Vector3& normal)
+{
+	Vector3 u = q - p;
+	Real length = u.normalise();
+	if (length == 0)
+		return raySphere(origin, dir, p, radius, maxT, t, normal);
+
+	// Starting inside
+	Vector3 m = origin - p;
+	Real s = std::min(std::max(m.dotProduct(u), Real(0)), length);
+	if ((m - u*s).squaredLength() <= radius*radius)
+		return raySphere(origin, dir, p + u*s, radius, maxT, t, normal);
+
+	// The side of the cylinder, in the plane across the axis
+	bool hit = false;
+	Vector3 mp = m - u*m.dotProduct(u);
+	Vector3 dp = dir - u*dir.dotProduct(u);
+	Real a = dp.squaredLength();
+	Real b = mp.dotProduct(dp);
+	Real c = mp.squaredLength() - radius*radius;
+	Real disc = b*b - a*c;
+	if (a > 0 && b < 0 && disc >= 0)
+	{
+		Real tc = (-b - Math::Sqrt(disc))/a;
+		Real sc = (m + dir*tc).dotProduct(u);
+		if (tc <= maxT && sc >= 0 && sc <= length)
+		{
+			t = maxT = tc;
+			normal = (mp + dp*tc)/radius;
+			hit = true;
+		}
+	}
+
+	// The caps
+	if (raySphere(origin, dir, p, radius, maxT, t, normal))
+	{
+		maxT = t;
+		hit = true;
+	}
+	if (raySphere(origin, dir, q, radius, maxT, t, normal))
+		hit = true;
+	return hit;
+}
+
+bool sweepTriangle(const Sweep& sweep, const Vector3& a, const Vector3& b, const Vector3& c, 
+	Real maxT, Real& t, Vector3& normal)
+{
+	const Vector3& o = sweep.origin;
+	const Vector3& d = sweep.dir;
+	const Real r = sweep.radius;
+	const Vector3 v[3] = {a, b, c};
+	bool hit = false;
+
+	if (sweep.axis.isZeroLength())
+	{
+		// A sphere: the triangle grown by the radius is its slab and the capsules around its edges
+		if (raySlab(o, d, a, b, c, r, maxT, t, normal))
+		{
+			maxT = t;
+			hit = true;
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			if (rayCapsule(o, d, v[i], v[(i + 1) % 3], r, maxT, t, normal))
+			{
+				maxT = t;
+				hit = true;
+			}
+		}
+		return hit;
+	}
+
+	// The axis already passing through the triangle
+	Real u;
+	if (rayTriangle(o, sweep.axis, a, b, c, u) && u >= 0 && u <= 1)
+	{
+		Vector3 n = (b - a).crossProduct(c - a).normalisedCopy();
+		t = 0;
+		normal = n.dotProduct(d) > 0 ? -n : n;
+		return true;
+	}
+
+	// A capsule: the triangle is first stretched along the mirrored axis into a prism
+	// with the triangle and its copy at either end, then grown as for the sphere
+	const Vector3 w[3] = {a - sweep.axis, b - sweep.axis, c - sweep.axis};
+	if (raySlab(o, d, a, b, c, r, maxT, t, normal))
+	{
+		maxT = t;
+		hit = true;
+	}
+	if (raySlab(o, d, w[0], w[1], w[2], r, maxT, t, normal))
+	{
+		maxT = t;
+		hit = true;
+	}
+	for (int i = 0; i < 3; ++i)
+	{
+		int j = (i + 1) % 3;
+		// The side of the prism through edge ij, as two triangles
+		if (raySlab(o, d, v[i], v[j], w[j], r, maxT, t, normal))
+		{
+			maxT = t;
+			hit = true;
+		}
+		if (raySlab(o, d, v[i], w[j], w[i], r, maxT, t, normal))
+		{
+			maxT = t;
+			hit = true;
+		}
+		// Its edges
+		if (rayCapsule(o, d, v[i], v[j], r, maxT, t, normal))
+		{
+			maxT = t;
+			hit = true;
+		}
+		if (rayCapsule(o, d, w[i], w[j], r, maxT, t, normal))
+		{
+			maxT = t;
+			hit = true;
+		}
+		if (rayCapsule(o, d, v[i], w[i], r, maxT, t, normal))
+		{
+			maxT = t;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+}
+}/// namespace Ogre
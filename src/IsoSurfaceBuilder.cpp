@@ -33,7 +33,7 @@ namespace Ogre
 
 IsoSurfaceBuilder::IsoSurfaceBuilder()
   : mIsoVertexIndices(0), mIsoVertexPositions(0), mIsoVertexNormals(0),
-	mIsoVertexColours(0), mIsoVertexTexCoords(0), mNumIsoVertices(0)//, mSurfaceFlags(0)
+	mIsoVertexColours(0), mIsoVertexTexCoords(0), mNumIsoVertices(0), mColumnMask(0), mVertexSnap(0)//, mSurfaceFlags(0)
 {
 }
 
@@ -85,10 +85,25 @@ void IsoSurfaceBuilder::update(IsoSurfaceRenderable *surf)
 	// Build the iso surface
 	buildIsoSurface();
 
+	if (mVertexSnap)
+		snapIsoVertices();
+
 	// Update the render operation
 	surf->fillHardwareBuffers(this);
 }
 
+void IsoSurfaceBuilder::snapIsoVertices()
+{
+	// Iso vertex positions are relative to the data grid
+	Vector3 offset = mDataGrid->getPosition();
+	for (IsoVertexVector::iterator i = mIsoVertices.begin(); i != mIsoVertices.end(); ++i)
+	{
+		Vector3 position = mIsoVertexPositions[*i] + offset;
+		if ((*mVertexSnap)(position))
+			mIsoVertexPositions[*i] = position - offset;
+	}
+}
+
 size_t IsoSurfaceBuilder::getNumIsoVertices()
 {
 	if (!mNumIsoVertices)
@@ -240,12 +255,21 @@ void IsoSurfaceBuilder::buildIsoSurface()
 		mDataGrid->getNumCellsX() *
 		mDataGrid->getNumCellsY() *
 		mDataGrid->getNumCellsZ();
+	size_t numCellsX = mDataGrid->getNumCellsX();
+	size_t cellsPerSlice = numCellsX * mDataGrid->getNumCellsY();
 	Real* values = mDataGrid->getValues();
 	GridCell* gridCell = mGridCells;
 
 	// Loop through all grid cells
 	for (size_t i = 0; i < count; ++i)
 	{
+		// Cells are ordered x fastest, then y, then z
+		if (mColumnMask && !mColumnMask[(i / cellsPerSlice) * numCellsX + i % numCellsX])
+		{
+			++gridCell;
+			continue;
+		}
+
 		IsoTriangle isoTriangle;
 		size_t flags = 0;
 
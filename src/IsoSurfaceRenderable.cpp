@@ -31,7 +31,7 @@ namespace Ogre
 {
 
 IsoSurfaceRenderable::IsoSurfaceRenderable()
-: mSurfaceFlags(0)
+: mSurfaceFlags(0), mBVHDirty(true)
 {
 }
 
@@ -134,10 +134,72 @@ void IsoSurfaceRenderable::fillHardwareBuffers(IsoSurfaceBuilder *builder)
 		*pIndex++ = static_cast<unsigned short>(builder->mIsoVertexIndices[i->vertices[0]]);
 		*pIndex++ = static_cast<unsigned short>(builder->mIsoVertexIndices[i->vertices[1]]);
 		*pIndex++ = static_cast<unsigned short>(builder->mIsoVertexIndices[i->vertices[2]]);
-		std::cout << *(pIndex - 1) << std::endl;
 	}
 	ibuf->unlock();
 	mAABB = builder->mDataGrid->getBoxSize();
+	mBVHDirty = true;
+}
+
+void IsoSurfaceRenderable::fillHardwareBuffers(const uchar *vertices, size_t vertexCount, const uint16 *indices, 
+	size_t indexCount, const AxisAlignedBox &box)
+{
+	prepareHardwareBuffers(vertexCount, indexCount);
+
+	if (vertexCount)
+	{
+		HardwareVertexBufferSharedPtr vbuf = mRenderOp.vertexData->vertexBufferBinding->getBuffer(0);
+		vbuf->writeData(0, vertexCount*getVertexSize(), vertices, true);
+	}
+	if (indexCount)
+	{
+		HardwareIndexBufferSharedPtr ibuf = mRenderOp.indexData->indexBuffer;
+		ibuf->writeData(0, indexCount*sizeof(uint16), indices, true);
+	}
+	mAABB = box;
+	mBVHDirty = true;
+}
+
+void IsoSurfaceRenderable::readHardwareBuffers(std::vector<uchar> &vertices, std::vector<uint16> &indices) const
+{
+	size_t vertexCount = mRenderOp.vertexData->vertexCount;
+	size_t indexCount = mRenderOp.indexData->indexCount;
+	vertices.resize(vertexCount*getVertexSize());
+	indices.resize(indexCount);
+	if (vertexCount)
+	{
+		mRenderOp.vertexData->vertexBufferBinding->getBuffer(0)->readData(
+			0, vertices.size(), &vertices[0]);
+	}
+	if (indexCount)
+		mRenderOp.indexData->indexBuffer->readData(0, indexCount*sizeof(uint16), &indices[0]);
+}
+
+bool IsoSurfaceRenderable::intersectRay(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t)
+{
+	updateBVH();
+	return mBVH.intersect(origin, dir, maxT, t);
+}
+
+bool IsoSurfaceRenderable::sweep(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal)
+{
+	updateBVH();
+	return mBVH.sweep(sweep, maxT, t, normal);
+}
+
+void IsoSurfaceRenderable::updateBVH()
+{
+	if (mBVHDirty && mRenderOp.vertexData)
+	{
+		std::vector<uchar> vertices;
+		std::vector<uint16> indices;
+		readHardwareBuffers(vertices, indices);
+		if (indices.empty())
+			mBVH.clear();
+		else
+			mBVH.build(&vertices[mPositionElement->getOffset()], getVertexCount(), getVertexSize(), 
+				&indices[0], indices.size());
+		mBVHDirty = false;
+	}
 }
 
 void IsoSurfaceRenderable::deleteGeometry()
@@ -0,0 +1,140 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "MappedFile.h"
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+namespace Ogre
+{
+//-----------------------------------------------------------------------
+MappedFile::MappedFile()
+: mData(0), mSize(0),
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+  mFileHandle(INVALID_HANDLE_VALUE), mMappingHandle(0)
+#else
+  mFileDescriptor(-1)
+#endif
+{
+}
+//-----------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	close();
+}
+//-----------------------------------------------------------------------
+void MappedFile::open(const String& filename)
+{
+	close();
+	mFilename = filename;
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	mFileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 0);
+	if (mFileHandle == INVALID_HANDLE_VALUE)
+	{
+		OGRE_EXCEPT(Exception::ERR_FILE_NOT_FOUND, "Cannot open " + filename,
+			"MappedFile::open");
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(mFileHandle, &size);
+	mSize = static_cast<size_t>(size.QuadPart);
+	if (mSize)
+	{
+		mMappingHandle = CreateFileMappingA(mFileHandle, 0, PAGE_READONLY, 0, 0, 0);
+		if (mMappingHandle)
+			mData = static_cast<const uchar*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+	}
+#else
+	mFileDescriptor = ::open(filename.c_str(), O_RDONLY);
+	if (mFileDescriptor < 0)
+	{
+		OGRE_EXCEPT(Exception::ERR_FILE_NOT_FOUND, "Cannot open " + filename,
+			"MappedFile::open");
+	}
+	struct stat st;
+	if (fstat(mFileDescriptor, &st) == 0)
+		mSize = static_cast<size_t>(st.st_size);
+	if (mSize)
+	{
+		void* p = mmap(0, mSize, PROT_READ, MAP_SHARED, mFileDescriptor, 0);
+		if (p != MAP_FAILED)
+			mData = static_cast<const uchar*>(p);
+	}
+#endif
+
+	if (!mData)
+	{
+		close();
+		OGRE_EXCEPT(Exception::ERR_INTERNAL_ERROR, "Cannot map " + filename + 
+			" (empty file or out of address space)", "MappedFile::open");
+	}
+}
+//-----------------------------------------------------------------------
+void MappedFile::prefetch(size_t offset, size_t size) const
+{
+	if (!mData || offset >= mSize)
+		return;
+	size = std::min(size, mSize - offset);
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	// PrefetchVirtualMemory needs Windows 8; rely on the read-ahead of the cache manager
+	(void)size;
+#else
+	// madvise wants a page aligned start
+	size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+	size_t start = offset - offset % pageSize;
+	madvise(const_cast<uchar*>(mData) + start, size + offset - start, MADV_WILLNEED);
+#endif
+}
+//-----------------------------------------------------------------------
+void MappedFile::close()
+{
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMappingHandle)
+		CloseHandle(mMappingHandle);
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(mFileHandle);
+	mMappingHandle = 0;
+	mFileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (mData)
+		munmap(const_cast<uchar*>(mData), mSize);
+	if (mFileDescriptor >= 0)
+		::close(mFileDescriptor);
+	mFileDescriptor = -1;
+#endif
+	mData = 0;
+	mSize = 0;
+}
+
+}// namespace Ogre
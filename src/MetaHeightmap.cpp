@@ -51,6 +51,34 @@ void MetaHeightmap::updateDataGrid(DataGrid* dataGrid)
 		mFallofRange = dataGrid->getGridScale();
 		mGradient = mGroundThreshold / dataGrid->getGridScale();
 	}
+
+	// Skip sampling the heights where the field is known to be constant
+	switch (classify(dataGrid->getBoundingBox()))
+	{
+	case MetaWorldFragment::FC_AIR:
+		return;
+	case MetaWorldFragment::FC_SOLID:
+		{
+			Real fieldStrength = 2.0*mGroundThreshold;
+			size_t numGridPoints = dataGrid->getNumGridPoints();
+			for (size_t i = 0; i < numGridPoints; ++i)
+				values[i] += fieldStrength;
+			if(worldFragments)
+			{
+				for (size_t i = 0; i < numGridPoints; ++i)
+				{
+					if(fieldStrength > worldFragments[i].first)
+					{
+						worldFragments[i].first = fieldStrength;
+						worldFragments[i].second = mMetaWorldFragment;
+					}
+				}
+			}
+			return;
+		}
+	default:
+		break;
+	}
 	Vector3 gridMin = dataGrid->getBoundingBox().getMinimum();
 	Vector3 gridCenter = dataGrid->getPosition();
 	for (size_t z = 0; z <= dataGrid->getNumCellsZ(); ++z)
@@ -101,7 +129,24 @@ void MetaHeightmap::updateDataGrid(DataGrid* dataGrid)
 
 AxisAlignedBox MetaHeightmap::getAABB() const
 {
-	return mTerrainTile->getBoundingBox();
+	const AxisAlignedBox& tileBox = mTerrainTile->getBoundingBox();
+	Real fallof = getEffectiveFallofRange();
+	Vector3 min = tileBox.getMinimum(), max = tileBox.getMaximum();
+	min.y -= 2.0*fallof;
+	max.y += fallof;
+	return AxisAlignedBox(min, max);
+}
+
+MetaWorldFragment::Classification MetaHeightmap::classify(const AxisAlignedBox& box) const
+{
+	AxisAlignedBox band = getAABB();
+	// d = h - y <= -fallof everywhere: no contribution
+	if (box.getMinimum().y >= band.getMaximum().y)
+		return MetaWorldFragment::FC_AIR;
+	// d >= 2*fallof everywhere: constant solid field
+	if (box.getMaximum().y <= band.getMinimum().y)
+		return MetaWorldFragment::FC_SOLID;
+	return MetaWorldFragment::FC_SURFACE;
 }
 
 }/// namespace Ogre
\ No newline at end of file
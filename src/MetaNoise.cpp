@@ -0,0 +1,134 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/phpBB2/viewtopic.php?t=32486
+
+Copyright (c) 2007 Martin Enge. Based on code from DWORD, released into public domain.
+martin.enge@gmail.com
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "MetaNoise.h"
+#include "DataGrid.h"
+#include "MetaWorldFragment.h"
+
+namespace Ogre
+{
+namespace
+{
+	/// Seed offset of the second CT_WORMS field, far from the octave seeds of the first
+	const uint32 SECOND_FIELD_SEED = 0x9E3779B9u;
+	/// Part of each half extent over which the field fades out
+	const Real FADE_FRACTION = 0.125;
+}
+
+MetaNoise::MetaNoise(MetaWorldFragment *wf, const Vector3& position, const Vector3& halfSize, uint32 seed,
+	Real frequency, CaveType caveType, Real threshold, Real strength, ushort octaves, bool excavating)
+  : MetaObject(wf, position), mHalfSize(halfSize), mCaveType(caveType), mThreshold(threshold), 
+  mStrength(strength), mExcavating(excavating), 
+  mNoise(seed, octaves, float(frequency)), mNoise2(seed ^ SECOND_FIELD_SEED, octaves, float(frequency))
+{
+}
+
+Real MetaNoise::getEdgeFade(const Vector3& pos) const
+{
+	Vector3 d = pos - mPosition;
+	Real fade = 1.0;
+	for (int i = 0; i < 3; ++i)
+	{
+		Real range = mHalfSize[i] * FADE_FRACTION;
+		Real inside = mHalfSize[i] - Math::Abs(d[i]);
+		if (inside < range)
+			fade = std::min(fade, inside > 0 ? inside / range : Real(0));
+	}
+	return fade;
+}
+
+void MetaNoise::updateDataGrid(DataGrid* dataGrid)
+{
+	size_t x0, y0, z0, x1, y1, z1;
+
+	// Find the grid points inside the region
+	if (!dataGrid->mapAABB(getAABB(), x0, y0, z0, x1, y1, z1))
+		return;
+
+	Real* values = dataGrid->getValues();
+	const Vector3* vertices = dataGrid->getVertices();
+	std::pair<Real, MetaWorldFragment*>* worldFragments = dataGrid->getMetaWorldFragments();
+	Vector3 gridPosition = dataGrid->getPosition();
+	Real gridScale = dataGrid->getGridScale();
+	Real invThreshold = 1.0 / mThreshold;
+
+	size_t count = x1 - x0 + 1;
+	std::vector<float> field(count), field2(count);
+	for (size_t z = z0; z <= z1; ++z)
+	{
+		for (size_t y = y0; y <= y1; ++y)
+		{
+			size_t rowIndex = dataGrid->getGridIndex(x0, y, z);
+			Vector3 rowStart = vertices[rowIndex] + gridPosition;
+			// Noise is sampled in world space, so fragments agree where they meet
+			mNoise.fillRow(float(rowStart.x), float(gridScale), float(rowStart.y), float(rowStart.z), 
+				count, &field[0]);
+			if (mCaveType == CT_WORMS)
+				mNoise2.fillRow(float(rowStart.x), float(gridScale), float(rowStart.y), float(rowStart.z), 
+					count, &field2[0]);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				Real tunnel = 1.0 - Math::Abs(field[i]) * invThreshold;
+				if (tunnel <= 0)
+					continue;
+				if (mCaveType == CT_WORMS)
+				{
+					Real tunnel2 = 1.0 - Math::Abs(field2[i]) * invThreshold;
+					if (tunnel2 <= 0)
+						continue;
+					tunnel *= tunnel2;
+				}
+				Real fade = getEdgeFade(rowStart + Vector3(Real(i) * gridScale, 0, 0));
+				if (fade <= 0)
+					continue;
+
+				Real currentFieldStrength = tunnel * fade * mStrength;
+				size_t index = rowIndex + i;
+				if (mExcavating)
+					values[index] -= currentFieldStrength;
+				else
+					values[index] += currentFieldStrength;
+
+				// No cheap analytic gradient; normals are averaged from the mesh instead
+				if (worldFragments)
+				{
+					if (currentFieldStrength > worldFragments[index].first)
+					{
+						worldFragments[index].first = currentFieldStrength;
+						worldFragments[index].second = mMetaWorldFragment;
+					}
+				}
+			}
+		}
+	}
+}
+
+AxisAlignedBox MetaNoise::getAABB() const
+{
+	return AxisAlignedBox(mPosition - mHalfSize, mPosition + mHalfSize);
+}
+}
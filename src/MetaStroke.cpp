@@ -0,0 +1,163 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/phpBB2/viewtopic.php?t=32486
+
+Copyright (c) 2007 Martin Enge. Based on code from DWORD, released into public domain.
+martin.enge@gmail.com
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "MetaStroke.h"
+#include "DataGrid.h"
+#include "MetaWorldFragment.h"
+
+namespace Ogre
+{
+const size_t MetaStroke::MAX_POINTS;
+
+MetaStroke::MetaStroke(MetaWorldFragment *wf, const std::vector<Vector3>& points, Real radius, bool excavating)
+  : MetaObject(wf, points.front()), mRadius(radius), mExcavating(excavating)
+{
+	assert(points.size() <= MAX_POINTS);
+	mOffsets.reserve(points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+		mOffsets.push_back(points[i] - mPosition);
+}
+
+MetaStroke::MetaStroke(MetaWorldFragment *wf, const Vector3& position, Real radius, bool excavating)
+  : MetaObject(wf, position), mRadius(radius), mExcavating(excavating)
+{
+}
+
+void MetaStroke::updateDataGrid(DataGrid* dataGrid)
+{
+	size_t x0, y0, z0, x1, y1, z1;
+
+	// Find the grid points the stroke can possibly affect
+	if (!dataGrid->mapAABB(getAABB(), x0, y0, z0, x1, y1, z1))
+		return;
+
+	// Nearest squared distance to the polyline of every grid point in the box, and the 
+	// vector from the nearest point. Points further than the radius are left alone.
+	size_t nx = x1 - x0 + 1, ny = y1 - y0 + 1, nz = z1 - z0 + 1;
+	Real radius2 = mRadius*mRadius;
+	std::vector<Real> distances(nx*ny*nz, radius2);
+	std::vector<Vector3> deltas(nx*ny*nz);
+
+	const Vector3* vertices = dataGrid->getVertices();
+	Vector3 offset = mPosition - dataGrid->getPosition();
+	Vector3 extent = mRadius*Vector3::UNIT_SCALE;
+	size_t numSegments = mOffsets.size() > 1 ? mOffsets.size() - 1 : 1;
+	for (size_t s = 0; s < numSegments; ++s)
+	{
+		// Segment in grid space
+		Vector3 a = offset + mOffsets[s];
+		Vector3 ab = offset + mOffsets[s + 1 < mOffsets.size() ? s + 1 : s] - a;
+		Real invLength2 = ab.squaredLength() > 0 ? 1.0 / ab.squaredLength() : 0;
+
+		Vector3 start = mPosition + mOffsets[s];
+		AxisAlignedBox aabb(start, start);
+		aabb.merge(start + ab);
+		aabb.setExtents(aabb.getMinimum() - extent, aabb.getMaximum() + extent);
+		size_t sx0, sy0, sz0, sx1, sy1, sz1;
+		if (!dataGrid->mapAABB(aabb, sx0, sy0, sz0, sx1, sy1, sz1))
+			continue;
+
+		for (size_t z = sz0; z <= sz1; ++z)
+		{
+			for (size_t y = sy0; y <= sy1; ++y)
+			{
+				size_t index = dataGrid->getGridIndex(sx0, y, z);
+				size_t local = ((z - z0)*ny + (y - y0))*nx + (sx0 - x0);
+				for (size_t x = sx0; x <= sx1; ++x, ++index, ++local)
+				{
+					Vector3 ap = vertices[index] - a;
+					Real t = ap.dotProduct(ab) * invLength2;
+					t = t < 0 ? 0 : (t > 1 ? 1 : t);
+					Vector3 v = ap - t*ab;
+					Real d2 = v.squaredLength();
+					if (d2 < distances[local])
+					{
+						distances[local] = d2;
+						deltas[local] = v;
+					}
+				}
+			}
+		}
+	}
+
+	Real* values = dataGrid->getValues();
+	Vector3* gradient = dataGrid->getGradient();
+	std::pair<Real, MetaWorldFragment*>* worldFragments = dataGrid->getMetaWorldFragments();
+	Real invDiameter2 = 1.0 / (2.0*radius2);
+	size_t local = 0;
+	for (size_t z = z0; z <= z1; ++z)
+	{
+		for (size_t y = y0; y <= y1; ++y)
+		{
+			size_t index = dataGrid->getGridIndex(x0, y, z);
+			for (size_t x = x0; x <= x1; ++x, ++index, ++local)
+			{
+				if (distances[local] >= radius2)
+					continue;
+
+				// Same falloff as MetaBall
+				Real r2 = distances[local] * invDiameter2;
+				Real currentFieldStrength = r2*r2 - r2 + 0.25;
+
+				if (mExcavating)
+					values[index] -= currentFieldStrength;
+				else
+					values[index] += currentFieldStrength;
+
+				if (gradient)
+					gradient[index] += deltas[local] / radius2;
+
+				if (worldFragments)
+				{
+					if (currentFieldStrength > worldFragments[index].first)
+					{
+						worldFragments[index].first = currentFieldStrength;
+						worldFragments[index].second = mMetaWorldFragment;
+					}
+				}
+			}
+		}
+	}
+}
+
+AxisAlignedBox MetaStroke::getAABB() const
+{
+	// Tight box of the swept spheres: the points' box grown by the radius
+	AxisAlignedBox aabb(mPosition, mPosition);
+	for (size_t i = 1; i < mOffsets.size(); ++i)
+		aabb.merge(mPosition + mOffsets[i]);
+	aabb.setExtents(aabb.getMinimum() - mRadius*Vector3::UNIT_SCALE, 
+		aabb.getMaximum() + mRadius*Vector3::UNIT_SCALE);
+	return aabb;
+}
+
+MetaCapsule::MetaCapsule(MetaWorldFragment *wf, const Vector3& start, const Vector3& end, Real radius, bool excavating)
+  : MetaStroke(wf, start, radius, excavating)
+{
+	mOffsets.push_back(Vector3::ZERO);
+	mOffsets.push_back(end - start);
+}
+}
@@ -29,6 +29,7 @@ http://www.gnu.org/copyleft/lesser.txt.
 #include "MetaObject.h"
 #include "IsoSurfaceBuilder.h"
 #include "IsoSurfaceRenderable.h"
+#include "FragmentMeshCache.h"
 
 //#define NUM_CELLS 30
 //#define WIDTH 4.0
@@ -39,19 +40,33 @@ namespace Ogre
 Real MetaWorldFragment::mGridScale = 0;
 Real MetaWorldFragment::mSize = 0;
 std::string MetaWorldFragment::mMaterialName = "";
+size_t MetaWorldFragment::mBakeThreshold = 0;
+const FragmentMeshCache *MetaWorldFragment::mMeshCache = 0;
 
 
 MetaWorldFragment::MetaWorldFragment(IsoSurfaceRenderable *is, const Vector3 &position, int ylevel)
-: 	mSurf(is), mPosition(position), mYLevel(ylevel)
+: 	mSurf(is), mPosition(position), mYLevel(ylevel), mBakedValues(0), mNumBakedValues(0),
+	mDensityHash(0), mDensityHashValid(false), mClassification(FC_SURFACE), mColumnMask(0),
+	mVertexSnap(0)
 {
 }
 
+MetaWorldFragment::~MetaWorldFragment()
+{
+	for(std::vector<MetaObject*>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+		(*it)->_release();
+	mObjs.clear();
+	delete[] mBakedValues;
+}
+
 ///Adds MetaObject to mObjs, and to mMoDataGrid
 void MetaWorldFragment::addMetaObject(MetaObject *mo)
 {
 	if(mo->getMetaWorldFragment() != this && mo->getMetaWorldFragment() != 0)
 		addToWfList(mo->getMetaWorldFragment());
+	mo->_addRef();
 	mObjs.push_back(mo);
+	mDensityHashValid = false;
 }
 
 ///Updates IsoSurface
@@ -65,15 +80,255 @@ void MetaWorldFragment::update(IsoSurfaceBuilder *builder)
 		if(!mMaterialName.empty())
 			mSurf->setMaterial(mMaterialName); //hm... should this be done here?
 	}
-	/// Zero data grid, then add the fields of objects to it.
 	DataGrid * dg = builder->getDataGrid();
+	if(isTriviallyEmpty())
+	{
+		/// Nothing but digging in the air, there is no field to evaluate.
+		dg->setPosition(mPosition);
+		mSurf->fillHardwareBuffers(0, 0, 0, 0, dg->getBoxSize());
+		mSurf->setBoundingBox(dg->getBoundingBox());
+		mDensityHashValid = false;
+		return;
+	}
+	fillDataGrid(dg);
+
+	/// No corner values on both sides of the iso value means no triangles; skip meshing.
+	const Real *values = dg->getValues();
+	size_t numGridPoints = dg->getNumGridPoints();
+	Real iso = builder->getIsoValue();
+	bool below = values[0] < iso, crossed = false;
+	for(size_t i = 1; i < numGridPoints && !crossed; ++i)
+		crossed = (values[i] < iso) != below;
+	if(!crossed)
+	{
+		mSurf->fillHardwareBuffers(0, 0, 0, 0, dg->getBoxSize());
+		mSurf->setBoundingBox(dg->getBoundingBox());
+		mDensityHashValid = false;
+		if(mBakeThreshold && mObjs.size() > mBakeThreshold)
+			bakeDataGrid(dg);
+		return;
+	}
+
+	/// Take the mesh from the cache if it was built from the very same densities.
+	const FragmentMeshCache::IndexEntry *cached = 0;
+	mDensityHashValid = false;
+	if(mMeshCache)
+	{
+		mDensityHash = hashDataGrid(dg);
+		mDensityHashValid = true;
+		cached = mMeshCache->find(mDensityHash);
+		if(cached && mMeshCache->getVertexSize() != mSurf->getVertexSize())
+			cached = 0;
+		mMeshCache->_notifyLookup(cached != 0);
+	}
+	if(cached)
+		mSurf->fillHardwareBuffers(mMeshCache->getVertices(*cached), cached->vertexCount,
+			mMeshCache->getIndices(*cached), cached->indexCount, dg->getBoxSize());
+	else
+	{
+		builder->setColumnMask(mColumnMask ? &(*mColumnMask)[0] : 0);
+		builder->setVertexSnap(mVertexSnap);
+		builder->update(mSurf);
+		builder->setColumnMask(0);
+		builder->setVertexSnap(0);
+	}
+	mSurf->setBoundingBox(dg->getBoundingBox());
+
+	/// The grid already holds the complete field, so baking now is only a copy.
+	if(mBakeThreshold && mObjs.size() > mBakeThreshold)
+		bakeDataGrid(dg);
+}
+
+void MetaWorldFragment::bake(IsoSurfaceBuilder *builder)
+{
+	if(mObjs.empty())
+		return;
+	DataGrid * dg = builder->getDataGrid();
+	fillDataGrid(dg);
+	bakeDataGrid(dg);
+}
+
+uint64 MetaWorldFragment::getDensityHash(IsoSurfaceBuilder *builder)
+{
+	if(!mDensityHashValid)
+	{
+		DataGrid * dg = builder->getDataGrid();
+		fillDataGrid(dg);
+		mDensityHash = hashDataGrid(dg);
+		mDensityHashValid = true;
+	}
+	return mDensityHash;
+}
+
+void MetaWorldFragment::setBakedValues(const Real *values, size_t numGridPoints)
+{
+	mDensityHashValid = false;
+	delete[] mBakedValues;
+	mBakedValues = new Real[numGridPoints];
+	mNumBakedValues = numGridPoints;
+	memcpy(mBakedValues, values, numGridPoints*sizeof(Real));
+
+	for(std::vector<MetaObject*>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+		(*it)->_release();
+	mObjs.clear();
+}
+
+void MetaWorldFragment::addBakedValues(const Real *values, size_t numGridPoints)
+{
+	assert(mBakedValues && numGridPoints == mNumBakedValues);
+	mDensityHashValid = false;
+	for(size_t i = 0; i < numGridPoints; ++i)
+		mBakedValues[i] += values[i];
+}
+
+bool MetaWorldFragment::hasHeightmap() const
+{
+	for(std::vector<MetaObject*>::const_iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+	{
+		if((*it)->getType() == MetaObject::MOT_HEIGHTMAP)
+			return true;
+	}
+	return false;
+}
+
+size_t MetaWorldFragment::getMemoryUsage() const
+{
+	size_t bytes = sizeof(MetaWorldFragment) + mNumBakedValues*sizeof(Real) + mObjs.capacity()*sizeof(MetaObject*) +
+		mCarvedColumns.capacity();
+	if(mSurf)
+		bytes += sizeof(IsoSurfaceRenderable) + mSurf->getMemoryUsage();
+	return bytes;
+}
+
+bool MetaWorldFragment::intersectRay(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t) const
+{
+	if(!mSurf)
+		return false;
+	/** Rays missing the column of the data grid can skip the mesh. Vertices snapped onto
+		the heightfield only move in y, so the column is unbounded in y. */
+	Real half = mSize/2;
+	Real ta = 0, tb = maxT;
+	if(!IntersectionTests::clipSlab(origin.x, dir.x, mPosition.x - half, mPosition.x + half, ta, tb) ||
+		!IntersectionTests::clipSlab(origin.z, dir.z, mPosition.z - half, mPosition.z + half, ta, tb))
+		return false;
+	return mSurf->intersectRay(origin - mPosition, dir, maxT, t);
+}
+
+bool MetaWorldFragment::sweep(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal) const
+{
+	if(!mSurf)
+		return false;
+	/// The column of the data grid, grown by the shape.
+	Real half = mSize/2;
+	Real ta = 0, tb = maxT;
+	if(!IntersectionTests::clipSlab(sweep.origin.x, sweep.dir.x, mPosition.x - half + sweep.growLo.x, 
+			mPosition.x + half + sweep.growHi.x, ta, tb) ||
+		!IntersectionTests::clipSlab(sweep.origin.z, sweep.dir.z, mPosition.z - half + sweep.growLo.z, 
+			mPosition.z + half + sweep.growHi.z, ta, tb))
+		return false;
+	IntersectionTests::Sweep local = sweep;
+	local.origin -= mPosition;
+	return mSurf->sweep(local, maxT, t, normal);
+}
+
+bool MetaWorldFragment::isTriviallyEmpty() const
+{
+	/// Nothing to build if the heightfield below has no holes.
+	if(mColumnMask && mColumnMask->empty())
+		return true;
+	/// Baked layers may hold material placed earlier.
+	if(mClassification != FC_AIR || mBakedValues)
+		return false;
+	for(std::vector<MetaObject*>::const_iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+	{
+		if(!(*it)->isExcavating())
+			return false;
+	}
+	return true;
+}
+
+unsigned long MetaWorldFragment::getLastVisibleFrame() const
+{
+	return mSurf ? mSurf->getLastVisibleFrame() : 0;
+}
+
+void MetaWorldFragment::fillDataGrid(DataGrid *dg)
+{
+	/// Zero data grid (or restore the baked layer), then add the fields of objects to it.
+	dg->setPosition(mPosition);
 	dg->clear();
+	if(mBakedValues)
+		memcpy(dg->getValues(), mBakedValues, dg->getNumGridPoints()*sizeof(Real));
 	for(std::vector<MetaObject*>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
 	{
 		(*it)->updateDataGrid(dg);
 	}
-	builder->update(mSurf);
-	mSurf->setBoundingBox(dg->getBoundingBox());
+}
+
+void MetaWorldFragment::bakeDataGrid(DataGrid *dg)
+{
+	if(!mBakedValues)
+	{
+		mBakedValues = new Real[dg->getNumGridPoints()];
+		mNumBakedValues = dg->getNumGridPoints();
+	}
+	memcpy(mBakedValues, dg->getValues(), dg->getNumGridPoints()*sizeof(Real));
+
+	for(std::vector<MetaObject*>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+		(*it)->_release();
+	mObjs.clear();
+}
+
+bool MetaWorldFragment::carveColumns(const AxisAlignedBox &box)
+{
+	int n = int(getNumCells());
+	if(mCarvedColumns.empty())
+		mCarvedColumns.assign(n*n, 0);
+
+	Real x0 = mPosition.x - 0.5*mSize, z0 = mPosition.z - 0.5*mSize;
+	int i0 = std::max(0, int(Math::Floor((box.getMinimum().x - x0)/mGridScale)) - 1);
+	int k0 = std::max(0, int(Math::Floor((box.getMinimum().z - z0)/mGridScale)) - 1);
+	int i1 = std::min(n - 1, int(Math::Floor((box.getMaximum().x - x0)/mGridScale)) + 1);
+	int k1 = std::min(n - 1, int(Math::Floor((box.getMaximum().z - z0)/mGridScale)) + 1);
+
+	bool changed = false;
+	for(int k = k0; k <= k1; ++k)
+	{
+		for(int i = i0; i <= i1; ++i)
+		{
+			changed |= !mCarvedColumns[i + k*n];
+			mCarvedColumns[i + k*n] = 1;
+		}
+	}
+	return changed;
+}
+
+void MetaWorldFragment::setCarvedColumns(const uchar *columns)
+{
+	if(columns)
+		mCarvedColumns.assign(columns, columns + getNumColumns());
+	else
+		mCarvedColumns.assign(getNumColumns(), 0);
+}
+
+uint64 MetaWorldFragment::hashDataGrid(DataGrid *dg) const
+{
+	uint64 hash = FragmentMeshCache::hashDensities(dg->getValues(), dg->getNumGridPoints());
+	/// The mesh depends on the columns it was built for, and on whether its border was snapped.
+	if(mColumnMask)
+	{
+		for(std::vector<uchar>::const_iterator it = mColumnMask->begin(); it != mColumnMask->end(); ++it)
+		{
+			hash ^= *it;
+			hash *= 1099511628211ULL;
+		}
+	}
+	if(mVertexSnap)
+	{
+		hash ^= 1;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
 }
 
 void MetaWorldFragment::addToWfList(MetaWorldFragment *wf)
@@ -281,9 +281,331 @@ namespace Ogre {
         "	lit r0.z, r0\n"
         "	rcp oFog, r0.z\n";
 
+    String TerrainVertexProgram::mCompactNoFogArbvp1 = 
+        "!!ARBvp1.0\n"
+        "PARAM c5 = { 1, 1, 1, 1 };\n"
+        "PARAM c10 = { 0, 0, 0, 1 };\n"
+        "#var float4x4 worldViewProj :  : c[0], 4 : 8 : 1\n"
+        "#var float morphFactor :  : c[4] : 9 : 1\n"
+        "#var float4 tileOrigin :  : c[8] : 10 : 1\n"
+        "#var float4 gridScale :  : c[9] : 11 : 1\n"
+        "TEMP R0, R1, R2;\n"
+        "ATTRIB v17 = vertex.weight;\n"
+        "ATTRIB v26 = vertex.texcoord[2];\n"
+        "ATTRIB v25 = vertex.texcoord[1];\n"
+        "ATTRIB v16 = vertex.position;\n"
+        "PARAM c0[4] = { program.local[0..3] };\n"
+        "PARAM c4 = program.local[4];\n"
+        "PARAM c8 = program.local[8];\n"
+        "PARAM c9 = program.local[9];\n"
+        "	ADD R1.xy, v16, c8;\n"
+        "	MUL result.texcoord[0].xy, R1, c9.zwzw;\n"
+        "	MOV result.texcoord[0].zw, c10;\n"
+        "	MOV result.texcoord[1], v25;\n"
+        "	MOV R0, c10;\n"
+        "	MUL R0.xz, R1.xxyy, c9.xxyy;\n"
+        "	ADD R0.xz, R0, c8.zzww;\n"
+        "	MUL R2.x, v17.x, c4.x;\n"
+        "	ADD R0.y, R2.x, v26.x;\n"
+        "	DP4 result.position.x, c0[0], R0;\n"
+        "	DP4 result.position.y, c0[1], R0;\n"
+        "	DP4 result.position.z, c0[2], R0;\n"
+        "	DP4 result.position.w, c0[3], R0;\n"
+        "	MOV result.color.front.primary, c5.x;\n"
+        "END\n";
+    String TerrainVertexProgram::mCompactLinearFogArbvp1 = 
+        "!!ARBvp1.0\n"
+        "PARAM c5 = { 1, 1, 1, 1 };\n"
+        "PARAM c10 = { 0, 0, 0, 1 };\n"
+        "#var float4x4 worldViewProj :  : c[0], 4 : 9 : 1\n"
+        "#var float morphFactor :  : c[4] : 10 : 1\n"
+        "#var float4 tileOrigin :  : c[8] : 11 : 1\n"
+        "#var float4 gridScale :  : c[9] : 12 : 1\n"
+        "TEMP R0, R1, R2;\n"
+        "ATTRIB v17 = vertex.weight;\n"
+        "ATTRIB v26 = vertex.texcoord[2];\n"
+        "ATTRIB v25 = vertex.texcoord[1];\n"
+        "ATTRIB v16 = vertex.position;\n"
+        "PARAM c0[4] = { program.local[0..3] };\n"
+        "PARAM c4 = program.local[4];\n"
+        "PARAM c8 = program.local[8];\n"
+        "PARAM c9 = program.local[9];\n"
+        "	ADD R0.xy, v16, c8;\n"
+        "	MUL result.texcoord[0].xy, R0, c9.zwzw;\n"
+        "	MOV result.texcoord[0].zw, c10;\n"
+        "	MOV result.texcoord[1], v25;\n"
+        "	MOV R1, c10;\n"
+        "	MUL R1.xz, R0.xxyy, c9.xxyy;\n"
+        "	ADD R1.xz, R1, c8.zzww;\n"
+        "	MUL R2.x, v17.x, c4.x;\n"
+        "	ADD R1.y, R2.x, v26.x;\n"
+        "	DP4 R0.x, c0[0], R1;\n"
+        "	DP4 R0.y, c0[1], R1;\n"
+        "	DP4 R0.z, c0[2], R1;\n"
+        "	DP4 R0.w, c0[3], R1;\n"
+        "	MOV result.fogcoord.x, R0.z;\n"
+        "	MOV result.position, R0;\n"
+        "	MOV result.color.front.primary, c5.x;\n"
+        "END\n";
+    String TerrainVertexProgram::mCompactExpFogArbvp1 = 
+        "!!ARBvp1.0\n"
+        "PARAM c6 = { 1, 1, 1, 1 };\n"
+        "PARAM c7 = { 2.71828, 0, 0, 0 };\n"
+        "PARAM c10 = { 0, 0, 0, 1 };\n"
+        "#var float4x4 worldViewProj :  : c[0], 4 : 9 : 1\n"
+        "#var float morphFactor :  : c[4] : 10 : 1\n"
+        "#var float fogDensity :  : c[5] : 11 : 1\n"
+        "#var float4 tileOrigin :  : c[8] : 12 : 1\n"
+        "#var float4 gridScale :  : c[9] : 13 : 1\n"
+        "TEMP R0, R1, R2;\n"
+        "ATTRIB v17 = vertex.weight;\n"
+        "ATTRIB v26 = vertex.texcoord[2];\n"
+        "ATTRIB v25 = vertex.texcoord[1];\n"
+        "ATTRIB v16 = vertex.position;\n"
+        "PARAM c5 = program.local[5];\n"
+        "PARAM c0[4] = { program.local[0..3] };\n"
+        "PARAM c4 = program.local[4];\n"
+        "PARAM c8 = program.local[8];\n"
+        "PARAM c9 = program.local[9];\n"
+        "	ADD R0.xy, v16, c8;\n"
+        "	MUL result.texcoord[0].xy, R0, c9.zwzw;\n"
+        "	MOV result.texcoord[0].zw, c10;\n"
+        "	MOV result.texcoord[1], v25;\n"
+        "	MOV R1, c10;\n"
+        "	MUL R1.xz, R0.xxyy, c9.xxyy;\n"
+        "	ADD R1.xz, R1, c8.zzww;\n"
+        "	MUL R2.x, v17.x, c4.x;\n"
+        "	ADD R1.y, R2.x, v26.x;\n"
+        "	DP4 R0.x, c0[0], R1;\n"
+        "	DP4 R0.y, c0[1], R1;\n"
+        "	DP4 R0.z, c0[2], R1;\n"
+        "	DP4 R0.w, c0[3], R1;\n"
+        "	MOV result.position, R0;\n"
+        "	MOV result.color.front.primary, c6.x;\n"
+        "	MUL R0.zw, R0.z, c5.x;\n"
+        "	MOV R0.xy, c7.x;\n"
+        "	LIT R0.z, R0;\n"
+        "	RCP result.fogcoord.x, R0.z;\n"
+        "END\n";
+    String TerrainVertexProgram::mCompactExp2FogArbvp1 = 
+        "!!ARBvp1.0\n"
+        "PARAM c6 = { 1, 1, 1, 1 };\n"
+        "PARAM c7 = { 0.002, 2.71828, 0, 0 };\n"
+        "PARAM c10 = { 0, 0, 0, 1 };\n"
+        "#var float4x4 worldViewProj :  : c[0], 4 : 9 : 1\n"
+        "#var float morphFactor :  : c[4] : 10 : 1\n"
+        "#var float fogDensity :  : c[5] : 11 : 1\n"
+        "#var float4 tileOrigin :  : c[8] : 12 : 1\n"
+        "#var float4 gridScale :  : c[9] : 13 : 1\n"
+        "TEMP R0, R1, R2;\n"
+        "ATTRIB v17 = vertex.weight;\n"
+        "ATTRIB v26 = vertex.texcoord[2];\n"
+        "ATTRIB v25 = vertex.texcoord[1];\n"
+        "ATTRIB v16 = vertex.position;\n"
+        "PARAM c0[4] = { program.local[0..3] };\n"
+        "PARAM c4 = program.local[4];\n"
+        "PARAM c8 = program.local[8];\n"
+        "PARAM c9 = program.local[9];\n"
+        "	ADD R0.xy, v16, c8;\n"
+        "	MUL result.texcoord[0].xy, R0, c9.zwzw;\n"
+        "	MOV result.texcoord[0].zw, c10;\n"
+        "	MOV result.texcoord[1], v25;\n"
+        "	MOV R1, c10;\n"
+        "	MUL R1.xz, R0.xxyy, c9.xxyy;\n"
+        "	ADD R1.xz, R1, c8.zzww;\n"
+        "	MUL R2.x, v17.x, c4.x;\n"
+        "	ADD R1.y, R2.x, v26.x;\n"
+        "	DP4 R0.x, c0[0], R1;\n"
+        "	DP4 R0.y, c0[1], R1;\n"
+        "	DP4 R0.z, c0[2], R1;\n"
+        "	DP4 R0.w, c0[3], R1;\n"
+        "	MOV result.position, R0;\n"
+        "	MOV result.color.front.primary, c6.x;\n"
+        "	MUL R0.x, R0.z, c7.x;\n"
+        "	MUL R0.zw, R0.x, R0.x;\n"
+        "	MOV R0.xy, c7.y;\n"
+        "	LIT R0.z, R0;\n"
+        "	RCP result.fogcoord.x, R0.z;\n"
+        "END\n";
+	String TerrainVertexProgram::mCompactShadowReceiverArbvp1 = 
+		"!!ARBvp1.0\n"
+		"PARAM c[17] = { program.local[0..15], { 1 } };\n"
+		"TEMP R0;\n"
+		"TEMP R1;\n"
+		"TEMP R2;\n"
+		"MOV result.color, c[16].x;\n"
+		"ADD R0.xy, vertex.position, c[14];\n"
+		"MOV R1.w, c[16].x;\n"
+		"MUL R1.xz, R0.xxyy, c[15].xxyy;\n"
+		"ADD R1.xz, R1, c[14].zzww;\n"
+		"MUL R0.x, vertex.weight, c[12];\n"
+		"ADD R1.y, R0.x, vertex.texcoord[2].x;\n"
+		"DP4 result.position.w, R1, c[3];\n"
+		"DP4 result.position.z, R1, c[2];\n"
+		"DP4 R0.w, R1, c[7];\n"
+		"DP4 R0.z, R1, c[6];\n"
+		"DP4 R0.y, R1, c[5];\n"
+		"DP4 R0.x, R1, c[4];\n"
+		"DP4 result.position.y, R1, c[1];\n"
+		"DP4 R2.y, R0, c[9];\n"
+		"DP4 R2.z, R0, c[11];\n"
+		"DP4 R2.x, R0, c[8];\n"
+		"RCP R0.x, R2.z;\n"
+		"DP4 result.position.x, R1, c[0];\n"
+		"MUL result.texcoord[0].xy, R2, R0.x;\n"
+		"END\n";
+
+    String TerrainVertexProgram::mCompactNoFogVs_1_1 = 
+        "vs_1_1\n"
+        "def c5, 1, 1, 1, 1\n"
+        "def c10, 0, 0, 0, 1\n"
+        "//var float4x4 worldViewProj :  : c[0], 4 : 8 : 1\n"
+        "//var float morphFactor :  : c[4] : 9 : 1\n"
+        "//var float4 tileOrigin :  : c[8] : 10 : 1\n"
+        "//var float4 gridScale :  : c[9] : 11 : 1\n"
+        "dcl_blendweight v1\n"
+        "dcl_texcoord2 v9\n"
+        "dcl_texcoord1 v8\n"
+        "dcl_position v0\n"
+        "	add r1.xy, v0, c8\n"
+        "	mul oT0.xy, r1, c9.zwzw\n"
+        "	mov oT1.xy, v8\n"
+        "	mov r0, c10\n"
+        "	mul r0.xz, r1.xxyy, c9.xxyy\n"
+        "	add r0.xz, r0, c8.zzww\n"
+        "	mul r2.x, v1.x, c4.x\n"
+        "	add r0.y, r2.x, v9.x\n"
+        "	dp4 oPos.x, c0, r0\n"
+        "	dp4 oPos.y, c1, r0\n"
+        "	dp4 oPos.z, c2, r0\n"
+        "	dp4 oPos.w, c3, r0\n"
+        "	mov oD0, c5.x\n";
+    String TerrainVertexProgram::mCompactLinearFogVs_1_1 = 
+        "vs_1_1\n"
+        "def c5, 1, 1, 1, 1\n"
+        "def c10, 0, 0, 0, 1\n"
+        "//var float4x4 worldViewProj :  : c[0], 4 : 9 : 1\n"
+        "//var float morphFactor :  : c[4] : 10 : 1\n"
+        "//var float4 tileOrigin :  : c[8] : 11 : 1\n"
+        "//var float4 gridScale :  : c[9] : 12 : 1\n"
+        "dcl_blendweight v1\n"
+        "dcl_texcoord2 v9\n"
+        "dcl_texcoord1 v8\n"
+        "dcl_position v0\n"
+        "	add r0.xy, v0, c8\n"
+        "	mul oT0.xy, r0, c9.zwzw\n"
+        "	mov oT1.xy, v8\n"
+        "	mov r1, c10\n"
+        "	mul r1.xz, r0.xxyy, c9.xxyy\n"
+        "	add r1.xz, r1, c8.zzww\n"
+        "	mul r2.x, v1.x, c4.x\n"
+        "	add r1.y, r2.x, v9.x\n"
+        "	dp4 r0.x, c0, r1\n"
+        "	dp4 r0.y, c1, r1\n"
+        "	dp4 r0.z, c2, r1\n"
+        "	dp4 r0.w, c3, r1\n"
+        "	mov oFog, r0.z\n"
+        "	mov oPos, r0\n"
+        "	mov oD0, c5.x\n";
+    String TerrainVertexProgram::mCompactExpFogVs_1_1 = 
+        "vs_1_1\n"
+        "def c6, 1, 1, 1, 1\n"
+        "def c7, 2.71828, 0, 0, 0\n"
+        "def c10, 0, 0, 0, 1\n"
+        "//var float4x4 worldViewProj :  : c[0], 4 : 9 : 1\n"
+        "//var float morphFactor :  : c[4] : 10 : 1\n"
+        "//var float fogDensity :  : c[5] : 11 : 1\n"
+        "//var float4 tileOrigin :  : c[8] : 12 : 1\n"
+        "//var float4 gridScale :  : c[9] : 13 : 1\n"
+        "dcl_blendweight v1\n"
+        "dcl_texcoord2 v9\n"
+        "dcl_texcoord1 v8\n"
+        "dcl_position v0\n"
+        "	add r0.xy, v0, c8\n"
+        "	mul oT0.xy, r0, c9.zwzw\n"
+        "	mov oT1.xy, v8\n"
+        "	mov r1, c10\n"
+        "	mul r1.xz, r0.xxyy, c9.xxyy\n"
+        "	add r1.xz, r1, c8.zzww\n"
+        "	mul r2.x, v1.x, c4.x\n"
+        "	add r1.y, r2.x, v9.x\n"
+        "	dp4 r0.x, c0, r1\n"
+        "	dp4 r0.y, c1, r1\n"
+        "	dp4 r0.z, c2, r1\n"
+        "	dp4 r0.w, c3, r1\n"
+        "	mov oPos, r0\n"
+        "	mov oD0, c6.x\n"
+        "	mul r0.zw, r0.z, c5.x\n"
+        "	mov r0.xy, c7.x\n"
+        "	lit r0.z, r0\n"
+        "	rcp oFog, r0.z\n";
+    String TerrainVertexProgram::mCompactExp2FogVs_1_1 = 
+        "vs_1_1\n"
+        "def c6, 1, 1, 1, 1\n"
+        "def c7, 0.002, 2.71828, 0, 0\n"
+        "def c10, 0, 0, 0, 1\n"
+        "//var float4x4 worldViewProj :  : c[0], 4 : 9 : 1\n"
+        "//var float morphFactor :  : c[4] : 10 : 1\n"
+        "//var float fogDensity :  : c[5] : 11 : 1\n"
+        "//var float4 tileOrigin :  : c[8] : 12 : 1\n"
+        "//var float4 gridScale :  : c[9] : 13 : 1\n"
+        "dcl_blendweight v1\n"
+        "dcl_texcoord2 v9\n"
+        "dcl_texcoord1 v8\n"
+        "dcl_position v0\n"
+        "	add r0.xy, v0, c8\n"
+        "	mul oT0.xy, r0, c9.zwzw\n"
+        "	mov oT1.xy, v8\n"
+        "	mov r1, c10\n"
+        "	mul r1.xz, r0.xxyy, c9.xxyy\n"
+        "	add r1.xz, r1, c8.zzww\n"
+        "	mul r2.x, v1.x, c4.x\n"
+        "	add r1.y, r2.x, v9.x\n"
+        "	dp4 r0.x, c0, r1\n"
+        "	dp4 r0.y, c1, r1\n"
+        "	dp4 r0.z, c2, r1\n"
+        "	dp4 r0.w, c3, r1\n"
+        "	mov oPos, r0\n"
+        "	mov oD0, c6.x\n"
+        "	mul r0.x, r0.z, c7.x\n"
+        "	mul r0.zw, r0.x, r0.x\n"
+        "	mov r0.xy, c7.y\n"
+        "	lit r0.z, r0\n"
+        "	rcp oFog, r0.z\n";
+	String TerrainVertexProgram::mCompactShadowReceiverVs_1_1 = 
+		"vs_1_1\n"
+		"def c13, 1, 1, 1, 1\n"
+		"dcl_blendweight v1\n"
+		"dcl_texcoord2 v9\n"
+		"dcl_position v0\n"
+		"add r0.xy, v0, c14\n"
+		"mov r1, c13\n"
+		"mul r1.xz, r0.xxyy, c15.xxyy\n"
+		"add r1.xz, r1, c14.zzww\n"
+		"mul r0.x, v1.x, c12.x\n"
+		"add r1.y, r0.x, v9.x\n"
+		"dp4 oPos.x, c0, r1\n"
+		"dp4 oPos.y, c1, r1\n"
+		"dp4 oPos.z, c2, r1\n"
+		"dp4 oPos.w, c3, r1\n"
+		"dp4 r0.x, c4, r1\n"
+		"dp4 r0.y, c5, r1\n"
+		"dp4 r0.z, c6, r1\n"
+		"dp4 r0.w, c7, r1\n"
+		"dp4 r1.x, c8, r0\n"
+		"dp4 r1.y, c9, r0\n"
+		"dp4 r1.w, c11, r0\n"
+		"rcp r0.x, r1.w\n"
+		"mul oT0.xy, r1.xy, r0.x\n"
+		"mov oD0, c13\n";
+
     const String& TerrainVertexProgram::getProgramSource(
-        FogMode fogMode, const String syntax, bool shadowReceiver)
+        FogMode fogMode, const String syntax, bool shadowReceiver, bool compact)
     {
+		if (compact)
+		{
+			return getCompactProgramSource(fogMode, syntax, shadowReceiver);
+		}
 		if (shadowReceiver)
 		{
 			if (syntax == "arbvp1")
@@ -346,4 +668,25 @@ namespace Ogre {
         return StringUtil::BLANK;
 
     }
+    const String& TerrainVertexProgram::getCompactProgramSource(
+        FogMode fogMode, const String syntax, bool shadowReceiver)
+    {
+        bool arb = syntax == "arbvp1";
+        if (shadowReceiver)
+            return arb ? mCompactShadowReceiverArbvp1 : mCompactShadowReceiverVs_1_1;
+
+        switch(fogMode)
+        {
+        case FOG_NONE:
+            return arb ? mCompactNoFogArbvp1 : mCompactNoFogVs_1_1;
+        case FOG_LINEAR:
+            return arb ? mCompactLinearFogArbvp1 : mCompactLinearFogVs_1_1;
+        case FOG_EXP:
+            return arb ? mCompactExpFogArbvp1 : mCompactExpFogVs_1_1;
+        case FOG_EXP2:
+            return arb ? mCompactExp2FogArbvp1 : mCompactExp2FogVs_1_1;
+        };
+        // default
+        return StringUtil::BLANK;
+    }
 }
@@ -32,6 +32,7 @@ Hacked by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTerra
 
 #include "OverhangHeightmapTerrainPageSource.h"
 #include "OverhangTerrainPage.h"
+#include "OverhangTerrainHeightData.h"
 #include "OgreException.h"
 #include "OgreStringConverter.h"
 #include "OverhangTerrainSceneManager.h"
@@ -42,7 +43,7 @@ namespace Ogre {
 
     //-------------------------------------------------------------------------
     OverhangHeightmapTerrainPageSource::OverhangHeightmapTerrainPageSource()
-        : mIsRaw(false), mFlipTerrain(false), mPage(0)
+        : mIsRaw(false), mFlipTerrain(false), mPagesPerSide(0), mImageSize(0)
     {
     }
     //-------------------------------------------------------------------------
@@ -53,9 +54,11 @@ namespace Ogre {
     //-------------------------------------------------------------------------
     void OverhangHeightmapTerrainPageSource::shutdown(void)
     {
+        // Pages in flight read the heightmap, so they go first
+        _unloadAllPages();
         // Image will destroy itself
-        delete mPage;
-        mPage = 0;
+        mRawFile.close();
+        mRawData.setNull();
     }
     //-------------------------------------------------------------------------
     void OverhangHeightmapTerrainPageSource::loadHeightmap(void)
@@ -67,20 +70,32 @@ namespace Ogre {
             // Image size comes from setting (since RAW is not self-describing)
             imgSize = mRawSize;
             
-            // Load data
+            // Load data; map it if it is a plain file, otherwise read it in
             mRawData.setNull();
-            DataStreamPtr stream = 
-                ResourceGroupManager::getSingleton().openResource(
-                    mSource, ResourceGroupManager::getSingleton().getWorldResourceGroupName());
-            mRawData = MemoryDataStreamPtr(new MemoryDataStream(mSource, stream));
+            mRawFile.close();
+            size_t rawBytes;
+            String path = findFileSystemPath(mSource);
+            if (!path.empty())
+            {
+                mRawFile.open(path);
+                rawBytes = mRawFile.getSize();
+            }
+            else
+            {
+                DataStreamPtr stream = 
+                    ResourceGroupManager::getSingleton().openResource(
+                        mSource, ResourceGroupManager::getSingleton().getWorldResourceGroupName());
+                mRawData = MemoryDataStreamPtr(new MemoryDataStream(mSource, stream));
+                rawBytes = mRawData->size();
+            }
 
             // Validate size
             size_t numBytes = imgSize * imgSize * mRawBpp;
-            if (mRawData->size() != numBytes)
+            if (rawBytes != numBytes)
             {
                 shutdown();
                 OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, 
-                    "RAW size (" + StringConverter::toString(mRawData->size()) + 
+                    "RAW size (" + StringConverter::toString(rawBytes) + 
                     ") does not agree with configuration settings.", 
                     "OverhangHeightmapTerrainPageSource::loadHeightmap");
             }
@@ -99,18 +114,29 @@ namespace Ogre {
             imgSize = mImage.getWidth();
         }
         //check to make sure it's the expected size
-        if ( imgSize != mPageSize)
+        if ( imgSize < mPageSize || (imgSize - 1) % (mPageSize - 1) != 0)
         {
             shutdown();
             String err = "Error: Invalid heightmap size : " +
                 StringConverter::toString( imgSize ) +
-                ". Should be " + StringConverter::toString(mPageSize);
+                ". Should be a multiple of " + StringConverter::toString(mPageSize - 1) + " plus 1";
             OGRE_EXCEPT( Exception::ERR_INVALIDPARAMS, err, 
                 "OverhangHeightmapTerrainPageSource::loadHeightmap" );
         }
+        mImageSize = imgSize;
+        mPagesPerSide = static_cast<ushort>((imgSize - 1) / (mPageSize - 1));
 
     }
     //-------------------------------------------------------------------------
+    String OverhangHeightmapTerrainPageSource::findFileSystemPath(const String& resource) const
+    {
+        FileInfoListPtr files = ResourceGroupManager::getSingleton().findResourceFileInfo(
+            ResourceGroupManager::getSingleton().getWorldResourceGroupName(), resource);
+        if (files->empty() || files->front().archive->getType() != "FileSystem")
+            return StringUtil::BLANK;
+        return files->front().archive->getName() + "/" + files->front().filename;
+    }
+    //-------------------------------------------------------------------------
     void OverhangHeightmapTerrainPageSource::initialise(OverhangTerrainSceneManager* tsm, 
         ushort tileSize, ushort pageSize, bool asyncLoading, 
         OverhangTerrainPageSourceOptionList& optionList)
@@ -185,103 +211,48 @@ namespace Ogre {
         loadHeightmap();
     }
     //-------------------------------------------------------------------------
-    void OverhangHeightmapTerrainPageSource::requestPage(ushort x, ushort y)
+    OverhangTerrainPage* OverhangHeightmapTerrainPageSource::_preparePage(ushort x, ushort z)
     {
-        // Only 1 page provided
-        if (x == 0 && y == 0 && !mPage)
-        {
-            // Convert the image data to unscaled floats
-            ulong totalPageSize = mPageSize * mPageSize; 
-            Real *heightData = new Real[totalPageSize];
-            const uchar* pOrigSrc, *pSrc;
-            Real* pDest = heightData;
-            Real invScale;
-            bool is16bit = false;
-            
-            if (mIsRaw)
-            {
-                pOrigSrc = mRawData->getPtr();
-                is16bit = (mRawBpp == 2);
-            }
-            else
-            {
-                PixelFormat pf = mImage.getFormat();
-                if (pf != PF_L8 && pf != PF_L16)
-                {
-                    OGRE_EXCEPT( Exception::ERR_INVALIDPARAMS, 
-                        "Error: Image is not a grayscale image.",
-                        "OverhangHeightmapTerrainPageSource::requestPage" );
-                }
+        const uchar* pSrc;
+        uchar bytesPerSample;
 
-                pOrigSrc = mImage.getData();
-                is16bit = (pf == PF_L16);
-            }
-            // Determine mapping from fixed to floating
-            ulong rowSize;
-            if ( is16bit )
-            {
-                invScale = 1.0f / 65535.0f; 
-                rowSize =  mPageSize * 2;
-            }
-            else 
-            {
-                invScale = 1.0f / 255.0f; 
-                rowSize =  mPageSize;
-            }
-            // Read the data
-            pSrc = pOrigSrc;
-            for (ulong j = 0; j < mPageSize; ++j)
-            {
-                if (mFlipTerrain)
-                {
-                    // Work backwards 
-                    pSrc = pOrigSrc + (rowSize * (mPageSize - j - 1));
-                }
-                for (ulong i = 0; i < mPageSize; ++i)
-                {
-                    if (is16bit)
-                    {
-                        #if OGRE_ENDIAN == OGRE_ENDIAN_BIG
-                            ushort val = *pSrc++ << 8;
-                            val += *pSrc++;
-                        #else
-                            ushort val = *pSrc++;
-                            val += *pSrc++ << 8;
-                        #endif
-                        *pDest++ = Real(val) * invScale;
-                    }
-                    else
-                    {
-                        *pDest++ = Real(*pSrc++) * invScale;
-                    }
-                }
-            }
+        if (mIsRaw)
+        {
+            pSrc = mRawFile.isOpen() ? mRawFile.getData() : mRawData->getPtr();
+            bytesPerSample = mRawBpp;
+        }
+        else
+        {
+            pSrc = mImage.getData();
+            bytesPerSample = (mImage.getFormat() == PF_L16) ? 2 : 1;
+        }
+        // Tiles read and scale the samples in place
+        return OverhangTerrainPageSource::_preparePage(OverhangTerrainHeightData(pSrc, mPageSize, 
+            bytesPerSample, mFlipTerrain, mImageSize, x * (mPageSize - 1), z * (mPageSize - 1), mIsRaw), x, z);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangHeightmapTerrainPageSource::requestPage(ushort x, ushort y)
+    {
+        if (!hasPage(x, y))
+            return;
 
-            // Call listeners
-            firePageConstructed(0, 0, heightData);
-            // Now turn into TerrainPage
-            // Note that we're using a single material for now
-            if (mSceneManager)
+        if (!mIsRaw)
+        {
+            PixelFormat pf = mImage.getFormat();
+            if (pf != PF_L8 && pf != PF_L16)
             {
-                mPage = buildPage(heightData, 
-                    mSceneManager->getOptions().terrainMaterial);
-                mSceneManager->attachPage(0, 0, mPage);
+                OGRE_EXCEPT( Exception::ERR_INVALIDPARAMS, 
+                    "Error: Image is not a grayscale image.",
+                    "OverhangHeightmapTerrainPageSource::requestPage" );
             }
-
-            // Free temp store
-            delete [] heightData;
         }
+
+        _loadPage(x, y);
     }
     //-------------------------------------------------------------------------
     void OverhangHeightmapTerrainPageSource::expirePage(ushort x, ushort y)
     {
-        // Single page
-        if (x == 0 && y == 0 && mPage)
-        {
-            delete mPage;
-            mPage = 0;
-        }
-
+        _unloadPage(x, y);
     }
     //-------------------------------------------------------------------------
 
@@ -0,0 +1,172 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "OverhangNoiseTerrainPageSource.h"
+#include "OverhangTerrainHeightData.h"
+#include "OverhangTerrainSceneManager.h"
+#include "OgreLogManager.h"
+#include "OgreStringConverter.h"
+#include "OgreTimer.h"
+#include "ThreadPool.h"
+
+#include <boost/bind/bind.hpp>
+
+namespace Ogre {
+
+    //-------------------------------------------------------------------------
+    OverhangNoiseTerrainPageSource::OverhangNoiseTerrainPageSource()
+        : mOffset(0.5), mAmplitude(0.5), mSamplesGenerated(0), mGenerationMicroseconds(0)
+    {
+    }
+    //-------------------------------------------------------------------------
+    OverhangNoiseTerrainPageSource::~OverhangNoiseTerrainPageSource()
+    {
+        shutdown();
+    }
+    //-------------------------------------------------------------------------
+    void OverhangNoiseTerrainPageSource::shutdown(void)
+    {
+        _unloadAllPages();
+    }
+    //-------------------------------------------------------------------------
+    void OverhangNoiseTerrainPageSource::initialise(OverhangTerrainSceneManager* tsm, 
+        ushort tileSize, ushort pageSize, bool asyncLoading, 
+        OverhangTerrainPageSourceOptionList& optionList)
+    {
+        // Shutdown to clear any previous data
+        shutdown();
+
+        OverhangTerrainPageSource::initialise(tsm, tileSize, pageSize, asyncLoading, optionList);
+
+        uint32 seed = 0;
+        ushort octaves = 6;
+        float frequency = 1.0f / 256.0f, lacunarity = 2.0f, gain = 0.5f;
+        mOffset = 0.5;
+        mAmplitude = 0.5;
+        OverhangTerrainPageSourceOptionList::iterator ti, tiend;
+        tiend = optionList.end();
+        for (ti = optionList.begin(); ti != tiend; ++ti)
+        {
+            String val = ti->first;
+            StringUtil::trim(val);
+            if (StringUtil::startsWith(val, "Noise.seed", false))
+                seed = StringConverter::parseUnsignedInt(ti->second);
+            else if (StringUtil::startsWith(val, "Noise.octaves", false))
+                octaves = static_cast<ushort>(StringConverter::parseUnsignedInt(ti->second));
+            else if (StringUtil::startsWith(val, "Noise.frequency", false))
+                frequency = StringConverter::parseReal(ti->second);
+            else if (StringUtil::startsWith(val, "Noise.lacunarity", false))
+                lacunarity = StringConverter::parseReal(ti->second);
+            else if (StringUtil::startsWith(val, "Noise.gain", false))
+                gain = StringConverter::parseReal(ti->second);
+            else if (StringUtil::startsWith(val, "Noise.offset", false))
+                mOffset = StringConverter::parseReal(ti->second);
+            else if (StringUtil::startsWith(val, "Noise.amplitude", false))
+                mAmplitude = StringConverter::parseReal(ti->second);
+            else
+            {
+                LogManager::getSingleton().logMessage("Warning: ignoring unknown Noise option '"
+                    + val + "'");
+            }
+        }
+        if (octaves == 0 || octaves > 16 || frequency <= 0)
+        {
+            OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, 
+                "'Noise.octaves' must be 1 to 16 and 'Noise.frequency' positive", 
+                "OverhangNoiseTerrainPageSource::initialise");
+        }
+        mNoise = FractalNoise(seed, octaves, frequency, lacunarity, gain);
+        mSamplesGenerated = 0;
+        mGenerationMicroseconds = 0;
+
+        LogManager::getSingleton().logMessage("OverhangNoiseTerrainPageSource: Seed " + 
+            StringConverter::toString(seed) + ", " + StringConverter::toString(octaves) + " octaves, " +
+            (FractalNoise::isVectorised() ? "SSE2" : "scalar") + " kernel");
+    }
+    //-------------------------------------------------------------------------
+    void OverhangNoiseTerrainPageSource::_generateRows(ushort x, ushort z, Real* heights, 
+        size_t begin, size_t end) const
+    {
+        // Pages share their edge samples with their neighbours
+        int x0 = int(x) * (mPageSize - 1);
+        int z0 = int(z) * (mPageSize - 1);
+        std::vector<float> row(mPageSize);
+        for (size_t j = begin; j < end; ++j)
+        {
+            mNoise.fillRow(x0, z0 + int(j), mPageSize, &row[0]);
+            Real* dst = heights + j * mPageSize;
+            for (size_t i = 0; i < mPageSize; ++i)
+                dst[i] = std::min(std::max(mOffset + mAmplitude * row[i], Real(0)), Real(1));
+        }
+    }
+    //-------------------------------------------------------------------------
+    OverhangTerrainPage* OverhangNoiseTerrainPageSource::_preparePage(ushort x, ushort z)
+    {
+        std::vector<Real> heights(size_t(mPageSize) * mPageSize);
+
+        Timer timer;
+        ThreadPool* pool = mSceneManager ? mSceneManager->_getThreadPool() : 0;
+        if (pool)
+        {
+            pool->parallelFor(0, mPageSize, boost::bind(&OverhangNoiseTerrainPageSource::_generateRows, 
+                this, x, z, &heights[0], boost::placeholders::_1, boost::placeholders::_2), 8);
+        }
+        else
+        {
+            _generateRows(x, z, &heights[0], 0, mPageSize);
+        }
+        unsigned long elapsed = timer.getMicroseconds();
+
+        {
+            boost::mutex::scoped_lock lock(mStatsMutex);
+            mSamplesGenerated += heights.size();
+            mGenerationMicroseconds += elapsed;
+        }
+        LogManager::getSingleton().logMessage("OverhangNoiseTerrainPageSource: Generated page [" +
+            StringConverter::toString(x) + "," + StringConverter::toString(z) + "] in " +
+            StringConverter::toString(elapsed / 1000) + " ms (" + 
+            StringConverter::toString(size_t(heights.size() * 1e6 / std::max(elapsed, 1ul))) + " samples/s)");
+
+        return OverhangTerrainPageSource::_preparePage(OverhangTerrainHeightData(&heights[0], mPageSize), x, z);
+    }
+    //-------------------------------------------------------------------------
+    Real OverhangNoiseTerrainPageSource::getSamplesPerSecond(void)
+    {
+        boost::mutex::scoped_lock lock(mStatsMutex);
+        if (!mGenerationMicroseconds)
+            return 0;
+        return Real(mSamplesGenerated * 1e6 / mGenerationMicroseconds);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangNoiseTerrainPageSource::requestPage(ushort x, ushort y)
+    {
+        _loadPage(x, y);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangNoiseTerrainPageSource::expirePage(ushort x, ushort y)
+    {
+        _unloadPage(x, y);
+    }
+    //-------------------------------------------------------------------------
+
+}
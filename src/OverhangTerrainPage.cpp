@@ -31,10 +31,23 @@ Hacked by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTerra
 */
 #include "OverhangTerrainPage.h"
 #include "TerrainTile.h"
+#include "OverhangTerrainRenderable.h"
+#include "ThreadPool.h"
 #include "OgreAxisAlignedBox.h"
 
+#include <boost/bind/bind.hpp>
+
 namespace Ogre {
 
+    namespace
+    {
+        /// The 8 grid directions (x, z), 45 degrees apart in index space
+        const int GRID_DIRS[ 8 ][ 2 ] = 
+            { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+        /// Horizon of a vertex with no terrain between it and the sun
+        const float NO_HORIZON = -1e30f;
+    }
+
     //-------------------------------------------------------------------------
     OverhangTerrainPage::OverhangTerrainPage(unsigned short numTiles)
     {
@@ -52,6 +65,10 @@ namespace Ogre {
         }
 
         pageSceneNode = 0;
+        pageX = pageZ = 0;
+        mHorizonDir[ 0 ] = mHorizonDir[ 1 ] = 0;
+        mHorizonBlend = 0;
+        mHorizonSun = Vector3::ZERO;
 
     }
     //-------------------------------------------------------------------------
@@ -96,6 +113,79 @@ namespace Ogre {
         }
     }
     //-------------------------------------------------------------------------
+    void OverhangTerrainPage::linkNeighbourPage(TerrainTile::Neighbor side, OverhangTerrainPage* page)
+    {
+        size_t last = tilesPerPage - 1;
+        for ( size_t k = 0; k < tilesPerPage; k++ )
+        {
+            TerrainTile *mine, *theirs = 0;
+            TerrainTile::Neighbor opposite;
+            switch (side)
+            {
+            case TerrainTile::NORTH:
+                mine = tiles[ k ][ 0 ];
+                if (page) theirs = page->tiles[ k ][ last ];
+                opposite = TerrainTile::SOUTH;
+                break;
+            case TerrainTile::SOUTH:
+                mine = tiles[ k ][ last ];
+                if (page) theirs = page->tiles[ k ][ 0 ];
+                opposite = TerrainTile::NORTH;
+                break;
+            case TerrainTile::WEST:
+                mine = tiles[ 0 ][ k ];
+                if (page) theirs = page->tiles[ last ][ k ];
+                opposite = TerrainTile::EAST;
+                break;
+            default:
+                mine = tiles[ last ][ k ];
+                if (page) theirs = page->tiles[ 0 ][ k ];
+                opposite = TerrainTile::WEST;
+                break;
+            }
+            // Unlinking: the tile across still points at us
+            if (!theirs && mine->_getNeighbor(side))
+                mine->_getNeighbor(side)->_setNeighbor(opposite, 0);
+            mine->_setNeighbor(side, theirs);
+            if (theirs)
+                theirs->_setNeighbor(opposite, mine);
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPage::calculateEdgeNormals(TerrainTile::Neighbor side)
+    {
+        size_t last = tilesPerPage - 1;
+        for ( size_t k = 0; k < tilesPerPage; k++ )
+        {
+            switch (side)
+            {
+            case TerrainTile::NORTH: tiles[ k ][ 0 ]->_calculateNormals(); break;
+            case TerrainTile::SOUTH: tiles[ k ][ last ]->_calculateNormals(); break;
+            case TerrainTile::WEST: tiles[ 0 ][ k ]->_calculateNormals(); break;
+            default: tiles[ last ][ k ]->_calculateNormals(); break;
+            }
+        }
+    }
+    //-------------------------------------------------------------------------
+    size_t OverhangTerrainPage::getMemoryUsage(void) const
+    {
+        size_t bytes = sizeof(OverhangTerrainPage);
+        for ( size_t j = 0; j < tilesPerPage; j++ )
+            for ( size_t i = 0; i < tilesPerPage; i++ )
+                bytes += tiles[ i ][ j ]->getMemoryUsage();
+        bytes += ( mHorizons[ 0 ].capacity() + mHorizons[ 1 ].capacity() ) * sizeof(float);
+        return bytes;
+    }
+    //-------------------------------------------------------------------------
+    unsigned long OverhangTerrainPage::getLastVisibleFrame(void) const
+    {
+        unsigned long frame = 0;
+        for ( size_t j = 0; j < tilesPerPage; j++ )
+            for ( size_t i = 0; i < tilesPerPage; i++ )
+                frame = std::max(frame, tiles[ i ][ j ]->getLastVisibleFrame());
+        return frame;
+    }
+    //-------------------------------------------------------------------------
     TerrainTile * OverhangTerrainPage::getTerrainTile( const Vector3 & pt )
     {
         /* Since we don't know if the terrain is square, or has holes, we use a line trace
@@ -136,6 +226,266 @@ namespace Ogre {
 			}
 		}
 	}
+    //-------------------------------------------------------------------------
+    const OverhangTerrainOptions& OverhangTerrainPage::_getOptions(void) const
+    {
+        return *tiles[ 0 ][ 0 ]->getTerrainRenderable()->getOptions();
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPage::_getHeights(std::vector<float>& heights) const
+    {
+        const OverhangTerrainOptions& options = _getOptions();
+        size_t n = options.pageSize;
+        size_t step = options.tileSize - 1;
+        heights.resize( n * n );
+
+        for ( size_t q = 0; q < tilesPerPage; q++ )
+        {
+            for ( size_t p = 0; p < tilesPerPage; p++ )
+            {
+                const OverhangTerrainRenderable* rend = tiles[ p ][ q ]->getTerrainRenderable();
+                // Shared edges are simply copied twice
+                for ( size_t j = 0; j <= step; j++ )
+                {
+                    float* pDst = &heights[ p * step + ( q * step + j ) * n ];
+                    for ( size_t i = 0; i <= step; i++ )
+                        *pDst++ = rend->_getVertexHeight( i, j );
+                }
+            }
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPage::calculateLighting(ThreadPool* pool)
+    {
+        const OverhangTerrainOptions& options = _getOptions();
+        if ( !options.coloured )
+            return;
+
+        const Vector3& sun = options.sunDirection;
+        size_t n = options.pageSize;
+
+        // The sun in index space, where the grid directions are 45 degrees apart
+        Real angle = Math::ATan2( sun.z / options.scale.z, sun.x / options.scale.x ).valueRadians();
+        if ( angle < 0 )
+            angle += Math::TWO_PI;
+        Real sector = angle / ( Math::PI / 4 );
+        int dir = std::min( ( int ) sector, 7 );
+
+        mHorizonDir[ 0 ] = dir;
+        mHorizonDir[ 1 ] = ( dir + 1 ) % 8;
+        mHorizonBlend = sector - dir;
+        mHorizonSun = sun;
+        mHorizons[ 0 ].resize( n * n );
+        mHorizons[ 1 ].resize( n * n );
+
+        _calculateLighting( 0, 0, n - 1, n - 1, pool );
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPage::updateLighting(Real minX, Real minZ, Real maxX, Real maxZ, ThreadPool* pool)
+    {
+        const OverhangTerrainOptions& options = _getOptions();
+        if ( !options.coloured )
+            return;
+
+        if ( mHorizons[ 0 ].empty() || mHorizonSun != options.sunDirection )
+        {
+            calculateLighting( pool );
+            return;
+        }
+
+        int last = options.pageSize - 1;
+        int originx = pageX * last;
+        int originz = pageZ * last;
+        // Normals read the vertices either side, so they change one vertex further out
+        int x0 = std::max( 0, ( int ) Math::Floor( minX / options.scale.x ) - originx - 1 );
+        int z0 = std::max( 0, ( int ) Math::Floor( minZ / options.scale.z ) - originz - 1 );
+        int x1 = std::min( last, ( int ) Math::Ceil( maxX / options.scale.x ) - originx + 1 );
+        int z1 = std::min( last, ( int ) Math::Ceil( maxZ / options.scale.z ) - originz + 1 );
+
+        if ( x0 <= x1 && z0 <= z1 )
+            _calculateLighting( x0, z0, x1, z1, pool );
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPage::_calculateLighting(int x0, int z0, int x1, int z1, ThreadPool* pool)
+    {
+        const OverhangTerrainOptions& options = _getOptions();
+        int n = options.pageSize;
+        int step = options.tileSize - 1;
+
+        std::vector<float> heights;
+        _getHeights( heights );
+
+        // Shaded area: the rectangle, and everything behind it as seen from the sun
+        int sx0 = x0, sz0 = z0, sx1 = x1, sz1 = z1;
+
+        for ( int slot = 0; slot < 2; slot++ )
+        {
+            int dx = GRID_DIRS[ mHorizonDir[ slot ] ][ 0 ];
+            int dz = GRID_DIRS[ mHorizonDir[ slot ] ][ 1 ];
+
+            // Lines keep x * dz - z * dx; keep those passing through the rectangle
+            int c0 = x0 * dz - z0 * dx, c1 = x1 * dz - z1 * dx;
+            int c2 = x0 * dz - z1 * dx, c3 = x1 * dz - z0 * dx;
+            int cmin = std::min( std::min( c0, c1 ), std::min( c2, c3 ) );
+            int cmax = std::max( std::max( c0, c1 ), std::max( c2, c3 ) );
+
+            // Each line starts at the vertex whose next step towards the sun leaves the page
+            std::vector<int> starts;
+            int frontx = dx > 0 ? n - 1 : 0;
+            int frontz = dz > 0 ? n - 1 : 0;
+            for ( int k = 0; k < n; k++ )
+            {
+                int c;
+                if ( dx != 0 )
+                {
+                    c = frontx * dz - k * dx;
+                    if ( c >= cmin && c <= cmax )
+                        starts.push_back( frontx + k * n );
+                }
+                // The corner is on both edges
+                if ( dz != 0 && !( dx != 0 && k == frontx ) )
+                {
+                    c = k * dz - frontz * dx;
+                    if ( c >= cmin && c <= cmax )
+                        starts.push_back( k + frontz * n );
+                }
+            }
+
+            if ( starts.empty() )
+            {
+                continue;
+            }
+            else if ( pool )
+            {
+                pool->parallelFor( 0, starts.size(), boost::bind( &OverhangTerrainPage::_sweepHorizons, 
+                    this, &heights[ 0 ], slot, &starts[ 0 ], boost::placeholders::_1, boost::placeholders::_2 ), 16 );
+            }
+            else
+            {
+                _sweepHorizons( &heights[ 0 ], slot, &starts[ 0 ], 0, starts.size() );
+            }
+
+            if ( dx > 0 ) sx0 = 0;
+            if ( dx < 0 ) sx1 = n - 1;
+            if ( dz > 0 ) sz0 = 0;
+            if ( dz < 0 ) sz1 = n - 1;
+        }
+
+        size_t pitch = sx1 - sx0 + 1;
+        size_t rows = sz1 - sz0 + 1;
+        std::vector<RGBA> colours( pitch * rows );
+        VertexElementType colourType = VertexElement::getBestColourVertexElementType();
+
+        if ( pool )
+        {
+            pool->parallelFor( 0, rows, boost::bind( &OverhangTerrainPage::_shadeVertices, this, 
+                &heights[ 0 ], sx0, sz0, sx1, &colours[ 0 ], colourType, 
+                boost::placeholders::_1, boost::placeholders::_2 ), 16 );
+        }
+        else
+        {
+            _shadeVertices( &heights[ 0 ], sx0, sz0, sx1, &colours[ 0 ], colourType, 0, rows );
+        }
+
+        // Hand each tile its part, edges shared between tiles go to both
+        for ( int q = std::max( sz0 - 1, 0 ) / step; q < ( int ) tilesPerPage && q * step <= sz1; q++ )
+        {
+            for ( int p = std::max( sx0 - 1, 0 ) / step; p < ( int ) tilesPerPage && p * step <= sx1; p++ )
+            {
+                int tx0 = std::max( sx0, p * step ), tx1 = std::min( sx1, p * step + step );
+                int tz0 = std::max( sz0, q * step ), tz1 = std::min( sz1, q * step + step );
+                tiles[ p ][ q ]->getTerrainRenderable()->_setVertexColours( 
+                    tx0 - p * step, tz0 - q * step, tx1 - p * step, tz1 - q * step,
+                    &colours[ ( tx0 - sx0 ) + ( tz0 - sz0 ) * pitch ], pitch );
+            }
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPage::_sweepHorizons(const float* heights, int slot, const int* starts, 
+        size_t begin, size_t end)
+    {
+        const OverhangTerrainOptions& options = _getOptions();
+        int n = options.pageSize;
+        int dx = GRID_DIRS[ mHorizonDir[ slot ] ][ 0 ];
+        int dz = GRID_DIRS[ mHorizonDir[ slot ] ][ 1 ];
+        float run = Math::Sqrt( Math::Sqr( dx * options.scale.x ) + Math::Sqr( dz * options.scale.z ) );
+        float* horizons = &mHorizons[ slot ][ 0 ];
+
+        // Upper convex hull of the vertices passed: distance from the start, height
+        std::vector< std::pair<float, float> > hull;
+        hull.reserve( n );
+
+        for ( size_t l = begin; l < end; l++ )
+        {
+            hull.clear();
+            int x = starts[ l ] % n;
+            int z = starts[ l ] / n;
+            // Walk away from the sun
+            for ( float d = 0; x >= 0 && x < n && z >= 0 && z < n; x -= dx, z -= dz, d += run )
+            {
+                int v = x + z * n;
+                float h = heights[ v ];
+
+                // The horizon is the hull vertex the line from here touches; those 
+                // nearer but below the line to the one after are hidden from here on
+                while ( hull.size() >= 2 )
+                {
+                    const std::pair<float, float>& a = hull[ hull.size() - 1 ];
+                    const std::pair<float, float>& b = hull[ hull.size() - 2 ];
+                    if ( ( a.second - h ) * ( d - b.first ) > ( b.second - h ) * ( d - a.first ) )
+                        break;
+                    hull.pop_back();
+                }
+
+                horizons[ v ] = hull.empty() ? NO_HORIZON : 
+                    ( hull.back().second - h ) / ( d - hull.back().first );
+                hull.push_back( std::make_pair( d, h ) );
+            }
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPage::_shadeVertices(const float* heights, int x0, int z0, int x1, RGBA* colours, 
+        VertexElementType colourType, size_t begin, size_t end)
+    {
+        const OverhangTerrainOptions& options = _getOptions();
+        int last = options.pageSize - 1;
+        const Vector3& sun = options.sunDirection;
+        // The sun is below the horizon where its elevation is lower
+        Real run = Math::Sqrt( sun.x * sun.x + sun.z * sun.z );
+        const float* horizons0 = &mHorizons[ 0 ][ 0 ];
+        const float* horizons1 = &mHorizons[ 1 ][ 0 ];
+        size_t pitch = x1 - x0 + 1;
+
+        for ( size_t row = begin; row < end; row++ )
+        {
+            int z = z0 + ( int ) row;
+            int zu = std::max( z - 1, 0 ), zd = std::min( z + 1, last );
+            RGBA* pDst = colours + row * pitch;
+
+            for ( int x = x0; x <= x1; x++ )
+            {
+                int xl = std::max( x - 1, 0 ), xr = std::min( x + 1, last );
+                int v = x + z * ( last + 1 );
+
+                // Central differences, one sided on the page edges
+                Vector3 normal(
+                    ( heights[ xl + z * ( last + 1 ) ] - heights[ xr + z * ( last + 1 ) ] ) / ( ( xr - xl ) * options.scale.x ),
+                    1,
+                    ( heights[ x + zu * ( last + 1 ) ] - heights[ x + zd * ( last + 1 ) ] ) / ( ( zd - zu ) * options.scale.z ) );
+                normal.normalise();
+
+                Real light = std::max( ( Real ) 0, normal.dotProduct( sun ) );
+                Real horizon = ( 1 - mHorizonBlend ) * horizons0[ v ] + mHorizonBlend * horizons1[ v ];
+                if ( sun.y < horizon * run )
+                    light = 0;
+
+                ColourValue colour = options.ambientLight + ColourValue( light, light, light, 0 );
+                colour.saturate();
+                colour.a = 1;
+                *pDst++ = VertexElement::convertColourValue( colour, colourType );
+            }
+        }
+    }
 
 }
 
@@ -32,8 +32,13 @@ Hacked by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTerra
 #include "OverhangTerrainPageSource.h"
 #include "OverhangTerrainPage.h"
 #include "OverhangTerrainRenderable.h"
+#include "OverhangTerrainHeightData.h"
 #include "OgreSceneNode.h"
 #include "OverhangTerrainSceneManager.h"
+#include "OgreLogManager.h"
+#include "ThreadPool.h"
+
+#include <boost/bind/bind.hpp>
 
 namespace Ogre {
 
@@ -78,21 +83,121 @@ namespace Ogre {
         }
 	}
 	//-------------------------------------------------------------------------
-	OverhangTerrainPageSource::OverhangTerrainPageSource() : mSceneManager(0), mAsyncLoading(false) {
+	OverhangTerrainPageSource::OverhangTerrainPageSource() : mSceneManager(0), mAsyncLoading(false), mThreadPool(0) {
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainPageSource::initialise(OverhangTerrainSceneManager* tsm, 
+		ushort tileSize, ushort pageSize, bool asyncLoading, 
+		OverhangTerrainPageSourceOptionList& optionList)
+	{
+		mSceneManager = tsm;
+		mTileSize = tileSize;
+		mPageSize = pageSize;
+		mAsyncLoading = asyncLoading;
+		mThreadPool = (tsm && asyncLoading) ? tsm->_getThreadPool() : 0;
+	}
+	//-------------------------------------------------------------------------
+	bool OverhangTerrainPageSource::hasPageListeners(void) const
+	{
+		return OverhangTerrainPageSourceListenerManager::getSingleton().hasListeners();
 	}
 	//-------------------------------------------------------------------------
 	OverhangTerrainPage* OverhangTerrainPageSource::buildPage(Real* heightData, const MaterialPtr& pMaterial)
+	{
+		return buildPage(OverhangTerrainHeightData(heightData, mPageSize), pMaterial);
+	}
+	//-------------------------------------------------------------------------
+	OverhangTerrainPage* OverhangTerrainPageSource::buildPage(const OverhangTerrainHeightData& heightData, 
+		const MaterialPtr& pMaterial, ushort pageX, ushort pageZ)
+	{
+		OverhangTerrainPage* page = preparePage(heightData, pageX, pageZ);
+		loadPage(page, pMaterial);
+		return page;
+	}
+	//-------------------------------------------------------------------------
+	OverhangTerrainPage* OverhangTerrainPageSource::preparePage(const OverhangTerrainHeightData& heightData, 
+		ushort pageX, ushort pageZ)
+	{
+        // Create a OverhangTerrain Page
+        OverhangTerrainPage* page = new OverhangTerrainPage((mPageSize-1) / (mTileSize-1));
+		page->pageX = pageX;
+		page->pageZ = pageZ;
+
+        for ( size_t q = 0; q < page->tilesPerPage; q++ )
+        {
+            for ( size_t p = 0; p < page->tilesPerPage; p++ )
+            {
+				StringUtil::StrStreamType new_name_str;
+                new_name_str << "tile[" << pageX << "," << pageZ << "][" << (int)p << "," << (int)q << "]";
+
+                page->tiles[ p ][ q ] = new TerrainTile(new_name_str.str(), mSceneManager, 0);
+            }
+        }
+
+		// Tiles only read the heights and fill their own staging memory, so they
+		// are prepared side by side
+		ThreadPool* pool = mSceneManager->_getThreadPool();
+		size_t numTiles = page->tilesPerPage * page->tilesPerPage;
+		if (pool)
+		{
+			pool->parallelFor(0, numTiles, boost::bind(&OverhangTerrainPageSource::_prepareTiles, 
+				this, page, &heightData, boost::placeholders::_1, boost::placeholders::_2));
+		}
+		else
+		{
+			_prepareTiles(page, &heightData, 0, numTiles);
+		}
+
+		// Normals read across tile edges, so only once all tiles are prepared
+		page->linkNeighbours();
+		if (mSceneManager->getOptions().lit)
+		{
+			if (pool)
+			{
+				pool->parallelFor(0, numTiles, boost::bind(&OverhangTerrainPageSource::_calculateTileNormals, 
+					this, page, boost::placeholders::_1, boost::placeholders::_2));
+			}
+			else
+			{
+				_calculateTileNormals(page, 0, numTiles);
+			}
+		}
+
+		// Colours are staged along with the vertices, before any buffer exists
+		page->calculateLighting(pool);
+
+		return page;
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainPageSource::_prepareTiles(OverhangTerrainPage* page, 
+		const OverhangTerrainHeightData* heightData, size_t begin, size_t end)
+	{
+		// Tiles are positioned in world space, the page node stays at the origin
+		int originx = page->pageX * (mPageSize - 1);
+		int originz = page->pageZ * (mPageSize - 1);
+
+		for (size_t k = begin; k < end; ++k)
+		{
+			size_t p = k % page->tilesPerPage;
+			size_t q = k / page->tilesPerPage;
+			page->tiles[ p ][ q ]->prepare(p * (mTileSize - 1), q * (mTileSize - 1), *heightData, 
+				originx, originz);
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainPageSource::_calculateTileNormals(OverhangTerrainPage* page, size_t begin, size_t end)
+	{
+		for (size_t k = begin; k < end; ++k)
+			page->tiles[ k % page->tilesPerPage ][ k / page->tilesPerPage ]->_calculateNormals();
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainPageSource::loadPage(OverhangTerrainPage* page, const MaterialPtr& pMaterial)
     {
         String name;
 
-        // Create a OverhangTerrain Page
-        OverhangTerrainPage* page = new OverhangTerrainPage((mPageSize-1) / (mTileSize-1));
         // Create a node for all tiles to be attached to
-        // Note we sequentially name since page can be attached at different points
-        // so page x/z is not appropriate
 		StringUtil::StrStreamType page_str;
-		size_t pageIndex = mSceneManager->_getPageCount();
-		page_str << pageIndex;
+		page_str << page->pageX << "," << page->pageZ;
         name = "page[";
         name += page_str.str() + "]";
 		if (mSceneManager->hasSceneNode(name))
@@ -104,18 +209,13 @@ namespace Ogre {
 			page->pageSceneNode = mSceneManager->createSceneNode(name);
 		}
         
-        size_t q = 0;
-        for ( size_t j = 0; j < mPageSize - 1; j += ( mTileSize - 1 ) )
+        for ( size_t q = 0; q < page->tilesPerPage; q++ )
         {
-            size_t p = 0;
-
-            for ( size_t i = 0; i < mPageSize - 1; i += ( mTileSize - 1 ) )
+            for ( size_t p = 0; p < page->tilesPerPage; p++ )
             {
-				StringUtil::StrStreamType new_name_str;
-				
-                // Create scene node for the tile and the TerrainRenderable
-                new_name_str << "tile[" << pageIndex << "][" << (int)p << "," << (int)q << "]";
-				name = new_name_str.str();
+				TerrainTile * tile = page->tiles[ p ][ q ];
+                // Create scene node for the tile
+				name = tile->getTerrainRenderable()->getName();
 
                 SceneNode *c;
 				if (mSceneManager->hasSceneNode(name))
@@ -129,46 +229,153 @@ namespace Ogre {
 					c = page->pageSceneNode->createChildSceneNode( name );
 				}
 
-//				OverhangTerrainRenderable *tile = new OverhangTerrainRenderable(name, mSceneManager);
-				TerrainTile * tile = new TerrainTile(name, mSceneManager, c);
 				// set queue
 				tile->setRenderQueueGroup(mSceneManager->getWorldGeometryRenderQueue());
-                // Initialise the tile
                 tile->setMaterial(pMaterial);
-                tile->initialise(i, j, heightData);
-                // Attach it to the page
-                page->tiles[ p ][ q ] = tile;
-                // Attach it to the node
-//                c ->attachObject( tile );
-                p++;
+                // Create the hardware buffers and attach it to the node
+                tile->load(c);
             }
-
-            q++;
-
         }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPageSource::_queuePreparedPage(OverhangTerrainPage* page)
+    {
+        boost::mutex::scoped_lock lock(mPreparedPagesMutex);
+        mPreparedPages.push_back(page);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPageSource::_discardPreparedPages(void)
+    {
+        boost::mutex::scoped_lock lock(mPreparedPagesMutex);
+        for (std::vector<OverhangTerrainPage*>::iterator i = mPreparedPages.begin(); i != mPreparedPages.end(); ++i)
+            delete *i;
+        mPreparedPages.clear();
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPageSource::_notifyPageLoaded(OverhangTerrainPage* page)
+    {
+        PageKey key(page->pageX, page->pageZ);
+        mLoadingPages.erase(key);
+        mPages[key] = page;
+    }
+    //-------------------------------------------------------------------------
+    OverhangTerrainPage* OverhangTerrainPageSource::_preparePage(const OverhangTerrainHeightData& heightData, 
+        ushort x, ushort z)
+    {
+        OverhangTerrainPage* page = 0;
+        if (hasPageListeners())
+        {
+            // Listeners may modify the heights, so they need a converted copy
+            Real *heights = new Real[mPageSize * mPageSize];
+            heightData.copyTo(heights);
 
-        pageIndex++;
+            // Call listeners
+            firePageConstructed(x, z, heights);
+            // Now turn into TerrainPage
+            if (mSceneManager)
+                page = preparePage(OverhangTerrainHeightData(heights, mPageSize), x, z);
 
-        // calculate neighbours for page
-        page->linkNeighbours();
+            // Free temp store
+            delete [] heights;
+        }
+        else if (mSceneManager)
+        {
+            page = preparePage(heightData, x, z);
+        }
+        return page;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPageSource::_loadPage(ushort x, ushort z)
+    {
+        PageKey key(x, z);
+        if (mPages.find(key) != mPages.end() || mLoadingPages.find(key) != mLoadingPages.end())
+            return;
 
-		if(mSceneManager->getOptions().lit)
-		{
-			q = 0;
-			for ( size_t j = 0; j < mPageSize - 1; j += ( mTileSize - 1 ) )
-			{
-				size_t p = 0;
+        // Note that we're using a single material for now
+        if (mThreadPool)
+        {
+            mPendingMaterial = mSceneManager->getOptions().terrainMaterial;
+            mLoadingPages.insert(key);
+            mThreadPool->submit(boost::bind(&OverhangTerrainPageSource::_preparePageTask, this, x, z));
+            return;
+        }
 
-				for ( size_t i = 0; i < mPageSize - 1; i += ( mTileSize - 1 ) )
-				{
-					page->tiles[ p ][ q ]->_calculateNormals();
-					p++;
-				}
-				q++;
-			}
-		}
+        OverhangTerrainPage* page = _preparePage(x, z);
+        if (page)
+        {
+            loadPage(page, mSceneManager->getOptions().terrainMaterial);
+            mPages[key] = page;
+            mSceneManager->attachPage(x, z, page);
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPageSource::_preparePageTask(ushort x, ushort z)
+    {
+        // Nothing may escape into the pool; a failed page stays marked as loading
+        // so it is not requested over and over
+        try
+        {
+            OverhangTerrainPage* page = _preparePage(x, z);
+            if (page)
+                _queuePreparedPage(page);
+        }
+        catch (Exception& e)
+        {
+            LogManager::getSingleton().logMessage("OverhangTerrainPageSource: Failed to load page [" +
+                StringConverter::toString(x) + "," + StringConverter::toString(z) + "]: " + e.getFullDescription());
+        }
+        catch (std::exception& e)
+        {
+            // e.g. std::bad_alloc from the height or vertex buffers
+            LogManager::getSingleton().logMessage("OverhangTerrainPageSource: Failed to load page [" +
+                StringConverter::toString(x) + "," + StringConverter::toString(z) + "]: " + e.what());
+        }
+        catch (...)
+        {
+            LogManager::getSingleton().logMessage("OverhangTerrainPageSource: Failed to load page [" +
+                StringConverter::toString(x) + "," + StringConverter::toString(z) + "]: unknown exception");
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPageSource::_unloadPage(ushort x, ushort z)
+    {
+        PageMap::iterator i = mPages.find(PageKey(x, z));
+        if (i != mPages.end())
+        {
+            delete i->second;
+            mPages.erase(i);
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainPageSource::_unloadAllPages(void)
+    {
+        // Pages in flight read the source data, let them finish first
+        if (mThreadPool && !mLoadingPages.empty())
+            mThreadPool->waitIdle();
+        mThreadPool = 0;
+        mLoadingPages.clear();
+        _discardPreparedPages();
 
-        return page;
+        for (PageMap::iterator i = mPages.begin(); i != mPages.end(); ++i)
+            delete i->second;
+        mPages.clear();
+    }
+    //-------------------------------------------------------------------------
+    size_t OverhangTerrainPageSource::processPendingPages(void)
+    {
+        std::vector<OverhangTerrainPage*> pages;
+        {
+            boost::mutex::scoped_lock lock(mPreparedPagesMutex);
+            pages.swap(mPreparedPages);
+        }
+        for (std::vector<OverhangTerrainPage*>::iterator i = pages.begin(); i != pages.end(); ++i)
+        {
+            OverhangTerrainPage* page = *i;
+            loadPage(page, mPendingMaterial);
+            _notifyPageLoaded(page);
+            mSceneManager->attachPage(page->pageX, page->pageZ, page);
+        }
+        return pages.size();
     }
     //-------------------------------------------------------------------------
     void OverhangTerrainPageSource::firePageConstructed(size_t pagex, size_t pagez, Real* heightData)
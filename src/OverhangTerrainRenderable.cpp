@@ -40,6 +40,8 @@ Hacked by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTerra
 ***************************************************************************/
 
 #include "OverhangTerrainRenderable.h"
+#include "OverhangTerrainHeightData.h"
+#include "IntersectionTests.h"
 #include "OgreSceneNode.h"
 #include "OgreRenderQueue.h"
 #include "OgreRenderOperation.h"
@@ -51,11 +53,77 @@ Hacked by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTerra
 #include "OgreViewport.h"
 #include "OgreException.h"
 
+#if OGRE_DOUBLE_PRECISION == 0 && \
+    ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+#   define OVERHANG_TERRAIN_SSE2
+#   include <emmintrin.h>
+#   include <boost/static_assert.hpp>
+#endif
+
 namespace Ogre
 {
+    using IntersectionTests::clipSlab;
+
+#ifdef OVERHANG_TERRAIN_SSE2
+    namespace
+    {
+        // Packets are clipped one segment per lane
+        BOOST_STATIC_ASSERT( OverhangTerrainRenderable::RAY_PACKET_SIZE == 4 );
+
+        /// The lanes of a where mask is set, those of b elsewhere
+        inline __m128 select4( __m128 mask, __m128 a, __m128 b )
+        {
+            return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+        }
+
+        /// clipSlab for four segments at once, returns a mask of the lanes still crossing the slab
+        inline __m128 clipSlab4( __m128 o, __m128 d, __m128 lo, __m128 hi, __m128& ta, __m128& tb )
+        {
+            // Lanes parallel to the slab keep their range, and only if they start inside it
+            __m128 moving = _mm_cmpneq_ps( d, _mm_setzero_ps() );
+            __m128 inside = _mm_and_ps( _mm_cmpge_ps( o, lo ), _mm_cmple_ps( o, hi ) );
+            __m128 t0 = _mm_div_ps( _mm_sub_ps( lo, o ), d );
+            __m128 t1 = _mm_div_ps( _mm_sub_ps( hi, o ), d );
+            ta = select4( moving, _mm_max_ps( ta, _mm_min_ps( t0, t1 ) ), ta );
+            tb = select4( moving, _mm_min_ps( tb, _mm_max_ps( t0, t1 ) ), tb );
+            return _mm_and_ps( _mm_cmple_ps( ta, tb ), _mm_or_ps( moving, inside ) );
+        }
+
+        /** Finds the quads of a tile under four points, as getHeightsAt does one at a time.
+        Leaves the position of each point within its quad in u and w, and the heights of 
+        the quad corners t1 t2 b1 b2 read from the position buffer in the lanes. */
+        inline void sampleQuads4( __m128 x, __m128 z, float x0, float z0, float sx, float sz, 
+            int quads, const float* positions, int row, 
+            __m128& u, __m128& w, __m128& t1, __m128& t2, __m128& b1, __m128& b2 )
+        {
+            __m128 zero = _mm_setzero_ps(), limit = _mm_set1_ps( float( quads ) );
+            u = _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_sub_ps( x, _mm_set1_ps( x0 ) ), _mm_set1_ps( sx ) ), zero ), limit );
+            w = _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_sub_ps( z, _mm_set1_ps( z0 ) ), _mm_set1_ps( sz ) ), zero ), limit );
+
+            // Truncation is flooring once clamped, the far edge belongs to the last quad
+            __m128 last = _mm_set1_ps( float( quads - 1 ) );
+            __m128 xf = _mm_min_ps( _mm_cvtepi32_ps( _mm_cvttps_epi32( u ) ), last );
+            __m128 zf = _mm_min_ps( _mm_cvtepi32_ps( _mm_cvttps_epi32( w ) ), last );
+            u = _mm_sub_ps( u, xf );
+            w = _mm_sub_ps( w, zf );
+
+            int xi[ 4 ], zi[ 4 ];
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( xi ), _mm_cvttps_epi32( xf ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( zi ), _mm_cvttps_epi32( zf ) );
+            const float* p[ 4 ];
+            for ( int k = 0; k < 4; k++ )
+                p[ k ] = positions + xi[ k ] * 3 + zi[ k ] * row + 1;
+            t1 = _mm_setr_ps( p[ 0 ][ 0 ], p[ 1 ][ 0 ], p[ 2 ][ 0 ], p[ 3 ][ 0 ] );
+            t2 = _mm_setr_ps( p[ 0 ][ 3 ], p[ 1 ][ 3 ], p[ 2 ][ 3 ], p[ 3 ][ 3 ] );
+            b1 = _mm_setr_ps( p[ 0 ][ row ], p[ 1 ][ row ], p[ 2 ][ row ], p[ 3 ][ row ] );
+            b2 = _mm_setr_ps( p[ 0 ][ row + 3 ], p[ 1 ][ row + 3 ], p[ 2 ][ row + 3 ], p[ 3 ][ row + 3 ] );
+        }
+    }
+#endif
     //-----------------------------------------------------------------------
     #define MAIN_BINDING 0
     #define DELTA_BINDING 1
+    #define GRID_BINDING 2
     //-----------------------------------------------------------------------
     //-----------------------------------------------------------------------
     String OverhangTerrainRenderable::mType = "OverhangTerrainMipMap";
@@ -64,10 +132,11 @@ namespace Ogre
 
     //-----------------------------------------------------------------------
     OverhangTerrainRenderable::OverhangTerrainRenderable(const String& name, OverhangTerrainSceneManager* tsm)
-        : Renderable(), MovableObject(name), mSceneManager(tsm), mTerrain(0), mDeltaBuffers(0), mPositionBuffer(0)
+        : Renderable(), MovableObject(name), mSceneManager(tsm), mTerrain(0), mDeltaBuffers(0), mPositionBuffer(0), mStagedVertexSize(0), mLastVisibleFrame(0)
     {
         mForcedRenderLevel = -1;
         mLastNextLevel = -1;
+        mHeightTreeDepth = 0;
 
         mMinLevelDistSqr = 0;
 
@@ -101,19 +170,38 @@ namespace Ogre
     {
         if(mTerrain)
             delete mTerrain;
+        mTerrain = 0;
 
         if (mPositionBuffer)
             delete [] mPositionBuffer;
+        mPositionBuffer = 0;
 
         if (mDeltaBuffers)
             delete [] mDeltaBuffers;
+        mDeltaBuffers = 0;
 
         if ( mMinLevelDistSqr != 0 )
             delete [] mMinLevelDistSqr;
+        mMinLevelDistSqr = 0;
+
+        mMainBuffer.setNull();
+        std::vector<uchar>().swap(mStagedVertices);
+        std::vector<float>().swap(mStagedDeltas);
+        std::vector<float>().swap(mHeightTree);
+        _clearSeamIndices();
+        mHoles.clear();
+        mInit = false;
     }
     //-----------------------------------------------------------------------
     void OverhangTerrainRenderable::initialise(int startx, int startz,  
-        Real* pageHeightData)
+        const OverhangTerrainHeightData& pageHeightData, int originx, int originz)
+    {
+        prepare(startx, startz, pageHeightData, originx, originz);
+        load();
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::prepare(int startx, int startz,  
+        const OverhangTerrainHeightData& pageHeightData, int originx, int originz)
     {
 
         if ( mOptions->maxGeoMipMapLevel != 0 )
@@ -129,56 +217,21 @@ namespace Ogre
 
         deleteGeometry();
 
-        //calculate min and max heights;
-        Real min = 256000, max = 0;
-
-        mTerrain = new VertexData;
-        mTerrain->vertexStart = 0;
-        mTerrain->vertexCount = mOptions->tileSize * mOptions->tileSize;
-
-        VertexDeclaration* decl = mTerrain->vertexDeclaration;
-        VertexBufferBinding* bind = mTerrain->vertexBufferBinding;
+        size_t vertexCount = mOptions->tileSize * mOptions->tileSize;
 
-        // positions
-        size_t offset = 0;
-        decl->addElement(MAIN_BINDING, offset, VET_FLOAT3, VES_POSITION);
-        offset += VertexElement::getTypeSize(VET_FLOAT3);
+        // Same layout as the declaration set up in load()
+        size_t texOffset = VertexElement::getTypeSize(mOptions->compactVertices ? VET_FLOAT1 : VET_FLOAT3);
         if (mOptions->lit)
-        {
-            decl->addElement(MAIN_BINDING, offset, VET_FLOAT3, VES_NORMAL);
-            offset += VertexElement::getTypeSize(VET_FLOAT3);
-        }
-        // texture coord sets
-        decl->addElement(MAIN_BINDING, offset, VET_FLOAT2, VES_TEXTURE_COORDINATES, 0);
-        offset += VertexElement::getTypeSize(VET_FLOAT2);
-        decl->addElement(MAIN_BINDING, offset, VET_FLOAT2, VES_TEXTURE_COORDINATES, 1);
-        offset += VertexElement::getTypeSize(VET_FLOAT2);
+            texOffset += VertexElement::getTypeSize(VET_FLOAT3);
+        mStagedVertexSize = texOffset;
+        if (!mOptions->compactVertices)
+            mStagedVertexSize += 2 * VertexElement::getTypeSize(VET_FLOAT2);
         if (mOptions->coloured)
-        {
-            decl->addElement(MAIN_BINDING, offset, VET_COLOUR, VES_DIFFUSE);
-            offset += VertexElement::getTypeSize(VET_COLOUR);
-        }
+            mStagedVertexSize += VertexElement::getTypeSize(VET_COLOUR);
+        mStagedVertices.assign(vertexCount * mStagedVertexSize, 0);
 
-        // Create shared vertex buffer
-        mMainBuffer =
-            HardwareBufferManager::getSingleton().createVertexBuffer(
-            decl->getVertexSize(MAIN_BINDING),
-            mTerrain->vertexCount, 
-            HardwareBuffer::HBU_STATIC_WRITE_ONLY);
         // Create system memory copy with just positions in it, for use in simple reads
-        mPositionBuffer = new float[mTerrain->vertexCount * 3];
-
-        bind->setBinding(MAIN_BINDING, mMainBuffer);
-
-        if (mOptions->lodMorph)
-        {
-            // Create additional element for delta
-            decl->addElement(DELTA_BINDING, 0, VET_FLOAT1, VES_BLEND_WEIGHTS);
-            // NB binding is not set here, it is set when deriving the LOD
-        }
-
-
-        mInit = true;
+        mPositionBuffer = new float[vertexCount * 3];
 
         mRenderLevel = 1;
 
@@ -188,78 +241,143 @@ namespace Ogre
 
         int endz = startz + mOptions->tileSize;
 
-        Vector3 left, down, here;
+        // World space vertex offset of the page
+        Real offsetx = ( Real ) originx * mOptions->scale.x;
+        Real offsetz = ( Real ) originz * mOptions->scale.z;
+        mGridOrigin = Vector4( startx, startz, offsetx, offsetz );
 
-        const VertexElement* poselem = decl->findElementBySemantic(VES_POSITION);
-        const VertexElement* texelem0 = decl->findElementBySemantic(VES_TEXTURE_COORDINATES, 0);
-        const VertexElement* texelem1 = decl->findElementBySemantic(VES_TEXTURE_COORDINATES, 1);
         float* pSysPos = mPositionBuffer;
 
-        unsigned char* pBase = static_cast<unsigned char*>(mMainBuffer->lock(HardwareBuffer::HBL_DISCARD));
+        unsigned char* pBase = &mStagedVertices[0];
 
         for ( int j = startz; j < endz; j++ )
         {
             for ( int i = startx; i < endx; i++ )
             {
-                float *pPos, *pTex0, *pTex1;
-                poselem->baseVertexPointerToElement(pBase, &pPos);
-                texelem0->baseVertexPointerToElement(pBase, &pTex0);
-                texelem1->baseVertexPointerToElement(pBase, &pTex1);
+                float *pPos = reinterpret_cast<float*>(pBase);
     
-                Real height = pageHeightData[j * mOptions->pageSize + i];
+                Real height = pageHeightData.getHeight(i, j);
                 height = height * mOptions->scale.y; // scale height 
 
-                *pSysPos++ = *pPos++ = ( float ) i * mOptions->scale.x; //x
-                *pSysPos++ = *pPos++ = height; // y
-                *pSysPos++ = *pPos++ = ( float ) j * mOptions->scale.z; //z
+                *pSysPos++ = ( float ) i * mOptions->scale.x + offsetx; //x
+                *pSysPos++ = height; // y
+                *pSysPos++ = ( float ) j * mOptions->scale.z + offsetz; //z
 
-                *pTex0++ = ( float ) i / ( float ) ( mOptions->pageSize - 1 );
-                *pTex0++ = ( float ) j / ( float ) ( mOptions->pageSize - 1 );
+                if ( mOptions->compactVertices )
+                {
+                    // x, z and the texture coords are derived from the shared grid
+                    *pPos = height;
+                }
+                else
+                {
+                    float *pTex0 = reinterpret_cast<float*>(pBase + texOffset);
+                    float *pTex1 = pTex0 + 2;
 
-                *pTex1++ = ( ( float ) i / ( float ) ( mOptions->tileSize - 1 ) ) * mOptions->detailTile;
-                *pTex1++ = ( ( float ) j / ( float ) ( mOptions->tileSize - 1 ) ) * mOptions->detailTile;
+                    std::copy( pSysPos - 3, pSysPos, pPos );
 
-                if ( height < min )
-                    min = ( Real ) height;
+                    *pTex0++ = ( float ) i / ( float ) ( mOptions->pageSize - 1 );
+                    *pTex0++ = ( float ) j / ( float ) ( mOptions->pageSize - 1 );
 
-                if ( height > max )
-                    max = ( Real ) height;
+                    *pTex1++ = ( ( float ) i / ( float ) ( mOptions->tileSize - 1 ) ) * mOptions->detailTile;
+                    *pTex1++ = ( ( float ) j / ( float ) ( mOptions->tileSize - 1 ) ) * mOptions->detailTile;
+                }
 
-                pBase += mMainBuffer->getVertexSize();
+                pBase += mStagedVertexSize;
             }
         }
 
-        mMainBuffer->unlock();
+        _calculateBounds();
+        _updateHeightTree( 0, 0, mOptions->tileSize - 1, mOptions->tileSize - 1 );
+
+        // Morph deltas for all except the highest LOD, uploaded by load()
+        if (mOptions->lodMorph)
+            mStagedDeltas.assign((mOptions->maxGeoMipMapLevel - 1) * vertexCount, 0);
+
+        Real C = _calculateCFactor();
+
+        _calculateMinLevelDist2( C );
 
-        mBounds.setExtents( 
-            ( Real ) startx * mOptions->scale.x, 
-            min, 
-            ( Real ) startz * mOptions->scale.z,
-            ( Real ) ( endx - 1 ) * mOptions->scale.x, 
-            max, 
-            ( Real ) ( endz - 1 ) * mOptions->scale.z );
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::load(void)
+    {
+        assert(!mStagedVertices.empty() && "prepare() has not been called");
 
+        mTerrain = new VertexData;
+        mTerrain->vertexStart = 0;
+        mTerrain->vertexCount = mOptions->tileSize * mOptions->tileSize;
 
-        mCenter = Vector3( ( startx * mOptions->scale.x + (endx - 1) * mOptions->scale.x ) / 2,
-            ( min + max ) / 2,
-            ( startz * mOptions->scale.z + (endz - 1) * mOptions->scale.z ) / 2 );
+        VertexDeclaration* decl = mTerrain->vertexDeclaration;
+        VertexBufferBinding* bind = mTerrain->vertexBufferBinding;
 
-        mBoundingRadius = Math::Sqrt(
-            Math::Sqr(max - min) +
-            Math::Sqr((endx - 1 - startx) * mOptions->scale.x) +
-            Math::Sqr((endz - 1 - startz) * mOptions->scale.z)) / 2;
+        size_t offset = 0;
+        if (mOptions->compactVertices)
+        {
+            // x / z and detail texture coords shared by all tiles, the vertex 
+            // program adds mGridOrigin and takes the heights from this tile
+            decl->addElement(GRID_BINDING, 0, VET_FLOAT2, VES_POSITION);
+            decl->addElement(GRID_BINDING, VertexElement::getTypeSize(VET_FLOAT2), 
+                VET_FLOAT2, VES_TEXTURE_COORDINATES, 1);
+            bind->setBinding(GRID_BINDING, mSceneManager->_getGridBuffer());
+
+            decl->addElement(MAIN_BINDING, offset, VET_FLOAT1, VES_TEXTURE_COORDINATES, 2);
+            offset += VertexElement::getTypeSize(VET_FLOAT1);
+        }
+        else
+        {
+            // positions
+            decl->addElement(MAIN_BINDING, offset, VET_FLOAT3, VES_POSITION);
+            offset += VertexElement::getTypeSize(VET_FLOAT3);
+        }
+        if (mOptions->lit)
+        {
+            decl->addElement(MAIN_BINDING, offset, VET_FLOAT3, VES_NORMAL);
+            offset += VertexElement::getTypeSize(VET_FLOAT3);
+        }
+        // texture coord sets
+        if (!mOptions->compactVertices)
+        {
+            decl->addElement(MAIN_BINDING, offset, VET_FLOAT2, VES_TEXTURE_COORDINATES, 0);
+            offset += VertexElement::getTypeSize(VET_FLOAT2);
+            decl->addElement(MAIN_BINDING, offset, VET_FLOAT2, VES_TEXTURE_COORDINATES, 1);
+            offset += VertexElement::getTypeSize(VET_FLOAT2);
+        }
+        if (mOptions->coloured)
+        {
+            decl->addElement(MAIN_BINDING, offset, VET_COLOUR, VES_DIFFUSE);
+            offset += VertexElement::getTypeSize(VET_COLOUR);
+        }
+        assert(decl->getVertexSize(MAIN_BINDING) == mStagedVertexSize);
+
+        // Create shared vertex buffer
+        mMainBuffer =
+            HardwareBufferManager::getSingleton().createVertexBuffer(
+            decl->getVertexSize(MAIN_BINDING),
+            mTerrain->vertexCount, 
+            HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        mMainBuffer->writeData(0, mStagedVertices.size(), &mStagedVertices[0], true);
+
+        bind->setBinding(MAIN_BINDING, mMainBuffer);
 
-        // Create delta buffer list if required to morph
         if (mOptions->lodMorph)
         {
+            // Create additional element for delta
+            decl->addElement(DELTA_BINDING, 0, VET_FLOAT1, VES_BLEND_WEIGHTS);
+            // NB binding is not set here, it is set when deriving the LOD
+
             // Create delta buffer for all except the lowest mip
             mDeltaBuffers = new HardwareVertexBufferSharedPtr[mOptions->maxGeoMipMapLevel - 1];
+            for ( int level = 1; level < mOptions->maxGeoMipMapLevel; level++ )
+                mDeltaBuffers[level - 1] = createDeltaBuffer(&mStagedDeltas[(level - 1) * mTerrain->vertexCount]);
         }
 
-        Real C = _calculateCFactor();
-
-        _calculateMinLevelDist2( C );
+        // Staging data is not needed any more
+        std::vector<uchar>().swap(mStagedVertices);
+        std::vector<float>().swap(mStagedDeltas);
 
+        // Count as just seen, so the page is not evicted before it had a chance to be
+        mLastVisibleFrame = Root::getSingleton().getNextFrameNumber();
+        mInit = true;
     }
     //-----------------------------------------------------------------------
     void OverhangTerrainRenderable::_getNormalAt( float x, float z, Vector3 * result )
@@ -302,10 +420,26 @@ namespace Ogre
 
         assert (mOptions->lit && "No normals present");
 
-        HardwareVertexBufferSharedPtr vbuf = 
-            mTerrain->vertexBufferBinding->getBuffer(MAIN_BINDING);
-        const VertexElement* elem = mTerrain->vertexDeclaration->findElementBySemantic(VES_NORMAL);
-        unsigned char* pBase = static_cast<unsigned char*>( vbuf->lock(HardwareBuffer::HBL_DISCARD) );
+        HardwareVertexBufferSharedPtr vbuf;
+        size_t vertexSize;
+        size_t offset;
+        unsigned char* pBase;
+
+        if ( !mStagedVertices.empty() )
+        {
+            // Not loaded yet, the normal follows the position (or height) in the staged layout
+            vertexSize = mStagedVertexSize;
+            offset = VertexElement::getTypeSize(mOptions->compactVertices ? VET_FLOAT1 : VET_FLOAT3);
+            pBase = &mStagedVertices[0];
+        }
+        else
+        {
+            vbuf = mTerrain->vertexBufferBinding->getBuffer(MAIN_BINDING);
+            vertexSize = vbuf->getVertexSize();
+            offset = mTerrain->vertexDeclaration->findElementBySemantic(VES_NORMAL)->getOffset();
+            // Only the normals are rewritten, so the rest of the buffer must survive the lock
+            pBase = static_cast<unsigned char*>( vbuf->lock(HardwareBuffer::HBL_NORMAL) );
+        }
         float* pNorm;
 
         for ( size_t j = 0; j < mOptions->tileSize; j++ )
@@ -316,17 +450,232 @@ namespace Ogre
                 _getNormalAt( _vertex( i, j, 0 ), _vertex( i, j, 2 ), &norm );
 
                 //  printf( "Normal = %5f,%5f,%5f\n", norm.x, norm.y, norm.z );
-                elem->baseVertexPointerToElement(pBase, &pNorm);
+                pNorm = reinterpret_cast<float*>( pBase + offset );
                 *pNorm++ = norm.x;
                 *pNorm++ = norm.y;
                 *pNorm++ = norm.z;
-                pBase += vbuf->getVertexSize();
+                pBase += vertexSize;
+            }
+
+        }
+
+        if ( !vbuf.isNull() )
+            vbuf->unlock();
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_modifyHeights( Real minX, Real minZ, Real maxX, Real maxZ, 
+        const HeightBrush& brush, std::vector<float>* deltas )
+    {
+        int x0, z0, x1, z1;
+        if ( !mInit || !_getVertexRect( minX, minZ, maxX, maxZ, x0, z0, x1, z1 ) )
+            return false;
+
+        HardwareVertexBufferSharedPtr vbuf = 
+            mTerrain->vertexBufferBinding->getBuffer(MAIN_BINDING);
+        // Compact vertices keep the height alone, in place of the position
+        const VertexElement* elem = mOptions->compactVertices ?
+            mTerrain->vertexDeclaration->findElementBySemantic(VES_TEXTURE_COORDINATES, 2) :
+            mTerrain->vertexDeclaration->findElementBySemantic(VES_POSITION);
+        int heightIndex = mOptions->compactVertices ? 0 : 1;
+        size_t vertexSize = vbuf->getVertexSize();
+        // Rows are stored one after another, lock from the first to the last dirty vertex
+        size_t first = _index( x0, z0 );
+        size_t count = _index( x1, z1 ) - first + 1;
+        // Only the heights are rewritten, so the rest of the buffer must survive the lock
+        unsigned char* pBase = static_cast<unsigned char*>( 
+            vbuf->lock(first * vertexSize, count * vertexSize, HardwareBuffer::HBL_NORMAL) );
+        float* pPos;
+        bool changed = false;
+
+        for ( int j = z0; j <= z1; j++ )
+        {
+            for ( int i = x0; i <= x1; i++ )
+            {
+                float* pSysPos = &mPositionBuffer[ _index( i, j ) * 3 ];
+                float height = brush( pSysPos[ 0 ], pSysPos[ 2 ], pSysPos[ 1 ] );
+                if ( height == pSysPos[ 1 ] )
+                    continue;
+
+                if ( deltas )
+                {
+                    if ( deltas->empty() )
+                        deltas->assign( mOptions->tileSize * mOptions->tileSize, 0 );
+                    ( *deltas )[ _index( i, j ) ] += height - pSysPos[ 1 ];
+                }
+                pSysPos[ 1 ] = height;
+                elem->baseVertexPointerToElement(pBase + ( _index( i, j ) - first ) * vertexSize, &pPos);
+                pPos[ heightIndex ] = height;
+                changed = true;
+            }
+        }
+        vbuf->unlock();
+
+        if ( !changed )
+            return false;
+
+        _calculateBounds();
+        _updateHeightTree( x0, z0, x1, z1 );
+
+        // The deltas are staged again just for the recalculation
+        size_t vertexCount = mOptions->tileSize * mOptions->tileSize;
+        if (mOptions->lodMorph)
+            mStagedDeltas.assign((mOptions->maxGeoMipMapLevel - 1) * vertexCount, 0);
+
+        _calculateMinLevelDist2( _calculateCFactor() );
+
+        if (mOptions->lodMorph)
+        {
+            for ( int level = 1; level < mOptions->maxGeoMipMapLevel; level++ )
+            {
+                mDeltaBuffers[level - 1]->writeData(0, vertexCount * sizeof(float), 
+                    &mStagedDeltas[(level - 1) * vertexCount], true);
             }
+            std::vector<float>().swap(mStagedDeltas);
+        }
+        return true;
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::_updateNormals( Real minX, Real minZ, Real maxX, Real maxZ )
+    {
+        int x0, z0, x1, z1;
+        if ( !mInit || !mOptions->lit || !_getVertexRect( minX, minZ, maxX, maxZ, x0, z0, x1, z1 ) )
+            return;
+
+        Vector3 norm;
+
+        HardwareVertexBufferSharedPtr vbuf = 
+            mTerrain->vertexBufferBinding->getBuffer(MAIN_BINDING);
+        const VertexElement* elem = mTerrain->vertexDeclaration->findElementBySemantic(VES_NORMAL);
+        size_t vertexSize = vbuf->getVertexSize();
+        size_t first = _index( x0, z0 );
+        size_t count = _index( x1, z1 ) - first + 1;
+        unsigned char* pBase = static_cast<unsigned char*>( 
+            vbuf->lock(first * vertexSize, count * vertexSize, HardwareBuffer::HBL_NORMAL) );
+        float* pNorm;
+
+        for ( int j = z0; j <= z1; j++ )
+        {
+            for ( int i = x0; i <= x1; i++ )
+            {
+                _getNormalAt( _vertex( i, j, 0 ), _vertex( i, j, 2 ), &norm );
 
+                elem->baseVertexPointerToElement(pBase + ( _index( i, j ) - first ) * vertexSize, &pNorm);
+                *pNorm++ = norm.x;
+                *pNorm++ = norm.y;
+                *pNorm++ = norm.z;
+            }
         }
         vbuf->unlock();
     }
     //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_getVertexRect( Real minX, Real minZ, Real maxX, Real maxZ, 
+        int& x0, int& z0, int& x1, int& z1 )
+    {
+        int last = mOptions->tileSize - 1;
+        Real startx = _vertex( 0, 0, 0 );
+        Real startz = _vertex( 0, 0, 2 );
+
+        x0 = std::max( 0, ( int ) Math::Ceil( ( minX - startx ) / mOptions->scale.x ) );
+        z0 = std::max( 0, ( int ) Math::Ceil( ( minZ - startz ) / mOptions->scale.z ) );
+        x1 = std::min( last, ( int ) Math::Floor( ( maxX - startx ) / mOptions->scale.x ) );
+        z1 = std::min( last, ( int ) Math::Floor( ( maxZ - startz ) / mOptions->scale.z ) );
+
+        return x0 <= x1 && z0 <= z1;
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::_calculateBounds()
+    {
+        //calculate min and max heights;
+        Real min = 256000, max = 0;
+
+        size_t vertexCount = mOptions->tileSize * mOptions->tileSize;
+        for ( size_t v = 0; v < vertexCount; v++ )
+        {
+            Real height = mPositionBuffer[ v * 3 + 1 ];
+
+            if ( height < min )
+                min = height;
+
+            if ( height > max )
+                max = height;
+        }
+
+        int last = mOptions->tileSize - 1;
+        Real startx = _vertex( 0, 0, 0 );
+        Real startz = _vertex( 0, 0, 2 );
+        Real endx = _vertex( last, last, 0 );
+        Real endz = _vertex( last, last, 2 );
+
+        mBounds.setExtents( startx, min, startz, endx, max, endz );
+
+        mCenter = Vector3( ( startx + endx ) / 2, ( min + max ) / 2, ( startz + endz ) / 2 );
+
+        mBoundingRadius = Math::Sqrt(
+            Math::Sqr(max - min) +
+            Math::Sqr(endx - startx) +
+            Math::Sqr(endz - startz)) / 2;
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::_updateHeightTree( int x0, int z0, int x1, int z1 )
+    {
+        int quads = mOptions->tileSize - 1;
+        if ( mHeightTree.empty() )
+        {
+            // The deepest nodes cover 2x2 quads, single quads are tested directly
+            mHeightTreeDepth = 0;
+            while ( ( 2 << mHeightTreeDepth ) < quads )
+                mHeightTreeDepth++;
+            mHeightTree.resize( _heightTreeIndex( mHeightTreeDepth + 1, 0, 0 ) );
+            x0 = z0 = 0;
+            x1 = z1 = quads;
+        }
+
+        // Nodes sharing a vertex of the rectangle, at the deepest level
+        int n = 1 << mHeightTreeDepth;
+        int nx0 = std::max( 0, ( x0 - 1 ) / 2 );
+        int nz0 = std::max( 0, ( z0 - 1 ) / 2 );
+        int nx1 = std::min( n - 1, x1 / 2 );
+        int nz1 = std::min( n - 1, z1 / 2 );
+
+        for ( int nz = nz0; nz <= nz1; nz++ )
+        {
+            for ( int nx = nx0; nx <= nx1; nx++ )
+            {
+                float lo = _vertex( 2 * nx, 2 * nz, 1 );
+                float hi = lo;
+                for ( int j = 2 * nz; j <= 2 * nz + 2; j++ )
+                {
+                    for ( int i = 2 * nx; i <= 2 * nx + 2; i++ )
+                    {
+                        lo = std::min( lo, _vertex( i, j, 1 ) );
+                        hi = std::max( hi, _vertex( i, j, 1 ) );
+                    }
+                }
+                float* node = &mHeightTree[ _heightTreeIndex( mHeightTreeDepth, nx, nz ) ];
+                node[ 0 ] = lo;
+                node[ 1 ] = hi;
+            }
+        }
+
+        for ( int level = mHeightTreeDepth - 1; level >= 0; level-- )
+        {
+            nx0 /= 2; nz0 /= 2; nx1 /= 2; nz1 /= 2;
+            for ( int nz = nz0; nz <= nz1; nz++ )
+            {
+                for ( int nx = nx0; nx <= nx1; nx++ )
+                {
+                    float* node = &mHeightTree[ _heightTreeIndex( level, nx, nz ) ];
+                    const float* c0 = &mHeightTree[ _heightTreeIndex( level + 1, 2 * nx, 2 * nz ) ];
+                    const float* c1 = &mHeightTree[ _heightTreeIndex( level + 1, 2 * nx + 1, 2 * nz ) ];
+                    const float* c2 = &mHeightTree[ _heightTreeIndex( level + 1, 2 * nx, 2 * nz + 1 ) ];
+                    const float* c3 = &mHeightTree[ _heightTreeIndex( level + 1, 2 * nx + 1, 2 * nz + 1 ) ];
+                    node[ 0 ] = std::min( std::min( c0[ 0 ], c1[ 0 ] ), std::min( c2[ 0 ], c3[ 0 ] ) );
+                    node[ 1 ] = std::max( std::max( c0[ 1 ], c1[ 1 ] ), std::max( c2[ 1 ], c3[ 1 ] ) );
+                }
+            }
+        }
+    }
+    //-----------------------------------------------------------------------
     void OverhangTerrainRenderable::_notifyCurrentCamera( Camera* cam )
     {
 		MovableObject::_notifyCurrentCamera(cam);
@@ -417,10 +766,28 @@ namespace Ogre
     {
         // Notify need to calculate light list when our sending to render queue
         mLightListDirty = true;
+        mLastVisibleFrame = Root::getSingleton().getNextFrameNumber();
 
         queue->addRenderable(this, mRenderQueueID);
     }
     //-----------------------------------------------------------------------
+    size_t OverhangTerrainRenderable::getMemoryUsage(void) const
+    {
+        size_t bytes = mStagedVertices.capacity() + 
+            ( mStagedDeltas.capacity() + mHeightTree.capacity() ) * sizeof(float);
+        if (mPositionBuffer)
+            bytes += mOptions->tileSize * mOptions->tileSize * 3 * sizeof(float);
+        if (!mMainBuffer.isNull())
+            bytes += mMainBuffer->getSizeInBytes();
+        if (mDeltaBuffers)
+        {
+            for (size_t i = 0; i + 1 < mOptions->maxGeoMipMapLevel; ++i)
+                if (!mDeltaBuffers[i].isNull())
+                    bytes += mDeltaBuffers[i]->getSizeInBytes();
+        }
+        return bytes;
+    }
+    //-----------------------------------------------------------------------
     void OverhangTerrainRenderable::getRenderOperation( RenderOperation& op )
     {
         //setup indexes for vertices and uvs...
@@ -428,7 +795,7 @@ namespace Ogre
         assert( mInit && "Uninitialized" );
 
         op.useIndexes = true;
-        op.operationType = mOptions->useTriStrips ? 
+        op.operationType = mOptions->useTriStrips && !_hasSeams() ? 
             RenderOperation::OT_TRIANGLE_STRIP : RenderOperation::OT_TRIANGLE_LIST;
         op.vertexData = mTerrain;
         op.indexData = getIndexData();
@@ -480,11 +847,8 @@ namespace Ogre
             float* pDeltas = 0;
             if (mOptions->lodMorph)
             {
-                // Create a set of delta values (store at index - 1 since 0 has none)
-                mDeltaBuffers[level - 1]  = createDeltaBuffer();
-                // Lock, but don't discard (we want the pre-initialised zeros)
-                pDeltas = static_cast<float*>(
-                    mDeltaBuffers[level - 1]->lock(HardwareBuffer::HBL_NORMAL));
+                // Staged set of delta values (store at index - 1 since 0 has none)
+                pDeltas = &mStagedDeltas[(level - 1) * mOptions->tileSize * mOptions->tileSize];
             }
 
             for ( j = 0; j < mOptions->tileSize - step; j += step )
@@ -590,12 +954,6 @@ namespace Ogre
                     }
                 }
             }
-
-            // Unlock morph deltas if required
-            if (mOptions->lodMorph)
-            {
-                mDeltaBuffers[level - 1]->unlock();
-            }
         }
 
 
@@ -782,31 +1140,503 @@ namespace Ogre
         return h;
     }
     //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::getHeightsAt( const float* x, const float* z, float* heights, size_t count )
+    {
+        int quads = mOptions->tileSize - 1;
+        int row = mOptions->tileSize * 3;
+        float x0 = _vertex( 0, 0, 0 ), z0 = _vertex( 0, 0, 2 );
+        float sx = quads / ( _vertex( quads, quads, 0 ) - x0 );
+        float sz = quads / ( _vertex( quads, quads, 2 ) - z0 );
+        size_t i = 0;
+#ifdef OVERHANG_TERRAIN_SSE2
+        for ( ; i + 4 <= count; i += 4 )
+        {
+            __m128 u, w, t1, t2, b1, b2;
+            sampleQuads4( _mm_loadu_ps( x + i ), _mm_loadu_ps( z + i ), x0, z0, sx, sz, 
+                quads, mPositionBuffer, row, u, w, t1, t2, b1, b2 );
+
+            __m128 one = _mm_set1_ps( 1.0f );
+            __m128 upper = _mm_cmple_ps( _mm_add_ps( u, w ), one );
+            __m128 top = _mm_add_ps( _mm_add_ps( t1, _mm_mul_ps( _mm_sub_ps( t2, t1 ), u ) ), 
+                _mm_mul_ps( _mm_sub_ps( b1, t1 ), w ) );
+            __m128 bottom = _mm_add_ps( _mm_add_ps( b2, _mm_mul_ps( _mm_sub_ps( b1, b2 ), _mm_sub_ps( one, u ) ) ), 
+                _mm_mul_ps( _mm_sub_ps( t2, b2 ), _mm_sub_ps( one, w ) ) );
+            _mm_storeu_ps( heights + i, select4( upper, top, bottom ) );
+        }
+#endif
+        // Remainder, or everything without SSE2
+        for ( ; i < count; i++ )
+        {
+            float u = std::min( std::max( ( x[ i ] - x0 ) * sx, 0.0f ), float( quads ) );
+            float w = std::min( std::max( ( z[ i ] - z0 ) * sz, 0.0f ), float( quads ) );
+            int xi = std::min( int( u ), quads - 1 );
+            int zi = std::min( int( w ), quads - 1 );
+            u -= xi;
+            w -= zi;
+
+            const float* p = mPositionBuffer + xi * 3 + zi * row + 1;
+            float t1 = p[ 0 ], t2 = p[ 3 ], b1 = p[ row ], b2 = p[ row + 3 ];
+
+            // The triangles t1 t2 b1 and t2 b2 b1 of getHeightAt
+            heights[ i ] = u + w <= 1 ?
+                t1 + ( t2 - t1 ) * u + ( b1 - t1 ) * w :
+                b2 + ( b1 - b2 ) * ( 1 - u ) + ( t2 - b2 ) * ( 1 - w );
+        }
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::getNormalsAt( const float* x, const float* z, Vector3* normals, size_t count )
+    {
+        int quads = mOptions->tileSize - 1;
+        int row = mOptions->tileSize * 3;
+        float x0 = _vertex( 0, 0, 0 ), z0 = _vertex( 0, 0, 2 );
+        float sx = quads / ( _vertex( quads, quads, 0 ) - x0 );
+        float sz = quads / ( _vertex( quads, quads, 2 ) - z0 );
+        size_t i = 0;
+#ifdef OVERHANG_TERRAIN_SSE2
+        for ( ; i + 4 <= count; i += 4 )
+        {
+            __m128 u, w, t1, t2, b1, b2;
+            sampleQuads4( _mm_loadu_ps( x + i ), _mm_loadu_ps( z + i ), x0, z0, sx, sz, 
+                quads, mPositionBuffer, row, u, w, t1, t2, b1, b2 );
+
+            __m128 one = _mm_set1_ps( 1.0f );
+            __m128 upper = _mm_cmple_ps( _mm_add_ps( u, w ), one );
+            __m128 dx = _mm_mul_ps( select4( upper, _mm_sub_ps( t2, t1 ), _mm_sub_ps( b2, b1 ) ), _mm_set1_ps( sx ) );
+            __m128 dz = _mm_mul_ps( select4( upper, _mm_sub_ps( b1, t1 ), _mm_sub_ps( b2, t2 ) ), _mm_set1_ps( sz ) );
+
+            // ( -dx, 1, -dz ) is never short, so it always normalises
+            __m128 length = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), one ), _mm_mul_ps( dz, dz ) ) );
+            __m128 scale = _mm_div_ps( one, length ), sign = _mm_set1_ps( -0.0f );
+            float nx[ 4 ], ny[ 4 ], nz[ 4 ];
+            _mm_storeu_ps( nx, _mm_mul_ps( _mm_xor_ps( dx, sign ), scale ) );
+            _mm_storeu_ps( ny, scale );
+            _mm_storeu_ps( nz, _mm_mul_ps( _mm_xor_ps( dz, sign ), scale ) );
+            for ( int k = 0; k < 4; k++ )
+                normals[ i + k ] = Vector3( nx[ k ], ny[ k ], nz[ k ] );
+        }
+#endif
+        // Remainder, or everything without SSE2
+        for ( ; i < count; i++ )
+        {
+            float u = std::min( std::max( ( x[ i ] - x0 ) * sx, 0.0f ), float( quads ) );
+            float w = std::min( std::max( ( z[ i ] - z0 ) * sz, 0.0f ), float( quads ) );
+            int xi = std::min( int( u ), quads - 1 );
+            int zi = std::min( int( w ), quads - 1 );
+            u -= xi;
+            w -= zi;
+
+            const float* p = mPositionBuffer + xi * 3 + zi * row + 1;
+            float t1 = p[ 0 ], t2 = p[ 3 ], b1 = p[ row ], b2 = p[ row + 3 ];
+
+            // Slopes of the triangle along x and z, per world unit
+            float dx = ( u + w <= 1 ? t2 - t1 : b2 - b1 ) * sx;
+            float dz = ( u + w <= 1 ? b1 - t1 : b2 - t2 ) * sz;
+            normals[ i ] = Vector3( -dx, 1, -dz );
+            normals[ i ].normalise();
+        }
+    }
+    //-----------------------------------------------------------------------
     bool OverhangTerrainRenderable::intersectSegment( const Vector3 & start, const Vector3 & end, Vector3 * result )
     {
         Vector3 dir = end - start;
-        Vector3 ray = start;
+        Real length = dir.normalise();
 
-        //special case...
-        if ( dir.x == 0 && dir.z == 0 )
+        // Walk the tiles along the segment, t being the distance from start
+        int last = mOptions->tileSize - 1;
+        Real tEnter = 0;
+        OverhangTerrainRenderable* tile = this;
+        while ( tile != 0 && !tile->mHeightTree.empty() )
         {
-            if ( ray.y <= getHeightAt( ray.x, ray.z ) )
+            Real x0 = tile->_vertex( 0, 0, 0 ), z0 = tile->_vertex( 0, 0, 2 );
+            Real x1 = tile->_vertex( last, last, 0 ), z1 = tile->_vertex( last, last, 2 );
+            Real ta = tEnter, tb = length;
+            if ( !clipSlab( start.x, dir.x, x0, x1, ta, tb ) || !clipSlab( start.z, dir.z, z0, z1, ta, tb ) )
+                break;
+
+            Real t;
+            if ( tile->getVisible() && tile->_traceNode( 0, 0, 0, start, dir, ta, tb, t ) )
             {
                 if ( result != 0 )
-                    * result = start;
+                    * result = start + dir * t;
 
                 return true;
             }
-        }
+            if ( tb >= length )
+                break;
 
-        dir.normalise();
+            // Carry on in the tile across the side the segment leaves through
+            Real tx = dir.x > 0 ? ( x1 - start.x ) / dir.x : dir.x < 0 ? ( x0 - start.x ) / dir.x : length;
+            Real tz = dir.z > 0 ? ( z1 - start.z ) / dir.z : dir.z < 0 ? ( z0 - start.z ) / dir.z : length;
+            if ( tx <= tz )
+                tile = tile->mNeighbors[ dir.x > 0 ? EAST : WEST ];
+            else
+                tile = tile->mNeighbors[ dir.z > 0 ? SOUTH : NORTH ];
+            tEnter = tb;
+        }
 
-        //dir.x *= mScale.x;
-        //dir.y *= mScale.y;
-        //dir.z *= mScale.z;
+        if ( result != 0 )
+            * result = Vector3( -1, -1, -1 );
 
-        const AxisAlignedBox& box = getBoundingBox();
-        //start with the next one...
+        return false;
+    }
+    //-----------------------------------------------------------------------
+    int OverhangTerrainRenderable::intersectSegments( int count, const Vector3* starts, 
+        const Vector3* dirs, const Real* lengths, Real* t )
+    {
+        assert( count <= RAY_PACKET_SIZE );
+
+        // Every lane is filled so the packet can be clipped four wide; 
+        // the lanes past count never join a mask
+        OverhangTerrainRenderable* tiles[ RAY_PACKET_SIZE ];
+        Real tEnter[ RAY_PACKET_SIZE ], ends[ RAY_PACKET_SIZE ], hit[ RAY_PACKET_SIZE ];
+        SegmentPacket packet;
+        for ( int i = 0; i < RAY_PACKET_SIZE; i++ )
+        {
+            const Vector3& start = i < count ? starts[ i ] : Vector3::ZERO;
+            const Vector3& dir = i < count ? dirs[ i ] : Vector3::ZERO;
+            packet.ox[ i ] = start.x;
+            packet.oy[ i ] = start.y;
+            packet.oz[ i ] = start.z;
+            packet.dx[ i ] = dir.x;
+            packet.dy[ i ] = dir.y;
+            packet.dz[ i ] = dir.z;
+            tiles[ i ] = i < count ? this : 0;
+            tEnter[ i ] = 0;
+            ends[ i ] = i < count ? lengths[ i ] : 0;
+            hit[ i ] = -1;
+        }
+
+        int last = mOptions->tileSize - 1;
+        int hits = 0;
+        for ( ;; )
+        {
+            // Trace the segments in the tile of the first one still going together
+            OverhangTerrainRenderable* tile = 0;
+            for ( int i = 0; i < count && tile == 0; i++ )
+                tile = tiles[ i ];
+            if ( tile == 0 )
+                break;
+
+            Real x0 = tile->_vertex( 0, 0, 0 ), z0 = tile->_vertex( 0, 0, 2 );
+            Real x1 = tile->_vertex( last, last, 0 ), z1 = tile->_vertex( last, last, 2 );
+            // Clip the segments to the tile
+            Real ta[ RAY_PACKET_SIZE ], tb[ RAY_PACKET_SIZE ];
+            unsigned int crossing = 0;
+#ifdef OVERHANG_TERRAIN_SSE2
+            __m128 ta4 = _mm_loadu_ps( tEnter ), tb4 = _mm_loadu_ps( ends );
+            __m128 in = clipSlab4( _mm_loadu_ps( packet.ox ), _mm_loadu_ps( packet.dx ), 
+                _mm_set1_ps( x0 ), _mm_set1_ps( x1 ), ta4, tb4 );
+            in = _mm_and_ps( in, clipSlab4( _mm_loadu_ps( packet.oz ), _mm_loadu_ps( packet.dz ), 
+                _mm_set1_ps( z0 ), _mm_set1_ps( z1 ), ta4, tb4 ) );
+            _mm_storeu_ps( ta, ta4 );
+            _mm_storeu_ps( tb, tb4 );
+            crossing = _mm_movemask_ps( in );
+#else
+            for ( int i = 0; i < count; i++ )
+            {
+                if ( tiles[ i ] != tile )
+                    continue;
+
+                ta[ i ] = tEnter[ i ];
+                tb[ i ] = ends[ i ];
+                if ( clipSlab( packet.ox[ i ], packet.dx[ i ], x0, x1, ta[ i ], tb[ i ] ) && 
+                    clipSlab( packet.oz[ i ], packet.dz[ i ], z0, z1, ta[ i ], tb[ i ] ) )
+                    crossing |= 1 << i;
+            }
+#endif
+            unsigned int mask = 0;
+            for ( int i = 0; i < count; i++ )
+            {
+                if ( tiles[ i ] != tile )
+                    continue;
+
+                if ( tile->mHeightTree.empty() || !( crossing & ( 1 << i ) ) )
+                    tiles[ i ] = 0;
+                else
+                    mask |= 1 << i;
+            }
+            if ( mask != 0 && tile->getVisible() )
+                tile->_traceNodePacket( 0, 0, 0, mask, packet, starts, dirs, ta, tb, hit );
+
+            for ( int i = 0; i < count; i++ )
+            {
+                if ( !( mask & ( 1 << i ) ) )
+                    continue;
+
+                if ( hit[ i ] >= 0 )
+                {
+                    tiles[ i ] = 0;
+                    hits++;
+                    continue;
+                }
+                if ( tb[ i ] >= ends[ i ] )
+                {
+                    tiles[ i ] = 0;
+                    continue;
+                }
+
+                // Carry on in the tile across the side the segment leaves through
+                const Vector3& dir = dirs[ i ];
+                const Vector3& start = starts[ i ];
+                Real tx = dir.x > 0 ? ( x1 - start.x ) / dir.x : dir.x < 0 ? ( x0 - start.x ) / dir.x : lengths[ i ];
+                Real tz = dir.z > 0 ? ( z1 - start.z ) / dir.z : dir.z < 0 ? ( z0 - start.z ) / dir.z : lengths[ i ];
+                if ( tx <= tz )
+                    tiles[ i ] = tile->mNeighbors[ dir.x > 0 ? EAST : WEST ];
+                else
+                    tiles[ i ] = tile->mNeighbors[ dir.z > 0 ? SOUTH : NORTH ];
+                tEnter[ i ] = tb[ i ];
+            }
+        }
+        std::copy( hit, hit + count, t );
+        return hits;
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::_traceNodePacket( int level, int x, int z, unsigned int mask, 
+        const SegmentPacket& packet, const Vector3* starts, const Vector3* dirs, 
+        const Real* ta, const Real* tb, Real* t )
+    {
+        int size = ( mOptions->tileSize - 1 ) >> level;
+        Real x0 = _vertex( x * size, 0, 0 ), x1 = _vertex( ( x + 1 ) * size, 0, 0 );
+        Real z0 = _vertex( 0, z * size, 2 ), z1 = _vertex( 0, ( z + 1 ) * size, 2 );
+        const float* node = &mHeightTree[ _heightTreeIndex( level, x, z ) ];
+
+        // Keep the segments that cross the node below its highest quad, 
+        // only up to their hit if they already have one
+        Real ca[ RAY_PACKET_SIZE ], cb[ RAY_PACKET_SIZE ];
+        unsigned int active = 0;
+#ifdef OVERHANG_TERRAIN_SSE2
+        __m128 t4 = _mm_loadu_ps( t ), tb4 = _mm_loadu_ps( tb );
+        __m128 ca4 = _mm_loadu_ps( ta );
+        __m128 cb4 = select4( _mm_cmpge_ps( t4, _mm_setzero_ps() ), _mm_min_ps( tb4, t4 ), tb4 );
+        __m128 in = clipSlab4( _mm_loadu_ps( packet.ox ), _mm_loadu_ps( packet.dx ), 
+            _mm_set1_ps( x0 ), _mm_set1_ps( x1 ), ca4, cb4 );
+        in = _mm_and_ps( in, clipSlab4( _mm_loadu_ps( packet.oz ), _mm_loadu_ps( packet.dz ), 
+            _mm_set1_ps( z0 ), _mm_set1_ps( z1 ), ca4, cb4 ) );
+        __m128 oy = _mm_loadu_ps( packet.oy ), dy = _mm_loadu_ps( packet.dy );
+        __m128 low = _mm_min_ps( _mm_add_ps( oy, _mm_mul_ps( dy, ca4 ) ), _mm_add_ps( oy, _mm_mul_ps( dy, cb4 ) ) );
+        in = _mm_and_ps( in, _mm_cmple_ps( low, _mm_set1_ps( node[ 1 ] ) ) );
+        _mm_storeu_ps( ca, ca4 );
+        _mm_storeu_ps( cb, cb4 );
+        active = _mm_movemask_ps( in ) & mask;
+#else
+        for ( int i = 0; i < RAY_PACKET_SIZE; i++ )
+        {
+            if ( !( mask & ( 1 << i ) ) )
+                continue;
+
+            ca[ i ] = ta[ i ];
+            cb[ i ] = t[ i ] >= 0 ? std::min( tb[ i ], t[ i ] ) : tb[ i ];
+            if ( clipSlab( packet.ox[ i ], packet.dx[ i ], x0, x1, ca[ i ], cb[ i ] ) &&
+                clipSlab( packet.oz[ i ], packet.dz[ i ], z0, z1, ca[ i ], cb[ i ] ) &&
+                std::min( packet.oy[ i ] + packet.dy[ i ] * ca[ i ], packet.oy[ i ] + packet.dy[ i ] * cb[ i ] ) <= node[ 1 ] )
+                active |= 1 << i;
+        }
+#endif
+        if ( active == 0 )
+            return;
+        int first = 0;
+        while ( !( active & ( 1 << first ) ) )
+            first++;
+
+        // Visit the children in the order the first segment passes through them. Segments
+        // heading elsewhere still end up with their nearest hit, as each hit shortens them
+        static const int order[ 4 ][ 2 ] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+        int flipx = dirs[ first ].x < 0 ? 1 : 0;
+        int flipz = dirs[ first ].z < 0 ? 1 : 0;
+        for ( int c = 0; c < 4; c++ )
+        {
+            int cx = 2 * x + ( order[ c ][ 0 ] ^ flipx );
+            int cz = 2 * z + ( order[ c ][ 1 ] ^ flipz );
+            if ( level < mHeightTreeDepth )
+            {
+                _traceNodePacket( level + 1, cx, cz, active, packet, starts, dirs, ca, cb, t );
+                continue;
+            }
+            for ( int i = 0; i < RAY_PACKET_SIZE; i++ )
+            {
+                Real hit;
+                if ( ( active & ( 1 << i ) ) && _traceQuad( cx, cz, starts[ i ], dirs[ i ], 
+                    ca[ i ], t[ i ] >= 0 ? t[ i ] : cb[ i ], hit ) )
+                    t[ i ] = hit;
+            }
+        }
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_traceNode( int level, int x, int z, const Vector3& start, 
+        const Vector3& dir, Real ta, Real tb, Real& t )
+    {
+        int size = ( mOptions->tileSize - 1 ) >> level;
+        if ( !clipSlab( start.x, dir.x, _vertex( x * size, 0, 0 ), _vertex( ( x + 1 ) * size, 0, 0 ), ta, tb ) ||
+            !clipSlab( start.z, dir.z, _vertex( 0, z * size, 2 ), _vertex( 0, ( z + 1 ) * size, 2 ), ta, tb ) )
+            return false;
+
+        // Nothing to hit while the ray stays above the highest quad
+        const float* node = &mHeightTree[ _heightTreeIndex( level, x, z ) ];
+        if ( std::min( start.y + dir.y * ta, start.y + dir.y * tb ) > node[ 1 ] )
+            return false;
+
+        // Visit the children in the order the ray passes through them
+        static const int order[ 4 ][ 2 ] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+        int flipx = dir.x < 0 ? 1 : 0;
+        int flipz = dir.z < 0 ? 1 : 0;
+        for ( int i = 0; i < 4; i++ )
+        {
+            int cx = 2 * x + ( order[ i ][ 0 ] ^ flipx );
+            int cz = 2 * z + ( order[ i ][ 1 ] ^ flipz );
+            bool hit = level == mHeightTreeDepth ?
+                _traceQuad( cx, cz, start, dir, ta, tb, t ) :
+                _traceNode( level + 1, cx, cz, start, dir, ta, tb, t );
+            if ( hit )
+                return true;
+        }
+        return false;
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::sweep( const IntersectionTests::Sweep& sweep, Real maxT, 
+        Real& t, Vector3& normal )
+    {
+        if ( mHeightTree.empty() || !getVisible() )
+            return false;
+
+        Real best = maxT;
+        if ( !_sweepNode( 0, 0, 0, sweep, best, normal ) )
+            return false;
+
+        t = best;
+        return true;
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_sweepNode( int level, int x, int z, 
+        const IntersectionTests::Sweep& sweep, Real& best, Vector3& normal )
+    {
+        int size = ( mOptions->tileSize - 1 ) >> level;
+        const float* node = &mHeightTree[ _heightTreeIndex( level, x, z ) ];
+        Vector3 lo( _vertex( x * size, 0, 0 ), node[ 0 ], _vertex( 0, z * size, 2 ) );
+        Vector3 hi( _vertex( ( x + 1 ) * size, 0, 0 ), node[ 1 ], _vertex( 0, ( z + 1 ) * size, 2 ) );
+        Real ta = 0, tb = best;
+        if ( !sweep.hitsBox( lo, hi, ta, tb ) )
+            return false;
+
+        static const int order[ 4 ][ 2 ] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+        int flipx = sweep.dir.x < 0 ? 1 : 0;
+        int flipz = sweep.dir.z < 0 ? 1 : 0;
+        bool hit = false;
+        for ( int i = 0; i < 4; i++ )
+        {
+            int cx = 2 * x + ( order[ i ][ 0 ] ^ flipx );
+            int cz = 2 * z + ( order[ i ][ 1 ] ^ flipz );
+            if ( level < mHeightTreeDepth )
+            {
+                if ( _sweepNode( level + 1, cx, cz, sweep, best, normal ) )
+                    hit = true;
+                continue;
+            }
+
+            // A quad: the triangles t1 t2 b1 and t2 b2 b1 of getHeightAt, unless cut away
+            if ( _isCut( cx, cz ) )
+                continue;
+
+            Vector3 t1( _vertex( cx, cz, 0 ), _vertex( cx, cz, 1 ), _vertex( cx, cz, 2 ) );
+            Vector3 t2( _vertex( cx + 1, cz, 0 ), _vertex( cx + 1, cz, 1 ), _vertex( cx + 1, cz, 2 ) );
+            Vector3 b1( _vertex( cx, cz + 1, 0 ), _vertex( cx, cz + 1, 1 ), _vertex( cx, cz + 1, 2 ) );
+            Vector3 b2( _vertex( cx + 1, cz + 1, 0 ), _vertex( cx + 1, cz + 1, 1 ), _vertex( cx + 1, cz + 1, 2 ) );
+            if ( IntersectionTests::sweepTriangle( sweep, t1, t2, b1, best, best, normal ) )
+                hit = true;
+            if ( IntersectionTests::sweepTriangle( sweep, t2, b2, b1, best, best, normal ) )
+                hit = true;
+        }
+        return hit;
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_traceQuad( int x, int z, const Vector3& start, 
+        const Vector3& dir, Real ta, Real tb, Real& t )
+    {
+        // Nothing is drawn there, the fragments filling the hole are traced separately
+        if ( _isCut( x, z ) )
+            return false;
+
+        Real x0 = _vertex( x, z, 0 ), z0 = _vertex( x, z, 2 );
+        Real x1 = _vertex( x + 1, z + 1, 0 ), z1 = _vertex( x + 1, z + 1, 2 );
+        if ( !clipSlab( start.x, dir.x, x0, x1, ta, tb ) || !clipSlab( start.z, dir.z, z0, z1, ta, tb ) )
+            return false;
+
+        float t1 = _vertex( x, z, 1 );
+        float t2 = _vertex( x + 1, z, 1 );
+        float b1 = _vertex( x, z + 1, 1 );
+        float b2 = _vertex( x + 1, z + 1, 1 );
+
+        // Position within the quad (0..1 along x and z) at t = 0, and per unit of t
+        Real u = ( start.x - x0 ) / ( x1 - x0 ), du = dir.x / ( x1 - x0 );
+        Real w = ( start.z - z0 ) / ( z1 - z0 ), dw = dir.z / ( z1 - z0 );
+
+        // The quad is split into triangles t1 t2 b1 and t2 b2 b1, as in getHeightAt
+        Real ends[ 3 ] = { ta, tb, tb };
+        int spans = 1;
+        if ( du + dw != 0 )
+        {
+            Real td = ( 1 - u - w ) / ( du + dw );
+            if ( td > ta && td < tb )
+            {
+                ends[ 1 ] = td;
+                spans = 2;
+            }
+        }
+
+        for ( int i = 0; i < spans; i++ )
+        {
+            Real s0 = ends[ i ], s1 = ends[ i + 1 ];
+            Real c, cu, cw;
+            if ( u + w + ( du + dw ) * 0.5 * ( s0 + s1 ) <= 1 )
+            {
+                c = t1; cu = t2 - t1; cw = b1 - t1;
+            }
+            else
+            {
+                c = b1 + t2 - b2; cu = b2 - b1; cw = b2 - t2;
+            }
+
+            // Height of the ray above the triangle, linear along the span
+            Real d0 = start.y + dir.y * s0 - ( c + cu * ( u + du * s0 ) + cw * ( w + dw * s0 ) );
+            Real d1 = start.y + dir.y * s1 - ( c + cu * ( u + du * s1 ) + cw * ( w + dw * s1 ) );
+            if ( d0 <= 0 )
+            {
+                t = s0;
+                return true;
+            }
+            if ( d1 <= 0 )
+            {
+                t = s0 + ( s1 - s0 ) * d0 / ( d0 - d1 );
+                return true;
+            }
+        }
+        return false;
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_marchSegment( const Vector3 & start, const Vector3 & end, Vector3 * result )
+    {
+        Vector3 dir = end - start;
+        Vector3 ray = start;
+
+        //special case...
+        if ( dir.x == 0 && dir.z == 0 )
+        {
+            if ( ray.y <= getHeightAt( ray.x, ray.z ) )
+            {
+                if ( result != 0 )
+                    * result = start;
+
+                return true;
+            }
+        }
+
+        dir.normalise();
+
+        //dir.x *= mScale.x;
+        //dir.y *= mScale.y;
+        //dir.z *= mScale.z;
+
+        const AxisAlignedBox& box = getBoundingBox();
+        //start with the next one...
         ray += dir;
 
 
@@ -835,13 +1665,13 @@ namespace Ogre
         }
 
         if ( ray.x < box.getMinimum().x && mNeighbors[ WEST ] != 0 )
-            return mNeighbors[ WEST ] ->intersectSegment( ray, end, result );
+            return mNeighbors[ WEST ] ->_marchSegment( ray, end, result );
         else if ( ray.z < box.getMinimum().z && mNeighbors[ NORTH ] != 0 )
-            return mNeighbors[ NORTH ] ->intersectSegment( ray, end, result );
+            return mNeighbors[ NORTH ] ->_marchSegment( ray, end, result );
         else if ( ray.x > box.getMaximum().x && mNeighbors[ EAST ] != 0 )
-            return mNeighbors[ EAST ] ->intersectSegment( ray, end, result );
+            return mNeighbors[ EAST ] ->_marchSegment( ray, end, result );
         else if ( ray.z > box.getMaximum().z && mNeighbors[ SOUTH ] != 0 )
-            return mNeighbors[ SOUTH ] ->intersectSegment( ray, end, result );
+            return mNeighbors[ SOUTH ] ->_marchSegment( ray, end, result );
         else
         {
             if ( result != 0 )
@@ -851,76 +1681,47 @@ namespace Ogre
         }
     }
     //-----------------------------------------------------------------------
-    void OverhangTerrainRenderable::_generateVertexLighting( const Vector3 &sunlight, ColourValue ambient )
+    void OverhangTerrainRenderable::_setVertexColours( int x0, int z0, int x1, int z1, 
+        const RGBA* colours, size_t pitch )
     {
+        if ( !mOptions->coloured || ( !mInit && mStagedVertices.empty() ) )
+            return;
 
-        Vector3 pt;
-        Vector3 normal;
-        Vector3 light;
+        size_t first = _index( x0, z0 );
+        size_t count = _index( x1, z1 ) - first + 1;
+        size_t vertexSize;
+        size_t offset;
+        unsigned char* pBase;
+        HardwareVertexBufferSharedPtr vbuf;
 
-        HardwareVertexBufferSharedPtr vbuf = 
-            mTerrain->vertexBufferBinding->getBuffer(MAIN_BINDING);
-        const VertexElement* elem = mTerrain->vertexDeclaration->findElementBySemantic(VES_DIFFUSE);
-        //for each point in the terrain, see if it's in the line of sight for the sun.
-        for ( size_t i = 0; i < mOptions->tileSize; i++ )
+        if ( !mStagedVertices.empty() )
         {
-            for ( size_t j = 0; j < mOptions->tileSize; j++ )
-            {
-                //  printf( "Checking %f,%f,%f ", pt.x, pt.y, pt.z );
-                pt.x = _vertex( i, j, 0 );
-                pt.y = _vertex( i, j, 1 );
-                pt.z = _vertex( i, j, 2 );
-
-                light = sunlight - pt;
-
-                light.normalise();
-
-                if ( ! intersectSegment( pt, sunlight, 0 ) )
-                {
-                    //
-                    _getNormalAt( _vertex( i, j, 0 ), _vertex( i, j, 2 ), &normal );
-
-                    float l = light.dotProduct( normal );
-
-                    ColourValue v;
-                    v.r = ambient.r + l;
-                    v.g = ambient.g + l;
-                    v.b = ambient.b + l;
-
-                    if ( v.r > 1 ) v.r = 1;
-
-                    if ( v.g > 1 ) v.g = 1;
-
-                    if ( v.b > 1 ) v.b = 1;
-
-                    if ( v.r < 0 ) v.r = 0;
-
-                    if ( v.g < 0 ) v.g = 0;
-
-                    if ( v.b < 0 ) v.b = 0;
-
-                    RGBA colour;
-                    Root::getSingleton().convertColourValue( v, &colour );
-                    vbuf->writeData(
-                        (_index( i, j ) * vbuf->getVertexSize()) + elem->getOffset(),
-                        sizeof(RGBA), &colour);
-                }
-
-                else
-                {
-                    RGBA colour;
-                    Root::getSingleton().convertColourValue( ambient, &colour );
-
-                    vbuf->writeData(
-                        (_index( i, j ) * vbuf->getVertexSize()) + elem->getOffset(), 
-                        sizeof(RGBA), &colour);
-                }
+            // Not loaded yet, the colour is the last element of the staged layout
+            vertexSize = mStagedVertexSize;
+            offset = mStagedVertexSize - VertexElement::getTypeSize(VET_COLOUR);
+            pBase = &mStagedVertices[ first * vertexSize ];
+        }
+        else
+        {
+            vbuf = mTerrain->vertexBufferBinding->getBuffer(MAIN_BINDING);
+            vertexSize = vbuf->getVertexSize();
+            offset = mTerrain->vertexDeclaration->findElementBySemantic(VES_DIFFUSE)->getOffset();
+            // Only the colours are rewritten, so the rest of the buffer must survive the lock
+            pBase = static_cast<unsigned char*>( 
+                vbuf->lock(first * vertexSize, count * vertexSize, HardwareBuffer::HBL_NORMAL) );
+        }
 
+        for ( int j = z0; j <= z1; j++ )
+        {
+            const RGBA* pSrc = colours + ( j - z0 ) * pitch;
+            for ( int i = x0; i <= x1; i++ )
+            {
+                memcpy( pBase + ( _index( i, j ) - first ) * vertexSize + offset, pSrc++, sizeof(RGBA) );
             }
-
         }
 
-        printf( "." );
+        if ( !vbuf.isNull() )
+            vbuf->unlock();
     }
     //-----------------------------------------------------------------------
     Real OverhangTerrainRenderable::getSquaredViewDepth(const Camera* cam) const
@@ -974,72 +1775,41 @@ namespace Ogre
                 (mNeighbors[ SOUTH ] -> mRenderLevel - mRenderLevel) << STITCH_SOUTH_SHIFT;
         }
 
-        // Check preexisting
-		LevelArray& levelIndex = mSceneManager->_getLevelIndex();
-        IndexMap::iterator ii = levelIndex[ mRenderLevel ]->find( stitchFlags );
-        IndexData* indexData;
-        if ( ii == levelIndex[ mRenderLevel ]->end())
+        if ( _hasSeams() )
         {
-            // Create
-            if (mOptions->useTriStrips)
-            {
-                indexData = generateTriStripIndexes(stitchFlags);
-            }
-            else
-            {
-                indexData = generateTriListIndexes(stitchFlags);
-            }
-            levelIndex[ mRenderLevel ]->insert(
-                IndexMap::value_type(stitchFlags, indexData));
+            // Seams are particular to this tile, so are their indexes
+            if ( mSeamIndices.empty() )
+                mSeamIndices.resize( mOptions->maxGeoMipMapLevel );
+            IndexMap& seamIndex = mSeamIndices[ mRenderLevel ];
+            IndexMap::iterator si = seamIndex.find( stitchFlags );
+            if ( si != seamIndex.end() )
+                return si->second;
+            IndexData* indexData = generateSeamIndexes();
+            seamIndex.insert(IndexMap::value_type(stitchFlags, indexData));
+            return indexData;
         }
-        else
-        {
-            indexData = ii->second;
-        }
-
-
-        return indexData;
-
 
+        // Shared by all tiles, built up front or on first use
+        return mSceneManager->_getLevelIndex( mRenderLevel, stitchFlags );
     }
     //-----------------------------------------------------------------------
-    IndexData* OverhangTerrainRenderable::generateTriStripIndexes(unsigned int stitchFlags)
+    size_t OverhangTerrainRenderable::_buildTriStripIndexes(const OverhangTerrainOptions& options, int level, 
+        unsigned int stitchFlags, unsigned short* pIdx)
     {
         // The step used for the current level
-        int step = 1 << mRenderLevel;
+        int step = 1 << level;
         // The step used for the lower level
-        int lowstep = 1 << (mRenderLevel + 1);
+        int lowstep = 1 << (level + 1);
 
         int numIndexes = 0;
 
-        // Calculate the number of indexes required
-        // This is the number of 'cells' at this detail level x 2
-        // plus 3 degenerates to turn corners
-        int numTrisAcross = (((mOptions->tileSize-1) / step) * 2) + 3;
-        // Num indexes is number of tris + 2
-        int new_length = numTrisAcross * ((mOptions->tileSize-1) / step) + 2;
-        //this is the maximum for a level.  It wastes a little, but shouldn't be a problem.
-
-        IndexData* indexData = new IndexData;
-        indexData->indexBuffer = 
-            HardwareBufferManager::getSingleton().createIndexBuffer(
-            HardwareIndexBuffer::IT_16BIT,
-            new_length, HardwareBuffer::HBU_STATIC_WRITE_ONLY);//, false);
-
-        mSceneManager->_getIndexCache().mCache.push_back( indexData );
-
-        unsigned short* pIdx = static_cast<unsigned short*>(
-            indexData->indexBuffer->lock(0, 
-            indexData->indexBuffer->getSizeInBytes(), 
-            HardwareBuffer::HBL_DISCARD));
-
         // Stripified mesh
-        for ( int j = 0; j < mOptions->tileSize - 1; j += step )
+        for ( int j = 0; j < options.tileSize - 1; j += step )
         {
             int i;
             // Forward strip
             // We just do the |/ here, final | done after
-            for ( i = 0; i < mOptions->tileSize - 1; i += step )
+            for ( i = 0; i < options.tileSize - 1; i += step )
             {
                 int x[4], y[4];
                 x[0] = x[1] = i;
@@ -1077,7 +1847,7 @@ namespace Ogre
                         y[1] -= step;
                     }
                 }
-                if (i == (mOptions->tileSize - 1 - step) && (stitchFlags & STITCH_EAST))
+                if (i == (options.tileSize - 1 - step) && (stitchFlags & STITCH_EAST))
                 {
                     // East tiling means rounding y[2] & y[3]
                     if (y[2] % lowstep != 0)
@@ -1094,22 +1864,22 @@ namespace Ogre
                 if (i == 0)
                 {
                     // Starter
-                    *pIdx++ = _index( x[0], y[0] ); numIndexes++;
+                    *pIdx++ = _index( options, x[0], y[0] ); numIndexes++;
                 }
-                *pIdx++ = _index( x[1], y[1] ); numIndexes++;
-                *pIdx++ = _index( x[2], y[2] ); numIndexes++;
+                *pIdx++ = _index( options, x[1], y[1] ); numIndexes++;
+                *pIdx++ = _index( options, x[2], y[2] ); numIndexes++;
 
-                if (i == mOptions->tileSize - 1 - step)
+                if (i == options.tileSize - 1 - step)
                 {
                     // Emit extra index to finish row
-                    *pIdx++ = _index( x[3], y[3] ); numIndexes++;
-                    if (j < mOptions->tileSize - 1 - step)
+                    *pIdx++ = _index( options, x[3], y[3] ); numIndexes++;
+                    if (j < options.tileSize - 1 - step)
                     {
                         // Emit this index twice more (this is to turn around without
                         // artefacts)
                         // ** Hmm, looks like we can drop this and it's unnoticeable
-                        //*pIdx++ = _index( x[3], y[3] ); numIndexes++;
-                        //*pIdx++ = _index( x[3], y[3] ); numIndexes++;
+                        //*pIdx++ = _index( options, x[3], y[3] ); numIndexes++;
+                        //*pIdx++ = _index( options, x[3], y[3] ); numIndexes++;
                     }
                 }
 
@@ -1117,7 +1887,7 @@ namespace Ogre
             // Increment row
             j += step;
             // Backward strip
-            for ( i = mOptions->tileSize - 1; i > 0 ; i -= step )
+            for ( i = options.tileSize - 1; i > 0 ; i -= step )
             {
                 int x[4], y[4];
                 x[0] = x[1] = i;
@@ -1127,7 +1897,7 @@ namespace Ogre
 
                 // Never get a north tiling on a backward strip (always
                 // start on a forward strip)
-                if (j == (mOptions->tileSize - 1 - step) && (stitchFlags & STITCH_SOUTH))
+                if (j == (options.tileSize - 1 - step) && (stitchFlags & STITCH_SOUTH))
                 {
                     // South reduction means rounding x[1] / x[3]
                     if (x[1] % lowstep != 0)
@@ -1152,7 +1922,7 @@ namespace Ogre
                         y[3] -= step;
                     }
                 }
-                if (i == mOptions->tileSize - 1 && (stitchFlags & STITCH_EAST))
+                if (i == options.tileSize - 1 && (stitchFlags & STITCH_EAST))
                 {
                     // East tiling means rounding y[0] and y[1] on backward strip
                     if (y[0] % lowstep != 0)
@@ -1166,107 +1936,314 @@ namespace Ogre
                 }
 
                 //triangles
-                if (i == mOptions->tileSize)
+                if (i == options.tileSize)
                 {
                     // Starter
-                    *pIdx++ = _index( x[0], y[0] ); numIndexes++;
+                    *pIdx++ = _index( options, x[0], y[0] ); numIndexes++;
                 }
-                *pIdx++ = _index( x[1], y[1] ); numIndexes++;
-                *pIdx++ = _index( x[2], y[2] ); numIndexes++;
+                *pIdx++ = _index( options, x[1], y[1] ); numIndexes++;
+                *pIdx++ = _index( options, x[2], y[2] ); numIndexes++;
 
                 if (i == step)
                 {
                     // Emit extra index to finish row
-                    *pIdx++ = _index( x[3], y[3] ); numIndexes++;
-                    if (j < mOptions->tileSize - 1 - step)
+                    *pIdx++ = _index( options, x[3], y[3] ); numIndexes++;
+                    if (j < options.tileSize - 1 - step)
                     {
                         // Emit this index once more (this is to turn around)
-                        *pIdx++ = _index( x[3], y[3] ); numIndexes++;
+                        *pIdx++ = _index( options, x[3], y[3] ); numIndexes++;
                     }
                 }
             }
         }
 
 
-        indexData->indexBuffer->unlock();
-        indexData->indexCount = numIndexes;
-        indexData->indexStart = 0;
-
-        return indexData;
-
+        return numIndexes;
     }
     //-----------------------------------------------------------------------
-    IndexData* OverhangTerrainRenderable::generateTriListIndexes(unsigned int stitchFlags)
+    size_t OverhangTerrainRenderable::_buildTriListIndexes(const OverhangTerrainOptions& options, int level, 
+        unsigned int stitchFlags, unsigned short* pIdx)
     {
 
         int numIndexes = 0;
-        int step = 1 << mRenderLevel;
-
-        IndexData* indexData = 0;
+        int step = 1 << level;
 
         int north = stitchFlags & STITCH_NORTH ? step : 0;
         int south = stitchFlags & STITCH_SOUTH ? step : 0;
         int east = stitchFlags & STITCH_EAST ? step : 0;
         int west = stitchFlags & STITCH_WEST ? step : 0;
 
-        int new_length = ( mOptions->tileSize / step ) * ( mOptions->tileSize / step ) * 2 * 2 * 2 ;
-        //this is the maximum for a level.  It wastes a little, but shouldn't be a problem.
-
-        indexData = new IndexData;
-        indexData->indexBuffer = 
-            HardwareBufferManager::getSingleton().createIndexBuffer(
-            HardwareIndexBuffer::IT_16BIT,
-            new_length, HardwareBuffer::HBU_STATIC_WRITE_ONLY);//, false);
-
-        mSceneManager->_getIndexCache().mCache.push_back( indexData );
-
-        unsigned short* pIdx = static_cast<unsigned short*>(
-            indexData->indexBuffer->lock(0, 
-            indexData->indexBuffer->getSizeInBytes(), 
-            HardwareBuffer::HBL_DISCARD));
-
         // Do the core vertices, minus stitches
-        for ( int j = north; j < mOptions->tileSize - 1 - south; j += step )
+        for ( int j = north; j < options.tileSize - 1 - south; j += step )
         {
-            for ( int i = west; i < mOptions->tileSize - 1 - east; i += step )
+            for ( int i = west; i < options.tileSize - 1 - east; i += step )
             {
                 //triangles
-                *pIdx++ = _index( i, j ); numIndexes++;
-                *pIdx++ = _index( i, j + step ); numIndexes++;
-                *pIdx++ = _index( i + step, j ); numIndexes++;
+                *pIdx++ = _index( options, i, j ); numIndexes++;
+                *pIdx++ = _index( options, i, j + step ); numIndexes++;
+                *pIdx++ = _index( options, i + step, j ); numIndexes++;
 
-                *pIdx++ = _index( i, j + step ); numIndexes++;
-                *pIdx++ = _index( i + step, j + step ); numIndexes++;
-                *pIdx++ = _index( i + step, j ); numIndexes++;
+                *pIdx++ = _index( options, i, j + step ); numIndexes++;
+                *pIdx++ = _index( options, i + step, j + step ); numIndexes++;
+                *pIdx++ = _index( options, i + step, j ); numIndexes++;
             }
         }
 
         // North stitching
         if ( north > 0 )
         {
-            numIndexes += stitchEdge(NORTH, mRenderLevel, mNeighbors[NORTH]->mRenderLevel,
-                west > 0, east > 0, &pIdx);
+            numIndexes += stitchEdge(options, NORTH, level, 
+                level + ( ( stitchFlags >> STITCH_NORTH_SHIFT ) & 0x7F ), west > 0, east > 0, &pIdx);
         }
         // East stitching
         if ( east > 0 )
         {
-            numIndexes += stitchEdge(EAST, mRenderLevel, mNeighbors[EAST]->mRenderLevel,
-                north > 0, south > 0, &pIdx);
+            numIndexes += stitchEdge(options, EAST, level, 
+                level + ( ( stitchFlags >> STITCH_EAST_SHIFT ) & 0x7F ), north > 0, south > 0, &pIdx);
         }
         // South stitching
         if ( south > 0 )
         {
-            numIndexes += stitchEdge(SOUTH, mRenderLevel, mNeighbors[SOUTH]->mRenderLevel,
-                east > 0, west > 0, &pIdx);
+            numIndexes += stitchEdge(options, SOUTH, level, 
+                level + ( ( stitchFlags >> STITCH_SOUTH_SHIFT ) & 0x7F ), east > 0, west > 0, &pIdx);
         }
         // West stitching
         if ( west > 0 )
         {
-            numIndexes += stitchEdge(WEST, mRenderLevel, mNeighbors[WEST]->mRenderLevel,
-                south > 0, north > 0, &pIdx);
+            numIndexes += stitchEdge(options, WEST, level, 
+                level + ( ( stitchFlags >> STITCH_WEST_SHIFT ) & 0x7F ), south > 0, north > 0, &pIdx);
         }
 
 
+        return numIndexes;
+    }
+    //-----------------------------------------------------------------------
+    size_t OverhangTerrainRenderable::_buildIndexes(const OverhangTerrainOptions& options, int level, 
+        unsigned int stitchFlags, unsigned short* pIdx)
+    {
+        if (options.useTriStrips)
+            return _buildTriStripIndexes(options, level, stitchFlags, pIdx);
+        else
+            return _buildTriListIndexes(options, level, stitchFlags, pIdx);
+    }
+    //-----------------------------------------------------------------------
+    size_t OverhangTerrainRenderable::_getMaxIndexCount(const OverhangTerrainOptions& options, int level)
+    {
+        int step = 1 << level;
+        //this is the maximum for a level.  It wastes a little, but shouldn't be a problem.
+        if (options.useTriStrips)
+        {
+            // This is the number of 'cells' at this detail level x 2
+            // plus 3 degenerates to turn corners
+            int numTrisAcross = (((options.tileSize-1) / step) * 2) + 3;
+            // Num indexes is number of tris + 2
+            return numTrisAcross * ((options.tileSize-1) / step) + 2;
+        }
+        else
+        {
+            return ( options.tileSize / step ) * ( options.tileSize / step ) * 2 * 2 * 2;
+        }
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_setHoles( const std::vector<uchar>& holes )
+    {
+        int quads = mOptions->tileSize - 1;
+        int block = 1 << ( mOptions->maxGeoMipMapLevel - 1 );
+        assert( holes.empty() || holes.size() == size_t( quads * quads ) );
+
+        std::vector<uchar> rounded;
+        for ( int bj = 0; bj < quads && !holes.empty(); bj += block )
+        {
+            for ( int bi = 0; bi < quads; bi += block )
+            {
+                bool hole = false;
+                for ( int j = bj; j < bj + block && !hole; j++ )
+                    for ( int i = bi; i < bi + block && !hole; i++ )
+                        hole = holes[ i + j * quads ] != 0;
+                if ( !hole )
+                    continue;
+
+                if ( rounded.empty() )
+                    rounded.assign( quads * quads, 0 );
+                for ( int j = bj; j < bj + block; j++ )
+                    std::fill( &rounded[ bi + j * quads ], &rounded[ bi + j * quads ] + block, 1 );
+            }
+        }
+
+        if ( rounded == mHoles )
+            return false;
+
+        mHoles.swap( rounded );
+        _notifySeamsChanged();
+        return true;
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::_notifySeamsChanged(void)
+    {
+        _clearSeamIndices();
+        for ( int i = 0; i < 4; i++ )
+        {
+            if ( mNeighbors[ i ] != 0 )
+                mNeighbors[ i ] ->_clearSeamIndices();
+        }
+    }
+    //-----------------------------------------------------------------------
+    void OverhangTerrainRenderable::_clearSeamIndices(void)
+    {
+        for ( std::vector<IndexMap>::iterator li = mSeamIndices.begin(); li != mSeamIndices.end(); ++li )
+        {
+            for ( IndexMap::iterator ii = li->begin(); ii != li->end(); ++ii )
+                delete ii->second;
+        }
+        mSeamIndices.clear();
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_cutsEdge( Neighbor edge ) const
+    {
+        if ( !getVisible() )
+            return true;
+        if ( mHoles.empty() )
+            return false;
+
+        // Holes are rounded to the coarsest LOD, so one quad tells for the whole block
+        int last = mOptions->tileSize - 2;
+        int block = 1 << ( mOptions->maxGeoMipMapLevel - 1 );
+        for ( int i = 0; i <= last; i += block )
+        {
+            bool cut;
+            switch ( edge )
+            {
+            case NORTH: cut = _isHole( i, 0 ); break;
+            case SOUTH: cut = _isHole( i, last ); break;
+            case EAST: cut = _isHole( last, i ); break;
+            default: cut = _isHole( 0, i ); break;
+            }
+            if ( cut )
+                return true;
+        }
+        return false;
+    }
+    //-----------------------------------------------------------------------
+    bool OverhangTerrainRenderable::_hasSeams(void) const
+    {
+        if ( !mHoles.empty() )
+            return true;
+
+        static const Neighbor opposite[ 4 ] = { SOUTH, NORTH, WEST, EAST };
+        for ( int i = 0; i < 4; i++ )
+        {
+            if ( mNeighbors[ i ] != 0 && mNeighbors[ i ] ->_cutsEdge( opposite[ i ] ) )
+                return true;
+        }
+        return false;
+    }
+    //-----------------------------------------------------------------------
+    int OverhangTerrainRenderable::_getSeamLOD( Neighbor side, int x, int z ) const
+    {
+        int last = mOptions->tileSize - 2;
+        int block = 1 << ( mOptions->maxGeoMipMapLevel - 1 );
+        int coarsest = mOptions->maxGeoMipMapLevel - 1;
+
+        // The quad across the side, and the tile it belongs to
+        const OverhangTerrainRenderable* tile = this;
+        switch ( side )
+        {
+        case NORTH:
+            z -= 1;
+            if ( z < 0 ) { tile = mNeighbors[ NORTH ]; z = last; }
+            break;
+        case SOUTH:
+            z += block;
+            if ( z > last ) { tile = mNeighbors[ SOUTH ]; z = 0; }
+            break;
+        case EAST:
+            x += block;
+            if ( x > last ) { tile = mNeighbors[ EAST ]; x = 0; }
+            break;
+        default:
+            x -= 1;
+            if ( x < 0 ) { tile = mNeighbors[ WEST ]; x = last; }
+            break;
+        }
+
+        if ( tile == 0 )
+            return mRenderLevel;
+        if ( tile ->_isCut( x, z ) )
+            return coarsest;
+        return std::max( tile ->mRenderLevel, mRenderLevel );
+    }
+    //-----------------------------------------------------------------------
+    IndexData* OverhangTerrainRenderable::generateSeamIndexes(void)
+    {
+        int numIndexes = 0;
+        int quads = mOptions->tileSize - 1;
+        int step = 1 << mRenderLevel;
+        int block = 1 << ( mOptions->maxGeoMipMapLevel - 1 );
+
+        // Each block holds at most (block / step)^2 quads, and 2 * (block / step) 
+        // stitching tris per side
+        int span = block / step;
+        int new_length = ( quads / block ) * ( quads / block ) * ( span * span * 6 + 4 * span * 6 );
+
+        IndexData* indexData = new IndexData;
+        indexData->indexBuffer = 
+            HardwareBufferManager::getSingleton().createIndexBuffer(
+            HardwareIndexBuffer::IT_16BIT,
+            new_length, HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+
+        unsigned short* pIdx = static_cast<unsigned short*>(
+            indexData->indexBuffer->lock(0, 
+            indexData->indexBuffer->getSizeInBytes(), 
+            HardwareBuffer::HBL_DISCARD));
+
+        for ( int bj = 0; bj < quads; bj += block )
+        {
+            for ( int bi = 0; bi < quads; bi += block )
+            {
+                // Holes cover whole blocks
+                if ( !mHoles.empty() && _isHole( bi, bj ) )
+                    continue;
+
+                int northLOD = _getSeamLOD( NORTH, bi, bj );
+                int southLOD = _getSeamLOD( SOUTH, bi, bj );
+                int eastLOD = _getSeamLOD( EAST, bi, bj );
+                int westLOD = _getSeamLOD( WEST, bi, bj );
+
+                int north = northLOD > mRenderLevel ? step : 0;
+                int south = southLOD > mRenderLevel ? step : 0;
+                int east = eastLOD > mRenderLevel ? step : 0;
+                int west = westLOD > mRenderLevel ? step : 0;
+
+                // The core of the block, minus stitches
+                for ( int j = bj + north; j < bj + block - south; j += step )
+                {
+                    for ( int i = bi + west; i < bi + block - east; i += step )
+                    {
+                        *pIdx++ = _index( i, j ); numIndexes++;
+                        *pIdx++ = _index( i, j + step ); numIndexes++;
+                        *pIdx++ = _index( i + step, j ); numIndexes++;
+
+                        *pIdx++ = _index( i, j + step ); numIndexes++;
+                        *pIdx++ = _index( i + step, j + step ); numIndexes++;
+                        *pIdx++ = _index( i + step, j ); numIndexes++;
+                    }
+                }
+
+                if ( north > 0 )
+                    numIndexes += stitchEdge( *mOptions, NORTH, mRenderLevel, northLOD,
+                        west > 0, east > 0, &pIdx, bi, bj, block );
+                if ( east > 0 )
+                    numIndexes += stitchEdge( *mOptions, EAST, mRenderLevel, eastLOD,
+                        north > 0, south > 0, &pIdx, bi, bj, block );
+                if ( south > 0 )
+                    numIndexes += stitchEdge( *mOptions, SOUTH, mRenderLevel, southLOD,
+                        east > 0, west > 0, &pIdx, bi, bj, block );
+                if ( west > 0 )
+                    numIndexes += stitchEdge( *mOptions, WEST, mRenderLevel, westLOD,
+                        south > 0, north > 0, &pIdx, bi, bj, block );
+            }
+        }
+
         indexData->indexBuffer->unlock();
         indexData->indexCount = numIndexes;
         indexData->indexStart = 0;
@@ -1274,7 +2251,47 @@ namespace Ogre
         return indexData;
     }
     //-----------------------------------------------------------------------
-    HardwareVertexBufferSharedPtr OverhangTerrainRenderable::createDeltaBuffer(void)
+    bool OverhangTerrainRenderable::_snapToSeam( Vector3& position )
+    {
+        bool hidden = !getVisible();
+        if ( !hidden && mHoles.empty() )
+            return false;
+
+        int quads = mOptions->tileSize - 1;
+        int block = 1 << ( mOptions->maxGeoMipMapLevel - 1 );
+        Real u = ( position.x - _vertex( 0, 0, 0 ) ) / mOptions->scale.x;
+        Real w = ( position.z - _vertex( 0, 0, 2 ) ) / mOptions->scale.z;
+        if ( u < 0 || w < 0 || u > quads || w > quads )
+            return false;
+
+        // A seam runs along a grid line with a cut quad on one side only; quads 
+        // outside the tile are drawn by the neighbour, or by nobody
+        const Real eps = 1e-3;
+        int x = int( Math::Floor( u + 0.5 ) );
+        int z = int( Math::Floor( w + 0.5 ) );
+        int row = std::min( int( w ), quads - 1 );
+        int col = std::min( int( u ), quads - 1 );
+        bool alongZ = Math::Abs( u - x ) < eps && 
+            ( x > 0 && _isCut( x - 1, row ) ) != ( x < quads && _isCut( x, row ) );
+        bool alongX = !alongZ && Math::Abs( w - z ) < eps &&
+            ( z > 0 && _isCut( col, z - 1 ) ) != ( z < quads && _isCut( col, z ) );
+        if ( !alongZ && !alongX )
+            return false;
+
+        // Rims are drawn between the vertices of the coarsest LOD
+        Real t = alongZ ? w : u;
+        int start = std::min( int( t ) / block * block, quads - block );
+        Real h0 = alongZ ? _vertex( x, start, 1 ) : _vertex( start, z, 1 );
+        Real h1 = alongZ ? _vertex( x, start + block, 1 ) : _vertex( start + block, z, 1 );
+        Real height = h0 + ( h1 - h0 ) * ( t - start ) / block;
+
+        if ( Math::Abs( height - position.y ) > block * std::max( mOptions->scale.x, mOptions->scale.z ) )
+            return false;
+        position.y = height;
+        return true;
+    }
+    //-----------------------------------------------------------------------
+    HardwareVertexBufferSharedPtr OverhangTerrainRenderable::createDeltaBuffer(const float* deltas)
     {
         // Delta buffer is a 1D float buffer of height offsets
         HardwareVertexBufferSharedPtr buf = 
@@ -1282,10 +2299,7 @@ namespace Ogre
             VertexElement::getTypeSize(VET_FLOAT1), 
             mOptions->tileSize * mOptions->tileSize,
             HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-        // Fill the buffer with zeros, we will only fill in delta
-        void* pVoid = buf->lock(HardwareBuffer::HBL_DISCARD);
-        memset(pVoid, 0, mOptions->tileSize * mOptions->tileSize * sizeof(float));
-        buf->unlock();
+        buf->writeData(0, mOptions->tileSize * mOptions->tileSize * sizeof(float), deltas, true);
 
         return buf;
 
@@ -1300,6 +2314,10 @@ namespace Ogre
             // Update morph LOD factor
             params->_writeRawConstant(constantEntry.physicalIndex, mLODMorphFactor);
         }
+        else if (constantEntry.data == GRID_CUSTOM_PARAM_ID)
+        {
+            params->_writeRawConstant(constantEntry.physicalIndex, mGridOrigin);
+        }
         else
         {
             Renderable::_updateCustomGpuParameter(constantEntry, params);
@@ -1307,8 +2325,8 @@ namespace Ogre
 
     }
     //-----------------------------------------------------------------------
-    int OverhangTerrainRenderable::stitchEdge(Neighbor neighbor, int hiLOD, int loLOD, 
-        bool omitFirstTri, bool omitLastTri, unsigned short** ppIdx)
+    int OverhangTerrainRenderable::stitchEdge(const OverhangTerrainOptions& options, Neighbor neighbor, 
+        int hiLOD, int loLOD, bool omitFirstTri, bool omitLastTri, unsigned short** ppIdx, int x, int z, int span)
     {
         assert(loLOD > hiLOD);
         /* 
@@ -1351,6 +2369,9 @@ namespace Ogre
         // Step half way between low detail steps
         int halfsuperstep = superstep >> 1;
 
+        if ( span == 0 )
+            span = options.tileSize - 1;
+
         // Work out the starting points and sign of increments
         // We always work the strip clockwise
         int startx, starty, endx, rowstep;
@@ -1358,15 +2379,17 @@ namespace Ogre
         switch(neighbor)
         {
         case NORTH:
-            startx = starty = 0;
-            endx = mOptions->tileSize - 1;
+            startx = x;
+            starty = z;
+            endx = x + span;
             rowstep = step;
             horizontal = true;
             break;
         case SOUTH:
             // invert x AND y direction, helps to keep same winding
-            startx = starty = mOptions->tileSize - 1;
-            endx = 0;
+            startx = x + span;
+            starty = z + span;
+            endx = x;
             rowstep = -step;
             step = -step;
             superstep = -superstep;
@@ -1374,16 +2397,16 @@ namespace Ogre
             horizontal = true;
             break;
         case EAST:
-            startx = 0;
-            endx = mOptions->tileSize - 1;
-            starty = mOptions->tileSize - 1;
+            startx = z;
+            endx = z + span;
+            starty = x + span;
             rowstep = -step;
             horizontal = false;
             break;
         case WEST:
-            startx = mOptions->tileSize - 1;
-            endx = 0;
-            starty = 0;
+            startx = z + span;
+            endx = z;
+            starty = x;
             rowstep = step;
             step = -step;
             superstep = -superstep;
@@ -1405,15 +2428,15 @@ namespace Ogre
                 {
                     if (horizontal)
                     {
-                        *pIdx++ = _index( j , starty ); numIndexes++;
-                        *pIdx++ = _index( jk, starty + rowstep ); numIndexes++;
-                        *pIdx++ = _index( jk + step, starty + rowstep ); numIndexes++;
+                        *pIdx++ = _index( options, j , starty ); numIndexes++;
+                        *pIdx++ = _index( options, jk, starty + rowstep ); numIndexes++;
+                        *pIdx++ = _index( options, jk + step, starty + rowstep ); numIndexes++;
                     }
                     else
                     {
-                        *pIdx++ = _index( starty, j ); numIndexes++;
-                        *pIdx++ = _index( starty + rowstep, jk ); numIndexes++;
-                        *pIdx++ = _index( starty + rowstep, jk + step); numIndexes++;
+                        *pIdx++ = _index( options, starty, j ); numIndexes++;
+                        *pIdx++ = _index( options, starty + rowstep, jk ); numIndexes++;
+                        *pIdx++ = _index( options, starty + rowstep, jk + step); numIndexes++;
                     }
                 }
             }
@@ -1421,15 +2444,15 @@ namespace Ogre
             // Middle tri
             if (horizontal)
             {
-                *pIdx++ = _index( j, starty ); numIndexes++;
-                *pIdx++ = _index( j + halfsuperstep, starty + rowstep); numIndexes++;
-                *pIdx++ = _index( j + superstep, starty ); numIndexes++;
+                *pIdx++ = _index( options, j, starty ); numIndexes++;
+                *pIdx++ = _index( options, j + halfsuperstep, starty + rowstep); numIndexes++;
+                *pIdx++ = _index( options, j + superstep, starty ); numIndexes++;
             }
             else
             {
-                *pIdx++ = _index( starty, j ); numIndexes++;
-                *pIdx++ = _index( starty + rowstep, j + halfsuperstep ); numIndexes++;
-                *pIdx++ = _index( starty, j + superstep ); numIndexes++;
+                *pIdx++ = _index( options, starty, j ); numIndexes++;
+                *pIdx++ = _index( options, starty + rowstep, j + halfsuperstep ); numIndexes++;
+                *pIdx++ = _index( options, starty, j + superstep ); numIndexes++;
             }
 
             for (k = halfsuperstep; k != superstep; k += step)
@@ -1439,15 +2462,15 @@ namespace Ogre
                 {
                     if (horizontal)
                     {
-                        *pIdx++ = _index( j + superstep, starty ); numIndexes++;
-                        *pIdx++ = _index( jk, starty + rowstep ); numIndexes++;
-                        *pIdx++ = _index( jk + step, starty + rowstep ); numIndexes++;
+                        *pIdx++ = _index( options, j + superstep, starty ); numIndexes++;
+                        *pIdx++ = _index( options, jk, starty + rowstep ); numIndexes++;
+                        *pIdx++ = _index( options, jk + step, starty + rowstep ); numIndexes++;
                     }
                     else
                     {
-                        *pIdx++ = _index( starty, j + superstep ); numIndexes++;
-                        *pIdx++ = _index( starty + rowstep, jk ); numIndexes++;
-                        *pIdx++ = _index( starty + rowstep, jk + step ); numIndexes++;
+                        *pIdx++ = _index( options, starty, j + superstep ); numIndexes++;
+                        *pIdx++ = _index( options, starty + rowstep, jk ); numIndexes++;
+                        *pIdx++ = _index( options, starty + rowstep, jk + step ); numIndexes++;
                     }
                 }
             }
@@ -56,14 +56,34 @@ Hacked by Martin Enge (martin.enge@gmail.com) 2007 to fit into the OverhangTerra
 #include "OgreLogManager.h"
 #include "OgreResourceGroupManager.h"
 #include "OgreMaterialManager.h"
+#include "OgreRoot.h"
+#include "OgreTimer.h"
 #include "OverhangHeightmapTerrainPageSource.h"
+#include "OverhangTiledHeightmapTerrainPageSource.h"
+#include "OverhangNoiseTerrainPageSource.h"
+#include "ThreadPool.h"
+#include "OgreOctree.h"
 #include <fstream>
+#include <boost/bind/bind.hpp>
 
 #include "DataGrid.h"
 #include "IsoSurfaceBuilder.h"
 #include "MetaWorldFragment.h"
+#include "FragmentDensityFile.h"
+#include "FragmentMeshCache.h"
+#include "TerrainEditJournal.h"
+#include "IsoSurfaceRenderable.h"
+#include "IntersectionTests.h"
 
 #include "MetaBall.h"
+#include "MetaStroke.h"
+#include <cstdio>
+
+#if OGRE_DOUBLE_PRECISION == 0 && \
+	(defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#	define OVERHANG_TERRAIN_SSE2
+#	include <emmintrin.h>
+#endif
 
 #define TERRAIN_MATERIAL_NAME "OverhangTerrainSceneManager/Terrain"
 
@@ -88,9 +108,26 @@ namespace Ogre
         mPagingEnabled = false;
         mLivePageMargin = 0;
         mBufferedPageMargin = 0;
+        mThreadPool = 0;
+		mPrecomputeLevelIndexes = false;
+		mCompactVertices = false;
+		mLateLevelIndexes = 0;
+		mLateLevelIndexTime = 0;
 
 		mDataGrid = 0;
 		mIsoSurfaceBuilder = 0;
+		mFragmentDensityFile = 0;
+		mFragmentMeshCache = 0;
+		mEditJournal = 0;
+		mEditJournalSnapshotInterval = 0;
+		mSpilledBytes = 0;
+		mMemoryBudget = 0;
+		mPrefetchHorizon = 0;
+		mCameraVelocity = Vector3::ZERO;
+		mLastCameraTime = 0;
+		mCameraTracked = false;
+		mLastCameraPageX = mLastCameraPageZ = 0;
+		resetPrefetchStats();
 
     }
 	//-------------------------------------------------------------------------
@@ -105,6 +142,7 @@ namespace Ogre
 		// and not when statics are destroyed (may be too late)
 		mIndexCache.shutdown();
 		destroyLevelIndexes();
+		mGridBuffer.setNull();
 
 		// Make sure we free up material (static)
 		mOptions.terrainMaterial.setNull();
@@ -114,6 +152,20 @@ namespace Ogre
 		{
 			mActivePageSource->shutdown();
 		}
+		// ... which waits for its loader tasks
+		delete mThreadPool;
+		mThreadPool = 0;
+
+		// Closing syncs the last batch of journaled edits
+		delete mEditJournal;
+		mEditJournal = 0;
+		_clearSpilledTiles();
+
+		delete mFragmentDensityFile;
+		mFragmentDensityFile = 0;
+		MetaWorldFragment::setMeshCache(0);
+		delete mFragmentMeshCache;
+		mFragmentMeshCache = 0;
 
 	}
     //-------------------------------------------------------------------------
@@ -184,12 +236,26 @@ namespace Ogre
         if ( config.getSetting( "VertexColours" ) == "yes" )
             mOptions.coloured = true;
 
+        val = config.getSetting( "SunDirection" );
+        if ( !val.empty() )
+            mOptions.sunDirection = StringConverter::parseVector3( val ).normalisedCopy();
+
+        val = config.getSetting( "AmbientLight" );
+        if ( !val.empty() )
+            mOptions.ambientLight = StringConverter::parseColourValue( val );
+
         if ( config.getSetting( "VertexNormals" ) == "yes" )
             mOptions.lit = true;
 
         if ( config.getSetting( "UseTriStrips" ) == "yes" )
             setUseTriStrips(true);
 
+        if ( config.getSetting( "PrecomputeStitches" ) == "yes" )
+            setPrecomputeLevelIndexes(true);
+
+        if ( config.getSetting( "CompactVertices" ) == "yes" )
+            setUseCompactVertices(true);
+
         if ( config.getSetting( "VertexProgramMorph" ) == "yes" )
             setUseLODMorph(true);
 
@@ -209,6 +275,75 @@ namespace Ogre
         if ( !val.empty() )
             setCustomMaterialMorphFactorParam(atoi(val.c_str()));
 
+        val = config.getSetting( "MetaBakeThreshold" );
+        if ( !val.empty() )
+            setMetaBakeThreshold(atoi(val.c_str()));
+
+        mFragmentDensityFileName = config.getSetting( "FragmentDensityFile" );
+
+        mFragmentMeshCacheName = config.getSetting( "FragmentMeshCache" );
+
+        mPagingEnabled = config.getSetting( "Paging" ) == "yes";
+
+        val = config.getSetting( "LivePageMargin" );
+        if ( !val.empty() )
+            mLivePageMargin = atoi( val.c_str() );
+
+        val = config.getSetting( "BufferedPageMargin" );
+        if ( !val.empty() )
+            mBufferedPageMargin = atoi( val.c_str() );
+
+        // In megabytes
+        val = config.getSetting( "MemoryBudget" );
+        if ( !val.empty() )
+            setMemoryBudget(size_t(atof( val.c_str() ) * 1024 * 1024));
+
+        val = config.getSetting( "PrefetchHorizon" );
+        if ( !val.empty() )
+            setPrefetchHorizon(atof( val.c_str() ));
+
+        // The pool is created once and kept for the lifetime of the manager;
+        // leave the setting out for one thread less than there are cores
+        if (!mThreadPool)
+        {
+            val = config.getSetting( "WorkerThreads" );
+            if ( val.empty() || atoi( val.c_str() ) > 0 )
+            {
+                mThreadPool = new ThreadPool( val.empty() ? 0 : atoi( val.c_str() ) );
+                LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: " + 
+                    StringConverter::toString(mThreadPool->getNumThreads()) + " worker threads");
+            }
+        }
+
+        mEditJournalName = config.getSetting( "EditJournal" );
+        if ( !mEditJournalName.empty() )
+        {
+            mEditJournalSnapshotName = config.getSetting( "EditJournalSnapshot" );
+            if ( mEditJournalSnapshotName.empty() )
+                mEditJournalSnapshotName = mEditJournalName + ".snapshot";
+
+            if ( !mEditJournal )
+                mEditJournal = new TerrainEditJournal();
+            size_t syncRecords = 1;
+            unsigned long syncTime = 0;
+            val = config.getSetting( "EditJournalSyncBatch" );
+            if ( !val.empty() )
+                syncRecords = atoi(val.c_str());
+            val = config.getSetting( "EditJournalSyncTime" );
+            if ( !val.empty() )
+                syncTime = atoi(val.c_str());
+            mEditJournal->setSyncBatch(syncRecords, syncTime);
+
+            val = config.getSetting( "EditJournalSnapshotInterval" );
+            if ( !val.empty() )
+                setEditJournalSnapshotInterval(atoi(val.c_str()));
+        }
+        else
+        {
+            delete mEditJournal;
+            mEditJournal = 0;
+        }
+
         // Now scan through the remaining settings, looking for any PageSource
         // prefixed items
         String pageSourceName = config.getSetting("PageSource");
@@ -293,9 +428,16 @@ namespace Ogre
     {
     	if(!mDestRenderSystem) {
     		mCustomMaterialName = "";
+    		mOptions.compactVertices = false;
     		return;
     	}
 
+        // Only the built in vertex program knows how to put compact vertices together
+        mOptions.compactVertices = mCompactVertices && mOptions.lodMorph && mCustomMaterialName == "" &&
+            mDestRenderSystem->getCapabilities()->hasCapability(RSC_VERTEX_PROGRAM);
+        const String programName = mOptions.compactVertices ? 
+            "Terrain/VertexMorphCompact" : "Terrain/VertexMorph";
+
         if (mCustomMaterialName == "")
         {
             // define our own material
@@ -332,7 +474,7 @@ namespace Ogre
 
             if (mDestRenderSystem && mOptions.lodMorph &&
                 mDestRenderSystem->getCapabilities()->hasCapability(RSC_VERTEX_PROGRAM) &&
-				GpuProgramManager::getSingleton().getByName("Terrain/VertexMorph").isNull())
+				pass->getVertexProgramName() != programName)
             {
                 // Create & assign LOD morphing vertex program
                 String syntax;
@@ -348,14 +490,19 @@ namespace Ogre
                 // Get source, and take into account current fog mode
                 FogMode fm = getFogMode();
                 const String& source = TerrainVertexProgram::getProgramSource(
-                    fm, syntax);
+                    fm, syntax, false, mOptions.compactVertices);
 
-                GpuProgramPtr prog = GpuProgramManager::getSingleton().createProgramFromString(
-                    "Terrain/VertexMorph", ResourceGroupManager::getSingleton().getWorldResourceGroupName(), 
-                    source, GPT_VERTEX_PROGRAM, syntax);
+                // Left over from an earlier world if the vertex layout changed since
+                GpuProgramPtr prog = GpuProgramManager::getSingleton().getByName(programName);
+                if (prog.isNull())
+                {
+                    prog = GpuProgramManager::getSingleton().createProgramFromString(
+                        programName, ResourceGroupManager::getSingleton().getWorldResourceGroupName(), 
+                        source, GPT_VERTEX_PROGRAM, syntax);
+                }
 
                 // Attach
-                pass->setVertexProgram("Terrain/VertexMorph");
+                pass->setVertexProgram(programName);
 
                 // Get params
                 GpuProgramParametersSharedPtr params = pass->getVertexProgramParameters();
@@ -372,16 +519,23 @@ namespace Ogre
                     // Set to linear and we derive [0,1] fog value in the shader
                     pass->setFog(true, FOG_LINEAR, getFogColour(), 0, 1, 0);
                 }
+                // tile origin (if relevant)
+                if (mOptions.compactVertices)
+                    params->setAutoConstant(8, GpuProgramParameters::ACT_CUSTOM, GRID_CUSTOM_PARAM_ID);
 
 				// Also set shadow receiver program
 				const String& source2 = TerrainVertexProgram::getProgramSource(
-					fm, syntax, true);
+					fm, syntax, true, mOptions.compactVertices);
 
-				prog = GpuProgramManager::getSingleton().createProgramFromString(
-					"Terrain/VertexMorphShadowReceive", 
-					ResourceGroupManager::getSingleton().getWorldResourceGroupName(), 
-					source2, GPT_VERTEX_PROGRAM, syntax);
-				pass->setShadowReceiverVertexProgram("Terrain/VertexMorphShadowReceive");
+				prog = GpuProgramManager::getSingleton().getByName(programName + "ShadowReceive");
+				if (prog.isNull())
+				{
+					prog = GpuProgramManager::getSingleton().createProgramFromString(
+						programName + "ShadowReceive", 
+						ResourceGroupManager::getSingleton().getWorldResourceGroupName(), 
+						source2, GPT_VERTEX_PROGRAM, syntax);
+				}
+				pass->setShadowReceiverVertexProgram(programName + "ShadowReceive");
 				params = pass->getShadowReceiverVertexProgramParameters();
 				// worldviewproj
 				params->setAutoConstant(0, GpuProgramParameters::ACT_WORLDVIEWPROJ_MATRIX);
@@ -391,6 +545,9 @@ namespace Ogre
 				params->setAutoConstant(8, GpuProgramParameters::ACT_TEXTURE_VIEWPROJ_MATRIX);
 				// morph factor
 				params->setAutoConstant(12, GpuProgramParameters::ACT_CUSTOM, MORPH_CUSTOM_PARAM_ID);
+				// tile origin (if relevant)
+				if (mOptions.compactVertices)
+					params->setAutoConstant(14, GpuProgramParameters::ACT_CUSTOM, GRID_CUSTOM_PARAM_ID);
 
 
                 // Set param index
@@ -398,6 +555,19 @@ namespace Ogre
                 mLodMorphParamIndex = 4;
             }
 
+            // Without the program the tiles would draw the bare grid as their positions
+            if (mOptions.compactVertices && !pass->hasVertexProgram())
+                mOptions.compactVertices = false;
+            if (mOptions.compactVertices)
+            {
+                // Scale of the shared grid, set each time as it follows the world
+                Vector4 gridScale(mOptions.scale.x, mOptions.scale.z, 
+                    1.0f / (mOptions.pageSize - 1), 1.0f / (mOptions.pageSize - 1));
+                pass->getVertexProgramParameters()->setConstant(9, gridScale);
+                if (pass->hasShadowReceiverVertexProgram())
+                    pass->getShadowReceiverVertexProgramParameters()->setConstant(15, gridScale);
+            }
+
             mOptions.terrainMaterial->load();
 
         }
@@ -514,7 +684,11 @@ namespace Ogre
                 ResourceGroupManager::getSingleton().getWorldResourceGroupName());
         }
 		destroyLevelIndexes();
+		mGridBuffer.setNull();
         mTerrainPages.clear();
+        _clearSpilledTiles();
+        mPrefetchedPages.clear();
+        mCameraTracked = false;
         // Load the configuration
         loadConfig(stream);
 		initLevelIndexes();
@@ -542,6 +716,14 @@ namespace Ogre
 		mIsoSurfaceBuilder = new IsoSurfaceBuilder();
 		mIsoSurfaceBuilder->initialize(mDataGrid, IsoSurfaceBuilder::GEN_NORMALS);//IsoSurfaceBuilder::GEN_NORMALS | IsoSurfaceBuilder::GEN_TEX_COORDS);
 		mIsoSurfaceBuilder->setFlipNormals(false);
+
+		// The mesh cache goes first, so restored fragments can use it
+		if (!mFragmentMeshCacheName.empty())
+			loadFragmentMeshCache(mFragmentMeshCacheName);
+		if (mEditJournal)
+			_recoverTerrainEdits();
+		else if (!mFragmentDensityFileName.empty())
+			loadFragmentDensities(mFragmentDensityFileName);
     }
     //-------------------------------------------------------------------------
     void OverhangTerrainSceneManager::clearScene(void)
@@ -549,32 +731,336 @@ namespace Ogre
         OctreeSceneManager::clearScene();
         mTerrainPages.clear();
 		destroyLevelIndexes();
+		mGridBuffer.setNull();
         // Octree has destroyed our root
         mTerrainRoot = 0;
     }
     //-------------------------------------------------------------------------
     void OverhangTerrainSceneManager::_renderScene(Camera* cam, Viewport *vp, bool includeOverlays)
     {
-        // For now, no paging and expect immediate response
-        if (!mTerrainPages.empty() && mTerrainPages[0][0] == 0)
+        if (mPagingEnabled)
+        {
+            _updatePaging(cam);
+        }
+        // Without paging, expect immediate response
+        else if (!mTerrainPages.empty() && mTerrainPages[0][0] == 0)
         {
             mActivePageSource->requestPage(0, 0);
         }
+        // The last edits of a burst reach the disk even if no further edit follows
+        if (mEditJournal && mEditJournal->isOpen())
+        {
+            mEditJournal->syncIfDue();
+        }
         SceneManager::_renderScene(cam, vp, includeOverlays);
 
     }
     //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::_updatePaging(Camera* cam)
+    {
+        if (!mActivePageSource)
+            return;
+
+        // Attach what the loader threads finished since the last frame
+        mActivePageSource->processPendingPages();
+
+        // Page around the camera used for LOD, if there is one
+        const Camera* c = mOptions.primaryCamera ? mOptions.primaryCamera : cam;
+        const Vector3& pos = c->getDerivedPosition();
+        int camX = static_cast<int>(Math::Floor(pos.x / (mOptions.scale.x * (mOptions.pageSize - 1))));
+        int camZ = static_cast<int>(Math::Floor(pos.z / (mOptions.scale.z * (mOptions.pageSize - 1))));
+        _updatePrefetchStats(camX, camZ);
+
+        // The source ignores pages it is already loading or does not have
+        for (int z = camZ - mLivePageMargin; z <= camZ + mLivePageMargin; ++z)
+        {
+            for (int x = camX - mLivePageMargin; x <= camX + mLivePageMargin; ++x)
+            {
+                if (x >= 0 && z >= 0 && x <= 0xFFFF && z <= 0xFFFF && !_getPage(x, z))
+                    mActivePageSource->requestPage(static_cast<ushort>(x), static_cast<ushort>(z));
+            }
+        }
+
+        _prefetchPages(pos);
+
+        if (mMemoryBudget)
+            _evictPages(camX, camZ);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::_updatePrefetchStats(int camPageX, int camPageZ)
+    {
+        if (mCameraTracked && (camPageX != mLastCameraPageX || camPageZ != mLastCameraPageZ))
+        {
+            int margin = mLivePageMargin;
+            for (int z = camPageZ - margin; z <= camPageZ + margin; ++z)
+            {
+                for (int x = camPageX - margin; x <= camPageX + margin; ++x)
+                {
+                    // Only pages entering the live margin
+                    if (std::abs(x - mLastCameraPageX) <= margin && std::abs(z - mLastCameraPageZ) <= margin)
+                        continue;
+                    if (x < 0 || z < 0 || x > 0xFFFF || z > 0xFFFF || 
+                        !mActivePageSource->hasPage(ushort(x), ushort(z)))
+                        continue;
+                    if (_getPage(x, z))
+                        ++mPrefetchStats.hits;
+                    else
+                        ++mPrefetchStats.misses;
+                }
+            }
+        }
+        mLastCameraPageX = camPageX;
+        mLastCameraPageZ = camPageZ;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::_prefetchPages(const Vector3& cameraPosition)
+    {
+        unsigned long now = Root::getSingleton().getTimer()->getMilliseconds();
+        if (mCameraTracked && now > mLastCameraTime)
+        {
+            // Smooth out the frame to frame jitter
+            Vector3 velocity = (cameraPosition - mLastCameraPosition) / ((now - mLastCameraTime) * 0.001f);
+            mCameraVelocity = mCameraVelocity * 0.75f + velocity * 0.25f;
+        }
+        mLastCameraPosition = cameraPosition;
+        mLastCameraTime = now;
+        mCameraTracked = true;
+
+        Real pageWorldX = mOptions.scale.x * (mOptions.pageSize - 1);
+        Real pageWorldZ = mOptions.scale.z * (mOptions.pageSize - 1);
+        Real speed = Math::Sqrt(mCameraVelocity.x * mCameraVelocity.x + mCameraVelocity.z * mCameraVelocity.z);
+        // Loading on the main thread, prefetching would just move the stall
+        if (mPrefetchHorizon <= 0 || !mThreadPool || 
+            speed * mPrefetchHorizon < 0.5f * std::min(pageWorldX, pageWorldZ))
+            return;
+
+        // Sample the path every half page, so the pages are requested in the order 
+        // the camera reaches them
+        static const int MAX_SAMPLES = 64;
+        Real step = 0.5f * std::min(pageWorldX, pageWorldZ) / speed;
+        step = std::max(step, mPrefetchHorizon / MAX_SAMPLES);
+        int margin = mLivePageMargin;
+        size_t tilesPerSide = (mOptions.pageSize - 1) / (mOptions.tileSize - 1);
+        for (Real t = step; t <= mPrefetchHorizon; t += step)
+        {
+            Vector3 p = cameraPosition + mCameraVelocity * t;
+            int px = static_cast<int>(Math::Floor(p.x / pageWorldX));
+            int pz = static_cast<int>(Math::Floor(p.z / pageWorldZ));
+            for (int z = pz - margin; z <= pz + margin; ++z)
+            {
+                for (int x = px - margin; x <= px + margin; ++x)
+                {
+                    if (x < 0 || z < 0 || x > 0xFFFF || z > 0xFFFF || _getPage(x, z) ||
+                        !mActivePageSource->hasPage(ushort(x), ushort(z)))
+                        continue;
+                    std::pair<ushort, ushort> key(ushort(x), ushort(z));
+                    if (!mPrefetchedPages.insert(key).second)
+                        continue;
+
+                    mActivePageSource->requestPage(key.first, key.second);
+                    ++mPrefetchStats.pagesPrefetched;
+                    // The fragments are restored from the density file once the page is attached
+                    if (mFragmentDensityFile && mFragmentDensityFile->isOpen())
+                    {
+                        for (size_t j = 0; j < tilesPerSide; ++j)
+                            for (size_t i = 0; i < tilesPerSide; ++i)
+                                if (mFragmentDensityFile->prefetchFragments(int(x*tilesPerSide + i), int(z*tilesPerSide + j)))
+                                    ++mPrefetchStats.tilesPrefetched;
+                    }
+                    // ... and their meshes looked up in the cache when they are built
+                    if (mFragmentMeshCache && mFragmentMeshCache->isOpen())
+                    {
+                        mPrefetchStats.meshesPrefetched += mFragmentMeshCache->prefetchMeshes(int(x*tilesPerSide), 
+                            int(z*tilesPerSide), int((x + 1)*tilesPerSide) - 1, int((z + 1)*tilesPerSide) - 1);
+                    }
+                }
+            }
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setPrefetchHorizon(Real seconds)
+    {
+        mPrefetchHorizon = seconds;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::resetPrefetchStats(void)
+    {
+        mPrefetchStats.pagesPrefetched = 0;
+        mPrefetchStats.tilesPrefetched = 0;
+        mPrefetchStats.meshesPrefetched = 0;
+        mPrefetchStats.hits = 0;
+        mPrefetchStats.misses = 0;
+    }
+    //-------------------------------------------------------------------------
+    namespace
+    {
+        /// Next number of a linear congruential sequence, in [0, 1)
+        inline Real lcgRandom(uint32& state)
+        {
+            state = state * 1664525 + 1013904223;
+            return (state >> 8) / Real(1 << 24);
+        }
+
+        struct EvictionCandidate
+        {
+            unsigned long lastVisibleFrame;
+            size_t bytes;
+            ushort pageX, pageZ;
+        };
+        bool leastRecentlyVisible(const EvictionCandidate& a, const EvictionCandidate& b)
+        {
+            return a.lastVisibleFrame < b.lastVisibleFrame;
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::_evictPages(int camPageX, int camPageZ)
+    {
+        size_t usage = mSpilledBytes;
+        std::vector<EvictionCandidate> candidates;
+        for (size_t x = 0; x < mTerrainPages.size(); ++x)
+        {
+            for (size_t z = 0; z < mTerrainPages[x].size(); ++z)
+            {
+                OverhangTerrainPage* page = mTerrainPages[x][z];
+                if (!page)
+                    continue;
+                EvictionCandidate c;
+                c.bytes = page->getMemoryUsage();
+                usage += c.bytes;
+                // Pages within the live margin would be requested again right away
+                if (std::abs(int(x) - camPageX) <= mLivePageMargin && 
+                    std::abs(int(z) - camPageZ) <= mLivePageMargin)
+                    continue;
+                c.lastVisibleFrame = page->getLastVisibleFrame();
+                c.pageX = ushort(x);
+                c.pageZ = ushort(z);
+                candidates.push_back(c);
+            }
+        }
+        if (usage <= mMemoryBudget)
+            return;
+
+        std::sort(candidates.begin(), candidates.end(), leastRecentlyVisible);
+        for (size_t i = 0; i < candidates.size() && usage > mMemoryBudget; ++i)
+        {
+            size_t spilled = mSpilledBytes;
+            detachPage(candidates[i].pageX, candidates[i].pageZ);
+            usage = usage - candidates[i].bytes + (mSpilledBytes - spilled);
+        }
+        if (usage > mMemoryBudget)
+        {
+            LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Terrain needs " + 
+                StringConverter::toString(usage) + " bytes, more than the memory budget of " +
+                StringConverter::toString(mMemoryBudget));
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::detachPage(ushort pageX, ushort pageZ)
+    {
+        OverhangTerrainPage* page = _getPage(pageX, pageZ);
+        if (!page)
+            return;
+
+        // Edits must outlive the page
+        _spillFragments(page);
+
+        static const TerrainTile::Neighbor sides[4] = 
+            { TerrainTile::NORTH, TerrainTile::SOUTH, TerrainTile::EAST, TerrainTile::WEST };
+        for (int s = 0; s < 4; ++s)
+            page->linkNeighbourPage(sides[s], 0);
+        mTerrainPages[pageX][pageZ] = 0;
+
+        // Tile and fragment nodes are created again when the page is loaded
+        page->pageSceneNode->removeAndDestroyAllChildren();
+        destroySceneNode(page->pageSceneNode->getName());
+        page->pageSceneNode = 0;
+
+        mActivePageSource->expirePage(pageX, pageZ);
+    }
+    //-------------------------------------------------------------------------
+    size_t OverhangTerrainSceneManager::getMemoryUsage(void) const
+    {
+        size_t usage = mSpilledBytes;
+        for (OverhangTerrainPage2D::const_iterator pi = mTerrainPages.begin(); pi != mTerrainPages.end(); ++pi)
+        {
+            for (OverhangTerrainPageRow::const_iterator ri = pi->begin(); ri != pi->end(); ++ri)
+            {
+                if (*ri)
+                    usage += (*ri)->getMemoryUsage();
+            }
+        }
+        return usage;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setMemoryBudget(size_t bytes)
+    {
+        mMemoryBudget = bytes;
+    }
+    //-------------------------------------------------------------------------
+    OverhangTerrainPage* OverhangTerrainSceneManager::_getPage(int pageX, int pageZ) const
+    {
+        if (pageX < 0 || pageZ < 0 || pageX >= (int)mTerrainPages.size() || 
+            pageZ >= (int)mTerrainPages[pageX].size())
+            return 0;
+        return mTerrainPages[pageX][pageZ];
+    }
+    //-------------------------------------------------------------------------
     void OverhangTerrainSceneManager::attachPage(ushort pageX, ushort pageZ, OverhangTerrainPage* page)
     {
-        assert(pageX == 0 && pageZ == 0 && "Multiple pages not yet supported");
+        // Grow the page grid to hold the new page
+        size_t cols = mTerrainPages.empty() ? 0 : mTerrainPages[0].size();
+        cols = std::max(cols, (size_t)pageZ + 1);
+        if (mTerrainPages.size() <= pageX)
+            mTerrainPages.resize(pageX + 1);
+        for (OverhangTerrainPage2D::iterator pi = mTerrainPages.begin(); pi != mTerrainPages.end(); ++pi)
+            pi->resize(cols, 0);
 
         assert(mTerrainPages[pageX][pageZ] == 0 && "Page at that index not yet expired!");
         // Insert page into list
         mTerrainPages[pageX][pageZ] = page;
+        mPrefetchedPages.erase(std::make_pair(pageX, pageZ));
         // Attach page to terrain root
 		if (page->pageSceneNode->getParentSceneNode() != mTerrainRoot)
 			mTerrainRoot->addChild(page->pageSceneNode);
 
+        // Stitch the page to those around it; their edge normals change too
+        static const TerrainTile::Neighbor sides[4] = 
+            { TerrainTile::NORTH, TerrainTile::SOUTH, TerrainTile::EAST, TerrainTile::WEST };
+        static const TerrainTile::Neighbor opposite[4] = 
+            { TerrainTile::SOUTH, TerrainTile::NORTH, TerrainTile::WEST, TerrainTile::EAST };
+        static const int offsetX[4] = { 0, 0, 1, -1 };
+        static const int offsetZ[4] = { -1, 1, 0, 0 };
+        for (int s = 0; s < 4; ++s)
+        {
+            OverhangTerrainPage* other = _getPage(pageX + offsetX[s], pageZ + offsetZ[s]);
+            if (!other)
+                continue;
+            page->linkNeighbourPage(sides[s], other);
+            if (mOptions.lit)
+            {
+                page->calculateEdgeNormals(sides[s]);
+                other->calculateEdgeNormals(opposite[s]);
+            }
+        }
+
+        // Make sure the octree covers the page
+        Real pageWorldX = mOptions.scale.x * (mOptions.pageSize - 1);
+        Real pageWorldZ = mOptions.scale.z * (mOptions.pageSize - 1);
+        AxisAlignedBox box(pageX * pageWorldX, 0, pageZ * pageWorldZ, 
+            (pageX + 1) * pageWorldX, mOptions.scale.y, (pageZ + 1) * pageWorldZ);
+        if (!mOctree->mBox.contains(box))
+        {
+            box.merge(mOctree->mBox);
+            resize(box);
+        }
+
+		// Page in stored edits of the new tiles, or those kept when it was evicted or
+		// edited before it arrived. Heights first, fragments are stored with them in place.
+		_restoreHeights(page);
+		if (mFragmentDensityFile)
+			_loadFragmentDensities(page);
+		_restoreSpilledFragments(page);
+
     }
     //-------------------------------------------------------------------------
     void OverhangTerrainSceneManager::_renderVisibleObjects( void )
@@ -607,12 +1093,78 @@ namespace Ogre
 
     }
     //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::getHeightsAt( const float* x, const float* z, float* heights, size_t count )
+    {
+        std::vector<size_t> order;
+        std::vector<TileBin> bins;
+        _binByTile( x, z, count, order, bins );
+
+        std::vector<float> bx, bz, bh;
+        for ( std::vector<TileBin>::iterator it = bins.begin(); it != bins.end(); ++it )
+        {
+            const size_t* points = &order[ it->first ];
+            if ( !it->tile )
+            {
+                for ( size_t i = 0; i < it->count; ++i )
+                    heights[ points[ i ] ] = -1;
+                continue;
+            }
+
+            // Gather the points of the tile, so the sampling loop runs over contiguous arrays
+            bx.resize( it->count );
+            bz.resize( it->count );
+            bh.resize( it->count );
+            for ( size_t i = 0; i < it->count; ++i )
+            {
+                bx[ i ] = x[ points[ i ] ];
+                bz[ i ] = z[ points[ i ] ];
+            }
+            it->tile->getTerrainRenderable()->getHeightsAt( &bx[ 0 ], &bz[ 0 ], &bh[ 0 ], it->count );
+            for ( size_t i = 0; i < it->count; ++i )
+                heights[ points[ i ] ] = bh[ i ];
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::getNormalsAt( const float* x, const float* z, Vector3* normals, size_t count )
+    {
+        std::vector<size_t> order;
+        std::vector<TileBin> bins;
+        _binByTile( x, z, count, order, bins );
+
+        std::vector<float> bx, bz;
+        std::vector<Vector3> bn;
+        for ( std::vector<TileBin>::iterator it = bins.begin(); it != bins.end(); ++it )
+        {
+            const size_t* points = &order[ it->first ];
+            if ( !it->tile )
+            {
+                for ( size_t i = 0; i < it->count; ++i )
+                    normals[ points[ i ] ] = Vector3::ZERO;
+                continue;
+            }
+
+            bx.resize( it->count );
+            bz.resize( it->count );
+            bn.resize( it->count );
+            for ( size_t i = 0; i < it->count; ++i )
+            {
+                bx[ i ] = x[ points[ i ] ];
+                bz[ i ] = z[ points[ i ] ];
+            }
+            it->tile->getTerrainRenderable()->getNormalsAt( &bx[ 0 ], &bz[ 0 ], &bn[ 0 ], it->count );
+            for ( size_t i = 0; i < it->count; ++i )
+                normals[ points[ i ] ] = bn[ i ];
+        }
+    }
+    //-------------------------------------------------------------------------
     OverhangTerrainPage* OverhangTerrainSceneManager::getTerrainPage( const Vector3 & pt )
     {
         if (mPagingEnabled)
         {
-            // TODO
-            return 0;
+            if (pt.x < 0 || pt.z < 0)
+                return 0;
+            return _getPage(static_cast<int>(pt.x / (mOptions.scale.x * (mOptions.pageSize - 1))), 
+                static_cast<int>(pt.z / (mOptions.scale.z * (mOptions.pageSize - 1))));
         }
         else
         {
@@ -646,63 +1198,416 @@ namespace Ogre
         return t -> intersectSegment( start, end, result );
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setUseTriStrips(bool useStrips)
-    {
-        mOptions.useTriStrips = useStrips;
-    }
-    //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setUseLODMorph(bool morph)
+    bool OverhangTerrainSceneManager::intersectFragments( const Vector3 & start, 
+        const Vector3 & end, Vector3 * result )
     {
-        // Set true only if vertex programs are supported
-    	if(mDestRenderSystem)
-    		mOptions.lodMorph = morph &&
-				mDestRenderSystem->getCapabilities()->hasCapability(RSC_VERTEX_PROGRAM);
+        Vector3 dir = end - start;
+        Real best = dir.normalise();
+        bool hit = false;
+
+        // Only the part of the segment over the page grid can pass any tile
+        Real tileScale = mOptions.scale.x * ( mOptions.tileSize - 1 );
+        Real worldX = mTerrainPages.size() * mOptions.scale.x * ( mOptions.pageSize - 1 );
+        Real worldZ = mTerrainPages.empty() ? 0 : mTerrainPages[ 0 ].size() * mOptions.scale.x * ( mOptions.pageSize - 1 );
+        Real ta = 0, tb = best;
+        if ( !IntersectionTests::clipSlab( start.x, dir.x, 0, worldX, ta, tb ) ||
+            !IntersectionTests::clipSlab( start.z, dir.z, 0, worldZ, ta, tb ) )
+        {
+            return false;
+        }
+
+        // Walk the tile columns the segment crosses in order. Fragments stay within the 
+        // column of their tile, so no column after the first hit can hold a nearer one.
+        Vector3 entry = start + dir * ta;
+        int x = int( Math::Floor( entry.x / tileScale ) ), z = int( Math::Floor( entry.z / tileScale ) );
+        int stepX = dir.x > 0 ? 1 : -1, stepZ = dir.z > 0 ? 1 : -1;
+        Real nextX = dir.x != 0 ? ( ( x + ( stepX > 0 ? 1 : 0 ) ) * tileScale - start.x ) / dir.x : Math::POS_INFINITY;
+        Real nextZ = dir.z != 0 ? ( ( z + ( stepZ > 0 ? 1 : 0 ) ) * tileScale - start.z ) / dir.z : Math::POS_INFINITY;
+        Real deltaX = dir.x != 0 ? tileScale / Math::Abs( dir.x ) : Math::POS_INFINITY;
+        Real deltaZ = dir.z != 0 ? tileScale / Math::Abs( dir.z ) : Math::POS_INFINITY;
+        for ( Real enter = ta; enter <= tb && enter <= best; )
+        {
+            TerrainTile* tile = getTerrainTile( Vector3( tileScale * ( x + 0.5f ), 0, tileScale * ( z + 0.5f ) ) );
+            Real t;
+            if ( tile && !tile->getMetaWorldFragments().empty() && tile->intersectFragments( start, dir, best, t ) )
+            {
+                best = t;
+                hit = true;
+            }
+            if ( nextX < nextZ )
+            {
+                enter = nextX;
+                nextX += deltaX;
+                x += stepX;
+            }
+            else
+            {
+                enter = nextZ;
+                nextZ += deltaZ;
+                z += stepZ;
+            }
+        }
+        if ( hit && result != 0 )
+            * result = start + dir * best;
+        return hit;
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setUseVertexNormals(bool useNormals)
+    size_t OverhangTerrainSceneManager::castTerrainRays( const Vector3* origins, const Vector3* directions, 
+        size_t numRays, Real* distances, Vector3* points, bool fragments, Real maxDistance )
     {
-        mOptions.lit = useNormals;
+        if ( numRays == 0 )
+            return 0;
+
+        if ( fragments )
+            _updateFragmentBVHs();
+
+        if ( mThreadPool )
+        {
+            mThreadPool->parallelFor( 0, numRays, boost::bind( &OverhangTerrainSceneManager::_castTerrainRays, 
+                this, origins, directions, distances, points, fragments, maxDistance, 
+                boost::placeholders::_1, boost::placeholders::_2 ), 64 );
+        }
+        else
+        {
+            _castTerrainRays( origins, directions, distances, points, fragments, maxDistance, 0, numRays );
+        }
+
+        size_t hits = 0;
+        for ( size_t i = 0; i < numRays; ++i )
+        {
+            if ( distances[ i ] >= 0 )
+                ++hits;
+        }
+        return hits;
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setUseVertexColours(bool useColours)
+    void OverhangTerrainSceneManager::_updateFragmentBVHs()
     {
-        mOptions.coloured = useColours;
+        // The BVHs are rebuilt lazily, which must not happen in several workers at once
+        for ( OverhangTerrainPage2D::iterator pi = mTerrainPages.begin(); pi != mTerrainPages.end(); ++pi )
+        {
+            for ( OverhangTerrainPageRow::iterator ri = pi->begin(); ri != pi->end(); ++ri )
+            {
+                OverhangTerrainPage* page = *ri;
+                if ( !page )
+                    continue;
+                for ( size_t j = 0; j < page->tilesPerPage; ++j )
+                {
+                    for ( size_t i = 0; i < page->tilesPerPage; ++i )
+                    {
+                        std::vector<IsoSurfaceRenderable*>& surfaces = page->tiles[ i ][ j ]->getMetaWorldRenderables();
+                        for ( std::vector<IsoSurfaceRenderable*>::iterator it = surfaces.begin(); it != surfaces.end(); ++it )
+                            ( *it )->updateBVH();
+                    }
+                }
+            }
+        }
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setWorldTexture(const String& textureName)
+    bool OverhangTerrainSceneManager::sweepCapsule( const Vector3& start, const Vector3& end, 
+        const Vector3& axis, Real radius, Real& distance, Vector3& normal )
     {
-        mWorldTextureName = textureName;
+        Vector3 dir = end - start;
+        Real best = dir.normalise();
+        IntersectionTests::Sweep sweep( start, dir, axis, radius );
+
+        // The tiles under the bounds of the shape at start and end
+        Vector3 lo = start, hi = start;
+        lo.makeFloor( end );
+        hi.makeCeil( end );
+        lo -= sweep.growHi;
+        hi -= sweep.growLo;
+        int minTileX, minTileZ, maxTileX, maxTileZ;
+        _getTileIndex( lo, minTileX, minTileZ );
+        _getTileIndex( hi, maxTileX, maxTileZ );
+        minTileX = std::max( minTileX, 0 );
+        minTileZ = std::max( minTileZ, 0 );
+
+        Real scale = mOptions.scale.x * ( mOptions.tileSize - 1 );
+        bool hit = false;
+        for ( int z = minTileZ; z <= maxTileZ; ++z )
+        {
+            for ( int x = minTileX; x <= maxTileX; ++x )
+            {
+                TerrainTile* tile = getTerrainTile( Vector3( scale * ( x + 0.5f ), 0, scale * ( z + 0.5f ) ) );
+                if ( !tile )
+                    continue;
+                if ( tile->getTerrainRenderable()->sweep( sweep, best, best, normal ) )
+                    hit = true;
+                if ( tile->sweepFragments( sweep, best, best, normal ) )
+                    hit = true;
+            }
+        }
+        if ( hit )
+            distance = best;
+        return hit;
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setDetailTexture(const String& textureName)
+    size_t OverhangTerrainSceneManager::sweepCapsules( const Vector3* starts, const Vector3* ends, 
+        size_t count, const Vector3& axis, Real radius, Real* distances, Vector3* normals )
     {
-        mDetailTextureName = textureName;
+        if ( count == 0 )
+            return 0;
 
+        _updateFragmentBVHs();
+        if ( mThreadPool )
+        {
+            mThreadPool->parallelFor( 0, count, boost::bind( &OverhangTerrainSceneManager::_sweepCapsules, 
+                this, starts, ends, axis, radius, distances, normals, 
+                boost::placeholders::_1, boost::placeholders::_2 ), 16 );
+        }
+        else
+        {
+            _sweepCapsules( starts, ends, axis, radius, distances, normals, 0, count );
+        }
+
+        size_t hits = 0;
+        for ( size_t i = 0; i < count; ++i )
+        {
+            if ( distances[ i ] >= 0 )
+                ++hits;
+        }
+        return hits;
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setDetailTextureRepeat(int repeat)
-    {
-        mOptions.detailTile = repeat;
-    }
-    //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setTileSize(int size) 
+    void OverhangTerrainSceneManager::_sweepCapsules( const Vector3* starts, const Vector3* ends, 
+        const Vector3& axis, Real radius, Real* distances, Vector3* normals, size_t begin, size_t end )
     {
-        mOptions.tileSize = size;
+        for ( size_t i = begin; i < end; ++i )
+        {
+            Vector3 normal = Vector3::ZERO;
+            if ( !sweepCapsule( starts[ i ], ends[ i ], axis, radius, distances[ i ], normal ) )
+                distances[ i ] = -1;
+            if ( normals )
+                normals[ i ] = normal;
+        }
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setPageSize(int size)
+    namespace
     {
-        mOptions.pageSize = size;
+        /// Normalises the directions of a ray packet as Vector3::normalise does, four at once with SSE2
+        void normalisePacket(Vector3* dirs, int count)
+        {
+            int i = 0;
+#ifdef OVERHANG_TERRAIN_SSE2
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 x = _mm_setr_ps(dirs[i].x, dirs[i + 1].x, dirs[i + 2].x, dirs[i + 3].x);
+                __m128 y = _mm_setr_ps(dirs[i].y, dirs[i + 1].y, dirs[i + 2].y, dirs[i + 3].y);
+                __m128 z = _mm_setr_ps(dirs[i].z, dirs[i + 1].z, dirs[i + 2].z, dirs[i + 3].z);
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+
+                // Directions too short to normalise are left alone
+                __m128 valid = _mm_cmpgt_ps(length, _mm_set1_ps(1e-08f));
+                __m128 scale = _mm_div_ps(_mm_set1_ps(1.0f), length);
+                scale = _mm_or_ps(_mm_and_ps(valid, scale), _mm_andnot_ps(valid, _mm_set1_ps(1.0f)));
+
+                float out[3][4];
+                _mm_storeu_ps(out[0], _mm_mul_ps(x, scale));
+                _mm_storeu_ps(out[1], _mm_mul_ps(y, scale));
+                _mm_storeu_ps(out[2], _mm_mul_ps(z, scale));
+                for (int k = 0; k < 4; ++k)
+                    dirs[i + k] = Vector3(out[0][k], out[1][k], out[2][k]);
+            }
+#endif
+            // Remainder, or everything without SSE2
+            for (; i < count; ++i)
+                dirs[i].normalise();
+        }
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setMaxPixelError(int pixelError) 
+    void OverhangTerrainSceneManager::_castTerrainRays( const Vector3* origins, const Vector3* directions, 
+        Real* distances, Vector3* points, bool fragments, Real maxDistance, size_t begin, size_t end )
     {
-        mOptions.maxPixelError = pixelError;
+        const int packetSize = OverhangTerrainRenderable::RAY_PACKET_SIZE;
+        Vector3 starts[ packetSize ], dirs[ packetSize ];
+        Real lengths[ packetSize ], t[ packetSize ];
+
+        size_t i = begin;
+        TerrainTile* next = i < end ? getTerrainTile( origins[ i ] ) : 0;
+        while ( i < end )
+        {
+            // Take up to a packet of the following rays starting on the same tile
+            TerrainTile* tile = next;
+            int count = 0;
+            do
+            {
+                starts[ count ] = origins[ i + count ];
+                dirs[ count ] = directions[ i + count ];
+                lengths[ count ] = maxDistance;
+                t[ count ] = -1;
+                ++count;
+                next = i + count < end ? getTerrainTile( origins[ i + count ] ) : 0;
+            }
+            while ( count < packetSize && i + count < end && next == tile );
+            normalisePacket( dirs, count );
+
+            if ( tile )
+                tile->getTerrainRenderable()->intersectSegments( count, starts, dirs, lengths, t );
+
+            for ( int k = 0; k < count; ++k, ++i )
+            {
+                // Caves and overhangs in front of the heightfield
+                Vector3 hit;
+                if ( fragments && intersectFragments( starts[ k ], 
+                    starts[ k ] + dirs[ k ] * ( t[ k ] >= 0 ? t[ k ] : maxDistance ), &hit ) )
+                    t[ k ] = ( hit - starts[ k ] ).length();
+
+                distances[ i ] = t[ k ];
+                if ( points )
+                    points[ i ] = t[ k ] >= 0 ? starts[ k ] + dirs[ k ] * t[ k ] : Vector3( -1, -1, -1 );
+            }
+        }
     }
     //-------------------------------------------------------------------------
-    void OverhangTerrainSceneManager::setScale(const Vector3& scale)
+    OverhangTerrainSceneManager::RayBenchmark OverhangTerrainSceneManager::_benchmarkRayQueries( 
+        size_t numRays, uint32 seed )
     {
-        mOptions.scale = scale;
+        RayBenchmark bench;
+        bench.tracedPerSecond = bench.marchedPerSecond = 0;
+        bench.hits = bench.mismatches = 0;
+
+        const AxisAlignedBox& box = mTerrainRoot ? mTerrainRoot->_getWorldAABB() : AxisAlignedBox::BOX_NULL;
+        if (box.isNull() || numRays == 0)
+            return bench;
+
+        // Segments from above the terrain, as long as those of ray queries
+        std::vector<Vector3> starts(numRays), ends(numRays);
+        std::vector<TerrainTile*> tiles(numRays);
+        const Vector3& lo = box.getMinimum();
+        Vector3 size = box.getMaximum() - lo;
+        uint32 state = seed;
+        for (size_t i = 0; i < numRays; ++i)
+        {
+            Vector3 start(lo.x + size.x * lcgRandom(state), lo.y + size.y * (1 + lcgRandom(state)),
+                lo.z + size.z * lcgRandom(state));
+            Vector3 target(lo.x + size.x * lcgRandom(state), lo.y + size.y * lcgRandom(state),
+                lo.z + size.z * lcgRandom(state));
+            starts[i] = start;
+            ends[i] = start + (target - start).normalisedCopy() * 100000;
+            tiles[i] = getTerrainTile(start);
+        }
+
+        std::vector<Vector3> traced(numRays), marched(numRays);
+        Timer timer;
+        for (size_t i = 0; i < numRays; ++i)
+        {
+            if (tiles[i] && tiles[i]->getTerrainRenderable()->intersectSegment(starts[i], ends[i], &traced[i]))
+                ++bench.hits;
+        }
+        unsigned long tracedTime = timer.getMicroseconds();
+
+        timer.reset();
+        for (size_t i = 0; i < numRays; ++i)
+        {
+            if (!tiles[i] || !tiles[i]->getTerrainRenderable()->_marchSegment(starts[i], ends[i], &marched[i]))
+                marched[i] = Vector3(-1, -1, -1);
+        }
+        unsigned long marchedTime = timer.getMicroseconds();
+
+        for (size_t i = 0; i < numRays; ++i)
+        {
+            if (!tiles[i])
+                continue;
+            bool tracedHit = traced[i] != Vector3(-1, -1, -1);
+            bool marchedHit = marched[i] != Vector3(-1, -1, -1);
+            // The marcher steps a unit at a time
+            if (tracedHit != marchedHit || (tracedHit && traced[i].distance(marched[i]) > 1.01))
+                ++bench.mismatches;
+        }
+
+        bench.tracedPerSecond = numRays * 1e6 / std::max(tracedTime, 1ul);
+        bench.marchedPerSecond = numRays * 1e6 / std::max(marchedTime, 1ul);
+        LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Ray queries " +
+            StringConverter::toString(size_t(bench.tracedPerSecond)) + " rays/s traced, " +
+            StringConverter::toString(size_t(bench.marchedPerSecond)) + " rays/s marched, " +
+            StringConverter::toString(bench.hits) + " of " + StringConverter::toString(numRays) + 
+            " hit, " + StringConverter::toString(bench.mismatches) + " mismatches");
+        return bench;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setUseTriStrips(bool useStrips)
+    {
+        mOptions.useTriStrips = useStrips;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setUseLODMorph(bool morph)
+    {
+        // Set true only if vertex programs are supported
+    	if(mDestRenderSystem)
+    		mOptions.lodMorph = morph &&
+				mDestRenderSystem->getCapabilities()->hasCapability(RSC_VERTEX_PROGRAM);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setUseVertexNormals(bool useNormals)
+    {
+        mOptions.lit = useNormals;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setUseVertexColours(bool useColours)
+    {
+        mOptions.coloured = useColours;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setPrecomputeLevelIndexes(bool precompute)
+    {
+        mPrecomputeLevelIndexes = precompute;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setUseCompactVertices(bool compact)
+    {
+        mCompactVertices = compact;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setSunLight(const Vector3& direction, const ColourValue& ambient)
+    {
+        mOptions.sunDirection = direction.normalisedCopy();
+        mOptions.ambientLight = ambient;
+
+        for (OverhangTerrainPage2D::iterator pi = mTerrainPages.begin(); pi != mTerrainPages.end(); ++pi)
+        {
+            for (OverhangTerrainPageRow::iterator pj = pi->begin(); pj != pi->end(); ++pj)
+            {
+                if (*pj)
+                    (*pj)->calculateLighting(mThreadPool);
+            }
+        }
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setWorldTexture(const String& textureName)
+    {
+        mWorldTextureName = textureName;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setDetailTexture(const String& textureName)
+    {
+        mDetailTextureName = textureName;
+
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setDetailTextureRepeat(int repeat)
+    {
+        mOptions.detailTile = repeat;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setTileSize(int size) 
+    {
+        mOptions.tileSize = size;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setPageSize(int size)
+    {
+        mOptions.pageSize = size;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setMaxPixelError(int pixelError) 
+    {
+        mOptions.maxPixelError = pixelError;
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTerrainSceneManager::setScale(const Vector3& scale)
+    {
+        mOptions.scale = scale;
     }
     //-------------------------------------------------------------------------
     void OverhangTerrainSceneManager::setMaxGeoMipMapLevel(int maxMip)
@@ -817,6 +1722,11 @@ namespace Ogre
             setUseVertexColours(*static_cast<const bool*>(value));
             return true;
         }
+        else if (name == "CompactVertices")
+        {
+            setUseCompactVertices(*static_cast<const bool*>(value));
+            return true;
+        }
         else if (name == "MorphLODFactorParamName")
         {
             setCustomMaterialMorphFactorParam(*static_cast<const String*>(value));
@@ -842,6 +1752,26 @@ namespace Ogre
             setDetailTexture(*static_cast<const String*>(value));
             return true;
         }
+        else if (name == "MetaBakeThreshold")
+        {
+            setMetaBakeThreshold(*static_cast<const size_t*>(value));
+            return true;
+        }
+        else if (name == "EditJournalSnapshotInterval")
+        {
+            setEditJournalSnapshotInterval(*static_cast<const size_t*>(value));
+            return true;
+        }
+        else if (name == "MemoryBudget")
+        {
+            setMemoryBudget(*static_cast<const size_t*>(value));
+            return true;
+        }
+        else if (name == "PrefetchHorizon")
+        {
+            setPrefetchHorizon(*static_cast<const Real*>(value));
+            return true;
+        }
         else
         {
             return OctreeSceneManager::setOption(name, value);
@@ -884,7 +1814,7 @@ namespace Ogre
         }
         mActivePageSource = i->second;
         mActivePageSource->initialise(this, mOptions.tileSize, mOptions.pageSize,
-            mPagingEnabled, optionList);
+            mPagingEnabled && mThreadPool != 0, optionList);
 
         LogManager::getSingleton().logMessage(
             "OverhangTerrainSceneManager: Activated PageSource " + typeName);
@@ -923,26 +1853,175 @@ namespace Ogre
 	//-----------------------------------------------------------------------
 	void OverhangTerrainSceneManager::initLevelIndexes()
 	{
-		if ( mLevelIndex.size() == 0 )
+		size_t slots = 1;
+		for ( int i = 0; i < 5; i++ )
+			slots *= mOptions.maxGeoMipMapLevel;
+		mLevelIndex.assign( slots, 0 );
+		mLateLevelIndexes = 0;
+		mLateLevelIndexTime = 0;
+
+		if ( !mPrecomputeLevelIndexes || slots == 0 )
+			return;
+
+		Timer timer;
+		std::vector<size_t> valid;
+		for ( size_t slot = 0; slot < slots; slot++ )
 		{
-			for ( int i = 0; i < 16; i++ )
-			{
-
-				mLevelIndex.push_back( new IndexMap() );
+			int level;
+			unsigned int stitchFlags;
+			if ( _getLevelStitch( slot, level, stitchFlags ) )
+				valid.push_back( slot );
+		}
 
-			}
+		std::vector< std::vector<unsigned short> > indexes( valid.size() );
+		if ( mThreadPool )
+		{
+			mThreadPool->parallelFor( 0, valid.size(), boost::bind( &OverhangTerrainSceneManager::_buildLevelIndexes, 
+				this, &valid[0], &indexes[0], boost::placeholders::_1, boost::placeholders::_2 ), 4 );
+		}
+		else
+		{
+			_buildLevelIndexes( &valid[0], &indexes[0], 0, valid.size() );
+		}
 
+		// Buffers belong to the render system, so are created here
+		size_t bytes = 0;
+		for ( size_t i = 0; i < valid.size(); i++ )
+		{
+			mLevelIndex[ valid[i] ] = _createLevelIndexData( indexes[i] );
+			bytes += indexes[i].size() * sizeof(unsigned short);
 		}
+
+		LogManager::getSingleton().logMessage( "OverhangTerrainSceneManager: Built " + 
+			StringConverter::toString( valid.size() ) + " level index buffers (" + 
+			StringConverter::toString( bytes / 1024 ) + " KB) in " + 
+			StringConverter::toString( timer.getMilliseconds() ) + " ms" );
 	}
 	//-----------------------------------------------------------------------
 	void OverhangTerrainSceneManager::destroyLevelIndexes()
 	{
-		for ( int i = 0; i < mLevelIndex.size(); i++ )
+		if ( mLateLevelIndexes > 0 )
 		{
-			delete mLevelIndex[i];
+			LogManager::getSingleton().logMessage( "OverhangTerrainSceneManager: Built " + 
+				StringConverter::toString( mLateLevelIndexes ) + " level index buffers on first use, taking " + 
+				StringConverter::toString( mLateLevelIndexTime / 1000 ) + " ms in total" );
 		}
+		mLateLevelIndexes = 0;
+		mLateLevelIndexTime = 0;
+
+		// The IndexData are owned by mIndexCache
 		mLevelIndex.clear();
 	}
+	//-----------------------------------------------------------------------
+	namespace
+	{
+		/// Shifts of the stitch flags of each neighbour, in the order of the slot digits
+		const int STITCH_SHIFTS[ 4 ] = 
+			{ STITCH_NORTH_SHIFT, STITCH_SOUTH_SHIFT, STITCH_EAST_SHIFT, STITCH_WEST_SHIFT };
+	}
+	//-----------------------------------------------------------------------
+	size_t OverhangTerrainSceneManager::_getLevelSlot(int level, unsigned int stitchFlags) const
+	{
+		size_t slot = level;
+		for ( int i = 0; i < 4; i++ )
+			slot = slot * mOptions.maxGeoMipMapLevel + ( ( stitchFlags >> STITCH_SHIFTS[i] ) & 0x7F );
+		return slot;
+	}
+	//-----------------------------------------------------------------------
+	bool OverhangTerrainSceneManager::_getLevelStitch(size_t slot, int& level, unsigned int& stitchFlags) const
+	{
+		int deltas[ 4 ];
+		for ( int i = 3; i >= 0; i-- )
+		{
+			deltas[i] = slot % mOptions.maxGeoMipMapLevel;
+			slot /= mOptions.maxGeoMipMapLevel;
+		}
+		level = slot;
+
+		stitchFlags = 0;
+		for ( int i = 0; i < 4; i++ )
+		{
+			if ( level + deltas[i] >= (int)mOptions.maxGeoMipMapLevel )
+				return false;
+			// Neighbours as fine or finer need no stitching
+			if ( deltas[i] > 0 )
+				stitchFlags |= ( 128 | deltas[i] ) << STITCH_SHIFTS[i];
+		}
+		return true;
+	}
+	//-----------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_buildLevelIndexes(const size_t* slots, 
+		std::vector<unsigned short>* indexes, size_t begin, size_t end) const
+	{
+		for ( size_t i = begin; i < end; i++ )
+		{
+			int level;
+			unsigned int stitchFlags;
+			_getLevelStitch( slots[i], level, stitchFlags );
+
+			indexes[i].resize( OverhangTerrainRenderable::_getMaxIndexCount( mOptions, level ) );
+			indexes[i].resize( OverhangTerrainRenderable::_buildIndexes( mOptions, level, stitchFlags, &indexes[i][0] ) );
+		}
+	}
+	//-----------------------------------------------------------------------
+	IndexData* OverhangTerrainSceneManager::_createLevelIndexData(const std::vector<unsigned short>& indexes)
+	{
+		IndexData* indexData = new IndexData;
+		indexData->indexBuffer = 
+			HardwareBufferManager::getSingleton().createIndexBuffer(
+			HardwareIndexBuffer::IT_16BIT,
+			indexes.size(), HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+		indexData->indexBuffer->writeData( 0, indexData->indexBuffer->getSizeInBytes(), &indexes[0], true );
+		indexData->indexCount = indexes.size();
+		indexData->indexStart = 0;
+
+		mIndexCache.mCache.push_back( indexData );
+		return indexData;
+	}
+	//-----------------------------------------------------------------------
+	const HardwareVertexBufferSharedPtr& OverhangTerrainSceneManager::_getGridBuffer(void)
+	{
+		if ( mGridBuffer.isNull() )
+		{
+			size_t tileSize = mOptions.tileSize;
+			std::vector<float> grid( tileSize * tileSize * 4 );
+			float* pGrid = &grid[0];
+			for ( size_t j = 0; j < tileSize; j++ )
+			{
+				for ( size_t i = 0; i < tileSize; i++ )
+				{
+					// Vertex in the tile, as the vertex program adds the tile start and scales
+					*pGrid++ = ( float ) i;
+					*pGrid++ = ( float ) j;
+					// Same for all tiles
+					*pGrid++ = ( ( float ) i / ( float ) ( tileSize - 1 ) ) * mOptions.detailTile;
+					*pGrid++ = ( ( float ) j / ( float ) ( tileSize - 1 ) ) * mOptions.detailTile;
+				}
+			}
+
+			mGridBuffer = HardwareBufferManager::getSingleton().createVertexBuffer(
+				4 * sizeof(float), tileSize * tileSize, HardwareBuffer::HBU_STATIC_WRITE_ONLY );
+			mGridBuffer->writeData( 0, mGridBuffer->getSizeInBytes(), &grid[0], true );
+		}
+		return mGridBuffer;
+	}
+	//-----------------------------------------------------------------------
+	IndexData* OverhangTerrainSceneManager::_getLevelIndex(int level, unsigned int stitchFlags)
+	{
+		IndexData*& indexData = mLevelIndex[ _getLevelSlot( level, stitchFlags ) ];
+		if ( !indexData )
+		{
+			// Not precomputed; this is the hitch initLevelIndexes avoids
+			Timer timer;
+			std::vector<unsigned short> indexes( OverhangTerrainRenderable::_getMaxIndexCount( mOptions, level ) );
+			indexes.resize( OverhangTerrainRenderable::_buildIndexes( mOptions, level, stitchFlags, &indexes[0] ) );
+			indexData = _createLevelIndexData( indexes );
+
+			mLateLevelIndexes++;
+			mLateLevelIndexTime += timer.getMicroseconds();
+		}
+		return indexData;
+	}
     //-------------------------------------------------------------------------
     //-------------------------------------------------------------------------
     RaySceneQuery* 
@@ -968,36 +2047,24 @@ namespace Ogre
     {
         mWorldFrag.fragmentType = SceneQuery::WFT_SINGLE_INTERSECTION;
 
+        OverhangTerrainSceneManager* tsm = static_cast<OverhangTerrainSceneManager*>(mParentSceneMgr);
         const Vector3& dir = mRay.getDirection();
         const Vector3& origin = mRay.getOrigin();
-        // Straight up / down?
-        if (dir == Vector3::UNIT_Y || dir == Vector3::NEGATIVE_UNIT_Y)
-        {
-            Real height = static_cast<OverhangTerrainSceneManager*>(mParentSceneMgr)->getHeightAt(
-                origin.x, origin.z);
-            if (height != -1 && (height <= origin.y && dir.y < 0) || (height >= origin.y && dir.y > 0))
-            {
-                mWorldFrag.singleIntersection.x = origin.x;
-                mWorldFrag.singleIntersection.z = origin.z;
-                mWorldFrag.singleIntersection.y = height;
-                if (!listener->queryResult(&mWorldFrag, 
-                    (mWorldFrag.singleIntersection - origin).length()))
-					return;
-            }
-        }
-        else
-        {
-            // Perform arbitrary query
-            if (static_cast<OverhangTerrainSceneManager*>(mParentSceneMgr)->intersectSegment(
-                origin, origin + (dir * 100000), &mWorldFrag.singleIntersection))
-            {
-                if (!listener->queryResult(&mWorldFrag, 
-                    (mWorldFrag.singleIntersection - origin).length()))
-					return;
-            }
+        // The trace handles straight up / down rays as well, and unlike getHeightAt 
+        // it knows about the holes the fragments cut
+        Vector3 end = origin + (dir * 100000);
+        bool hit = tsm->intersectSegment(origin, end, &mWorldFrag.singleIntersection);
+        if (hit)
+            end = mWorldFrag.singleIntersection;
 
+        // Caves and overhangs in front of the heightfield
+        if (tsm->intersectFragments(origin, end, &mWorldFrag.singleIntersection))
+            hit = true;
+
+        if (hit && !listener->queryResult(&mWorldFrag, 
+            (mWorldFrag.singleIntersection - origin).length()))
+            return;
 
-        }
         OctreeRaySceneQuery::execute(listener);
 
     }
@@ -1011,34 +2078,73 @@ namespace Ogre
 	//-------------------------------------------------------------------------
 	void OverhangTerrainSceneManager::addMetaObject(MetaObject *mo)
 	{
+		// Log the edit before applying it, applying may already bake (and free) it.
+		if (mEditJournal && mEditJournal->isOpen() && mEditJournal->append(mo))
+		{
+			_applyMetaObject(mo);
+			if (mEditJournalSnapshotInterval && 
+				mEditJournal->getNumRecords() >= mEditJournalSnapshotInterval)
+			{
+				snapshotTerrainEdits();
+			}
+		}
+		else
+			_applyMetaObject(mo);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_applyMetaObject(MetaObject *mo)
+	{
+		// Hold on to the object while it is distributed; fragments baking in between
+		// must not free it. Objects that end up in no fragment are freed here.
+		mo->_addRef();
+
 		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
 		double invScale = 1.0/double(scale); //x and y scale have to be the same. I think the same restriction applies for original tsm.
 		AxisAlignedBox aabb = mo->getAABB();
 
 		Vector3 min = aabb.getMinimum();
 		int minX = floor(min.x * invScale);
-		int minY = floor(min.y * invScale);
 		int minZ = floor(min.z * invScale);
 		minX = minX < 0 ? 0 : minX;
 		minZ = minZ < 0 ? 0 : minZ;
 
+		// Page indices are ushorts, tiles past the last page are outside any world
 		Vector3 max = aabb.getMaximum();
-		int maxX = floor(max.x * invScale);
-		int maxY = floor(max.y * invScale);
-		int maxZ = floor(max.z * invScale);
+		int lastTile = 0x10000 * int((mOptions.pageSize - 1) / (mOptions.tileSize - 1)) - 1;
+		int maxX = std::min(int(floor(max.x * invScale)), lastTile);
+		int maxZ = std::min(int(floor(max.z * invScale)), lastTile);
 		for(int x = minX; x <= maxX; ++x)
 		{
 			for(int z = minZ; z <= maxZ; ++z)
 			{
 				TerrainTile *tile = getTerrainTile(Vector3(scale*float(x)+0.5*scale, 0, scale*float(z)+0.5*scale));
-				for(int y = minY; y <= maxY; ++y)
+				if(tile)
+					_addMetaObjectToTile(mo, tile, x, z);
+				else if(_hasTilePage(x, z))
 				{
-					Vector3 pos(scale*float(x)+scale*0.5, scale*float(y)+scale*0.5, scale*float(z)+scale*0.5);
-					mDataGrid->setPosition(pos);
-					tile->addMetaObject(mo, y, mIsoSurfaceBuilder, pos);
+					// The part on pages not loaded (yet, or any more) is added when they are
+					mo->_addRef();
+					_getSpilledTile(x, z).edits.push_back(mo);
 				}
 			}
 		}
+
+		mo->_release();
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_addMetaObjectToTile(MetaObject *mo, TerrainTile *tile, int tileX, int tileZ)
+	{
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		double invScale = 1.0/double(scale);
+		AxisAlignedBox aabb = mo->getAABB();
+		int minY = floor(aabb.getMinimum().y * invScale);
+		int maxY = floor(aabb.getMaximum().y * invScale);
+		for(int y = minY; y <= maxY; ++y)
+		{
+			Vector3 pos(scale*float(tileX)+scale*0.5, scale*float(y)+scale*0.5, scale*float(tileZ)+scale*0.5);
+			mDataGrid->setPosition(pos);
+			tile->addMetaObject(mo, y, mIsoSurfaceBuilder, pos);
+		}
 	}
 
 	//-------------------------------------------------------------------------
@@ -1047,6 +2153,1045 @@ namespace Ogre
 		MetaBall *mo = new MetaBall(0, position, radius, excavating);
 		addMetaObject(mo);
 	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::addMetaNoise(const Vector3& center, const Vector3& halfSize, 
+		uint32 seed, Real frequency, MetaNoise::CaveType caveType, Real threshold, Real strength)
+	{
+		MetaNoise *mo = new MetaNoise(0, center, halfSize, seed, frequency, caveType, threshold, strength);
+		addMetaObject(mo);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::addMetaCapsule(const Vector3& start, const Vector3& end, 
+		Real radius, bool excavating)
+	{
+		MetaCapsule *mo = new MetaCapsule(0, start, end, radius, excavating);
+		addMetaObject(mo);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::addMetaStroke(const std::vector<Vector3>& points, 
+		Real radius, bool excavating)
+	{
+		if (points.size() == 1)
+		{
+			addMetaBall(points.front(), radius, excavating);
+			return;
+		}
+		// Consecutive strokes share their end points, so the path stays connected
+		for (size_t first = 0; first + 1 < points.size(); first += MetaStroke::MAX_POINTS - 1)
+		{
+			size_t last = std::min(first + MetaStroke::MAX_POINTS, points.size());
+			std::vector<Vector3> chunk(points.begin() + first, points.begin() + last);
+			addMetaObject(new MetaStroke(0, chunk, radius, excavating));
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::modifyHeights(Real minX, Real minZ, Real maxX, Real maxZ, 
+		const HeightBrush& brush)
+	{
+		// Vertices on the edge of the rectangle may belong to the tiles beyond it as well
+		Real margin = std::max(mOptions.scale.x, mOptions.scale.z);
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		int minTileX, minTileZ, maxTileX, maxTileZ;
+		_getTileIndex(Vector3(minX - margin, 0, minZ - margin), minTileX, minTileZ);
+		_getTileIndex(Vector3(maxX + margin, 0, maxZ + margin), maxTileX, maxTileZ);
+		minTileX = std::max(minTileX, 0);
+		minTileZ = std::max(minTileZ, 0);
+
+		bool journal = mEditJournal && mEditJournal->isOpen();
+		bool changed = false;
+		for (int x = minTileX; x <= maxTileX; ++x)
+		{
+			for (int z = minTileZ; z <= maxTileZ; ++z)
+			{
+				TerrainTile *tile = getTerrainTile(Vector3(scale*float(x)+0.5*scale, 0, scale*float(z)+0.5*scale));
+				// Edge vertices are shared with the neighbour and get the same height in both tiles
+				if (!tile || !tile->modifyHeights(minX, minZ, maxX, maxZ, brush, mIsoSurfaceBuilder))
+					continue;
+				changed = true;
+				if (!journal)
+					continue;
+
+				// The brush can not be stored, its result can: the deltas of the rectangle it covers
+				int x0, z0, x1, z1;
+				tile->getTerrainRenderable()->_getVertexRect(minX, minZ, maxX, maxZ, x0, z0, x1, z1);
+				TerrainEditJournal::HeightDeltas heights;
+				heights.tileX = x;
+				heights.tileZ = z;
+				heights.x = x0;
+				heights.z = z0;
+				heights.width = x1 - x0 + 1;
+				heights.depth = z1 - z0 + 1;
+				const std::vector<float>& deltas = tile->getHeightDeltas();
+				for (int j = z0; j <= z1; ++j)
+				{
+					std::vector<float>::const_iterator row = deltas.begin() + j*mOptions.tileSize;
+					heights.deltas.insert(heights.deltas.end(), row + x0, row + x1 + 1);
+				}
+				mEditJournal->append(heights);
+			}
+		}
+		if (!changed)
+			return;
+
+		_notifyHeightsChanged(minX, minZ, maxX, maxZ);
+		if (journal && mEditJournalSnapshotInterval && 
+			mEditJournal->getNumRecords() >= mEditJournalSnapshotInterval)
+		{
+			snapshotTerrainEdits();
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_notifyHeightsChanged(Real minX, Real minZ, Real maxX, Real maxZ)
+	{
+		// Normals read heights one vertex and one world unit away (see 
+		// OverhangTerrainRenderable::_getNormalAt), so they change in a margin around the brush.
+		Real margin = std::max(mOptions.scale.x, mOptions.scale.z) + 1;
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		int minTileX, minTileZ, maxTileX, maxTileZ;
+		_getTileIndex(Vector3(minX - margin, 0, minZ - margin), minTileX, minTileZ);
+		_getTileIndex(Vector3(maxX + margin, 0, maxZ + margin), maxTileX, maxTileZ);
+		minTileX = std::max(minTileX, 0);
+		minTileZ = std::max(minTileZ, 0);
+
+		// Once all heights are in place: normals and fragments read across tile edges
+		std::vector<OverhangTerrainPage*> pages;
+		for (int x = minTileX; x <= maxTileX; ++x)
+		{
+			for (int z = minTileZ; z <= maxTileZ; ++z)
+			{
+				TerrainTile *tile = getTerrainTile(Vector3(scale*float(x)+0.5*scale, 0, scale*float(z)+0.5*scale));
+				if (!tile)
+					continue;
+				tile->_notifyHeightsChanged(minX - margin, minZ - margin, maxX + margin, maxZ + margin, 
+					mIsoSurfaceBuilder);
+				OverhangTerrainPage* page = getTerrainPage(tile->getTerrainRenderable()->getCenter());
+				if (page && std::find(pages.begin(), pages.end(), page) == pages.end())
+					pages.push_back(page);
+			}
+		}
+
+		// Shadows reach past the brush, each page relights what lies behind it
+		for (std::vector<OverhangTerrainPage*>::iterator it = pages.begin(); it != pages.end(); ++it)
+			(*it)->updateLighting(minX - margin, minZ - margin, maxX + margin, maxZ + margin, mThreadPool);
+	}
+	//-------------------------------------------------------------------------
+	namespace
+	{
+		/// Sets the height deltas of a rectangle of a tile's vertices, see TerrainTile::getHeightDeltas
+		struct DeltaBrush
+		{
+			const float *deltas;
+			const std::vector<float> *current;
+			Real startX, startZ, scaleX, scaleZ;
+			int x, z, width, depth, tileSize;
+
+			Real operator()(Real px, Real pz, Real height) const
+			{
+				int i = int(Math::Floor((px - startX) / scaleX + 0.5f));
+				int j = int(Math::Floor((pz - startZ) / scaleZ + 0.5f));
+				if (i < x || j < z || i >= x + width || j >= z + depth)
+					return height;
+				Real delta = deltas[(i - x) + (j - z)*width];
+				if (!current->empty())
+					delta -= (*current)[i + j*tileSize];
+				return height + delta;
+			}
+		};
+	}
+	//-------------------------------------------------------------------------
+	bool OverhangTerrainSceneManager::_setHeightDeltas(TerrainTile *tile, int tileX, int tileZ, 
+		size_t x, size_t z, size_t width, size_t depth, const float *deltas)
+	{
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		DeltaBrush brush;
+		brush.deltas = deltas;
+		brush.current = &tile->getHeightDeltas();
+		brush.startX = scale*tileX;
+		brush.startZ = scale*tileZ;
+		brush.scaleX = mOptions.scale.x;
+		brush.scaleZ = mOptions.scale.z;
+		brush.x = int(x);
+		brush.z = int(z);
+		brush.width = int(width);
+		brush.depth = int(depth);
+		brush.tileSize = int(mOptions.tileSize);
+		// Half a vertex around the rectangle, so rounding keeps its edges inside
+		if (!tile->modifyHeights(brush.startX + (x - 0.5f)*brush.scaleX, brush.startZ + (z - 0.5f)*brush.scaleZ,
+			brush.startX + (x + width - 0.5f)*brush.scaleX, brush.startZ + (z + depth - 0.5f)*brush.scaleZ, brush,
+			mIsoSurfaceBuilder))
+			return false;
+
+		// Keep the deltas as given rather than summed up from the heights
+		std::vector<float>& current = tile->getHeightDeltas();
+		for (size_t j = 0; j < depth; ++j)
+			std::copy(deltas + j*width, deltas + (j + 1)*width, &current[x + (z + j)*mOptions.tileSize]);
+		return true;
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_applyHeightDeltas(int tileX, int tileZ, size_t x, size_t z, 
+		size_t width, size_t depth, const float *deltas)
+	{
+		if (x + width > mOptions.tileSize || z + depth > mOptions.tileSize)
+			return;
+
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		TerrainTile *tile = getTerrainTile(Vector3(scale*float(tileX)+0.5*scale, 0, scale*float(tileZ)+0.5*scale));
+		if (tile)
+		{
+			if (_setHeightDeltas(tile, tileX, tileZ, x, z, width, depth, deltas))
+			{
+				_notifyHeightsChanged(scale*tileX + x*mOptions.scale.x, scale*tileZ + z*mOptions.scale.z,
+					scale*tileX + (x + width - 1)*mOptions.scale.x, scale*tileZ + (z + depth - 1)*mOptions.scale.z);
+			}
+			return;
+		}
+
+		// Kept with the tile until its page is loaded
+		if (!_hasTilePage(tileX, tileZ))
+			return;
+		std::vector<float>& spilled = _getSpilledTile(tileX, tileZ).heightDeltas;
+		if (spilled.empty())
+		{
+			spilled.assign(mOptions.tileSize*mOptions.tileSize, 0);
+			mSpilledBytes += spilled.capacity()*sizeof(float);
+		}
+		for (size_t j = 0; j < depth; ++j)
+			std::copy(deltas + j*width, deltas + (j + 1)*width, &spilled[x + (z + j)*mOptions.tileSize]);
+	}
+	//-------------------------------------------------------------------------
+	namespace
+	{
+		/// Squared falloff from 1 at the centre to 0 at radius, as for MetaBalls
+		Real brushFalloff(Real dx, Real dz, Real radius)
+		{
+			Real t = 1 - (dx*dx + dz*dz) / (radius*radius);
+			return t > 0 ? t*t : 0;
+		}
+
+		struct RaiseBrush
+		{
+			Vector3 centre;
+			Real radius, amount;
+
+			Real operator()(Real x, Real z, Real height) const
+			{
+				return height + amount * brushFalloff(x - centre.x, z - centre.z, radius);
+			}
+		};
+
+		struct FlattenBrush
+		{
+			Vector3 centre;
+			Real radius, strength;
+
+			Real operator()(Real x, Real z, Real height) const
+			{
+				Real w = strength * brushFalloff(x - centre.x, z - centre.z, radius);
+				return height + (centre.y - height) * std::min(w, Real(1));
+			}
+		};
+
+		struct RampBrush
+		{
+			Vector3 start, end;
+			Real halfWidth;
+
+			Real operator()(Real x, Real z, Real height) const
+			{
+				// Closest point on the centre line, in the xz-plane
+				Real dx = end.x - start.x, dz = end.z - start.z;
+				Real len2 = dx*dx + dz*dz;
+				Real s = len2 > 0 ? ((x - start.x)*dx + (z - start.z)*dz) / len2 : 0;
+				s = std::max(Real(0), std::min(s, Real(1)));
+				Real d = Math::Sqrt(Math::Sqr(x - start.x - s*dx) + Math::Sqr(z - start.z - s*dz));
+				if (d >= 2*halfWidth)
+					return height;
+
+				// Flat across the ramp, then a shoulder of the same width blending into the terrain
+				Real w = d <= halfWidth ? 1 : Math::Sqr(2 - d / halfWidth);
+				Real target = start.y + (end.y - start.y) * s;
+				return height + (target - height) * w;
+			}
+		};
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::raiseHeights(const Vector3& centre, Real radius, Real amount)
+	{
+		RaiseBrush brush;
+		brush.centre = centre;
+		brush.radius = radius;
+		brush.amount = amount;
+		modifyHeights(centre.x - radius, centre.z - radius, centre.x + radius, centre.z + radius, brush);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::flattenHeights(const Vector3& centre, Real radius, Real strength)
+	{
+		FlattenBrush brush;
+		brush.centre = centre;
+		brush.radius = radius;
+		brush.strength = strength;
+		modifyHeights(centre.x - radius, centre.z - radius, centre.x + radius, centre.z + radius, brush);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::rampHeights(const Vector3& start, const Vector3& end, Real halfWidth)
+	{
+		RampBrush brush;
+		brush.start = start;
+		brush.end = end;
+		brush.halfWidth = halfWidth;
+		Real reach = 2*halfWidth;
+		modifyHeights(std::min(start.x, end.x) - reach, std::min(start.z, end.z) - reach,
+			std::max(start.x, end.x) + reach, std::max(start.z, end.z) + reach, brush);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::bakeMetaObjects(void)
+	{
+		for (OverhangTerrainPage2D::iterator pi = mTerrainPages.begin(); 
+			pi != mTerrainPages.end(); ++pi)
+		{
+			for (OverhangTerrainPageRow::iterator ri = pi->begin(); ri != pi->end(); ++ri)
+			{
+				OverhangTerrainPage* page = *ri;
+				if (!page)
+					continue;
+				for (size_t j = 0; j < page->tilesPerPage; ++j)
+					for (size_t i = 0; i < page->tilesPerPage; ++i)
+						page->tiles[i][j]->bakeMetaWorldFragments(mIsoSurfaceBuilder);
+			}
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::setMetaBakeThreshold(size_t threshold)
+	{
+		MetaWorldFragment::setBakeThreshold(threshold);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_getTileIndex(const Vector3& pt, int& tileX, int& tileZ) const
+	{
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		tileX = int(Math::Floor(pt.x / scale));
+		tileZ = int(Math::Floor(pt.z / scale));
+	}
+	//-------------------------------------------------------------------------
+	namespace
+	{
+		/// A point of a batched query, keyed by its tile index
+		struct TileQuery
+		{
+			int tileX, tileZ;
+			size_t index;
+		};
+
+		bool tileQueryLess(const TileQuery& a, const TileQuery& b)
+		{
+			if (a.tileZ != b.tileZ)
+				return a.tileZ < b.tileZ;
+			if (a.tileX != b.tileX)
+				return a.tileX < b.tileX;
+			return a.index < b.index;
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_binByTile(const float* x, const float* z, size_t count, 
+		std::vector<size_t>& order, std::vector<TileBin>& bins)
+	{
+		std::vector<TileQuery> queries(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			_getTileIndex(Vector3(x[i], 0, z[i]), queries[i].tileX, queries[i].tileZ);
+			queries[i].index = i;
+		}
+		std::sort(queries.begin(), queries.end(), tileQueryLess);
+
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		order.resize(count);
+		bins.clear();
+		for (size_t i = 0; i < count; ++i)
+		{
+			order[i] = queries[i].index;
+			if (i == 0 || queries[i].tileX != queries[i - 1].tileX || queries[i].tileZ != queries[i - 1].tileZ)
+			{
+				// One page walk per tile, from its centre as in modifyHeights
+				TileBin bin;
+				bin.tile = queries[i].tileX < 0 || queries[i].tileZ < 0 ? 0 : getTerrainTile(
+					Vector3(scale*(queries[i].tileX + 0.5f), 0, scale*(queries[i].tileZ + 0.5f)));
+				bin.first = i;
+				bin.count = 0;
+				bins.push_back(bin);
+			}
+			++bins.back().count;
+		}
+	}
+	//-------------------------------------------------------------------------
+	namespace
+	{
+		FragmentDensityFile::TileBlock makeTileBlock(int tileX, int tileZ, uint32 flags, 
+			const std::vector<uint32>& words)
+		{
+			FragmentDensityFile::TileBlock block;
+			block.tileX = tileX;
+			block.tileZ = tileZ;
+			block.flags = flags & FragmentDensityFile::ENTRY_TILE_BLOCK;
+			block.words = words.empty() ? 0 : &words[0];
+			block.numWords = words.size();
+			return block;
+		}
+
+		/// Appends the bits of values to words
+		void appendFloatWords(const std::vector<float>& values, std::list<std::vector<uint32> >& words)
+		{
+			words.push_back(std::vector<uint32>(values.size()));
+			if (!values.empty())
+				memcpy(&words.back()[0], &values[0], values.size()*sizeof(float));
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::saveFragmentDensities(const String& filename, bool compress)
+	{
+		bakeMetaObjects();
+
+		FragmentDensityFile::FragmentList fragments;
+		FragmentDensityFile::TileBlockList tileBlocks;
+		std::list<std::vector<uint32> > blockWords;
+		for (OverhangTerrainPage2D::iterator pi = mTerrainPages.begin(); 
+			pi != mTerrainPages.end(); ++pi)
+		{
+			for (OverhangTerrainPageRow::iterator ri = pi->begin(); ri != pi->end(); ++ri)
+			{
+				OverhangTerrainPage* page = *ri;
+				if (!page)
+					continue;
+				for (size_t j = 0; j < page->tilesPerPage; ++j)
+				{
+					for (size_t i = 0; i < page->tilesPerPage; ++i)
+					{
+						TerrainTile *tile = page->tiles[i][j];
+						if (!tile->getHeightDeltas().empty())
+						{
+							int tileX, tileZ;
+							_getTileIndex(tile->getCenter(), tileX, tileZ);
+							appendFloatWords(tile->getHeightDeltas(), blockWords);
+							tileBlocks.push_back(makeTileBlock(tileX, tileZ, 
+								FragmentDensityFile::ENTRY_TILE_HEIGHTS, blockWords.back()));
+						}
+
+						std::vector<MetaWorldFragment*>& frags = tile->getMetaWorldFragments();
+						for (std::vector<MetaWorldFragment*>::iterator it = frags.begin(); it != frags.end(); ++it)
+						{
+							if (!(*it)->isBaked())
+								continue;
+							FragmentDensityFile::Fragment f;
+							_getTileIndex((*it)->getPosition(), f.tileX, f.tileZ);
+							f.yLevel = int((*it)->getYLevel());
+							f.flags = tile->isHeightfieldReplaced() ? FragmentDensityFile::ENTRY_HIDES_HEIGHTFIELD : 0;
+							f.position = (*it)->getPosition();
+							f.values = (*it)->getBakedValues();
+							const std::vector<uchar>& columns = (*it)->getCarvedColumns();
+							f.columns = columns.empty() ? 0 : &columns[0];
+							fragments.push_back(f);
+						}
+					}
+				}
+			}
+		}
+
+		// Keep the fragments of tiles that have not been paged in yet. When overwriting
+		// the mapped file, let go of the mapping before writing.
+		bool carry = mFragmentDensityFile && mFragmentDensityFile->isOpen();
+		bool reopen = carry && mFragmentDensityFile->getFilename() == filename;
+		std::vector<Real> carried;
+		std::vector<uchar> carriedColumns;
+		if (carry)
+		{
+			size_t numPoints = mFragmentDensityFile->getNumGridPoints();
+			size_t numColumns = mFragmentDensityFile->getNumColumns();
+			Real tileScale = mOptions.scale.x*(mOptions.tileSize-1);
+			std::vector<const FragmentDensityFile::IndexEntry*> pending;
+			for (size_t e = 0; e < mFragmentDensityFile->getNumEntries(); ++e)
+			{
+				const FragmentDensityFile::IndexEntry& entry = mFragmentDensityFile->getEntry(e);
+				Vector3 centre(tileScale*(entry.tileX + 0.5f), 0, tileScale*(entry.tileZ + 0.5f));
+				// Evicted tiles keep newer densities than the file; tiles outside the world
+				// (from snapshots written before they were left out) are dropped
+				if (getTerrainTile(centre) || 
+					mSpilledTiles.find(std::make_pair(int(entry.tileX), int(entry.tileZ))) != mSpilledTiles.end() ||
+					!_hasTilePage(entry.tileX, entry.tileZ))
+					continue;
+				if (entry.flags & FragmentDensityFile::ENTRY_TILE_BLOCK)
+				{
+					const uint32* words = mFragmentDensityFile->getTileBlock(entry);
+					blockWords.push_back(std::vector<uint32>(words, words + entry.size/sizeof(uint32)));
+					tileBlocks.push_back(makeTileBlock(entry.tileX, entry.tileZ, entry.flags, blockWords.back()));
+				}
+				else
+					pending.push_back(&entry);
+			}
+			carried.resize(pending.size()*numPoints);
+			carriedColumns.resize(pending.size()*numColumns);
+			for (size_t e = 0; e < pending.size(); ++e)
+			{
+				const FragmentDensityFile::IndexEntry& entry = *pending[e];
+				mFragmentDensityFile->readDensities(entry, &carried[e*numPoints]);
+				FragmentDensityFile::Fragment f;
+				f.tileX = entry.tileX;
+				f.tileZ = entry.tileZ;
+				f.yLevel = entry.yLevel;
+				f.flags = entry.flags;
+				f.position = Vector3(entry.position[0], entry.position[1], entry.position[2]);
+				f.values = &carried[e*numPoints];
+				f.columns = 0;
+				if (const uchar* columns = mFragmentDensityFile->getColumns(entry))
+				{
+					// Copy out of the mapping, it may be closed before the file is rewritten
+					std::copy(columns, columns + numColumns, carriedColumns.begin() + e*numColumns);
+					f.columns = &carriedColumns[e*numColumns];
+				}
+				fragments.push_back(f);
+			}
+			if (reopen)
+				mFragmentDensityFile->close();
+		}
+
+		// ... and those of evicted pages
+		size_t numGridPoints = mDataGrid->getNumGridPoints();
+		size_t numSpilled = 0;
+		for (SpilledTileMap::iterator it = mSpilledTiles.begin(); it != mSpilledTiles.end(); ++it)
+			numSpilled += it->second.fragments.size();
+		std::vector<Real> spilled(numSpilled*numGridPoints);
+		size_t s = 0;
+		for (SpilledTileMap::iterator it = mSpilledTiles.begin(); it != mSpilledTiles.end(); ++it)
+		{
+			SpilledFragmentList& list = it->second.fragments;
+			for (SpilledFragmentList::iterator fi = list.begin(); fi != list.end(); ++fi, ++s)
+			{
+				FragmentDensityFile::decodeBlock(&fi->block[0], fi->block.size(), 
+					(fi->flags & FragmentDensityFile::ENTRY_COMPRESSED) != 0, &spilled[s*numGridPoints], numGridPoints);
+				FragmentDensityFile::Fragment f;
+				f.tileX = it->first.first;
+				f.tileZ = it->first.second;
+				f.yLevel = fi->yLevel;
+				f.flags = fi->flags & ~FragmentDensityFile::ENTRY_COMPRESSED;
+				f.position = fi->position;
+				f.values = &spilled[s*numGridPoints];
+				f.columns = fi->columns.empty() ? 0 : &fi->columns[0];
+				fragments.push_back(f);
+			}
+
+			if (!it->second.heightDeltas.empty())
+			{
+				appendFloatWords(it->second.heightDeltas, blockWords);
+				tileBlocks.push_back(makeTileBlock(it->first.first, it->first.second, 
+					FragmentDensityFile::ENTRY_TILE_HEIGHTS, blockWords.back()));
+			}
+
+			// Edits waiting for the tile, which the journal may drop once this is a snapshot
+			if (it->second.edits.empty())
+				continue;
+			std::vector<uchar> records;
+			if (!TerrainEditJournal::writeRecords(it->second.edits, records))
+				continue;
+			records.resize((records.size() + 3) & ~size_t(3), 0);
+			blockWords.push_back(std::vector<uint32>(records.size()/sizeof(uint32)));
+			memcpy(&blockWords.back()[0], &records[0], records.size());
+			tileBlocks.push_back(makeTileBlock(it->first.first, it->first.second, 
+				FragmentDensityFile::ENTRY_TILE_EDITS, blockWords.back()));
+		}
+
+		// The densities contain every journaled edit so far
+		uint64 sequence = mEditJournal ? mEditJournal->getSequence() : 0;
+		FragmentDensityFile::save(filename, fragments, mDataGrid->getNumCellsX(), mDataGrid->getNumCellsY(),
+			mDataGrid->getNumCellsZ(), mDataGrid->getGridScale(), compress, sequence, &tileBlocks);
+		LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Saved " + 
+			StringConverter::toString(fragments.size()) + " fragment densities to " + filename);
+
+		if (reopen)
+			mFragmentDensityFile->open(filename);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::loadFragmentDensities(const String& filename)
+	{
+		if (!mFragmentDensityFile)
+			mFragmentDensityFile = new FragmentDensityFile();
+		mFragmentDensityFile->open(filename);
+		if (!mFragmentDensityFile->matchesGrid(mDataGrid->getNumCellsX(), mDataGrid->getNumCellsY(),
+			mDataGrid->getNumCellsZ(), mDataGrid->getGridScale()))
+		{
+			mFragmentDensityFile->close();
+			OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, 
+				filename + " was written for a different data grid layout",
+				"OverhangTerrainSceneManager::loadFragmentDensities");
+		}
+
+		for (OverhangTerrainPage2D::iterator pi = mTerrainPages.begin(); 
+			pi != mTerrainPages.end(); ++pi)
+		{
+			for (OverhangTerrainPageRow::iterator ri = pi->begin(); ri != pi->end(); ++ri)
+			{
+				if (!*ri)
+					continue;
+				_restoreHeights(*ri);
+				_loadFragmentDensities(*ri);
+			}
+		}
+
+		if (mFragmentMeshCache && mFragmentMeshCache->isOpen())
+		{
+			LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Fragment mesh cache hits " +
+				StringConverter::toString(mFragmentMeshCache->getNumHits()) + ", rebuilt " +
+				StringConverter::toString(mFragmentMeshCache->getNumMisses()));
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::saveFragmentMeshCache(const String& filename)
+	{
+		FragmentMeshCache::MeshList meshes;
+		std::vector< std::vector<uchar> > vertices;
+		std::vector< std::vector<uint16> > indices;
+		size_t vertexSize = 0;
+
+		// Gather first, the buffers must not move while the mesh list points into them
+		std::vector<MetaWorldFragment*> frags;
+		for (OverhangTerrainPage2D::iterator pi = mTerrainPages.begin(); 
+			pi != mTerrainPages.end(); ++pi)
+		{
+			for (OverhangTerrainPageRow::iterator ri = pi->begin(); ri != pi->end(); ++ri)
+			{
+				OverhangTerrainPage* page = *ri;
+				if (!page)
+					continue;
+				for (size_t j = 0; j < page->tilesPerPage; ++j)
+				{
+					for (size_t i = 0; i < page->tilesPerPage; ++i)
+					{
+						std::vector<MetaWorldFragment*>& tf = page->tiles[i][j]->getMetaWorldFragments();
+						for (std::vector<MetaWorldFragment*>::iterator it = tf.begin(); it != tf.end(); ++it)
+						{
+							if ((*it)->getIsoSurface())
+								frags.push_back(*it);
+						}
+					}
+				}
+			}
+		}
+
+		vertices.resize(frags.size());
+		indices.resize(frags.size());
+		for (size_t f = 0; f < frags.size(); ++f)
+		{
+			MetaWorldFragment *wf = frags[f];
+			IsoSurfaceRenderable *surf = wf->getIsoSurface();
+			surf->readHardwareBuffers(vertices[f], indices[f]);
+			vertexSize = surf->getVertexSize();
+
+			FragmentMeshCache::Mesh m;
+			m.hash = wf->getDensityHash(mIsoSurfaceBuilder);
+			_getTileIndex(wf->getPosition(), m.tileX, m.tileZ);
+			m.yLevel = int(wf->getYLevel());
+			m.vertices = vertices[f].empty() ? 0 : &vertices[f][0];
+			m.vertexCount = surf->getVertexCount();
+			m.indices = indices[f].empty() ? 0 : &indices[f][0];
+			m.indexCount = indices[f].size();
+			meshes.push_back(m);
+		}
+
+		// Keep the cached meshes of tiles that are not loaded; they are still valid.
+		bool reopen = mFragmentMeshCache && mFragmentMeshCache->isOpen();
+		std::vector<uchar> carried;
+		if (reopen)
+		{
+			if (!vertexSize)
+				vertexSize = mFragmentMeshCache->getVertexSize();
+			Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+			std::vector<const FragmentMeshCache::IndexEntry*> pending;
+			size_t bytes = 0;
+			for (size_t e = 0; e < mFragmentMeshCache->getNumEntries(); ++e)
+			{
+				const FragmentMeshCache::IndexEntry& entry = mFragmentMeshCache->getEntry(e);
+				Vector3 centre((entry.tileX + 0.5)*scale, 0, (entry.tileZ + 0.5)*scale);
+				if (!getTerrainTile(centre) && mFragmentMeshCache->getVertexSize() == vertexSize)
+				{
+					pending.push_back(&entry);
+					bytes += entry.vertexCount*vertexSize + entry.indexCount*sizeof(uint16);
+				}
+			}
+			// Copy out of the mapping, it is closed before the file is rewritten
+			carried.resize(bytes);
+			size_t offset = 0;
+			for (size_t e = 0; e < pending.size(); ++e)
+			{
+				const FragmentMeshCache::IndexEntry& entry = *pending[e];
+				size_t vbytes = entry.vertexCount*vertexSize;
+				size_t ibytes = entry.indexCount*sizeof(uint16);
+				if (vbytes)
+					memcpy(&carried[offset], mFragmentMeshCache->getVertices(entry), vbytes);
+				if (ibytes)
+					memcpy(&carried[offset + vbytes], mFragmentMeshCache->getIndices(entry), ibytes);
+
+				FragmentMeshCache::Mesh m;
+				m.hash = entry.hash;
+				m.tileX = entry.tileX;
+				m.tileZ = entry.tileZ;
+				m.yLevel = entry.yLevel;
+				m.vertices = vbytes ? &carried[offset] : 0;
+				m.vertexCount = entry.vertexCount;
+				m.indices = ibytes ? reinterpret_cast<const uint16*>(&carried[offset + vbytes]) : 0;
+				m.indexCount = entry.indexCount;
+				meshes.push_back(m);
+				offset += vbytes + ibytes;
+			}
+			MetaWorldFragment::setMeshCache(0);
+			mFragmentMeshCache->close();
+		}
+
+		FragmentMeshCache::save(filename, meshes, vertexSize);
+		LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Saved " + 
+			StringConverter::toString(meshes.size()) + " fragment meshes to " + filename);
+
+		if (reopen)
+			loadFragmentMeshCache(filename);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::loadFragmentMeshCache(const String& filename)
+	{
+		if (!mFragmentMeshCache)
+			mFragmentMeshCache = new FragmentMeshCache();
+
+		std::ifstream probe(filename.c_str(), std::ios::in | std::ios::binary);
+		if (!probe)
+		{
+			LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Fragment mesh cache " + 
+				filename + " does not exist yet, all fragments will be meshed");
+			return;
+		}
+		probe.close();
+
+		MetaWorldFragment::setMeshCache(0);
+		mFragmentMeshCache->open(filename);
+		MetaWorldFragment::setMeshCache(mFragmentMeshCache);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_loadFragmentDensities(OverhangTerrainPage* page)
+	{
+		if (!mFragmentDensityFile || !mFragmentDensityFile->isOpen())
+			return;
+
+		FragmentDensityFile::EntryList entries;
+		std::vector<Real> values(mFragmentDensityFile->getNumGridPoints());
+		for (size_t j = 0; j < page->tilesPerPage; ++j)
+		{
+			for (size_t i = 0; i < page->tilesPerPage; ++i)
+			{
+				TerrainTile *tile = page->tiles[i][j];
+				int tileX, tileZ;
+				_getTileIndex(tile->getCenter(), tileX, tileZ);
+				// Densities kept at eviction are newer
+				if (mSpilledTiles.find(std::make_pair(tileX, tileZ)) != mSpilledTiles.end())
+					continue;
+
+				mFragmentDensityFile->findFragments(tileX, tileZ, entries);
+				for (FragmentDensityFile::EntryList::iterator it = entries.begin(); it != entries.end(); ++it)
+				{
+					const FragmentDensityFile::IndexEntry& e = **it;
+					mFragmentDensityFile->readDensities(e, &values[0]);
+					Vector3 pos(e.position[0], e.position[1], e.position[2]);
+					mDataGrid->setPosition(pos);
+					tile->addBakedMetaWorldFragment(e.yLevel, pos, &values[0], values.size(), mIsoSurfaceBuilder,
+						(e.flags & FragmentDensityFile::ENTRY_HIDES_HEIGHTFIELD) != 0, 
+						mFragmentDensityFile->getNumColumns() == MetaWorldFragment::getNumColumns() ? 
+						mFragmentDensityFile->getColumns(e) : 0);
+				}
+
+				// Edits the tile missed before the file was written
+				std::vector<MetaObject*> edits;
+				_readTileEdits(tileX, tileZ, edits);
+				for (std::vector<MetaObject*>::iterator ei = edits.begin(); ei != edits.end(); ++ei)
+				{
+					(*ei)->_addRef();
+					_addMetaObjectToTile(*ei, tile, tileX, tileZ);
+					(*ei)->_release();
+				}
+			}
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_readTileEdits(int tileX, int tileZ, std::vector<MetaObject*>& edits)
+	{
+		const FragmentDensityFile::IndexEntry* e = 
+			mFragmentDensityFile->findTileBlock(tileX, tileZ, FragmentDensityFile::ENTRY_TILE_EDITS);
+		if (e)
+		{
+			TerrainEditJournal::readRecords(reinterpret_cast<const uchar*>(mFragmentDensityFile->getTileBlock(*e)),
+				e->size, edits);
+		}
+	}
+	//-------------------------------------------------------------------------
+	bool OverhangTerrainSceneManager::_readTileHeights(int tileX, int tileZ, std::vector<float>& deltas)
+	{
+		const FragmentDensityFile::IndexEntry* e = 
+			mFragmentDensityFile->findTileBlock(tileX, tileZ, FragmentDensityFile::ENTRY_TILE_HEIGHTS);
+		size_t count = mOptions.tileSize*mOptions.tileSize;
+		if (!e || e->size != count*sizeof(float))
+			return false;
+		deltas.resize(count);
+		memcpy(&deltas[0], mFragmentDensityFile->getTileBlock(*e), e->size);
+		return true;
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_restoreHeights(OverhangTerrainPage* page)
+	{
+		bool open = mFragmentDensityFile && mFragmentDensityFile->isOpen();
+		if (!open && mSpilledTiles.empty())
+			return;
+
+		size_t count = mOptions.tileSize*mOptions.tileSize;
+		bool changed = false;
+		std::vector<float> deltas;
+		for (size_t j = 0; j < page->tilesPerPage; ++j)
+		{
+			for (size_t i = 0; i < page->tilesPerPage; ++i)
+			{
+				TerrainTile *tile = page->tiles[i][j];
+				int tileX, tileZ;
+				_getTileIndex(tile->getCenter(), tileX, tileZ);
+
+				// Those kept at eviction are newer than the file
+				deltas.clear();
+				SpilledTileMap::iterator it = mSpilledTiles.find(std::make_pair(tileX, tileZ));
+				if (it != mSpilledTiles.end())
+				{
+					mSpilledBytes -= it->second.heightDeltas.capacity()*sizeof(float);
+					deltas.swap(it->second.heightDeltas);
+				}
+				else if (open)
+					_readTileHeights(tileX, tileZ, deltas);
+
+				if (deltas.size() == count && 
+					_setHeightDeltas(tile, tileX, tileZ, 0, 0, mOptions.tileSize, mOptions.tileSize, &deltas[0]))
+					changed = true;
+			}
+		}
+		if (!changed)
+			return;
+
+		// Normals at the page edges change in the neighbour pages as well
+		int tileX, tileZ;
+		_getTileIndex(page->tiles[0][0]->getCenter(), tileX, tileZ);
+		Real scale = mOptions.scale.x*(mOptions.tileSize-1);
+		_notifyHeightsChanged(scale*tileX, scale*tileZ, 
+			scale*(tileX + page->tilesPerPage), scale*(tileZ + page->tilesPerPage));
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_spillFragments(OverhangTerrainPage* page)
+	{
+		size_t numGridPoints = mDataGrid->getNumGridPoints();
+		for (size_t j = 0; j < page->tilesPerPage; ++j)
+		{
+			for (size_t i = 0; i < page->tilesPerPage; ++i)
+			{
+				TerrainTile *tile = page->tiles[i][j];
+				int tileX, tileZ;
+				_getTileIndex(tile->getCenter(), tileX, tileZ);
+				// Even without fragments, the tile must not read its entries in the density file again
+				SpilledTile& spilled = mSpilledTiles[std::make_pair(tileX, tileZ)];
+				spilled.heightDeltas.swap(tile->getHeightDeltas());
+				mSpilledBytes += spilled.heightDeltas.capacity()*sizeof(float);
+
+				SpilledFragmentList& list = spilled.fragments;
+				std::vector<MetaWorldFragment*>& frags = tile->getMetaWorldFragments();
+				if (frags.empty())
+					continue;
+				tile->bakeMetaWorldFragments(mIsoSurfaceBuilder);
+
+				for (std::vector<MetaWorldFragment*>::iterator it = frags.begin(); it != frags.end(); ++it)
+				{
+					if (!(*it)->isBaked())
+						continue;
+					list.push_back(SpilledFragment());
+					SpilledFragment& s = list.back();
+					s.yLevel = int((*it)->getYLevel());
+					s.flags = tile->isHeightfieldReplaced() ? FragmentDensityFile::ENTRY_HIDES_HEIGHTFIELD : 0;
+					s.position = (*it)->getPosition();
+					if (FragmentDensityFile::encodeBlock((*it)->getBakedValues(), numGridPoints, true, s.block))
+						s.flags |= FragmentDensityFile::ENTRY_COMPRESSED;
+					s.columns = (*it)->getCarvedColumns();
+					mSpilledBytes += sizeof(SpilledFragment) + s.block.capacity()*sizeof(uint32) + s.columns.capacity();
+				}
+			}
+		}
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_restoreSpilledFragments(OverhangTerrainPage* page)
+	{
+		if (mSpilledTiles.empty())
+			return;
+
+		std::vector<Real> values(mDataGrid->getNumGridPoints());
+		for (size_t j = 0; j < page->tilesPerPage; ++j)
+		{
+			for (size_t i = 0; i < page->tilesPerPage; ++i)
+			{
+				TerrainTile *tile = page->tiles[i][j];
+				int tileX, tileZ;
+				_getTileIndex(tile->getCenter(), tileX, tileZ);
+				SpilledTileMap::iterator it = mSpilledTiles.find(std::make_pair(tileX, tileZ));
+				if (it == mSpilledTiles.end())
+					continue;
+
+				SpilledFragmentList& fragments = it->second.fragments;
+				for (SpilledFragmentList::iterator fi = fragments.begin(); fi != fragments.end(); ++fi)
+				{
+					mSpilledBytes -= sizeof(SpilledFragment) + fi->block.capacity()*sizeof(uint32) + fi->columns.capacity();
+					if (!FragmentDensityFile::decodeBlock(&fi->block[0], fi->block.size(), 
+						(fi->flags & FragmentDensityFile::ENTRY_COMPRESSED) != 0, &values[0], values.size()))
+						continue;
+					mDataGrid->setPosition(fi->position);
+					tile->addBakedMetaWorldFragment(fi->yLevel, fi->position, &values[0], values.size(), mIsoSurfaceBuilder,
+						(fi->flags & FragmentDensityFile::ENTRY_HIDES_HEIGHTFIELD) != 0, 
+						fi->columns.empty() ? 0 : &fi->columns[0]);
+				}
+
+				// Edits made while the tile was away go on top, in their original order
+				std::vector<MetaObject*> edits;
+				edits.swap(it->second.edits);
+				mSpilledTiles.erase(it);
+				for (std::vector<MetaObject*>::iterator ei = edits.begin(); ei != edits.end(); ++ei)
+				{
+					_addMetaObjectToTile(*ei, tile, tileX, tileZ);
+					(*ei)->_release();
+				}
+			}
+		}
+	}
+	//-------------------------------------------------------------------------
+	bool OverhangTerrainSceneManager::_hasTilePage(int tileX, int tileZ) const
+	{
+		int tilesPerSide = int((mOptions.pageSize - 1) / (mOptions.tileSize - 1));
+		if (!mActivePageSource || tileX < 0 || tileZ < 0 || 
+			tileX / tilesPerSide > 0xFFFF || tileZ / tilesPerSide > 0xFFFF)
+			return false;
+		return mActivePageSource->hasPage(ushort(tileX / tilesPerSide), ushort(tileZ / tilesPerSide));
+	}
+	//-------------------------------------------------------------------------
+	OverhangTerrainSceneManager::SpilledTile& OverhangTerrainSceneManager::_getSpilledTile(int tileX, int tileZ)
+	{
+		assert(_hasTilePage(tileX, tileZ));
+		std::pair<int, int> key(tileX, tileZ);
+		SpilledTileMap::iterator it = mSpilledTiles.find(key);
+		if (it != mSpilledTiles.end())
+			return it->second;
+
+		// Take over what the file stores for the tile, its entries are not read again
+		SpilledTile& spilled = mSpilledTiles[key];
+		if (!mFragmentDensityFile || !mFragmentDensityFile->isOpen())
+			return spilled;
+		FragmentDensityFile::EntryList entries;
+		mFragmentDensityFile->findFragments(tileX, tileZ, entries);
+
+		size_t numColumns = mFragmentDensityFile->getNumColumns();
+		std::vector<Real> values(mFragmentDensityFile->getNumGridPoints());
+		for (FragmentDensityFile::EntryList::iterator ei = entries.begin(); ei != entries.end(); ++ei)
+		{
+			const FragmentDensityFile::IndexEntry& e = **ei;
+			mFragmentDensityFile->readDensities(e, &values[0]);
+			spilled.fragments.push_back(SpilledFragment());
+			SpilledFragment& s = spilled.fragments.back();
+			s.yLevel = e.yLevel;
+			s.flags = e.flags & FragmentDensityFile::ENTRY_HIDES_HEIGHTFIELD;
+			s.position = Vector3(e.position[0], e.position[1], e.position[2]);
+			if (FragmentDensityFile::encodeBlock(&values[0], values.size(), true, s.block))
+				s.flags |= FragmentDensityFile::ENTRY_COMPRESSED;
+			const uchar* columns = mFragmentDensityFile->getColumns(e);
+			if (columns && numColumns == MetaWorldFragment::getNumColumns())
+				s.columns.assign(columns, columns + numColumns);
+			mSpilledBytes += sizeof(SpilledFragment) + s.block.capacity()*sizeof(uint32) + s.columns.capacity();
+		}
+		_readTileEdits(tileX, tileZ, spilled.edits);
+		for (std::vector<MetaObject*>::iterator ei = spilled.edits.begin(); ei != spilled.edits.end(); ++ei)
+			(*ei)->_addRef();
+		if (_readTileHeights(tileX, tileZ, spilled.heightDeltas))
+			mSpilledBytes += spilled.heightDeltas.capacity()*sizeof(float);
+		return spilled;
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_clearSpilledTiles(void)
+	{
+		for (SpilledTileMap::iterator it = mSpilledTiles.begin(); it != mSpilledTiles.end(); ++it)
+		{
+			std::vector<MetaObject*>& edits = it->second.edits;
+			for (std::vector<MetaObject*>::iterator ei = edits.begin(); ei != edits.end(); ++ei)
+				(*ei)->_release();
+		}
+		mSpilledTiles.clear();
+		mSpilledBytes = 0;
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::setEditJournalSnapshotInterval(size_t records)
+	{
+		mEditJournalSnapshotInterval = records;
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::snapshotTerrainEdits(void)
+	{
+		if (!mEditJournal || !mEditJournal->isOpen())
+			return;
+
+		mEditJournal->sync();
+
+		// Write next to the snapshot and rename, so a crash while writing leaves the
+		// previous snapshot and the journal intact.
+		String tempName = mEditJournalSnapshotName + ".tmp";
+		saveFragmentDensities(tempName);
+		if (mFragmentDensityFile)
+			mFragmentDensityFile->close();
+		TerrainEditJournal::replaceFile(tempName, mEditJournalSnapshotName);
+		// The snapshot holds the loaded fragments and all carried over ones; only the
+		// latter are read from it, so mapping it is enough.
+		if (!mFragmentDensityFile)
+			mFragmentDensityFile = new FragmentDensityFile();
+		mFragmentDensityFile->open(mEditJournalSnapshotName);
+
+		mEditJournal->truncate();
+		LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Snapshot of terrain edits up to " +
+			StringConverter::toString(size_t(mEditJournal->getSequence())) + " written to " + 
+			mEditJournalSnapshotName);
+	}
+	//-------------------------------------------------------------------------
+	void OverhangTerrainSceneManager::_recoverTerrainEdits(void)
+	{
+		FILE *snapshot = fopen(mEditJournalSnapshotName.c_str(), "rb");
+		if (snapshot)
+		{
+			fclose(snapshot);
+			loadFragmentDensities(mEditJournalSnapshotName);
+		}
+		else if (!mFragmentDensityFileName.empty())
+			loadFragmentDensities(mFragmentDensityFileName);
+
+		uint64 sequence = mFragmentDensityFile ? mFragmentDensityFile->getSequence() : 0;
+		TerrainEditJournal::RecordList records;
+		TerrainEditJournal::read(mEditJournalName, sequence, records);
+		// Replayed edits are in the journal already; those on pages not loaded yet are
+		// kept per tile and go into the next snapshot along with its fragments.
+		for (size_t i = 0; i < records.size(); ++i)
+		{
+			if (records[i].object)
+			{
+				_applyMetaObject(records[i].object);
+				continue;
+			}
+			TerrainEditJournal::HeightDeltas *heights = records[i].heights;
+			_applyHeightDeltas(heights->tileX, heights->tileZ, heights->x, heights->z, heights->width, 
+				heights->depth, heights->deltas.empty() ? 0 : &heights->deltas[0]);
+			delete heights;
+		}
+		if (!records.empty())
+		{
+			LogManager::getSingleton().logMessage("OverhangTerrainSceneManager: Recovered " + 
+				StringConverter::toString(records.size()) + " terrain edits from " + mEditJournalName);
+		}
+
+		mEditJournal->open(mEditJournalName, sequence);
+	}
     //-------------------------------------------------------------------------
     OverhangTerrainSceneManager::PageSourceIterator OverhangTerrainSceneManager::getPageSourceIterator(void)
     {
@@ -1107,6 +3252,12 @@ namespace Ogre
 		OverhangHeightmapTerrainPageSource* ps = new OverhangHeightmapTerrainPageSource();
 		mTerrainPageSources.push_back(ps);
 		tsm->registerPageSource("Heightmap", ps);
+		OverhangTiledHeightmapTerrainPageSource* tps = new OverhangTiledHeightmapTerrainPageSource();
+		mTerrainPageSources.push_back(tps);
+		tsm->registerPageSource("TiledHeightmap", tps);
+		OverhangNoiseTerrainPageSource* nps = new OverhangNoiseTerrainPageSource();
+		mTerrainPageSources.push_back(nps);
+		tsm->registerPageSource("Noise", nps);
 
 		return tsm;
 
@@ -0,0 +1,195 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "OverhangTiledHeightmapTerrainPageSource.h"
+#include "OverhangTerrainHeightData.h"
+#include "OverhangTerrainSceneManager.h"
+#include "OgreLogManager.h"
+#include "OgreStringConverter.h"
+#include "MappedFile.h"
+
+#include <fstream>
+
+namespace Ogre {
+
+    //-------------------------------------------------------------------------
+    OverhangTiledHeightmapTerrainPageSource::OverhangTiledHeightmapTerrainPageSource()
+        : mPattern("page_{x}_{z}.raw"), mFlipTerrain(false), mRawBpp(2)
+    {
+    }
+    //-------------------------------------------------------------------------
+    OverhangTiledHeightmapTerrainPageSource::~OverhangTiledHeightmapTerrainPageSource()
+    {
+        shutdown();
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTiledHeightmapTerrainPageSource::shutdown(void)
+    {
+        _unloadAllPages();
+        mPageExists.clear();
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTiledHeightmapTerrainPageSource::initialise(OverhangTerrainSceneManager* tsm, 
+        ushort tileSize, ushort pageSize, bool asyncLoading, 
+        OverhangTerrainPageSourceOptionList& optionList)
+    {
+        // Shutdown to clear any previous data
+        shutdown();
+
+        OverhangTerrainPageSource::initialise(tsm, tileSize, pageSize, asyncLoading, optionList);
+
+        OverhangTerrainPageSourceOptionList::iterator ti, tiend;
+        tiend = optionList.end();
+        bool directoryFound = false;
+        bool rawSizeFound = false;
+        bool rawBppFound = false;
+        size_t rawSize = 0;
+        mPattern = "page_{x}_{z}.raw";
+        mFlipTerrain = false;
+        for (ti = optionList.begin(); ti != tiend; ++ti)
+        {
+            String val = ti->first;
+            StringUtil::trim(val);
+            if (StringUtil::startsWith(val, "TiledHeightmap.directory", false))
+            {
+                mDirectory = ti->second;
+                StringUtil::trim(mDirectory);
+                directoryFound = true;
+            }
+            else if (StringUtil::startsWith(val, "TiledHeightmap.pattern", false))
+            {
+                mPattern = ti->second;
+                StringUtil::trim(mPattern);
+            }
+            else if (StringUtil::startsWith(val, "TiledHeightmap.raw.size", false))
+            {
+                rawSize = atoi(ti->second.c_str());
+                rawSizeFound = true;
+            }
+            else if (StringUtil::startsWith(val, "TiledHeightmap.raw.bpp", false))
+            {
+                mRawBpp = atoi(ti->second.c_str());
+                if (mRawBpp < 1 || mRawBpp > 2)
+                {
+                    OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, 
+                        "Invalid value for 'TiledHeightmap.raw.bpp', must be 1 or 2",
+                        "OverhangTiledHeightmapTerrainPageSource::initialise");
+                }
+                rawBppFound = true;
+            }
+            else if (StringUtil::startsWith(val, "TiledHeightmap.flip", false))
+            {
+                mFlipTerrain = StringConverter::parseBool(ti->second);
+            }
+            else
+            {
+                LogManager::getSingleton().logMessage("Warning: ignoring unknown TiledHeightmap option '"
+                    + val + "'");
+            }
+        }
+        if (!directoryFound)
+        {
+            OGRE_EXCEPT(Exception::ERR_ITEM_NOT_FOUND, 
+                "Missing option 'TiledHeightmap.directory'", 
+                "OverhangTiledHeightmapTerrainPageSource::initialise");
+        }
+        if (!rawBppFound)
+        {
+            OGRE_EXCEPT(Exception::ERR_ITEM_NOT_FOUND, 
+                "Option 'TiledHeightmap.raw.bpp' must be specified", 
+                "OverhangTiledHeightmapTerrainPageSource::initialise");
+        }
+        // Every file holds exactly one page
+        if (rawSizeFound && rawSize != mPageSize)
+        {
+            OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, 
+                "'TiledHeightmap.raw.size' must be equal to PageSize", 
+                "OverhangTiledHeightmapTerrainPageSource::initialise");
+        }
+        if (mPattern.find("{x}") == String::npos || mPattern.find("{z}") == String::npos)
+        {
+            OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, 
+                "'TiledHeightmap.pattern' must contain both {x} and {z}", 
+                "OverhangTiledHeightmapTerrainPageSource::initialise");
+        }
+        if (!mDirectory.empty() && mDirectory[mDirectory.size() - 1] != '/' && 
+            mDirectory[mDirectory.size() - 1] != '\\')
+            mDirectory += '/';
+    }
+    //-------------------------------------------------------------------------
+    String OverhangTiledHeightmapTerrainPageSource::getPageFileName(ushort x, ushort z) const
+    {
+        String name = mPattern;
+        String::size_type pos;
+        while ((pos = name.find("{x}")) != String::npos)
+            name.replace(pos, 3, StringConverter::toString(x));
+        while ((pos = name.find("{z}")) != String::npos)
+            name.replace(pos, 3, StringConverter::toString(z));
+        return mDirectory + name;
+    }
+    //-------------------------------------------------------------------------
+    bool OverhangTiledHeightmapTerrainPageSource::hasPage(ushort x, ushort y) const
+    {
+        PageKey key(x, y);
+        std::map<PageKey, bool>::const_iterator i = mPageExists.find(key);
+        if (i != mPageExists.end())
+            return i->second;
+
+        std::ifstream file(getPageFileName(x, y).c_str(), std::ios::in | std::ios::binary);
+        bool exists = file.is_open();
+        mPageExists[key] = exists;
+        return exists;
+    }
+    //-------------------------------------------------------------------------
+    OverhangTerrainPage* OverhangTiledHeightmapTerrainPageSource::_preparePage(ushort x, ushort z)
+    {
+        // The mapping only lives while the tiles copy the samples
+        MappedFile file;
+        file.open(getPageFileName(x, z));
+
+        size_t numBytes = size_t(mPageSize) * mPageSize * mRawBpp;
+        if (file.getSize() != numBytes)
+        {
+            OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, 
+                "RAW size of '" + file.getFilename() + "' (" + StringConverter::toString(file.getSize()) + 
+                ") does not agree with configuration settings.", 
+                "OverhangTiledHeightmapTerrainPageSource::_preparePage");
+        }
+
+        return OverhangTerrainPageSource::_preparePage(OverhangTerrainHeightData(file.getData(), 
+            mPageSize, mRawBpp, mFlipTerrain, 0, 0, 0, true), x, z);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTiledHeightmapTerrainPageSource::requestPage(ushort x, ushort y)
+    {
+        if (hasPage(x, y))
+            _loadPage(x, y);
+    }
+    //-------------------------------------------------------------------------
+    void OverhangTiledHeightmapTerrainPageSource::expirePage(ushort x, ushort y)
+    {
+        _unloadPage(x, y);
+    }
+    //-------------------------------------------------------------------------
+
+}
@@ -0,0 +1,699 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "TerrainEditJournal.h"
+#include "MetaBall.h"
+#include "MetaNoise.h"
+#include "MetaStroke.h"
+#include <boost/crc.hpp>
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#	include <io.h>
+#else
+#	include <sys/time.h>
+#	include <unistd.h>
+#endif
+
+namespace Ogre
+{
+namespace
+{
+	const uint32 VERSION = 1;
+	const uint32 BYTE_ORDER_MARK = 0x01020304;
+
+	struct FileHeader
+	{
+		char magic[4];
+		uint32 version;
+		uint32 byteOrder;
+		uint32 reserved;
+	};
+
+	/// MetaBall, MetaNoise and MetaStroke record flags
+	const uint16 FLAG_EXCAVATING = 1;
+	/// Record type of HeightDeltas, past all MetaObject types
+	const uint16 TYPE_HEIGHT_DELTAS = 0x100;
+	/// Larger payloads are taken as garbage from a torn write (a whole tile of heights fits).
+	const uint32 MAX_PAYLOAD_SIZE = 1 << 20;
+
+	/// Parameters stored for a MetaBall.
+	struct MetaBallPayload
+	{
+		float position[3];
+		float radius;
+	};
+
+	/// Parameters stored for a MetaNoise.
+	struct MetaNoisePayload
+	{
+		float position[3];
+		float halfSize[3];
+		uint32 seed;
+		float frequency;
+		float threshold;
+		float strength;
+		uint16 octaves;
+		uint16 caveType;
+	};
+
+	/// Parameters stored for a MetaCapsule.
+	struct MetaCapsulePayload
+	{
+		float start[3];
+		float end[3];
+		float radius;
+	};
+
+	/// Parameters stored for a MetaStroke, followed by numPoints float[3] points.
+	struct MetaStrokePayload
+	{
+		float radius;
+		uint32 numPoints;
+	};
+
+	/// Rectangle of HeightDeltas, followed by width * depth float deltas.
+	struct HeightDeltasPayload
+	{
+		int32 tileX, tileZ;
+		uint16 x, z, width, depth;
+	};
+
+	void writeFileHeader(std::vector<uchar> &buffer)
+	{
+		FileHeader header;
+		memcpy(header.magic, "OTEJ", 4);
+		header.version = VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		header.reserved = 0;
+		const uchar *bytes = reinterpret_cast<const uchar*>(&header);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(FileHeader));
+	}
+
+	/** Reads the file header of a journal.
+		@returns false if the file is too short to hold one, e.g. when a crash cut off its creation
+		@exception Exception::ERR_INVALIDPARAMS for a header of another file, byte order or version,
+			which must not be overwritten */
+	bool readFileHeader(FILE *file, const String& filename)
+	{
+		FileHeader header;
+		if (fread(&header, sizeof(FileHeader), 1, file) != 1)
+			return false;
+		String problem;
+		if (memcmp(header.magic, "OTEJ", 4) != 0)
+			problem = " is no terrain edit journal";
+		else if (header.byteOrder != BYTE_ORDER_MARK)
+			problem = " was written with the other byte order";
+		else if (header.version != VERSION)
+			problem = " has the unsupported version " + StringConverter::toString(header.version);
+		if (!problem.empty())
+		{
+			OGRE_EXCEPT(Exception::ERR_INVALIDPARAMS, filename + problem, "TerrainEditJournal::readFileHeader");
+		}
+		return true;
+	}
+
+	/// Flushes a file and forces it to disk
+	void syncFile(FILE *file)
+	{
+		fflush(file);
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+		_commit(_fileno(file));
+#else
+		fsync(fileno(file));
+#endif
+	}
+
+	/// Writes data to a file and forces it to disk, or throws
+	void writeFileSynced(const String& filename, const char *mode, const std::vector<uchar> &data)
+	{
+		FILE *file = fopen(filename.c_str(), mode);
+		bool written = file && (data.empty() || fwrite(&data[0], data.size(), 1, file) == 1);
+		if (file)
+		{
+			syncFile(file);
+			written = !ferror(file) && written;
+			written = fclose(file) == 0 && written;
+		}
+		if (!written)
+		{
+			OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Error writing " + filename,
+				"TerrainEditJournal::open");
+		}
+	}
+
+	uint32 checksum(TerrainEditJournal::RecordHeader header, const std::vector<uchar> &payload)
+	{
+		header.crc = 0;
+		boost::crc_32_type crc;
+		crc.process_bytes(&header, sizeof(header));
+		if (!payload.empty())
+			crc.process_bytes(&payload[0], payload.size());
+		return crc.checksum();
+	}
+}
+//-----------------------------------------------------------------------
+TerrainEditJournal::TerrainEditJournal()
+: mFile(0), mSequence(0), mNumRecords(0), mSyncRecords(1), mSyncMilliseconds(0),
+  mUnsyncedRecords(0), mFirstUnsyncedTime(0)
+{
+}
+//-----------------------------------------------------------------------
+TerrainEditJournal::~TerrainEditJournal()
+{
+	close();
+}
+//-----------------------------------------------------------------------
+uint64 TerrainEditJournal::getTimestamp()
+{
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	uint64 t = (uint64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	// 100ns intervals since 1601 -> ms since 1970
+	return t / 10000 - 11644473600000ULL;
+#else
+	timeval tv;
+	gettimeofday(&tv, 0);
+	return uint64(tv.tv_sec)*1000 + tv.tv_usec/1000;
+#endif
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::replaceFile(const String& from, const String& to)
+{
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+	bool replaced = MoveFileExA(from.c_str(), to.c_str(), 
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool replaced = rename(from.c_str(), to.c_str()) == 0;
+#endif
+	if (!replaced)
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Cannot replace " + to + " with " + from,
+			"TerrainEditJournal::replaceFile");
+	}
+}
+//-----------------------------------------------------------------------
+bool TerrainEditJournal::readRecord(FILE *file, RecordHeader &header, std::vector<uchar> &payload)
+{
+	if (fread(&header, sizeof(RecordHeader), 1, file) != 1)
+		return false;
+	if (header.payloadSize > MAX_PAYLOAD_SIZE)
+		return false;
+	payload.resize(header.payloadSize);
+	if (header.payloadSize && fread(&payload[0], header.payloadSize, 1, file) != 1)
+		return false;
+	// A zeroed or garbage tail may still look like a record
+	return header.crc == checksum(header, payload);
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::writeRecord(std::vector<uchar> &buffer, RecordHeader header, const std::vector<uchar> &payload)
+{
+	header.payloadSize = uint32(payload.size());
+	header.reserved = 0;
+	header.crc = checksum(header, payload);
+	const uchar *bytes = reinterpret_cast<const uchar*>(&header);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(RecordHeader));
+	buffer.insert(buffer.end(), payload.begin(), payload.end());
+}
+//-----------------------------------------------------------------------
+size_t TerrainEditJournal::scan(FILE *file, const String& filename, uint64 &lastSequence)
+{
+	lastSequence = 0;
+	fseek(file, 0, SEEK_SET);
+	if (!readFileHeader(file, filename))
+		return 0;
+
+	size_t valid = sizeof(FileHeader);
+	std::vector<uchar> payload;
+	RecordHeader header;
+	while (readRecord(file, header, payload))
+	{
+		valid = size_t(ftell(file));
+		lastSequence = header.sequence;
+	}
+	return valid;
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::open(const String& filename, uint64 firstSequence)
+{
+	close();
+
+	// Find the valid part of an existing journal and cut off a torn last record.
+	// A file that is no journal of this build throws rather than being overwritten.
+	uint64 lastSequence = 0;
+	size_t fileSize = 0, valid = 0;
+	std::vector<uchar> prefix, tail;
+	FILE *existing = fopen(filename.c_str(), "rb");
+	if (existing)
+	{
+		fseek(existing, 0, SEEK_END);
+		fileSize = size_t(ftell(existing));
+		try
+		{
+			valid = scan(existing, filename, lastSequence);
+		}
+		catch (...)
+		{
+			fclose(existing);
+			throw;
+		}
+		bool complete = true;
+		if (valid < fileSize)
+		{
+			fseek(existing, 0, SEEK_SET);
+			prefix.resize(valid);
+			tail.resize(fileSize - valid);
+			complete = (prefix.empty() || fread(&prefix[0], prefix.size(), 1, existing) == 1) &&
+				fread(&tail[0], tail.size(), 1, existing) == 1;
+		}
+		fclose(existing);
+		if (!complete)
+		{
+			OGRE_EXCEPT(Exception::ERR_INTERNAL_ERROR, "Error reading " + filename, 
+				"TerrainEditJournal::open");
+		}
+	}
+
+	if (valid == 0 || valid < fileSize)
+	{
+		if (!tail.empty())
+		{
+			// A torn last record, or everything after a damaged one; kept for inspection
+			String corruptName = filename + ".corrupt";
+			LogManager::getSingleton().logMessage("TerrainEditJournal: Dropping " + 
+				StringConverter::toString(tail.size()) + " invalid bytes at the end of " + filename +
+				", appended to " + corruptName);
+			writeFileSynced(corruptName, "ab", tail);
+		}
+		if (prefix.empty())
+			writeFileHeader(prefix);
+
+		// Write next to the journal and rename, so a crash or a full disk leaves it intact
+		String tempName = filename + ".tmp";
+		writeFileSynced(tempName, "wb", prefix);
+		replaceFile(tempName, filename);
+	}
+
+	mFile = fopen(filename.c_str(), "ab");
+	if (!mFile)
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Cannot open " + filename + " for appending",
+			"TerrainEditJournal::open");
+	}
+	mFilename = filename;
+	mSequence = std::max(firstSequence, lastSequence);
+	mNumRecords = 0;
+	mUnsyncedRecords = 0;
+	sync();
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::close()
+{
+	if (!mFile)
+		return;
+	sync();
+	fclose(mFile);
+	mFile = 0;
+}
+//-----------------------------------------------------------------------
+bool TerrainEditJournal::isJournaled(const MetaObject *mo)
+{
+	// Heightmaps are part of the page data, not edits.
+	return mo->getType() != MetaObject::MOT_HEIGHTMAP;
+}
+//-----------------------------------------------------------------------
+bool TerrainEditJournal::serialise(const MetaObject *mo, RecordHeader &header, std::vector<uchar> &payload)
+{
+	header.type = uint16(mo->getType());
+	header.flags = 0;
+	switch (mo->getType())
+	{
+	case MetaObject::MOT_BALL:
+		{
+			const MetaBall *ball = static_cast<const MetaBall*>(mo);
+			MetaBallPayload p;
+			p.position[0] = ball->getPosition().x;
+			p.position[1] = ball->getPosition().y;
+			p.position[2] = ball->getPosition().z;
+			p.radius = ball->getRadius();
+			if (ball->isExcavating())
+				header.flags |= FLAG_EXCAVATING;
+			payload.resize(sizeof(MetaBallPayload));
+			memcpy(&payload[0], &p, sizeof(MetaBallPayload));
+			break;
+		}
+	case MetaObject::MOT_NOISE:
+		{
+			const MetaNoise *noise = static_cast<const MetaNoise*>(mo);
+			MetaNoisePayload p;
+			for (int i = 0; i < 3; ++i)
+			{
+				p.position[i] = noise->getPosition()[i];
+				p.halfSize[i] = noise->getHalfSize()[i];
+			}
+			p.seed = noise->getSeed();
+			p.frequency = noise->getFrequency();
+			p.threshold = noise->getThreshold();
+			p.strength = noise->getStrength();
+			p.octaves = noise->getOctaves();
+			p.caveType = uint16(noise->getCaveType());
+			if (noise->isExcavating())
+				header.flags |= FLAG_EXCAVATING;
+			payload.resize(sizeof(MetaNoisePayload));
+			memcpy(&payload[0], &p, sizeof(MetaNoisePayload));
+			break;
+		}
+	case MetaObject::MOT_CAPSULE:
+		{
+			const MetaCapsule *capsule = static_cast<const MetaCapsule*>(mo);
+			MetaCapsulePayload p;
+			Vector3 end = capsule->getEnd();
+			for (int i = 0; i < 3; ++i)
+			{
+				p.start[i] = capsule->getStart()[i];
+				p.end[i] = end[i];
+			}
+			p.radius = capsule->getRadius();
+			if (capsule->isExcavating())
+				header.flags |= FLAG_EXCAVATING;
+			payload.resize(sizeof(MetaCapsulePayload));
+			memcpy(&payload[0], &p, sizeof(MetaCapsulePayload));
+			break;
+		}
+	case MetaObject::MOT_STROKE:
+		{
+			const MetaStroke *stroke = static_cast<const MetaStroke*>(mo);
+			MetaStrokePayload p;
+			p.radius = stroke->getRadius();
+			p.numPoints = uint32(stroke->getNumPoints());
+			if (stroke->isExcavating())
+				header.flags |= FLAG_EXCAVATING;
+			payload.resize(sizeof(MetaStrokePayload) + p.numPoints*3*sizeof(float));
+			memcpy(&payload[0], &p, sizeof(MetaStrokePayload));
+			float *points = reinterpret_cast<float*>(&payload[sizeof(MetaStrokePayload)]);
+			for (uint32 i = 0; i < p.numPoints; ++i)
+			{
+				Vector3 pt = stroke->getPoint(i);
+				*points++ = pt.x;
+				*points++ = pt.y;
+				*points++ = pt.z;
+			}
+			break;
+		}
+	default:
+		// Heightmaps are part of the page data, not edits.
+		return false;
+	}
+	header.payloadSize = uint32(payload.size());
+	return true;
+}
+//-----------------------------------------------------------------------
+MetaObject* TerrainEditJournal::deserialise(const RecordHeader &header, const uchar *payload)
+{
+	switch (header.type)
+	{
+	case MetaObject::MOT_BALL:
+		{
+			if (header.payloadSize < sizeof(MetaBallPayload))
+				return 0;
+			MetaBallPayload p;
+			memcpy(&p, payload, sizeof(MetaBallPayload));
+			return new MetaBall(0, Vector3(p.position[0], p.position[1], p.position[2]), p.radius,
+				(header.flags & FLAG_EXCAVATING) != 0);
+		}
+	case MetaObject::MOT_NOISE:
+		{
+			if (header.payloadSize < sizeof(MetaNoisePayload))
+				return 0;
+			MetaNoisePayload p;
+			memcpy(&p, payload, sizeof(MetaNoisePayload));
+			return new MetaNoise(0, Vector3(p.position[0], p.position[1], p.position[2]),
+				Vector3(p.halfSize[0], p.halfSize[1], p.halfSize[2]), p.seed, p.frequency,
+				MetaNoise::CaveType(p.caveType), p.threshold, p.strength, p.octaves,
+				(header.flags & FLAG_EXCAVATING) != 0);
+		}
+	case MetaObject::MOT_CAPSULE:
+		{
+			if (header.payloadSize < sizeof(MetaCapsulePayload))
+				return 0;
+			MetaCapsulePayload p;
+			memcpy(&p, payload, sizeof(MetaCapsulePayload));
+			return new MetaCapsule(0, Vector3(p.start[0], p.start[1], p.start[2]), 
+				Vector3(p.end[0], p.end[1], p.end[2]), p.radius, (header.flags & FLAG_EXCAVATING) != 0);
+		}
+	case MetaObject::MOT_STROKE:
+		{
+			if (header.payloadSize < sizeof(MetaStrokePayload))
+				return 0;
+			MetaStrokePayload p;
+			memcpy(&p, payload, sizeof(MetaStrokePayload));
+			if (p.numPoints == 0 || p.numPoints > MetaStroke::MAX_POINTS ||
+				header.payloadSize < sizeof(MetaStrokePayload) + p.numPoints*3*sizeof(float))
+				return 0;
+			std::vector<Vector3> points(p.numPoints);
+			const uchar *src = payload + sizeof(MetaStrokePayload);
+			for (uint32 i = 0; i < p.numPoints; ++i, src += 3*sizeof(float))
+			{
+				float pt[3];
+				memcpy(pt, src, sizeof(pt));
+				points[i] = Vector3(pt[0], pt[1], pt[2]);
+			}
+			return new MetaStroke(0, points, p.radius, (header.flags & FLAG_EXCAVATING) != 0);
+		}
+	default:
+		return 0;
+	}
+}
+//-----------------------------------------------------------------------
+TerrainEditJournal::HeightDeltas* TerrainEditJournal::deserialiseHeights(const RecordHeader &header, 
+	const uchar *payload)
+{
+	if (header.type != TYPE_HEIGHT_DELTAS || header.payloadSize < sizeof(HeightDeltasPayload))
+		return 0;
+	HeightDeltasPayload p;
+	memcpy(&p, payload, sizeof(HeightDeltasPayload));
+	size_t count = size_t(p.width) * p.depth;
+	if (header.payloadSize < sizeof(HeightDeltasPayload) + count*sizeof(float))
+		return 0;
+	HeightDeltas *heights = new HeightDeltas();
+	heights->tileX = p.tileX;
+	heights->tileZ = p.tileZ;
+	heights->x = p.x;
+	heights->z = p.z;
+	heights->width = p.width;
+	heights->depth = p.depth;
+	heights->deltas.resize(count);
+	if (count)
+		memcpy(&heights->deltas[0], payload + sizeof(HeightDeltasPayload), count*sizeof(float));
+	return heights;
+}
+//-----------------------------------------------------------------------
+uint64 TerrainEditJournal::append(const MetaObject *mo)
+{
+	assert(mFile);
+	RecordHeader header;
+	std::vector<uchar> payload;
+	if (!serialise(mo, header, payload))
+		return 0;
+	return _append(header, payload);
+}
+//-----------------------------------------------------------------------
+uint64 TerrainEditJournal::append(const HeightDeltas& heights)
+{
+	assert(mFile && heights.deltas.size() == heights.width*heights.depth);
+	HeightDeltasPayload p;
+	p.tileX = heights.tileX;
+	p.tileZ = heights.tileZ;
+	p.x = uint16(heights.x);
+	p.z = uint16(heights.z);
+	p.width = uint16(heights.width);
+	p.depth = uint16(heights.depth);
+	std::vector<uchar> payload(sizeof(HeightDeltasPayload) + heights.deltas.size()*sizeof(float));
+	memcpy(&payload[0], &p, sizeof(HeightDeltasPayload));
+	if (!heights.deltas.empty())
+		memcpy(&payload[sizeof(HeightDeltasPayload)], &heights.deltas[0], heights.deltas.size()*sizeof(float));
+
+	RecordHeader header;
+	header.type = TYPE_HEIGHT_DELTAS;
+	header.flags = 0;
+	header.payloadSize = uint32(payload.size());
+	return _append(header, payload);
+}
+//-----------------------------------------------------------------------
+uint64 TerrainEditJournal::_append(RecordHeader &header, const std::vector<uchar> &payload)
+{
+	header.sequence = ++mSequence;
+	header.timestamp = getTimestamp();
+	std::vector<uchar> record;
+	writeRecord(record, header, payload);
+	fwrite(&record[0], record.size(), 1, mFile);
+	if (ferror(mFile))
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Error writing " + mFilename,
+			"TerrainEditJournal::append");
+	}
+	++mNumRecords;
+
+	if (mUnsyncedRecords++ == 0)
+		mFirstUnsyncedTime = header.timestamp;
+	if (mUnsyncedRecords >= mSyncRecords || 
+		(mSyncMilliseconds && header.timestamp - mFirstUnsyncedTime >= mSyncMilliseconds))
+	{
+		sync();
+	}
+	return header.sequence;
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::sync()
+{
+	if (!mFile)
+		return;
+	syncFile(mFile);
+	mUnsyncedRecords = 0;
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::syncIfDue()
+{
+	// append only sees the time when the next record arrives, which may be never
+	if (mFile && mUnsyncedRecords && mSyncMilliseconds && 
+		getTimestamp() - mFirstUnsyncedTime >= mSyncMilliseconds)
+	{
+		sync();
+	}
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::truncate()
+{
+	assert(mFile);
+	fclose(mFile);
+	mFile = fopen(mFilename.c_str(), "wb");
+	if (!mFile)
+	{
+		OGRE_EXCEPT(Exception::ERR_CANNOT_WRITE_TO_FILE, "Cannot truncate " + mFilename,
+			"TerrainEditJournal::truncate");
+	}
+	// Sequence numbers keep counting, the snapshot refers to them.
+	std::vector<uchar> header;
+	writeFileHeader(header);
+	fwrite(&header[0], header.size(), 1, mFile);
+	mNumRecords = 0;
+	sync();
+}
+//-----------------------------------------------------------------------
+void TerrainEditJournal::setSyncBatch(size_t records, unsigned long milliseconds)
+{
+	mSyncRecords = std::max(records, size_t(1));
+	mSyncMilliseconds = milliseconds;
+}
+//-----------------------------------------------------------------------
+size_t TerrainEditJournal::read(const String& filename, uint64 afterSequence, RecordList& records)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return 0;
+
+	size_t count = 0;
+	bool hasHeader;
+	try
+	{
+		hasHeader = readFileHeader(file, filename);
+	}
+	catch (...)
+	{
+		fclose(file);
+		throw;
+	}
+	if (hasHeader)
+	{
+		std::vector<uchar> payload;
+		RecordHeader header;
+		while (readRecord(file, header, payload))
+		{
+			if (header.sequence <= afterSequence)
+				continue;
+			Record r;
+			r.sequence = header.sequence;
+			r.timestamp = header.timestamp;
+			r.object = deserialise(header, payload.empty() ? 0 : &payload[0]);
+			r.heights = r.object ? 0 : deserialiseHeights(header, payload.empty() ? 0 : &payload[0]);
+			if (!r.object && !r.heights)
+			{
+				LogManager::getSingleton().logMessage("TerrainEditJournal: Skipping record " + 
+					StringConverter::toString(size_t(header.sequence)) + " of unknown type " + 
+					StringConverter::toString(header.type));
+				continue;
+			}
+			records.push_back(r);
+			++count;
+		}
+	}
+	fclose(file);
+	return count;
+}
+//-----------------------------------------------------------------------
+size_t TerrainEditJournal::writeRecords(const std::vector<MetaObject*>& objects, std::vector<uchar>& buffer)
+{
+	size_t count = 0;
+	RecordHeader header;
+	std::vector<uchar> payload;
+	for (std::vector<MetaObject*>::const_iterator it = objects.begin(); it != objects.end(); ++it)
+	{
+		if (!serialise(*it, header, payload))
+			continue;
+		// Only their order matters outside of a journal
+		header.sequence = 0;
+		header.timestamp = 0;
+		writeRecord(buffer, header, payload);
+		++count;
+	}
+	return count;
+}
+//-----------------------------------------------------------------------
+size_t TerrainEditJournal::readRecords(const uchar* data, size_t size, std::vector<MetaObject*>& objects)
+{
+	size_t count = 0;
+	RecordHeader header;
+	std::vector<uchar> payload;
+	while (size >= sizeof(RecordHeader))
+	{
+		memcpy(&header, data, sizeof(RecordHeader));
+		if (header.payloadSize > MAX_PAYLOAD_SIZE || header.payloadSize > size - sizeof(RecordHeader))
+			break;
+		payload.assign(data + sizeof(RecordHeader), data + sizeof(RecordHeader) + header.payloadSize);
+		if (header.crc != checksum(header, payload))
+			break;
+		data += sizeof(RecordHeader) + header.payloadSize;
+		size -= sizeof(RecordHeader) + header.payloadSize;
+
+		if (MetaObject *mo = deserialise(header, payload.empty() ? 0 : &payload[0]))
+		{
+			objects.push_back(mo);
+			++count;
+		}
+	}
+	return count;
+}
+
+}// namespace Ogre
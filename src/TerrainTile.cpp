@@ -30,15 +30,41 @@ http://www.gnu.org/copyleft/lesser.txt.
 #include "IsoSurfaceRenderable.h"
 #include "MetaWorldFragment.h"
 #include "MetaHeightmap.h"
+#include "IsoSurfaceBuilder.h"
+#include "DataGrid.h"
+#include <algorithm>
+#include <boost/bind/bind.hpp>
 
 
 namespace Ogre
 {
 
+namespace
+{
+	/// Returns true if the fragment overlaps [minX, maxX] x [minZ, maxZ] in the xz-plane
+	bool overlaps(MetaWorldFragment *wf, Real minX, Real minZ, Real maxX, Real maxZ)
+	{
+		Real halfSize = 0.5*MetaWorldFragment::getSize();
+		Vector3 pos = wf->getPosition();
+		return pos.x + halfSize >= minX && pos.x - halfSize <= maxX &&
+			pos.z + halfSize >= minZ && pos.z - halfSize <= maxZ;
+	}
+
+	/// Evaluates the field of a heightmap alone over the data grid of a fragment
+	void sampleHeightmap(MetaHeightmap *mhm, MetaWorldFragment *wf, DataGrid *dg, Real *values)
+	{
+		dg->setPosition(wf->getPosition());
+		dg->clear();
+		mhm->updateDataGrid(dg);
+		memcpy(values, dg->getValues(), dg->getNumGridPoints()*sizeof(Real));
+	}
+}
+
 TerrainTile::TerrainTile(const String& name, OverhangTerrainSceneManager* tsm, SceneNode *c)
 : mTerrainRenderable(0), mSceneNode(c)
 {
 	mTerrainRenderable = new OverhangTerrainRenderable(name, tsm);
+	mSeamSnap = boost::bind(&OverhangTerrainRenderable::_snapToSeam, mTerrainRenderable, boost::placeholders::_1);
 	for ( int i = 0; i < 4; i++ )
 	{
 		mNeighbors[ i ] = 0;
@@ -54,7 +80,7 @@ void TerrainTile::_setNeighbor(Neighbor n, TerrainTile * t )
 {
 	mNeighbors[n] = t;
 	if(mTerrainRenderable)
-		mTerrainRenderable->_setNeighbor(OverhangTerrainRenderable::Neighbor(n), t->getTerrainRenderable());
+		mTerrainRenderable->_setNeighbor(OverhangTerrainRenderable::Neighbor(n), t ? t->getTerrainRenderable() : 0);
 }
 
 void TerrainTile::deleteGeometry()
@@ -85,9 +111,25 @@ void TerrainTile::setRenderQueueGroup(uint8 qid)
 	}
 }
 
-void TerrainTile::initialise(int startx, int startz, Real* pageHeightData)
+void TerrainTile::initialise(int startx, int startz, const OverhangTerrainHeightData& pageHeightData,
+	int originx, int originz)
 {
-	mTerrainRenderable->initialise(startx, startz, pageHeightData);
+	prepare(startx, startz, pageHeightData, originx, originz);
+	load();
+}
+
+void TerrainTile::prepare(int startx, int startz, const OverhangTerrainHeightData& pageHeightData,
+	int originx, int originz)
+{
+	mTerrainRenderable->prepare(startx, startz, pageHeightData, originx, originz);
+}
+
+void TerrainTile::load(SceneNode *c)
+{
+	if(c)
+		mSceneNode = c;
+	assert(mSceneNode);
+	mTerrainRenderable->load();
 	mSceneNode->attachObject(mTerrainRenderable);
 }
 
@@ -145,55 +187,357 @@ bool TerrainTile::intersectSegment( const Vector3 & start, const Vector3 & end,
 	assert(mTerrainRenderable);
 	return mTerrainRenderable->intersectSegment( start, end, result);
 }
+bool TerrainTile::intersectFragments(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t) const
+{
+	bool hit = false;
+	for(std::vector<MetaWorldFragment*>::const_iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+	{
+		// Each hit shortens the ray for the fragments after it
+		if((*it)->intersectRay(origin, dir, maxT, t))
+		{
+			maxT = t;
+			hit = true;
+		}
+	}
+	return hit;
+}
+bool TerrainTile::sweepFragments(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal) const
+{
+	bool hit = false;
+	for(std::vector<MetaWorldFragment*>::const_iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+	{
+		if((*it)->sweep(sweep, maxT, t, normal))
+		{
+			maxT = t;
+			hit = true;
+		}
+	}
+	return hit;
+}
 float TerrainTile::getHeightAt( float x, float y )
 {
 	assert(mTerrainRenderable);
 	return mTerrainRenderable->getHeightAt(x,y);
 }
 
+bool TerrainTile::modifyHeights(Real minX, Real minZ, Real maxX, Real maxZ, const HeightBrush& brush,
+	IsoSurfaceBuilder *isb)
+{
+	assert(mTerrainRenderable);
+	// Baked fragments hold the heightmap field of the heights they were baked with. Heights
+	// are interpolated between vertices, so the field changes up to a quad around the brush.
+	const OverhangTerrainOptions *opts = mTerrainRenderable->getOptions();
+	Real margin = std::max(opts->scale.x, opts->scale.z);
+	std::vector<MetaWorldFragment*> baked;
+	for(std::vector<MetaWorldFragment*>::iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+	{
+		if((*it)->isBaked() && overlaps(*it, minX - margin, minZ - margin, maxX + margin, maxZ + margin))
+			baked.push_back(*it);
+	}
+	DataGrid *dg = isb->getDataGrid();
+	size_t numGridPoints = dg->getNumGridPoints();
+	std::vector<Real> oldFields(baked.size()*numGridPoints);
+	MetaHeightmap *probe = new MetaHeightmap(0, this, 0.2);
+	for(size_t i = 0; i < baked.size(); ++i)
+		sampleHeightmap(probe, baked[i], dg, &oldFields[i*numGridPoints]);
+
+	bool changed = mTerrainRenderable->_modifyHeights(minX, minZ, maxX, maxZ, brush, &mHeightDeltas);
+	if(changed)
+	{
+		// Swap the old field for the new one, the rest of the baked layer stays
+		std::vector<Real> field(numGridPoints);
+		for(size_t i = 0; i < baked.size(); ++i)
+		{
+			sampleHeightmap(probe, baked[i], dg, &field[0]);
+			for(size_t j = 0; j < numGridPoints; ++j)
+				field[j] -= oldFields[i*numGridPoints + j];
+			baked[i]->addBakedValues(&field[0], numGridPoints);
+		}
+	}
+	delete probe;
+	if(!changed)
+		return false;
+
+	// the bounds of the renderable changed
+	if(mSceneNode)
+		mSceneNode->needUpdate();
+	return true;
+}
+
+void TerrainTile::_notifyHeightsChanged(Real minX, Real minZ, Real maxX, Real maxZ, IsoSurfaceBuilder *isb)
+{
+	assert(mTerrainRenderable);
+	mTerrainRenderable->_updateNormals(minX, minZ, maxX, maxZ);
+
+	// The heightfield may have moved into fragments or out of them
+	Vector3 halfSize = 0.5*MetaWorldFragment::getSize()*Vector3::UNIT_SCALE;
+	MetaHeightmap *probe = new MetaHeightmap(0, this, 0.2);
+	std::vector<MetaWorldFragment*> frags;
+	for(std::vector<MetaWorldFragment*>::iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+	{
+		MetaWorldFragment *wf = *it;
+		if(!overlaps(wf, minX, minZ, maxX, maxZ))
+			continue;
+		frags.push_back(wf);
+
+		Vector3 pos = wf->getPosition();
+		AxisAlignedBox box(pos - halfSize, pos + halfSize);
+		MetaWorldFragment::Classification c = probe->classify(box);
+		MetaWorldFragment::Classification old = wf->getClassification();
+		if(c == old)
+			continue;
+		wf->setClassification(c);
+		// Fragments created in the air were left without the heightmap; baked ones got
+		// the new field from modifyHeights
+		if(old == MetaWorldFragment::FC_AIR && !wf->isBaked() && !wf->hasHeightmap())
+			wf->addMetaObject(new MetaHeightmap(0, this, 0.2));
+		// The fragment now holds the surface the heightfield draws, and takes over from it
+		if(c == MetaWorldFragment::FC_SURFACE)
+			_cutHeightfield(wf, box, isb);
+	}
+	delete probe;
+
+	// Levels the heightfield moved into need fragments to fill its holes as well
+	std::vector<MetaWorldFragment*> added;
+	_addHoleFillers(0, added);
+
+	for(std::vector<MetaWorldFragment*>::iterator it = frags.begin(); it != frags.end(); ++it)
+		(*it)->update(isb);
+	for(std::vector<MetaWorldFragment*>::iterator it = added.begin(); it != added.end(); ++it)
+	{
+		(*it)->update(isb);
+		_attachMetaWorldFragment(*it, (*it)->getPosition());
+	}
+}
+
 void TerrainTile::addMetaObject(MetaObject *mo, int level, IsoSurfaceBuilder *isb, const Vector3 &pos)
 {
 	// check if level already exists.
-	for(std::vector<MetaWorldFragment*>::iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+	MetaWorldFragment *wf = getMetaWorldFragment(level);
+	bool created = !wf;
+	if(created)
 	{
-		if(level == (*it)->getYLevel())
+		//this y-level didn't exist - we have to create it!
+		MetaHeightmap *mhm = new MetaHeightmap(0, this, 0.2);
+		Vector3 halfSize = 0.5*MetaWorldFragment::getSize()*Vector3::UNIT_SCALE;
+		MetaWorldFragment::Classification c = mhm->classify(AxisAlignedBox(pos - halfSize, pos + halfSize));
+		if(c == MetaWorldFragment::FC_AIR)
 		{
-			(*it)->addMetaObject(mo);
-			(*it)->update(isb);
-			return;
+			// The heightmap adds nothing up here, and digging in the air leaves no surface
+			delete mhm;
+			if(mo->isExcavating())
+				return;
+			mhm = 0;
 		}
+		wf = new MetaWorldFragment(0, pos, level);
+		wf->setClassification(c);
+		if(mhm)
+			wf->addMetaObject(mhm);
 	}
-	//this y-level didn't exist - we have to create it!
-	MetaWorldFragment *wf = new MetaWorldFragment(0, mTerrainRenderable->getWorldPosition()+Vector3(0,level*MetaWorldFragment::getScale(),0), level);
-	MetaHeightmap *mhm = new MetaHeightmap(0, this, 0.2);
-	wf->addMetaObject(mhm);
 	wf->addMetaObject(mo);
-	mMetaWorldFragments.push_back(wf);
+	_cutHeightfield(wf, mo->getAABB(), isb);
 	wf->update(isb);
+	if(created)
+		_attachMetaWorldFragment(wf, pos);
+}
 
+void TerrainTile::addBakedMetaWorldFragment(int level, const Vector3 &pos, const Real *values, size_t numGridPoints,
+	IsoSurfaceBuilder *isb, bool hideHeightfield, const uchar *columns)
+{
+	MetaWorldFragment *wf = getMetaWorldFragment(level);
+	bool created = !wf;
+	Vector3 halfSize = 0.5*MetaWorldFragment::getSize()*Vector3::UNIT_SCALE;
+	if(created)
+	{
+		wf = new MetaWorldFragment(0, pos, level);
+		MetaHeightmap *mhm = new MetaHeightmap(0, this, 0.2);
+		wf->setClassification(mhm->classify(AxisAlignedBox(pos - halfSize, pos + halfSize)));
+		delete mhm;
+	}
+	wf->setBakedValues(values, numGridPoints);
+	if(canCutHoles(isb))
+	{
+		if(wf->getClassification() == MetaWorldFragment::FC_SURFACE)
+		{
+			wf->setColumnMask(&mTerrainRenderable->getHoles());
+			wf->setVertexSnap(&mSeamSnap);
+			// Densities stored without columns took over the whole tile
+			if(columns)
+				wf->setCarvedColumns(columns);
+			else
+				wf->carveColumns(AxisAlignedBox(pos - halfSize, pos + halfSize));
+			_updateHoles(wf, isb);
+		}
+	}
+	else if(hideHeightfield)
+	{
+		_hideHeightfield();
+		wf->setVertexSnap(&mSeamSnap);
+	}
+	wf->update(isb);
+	if(created)
+		_attachMetaWorldFragment(wf, pos);
+}
+
+MetaWorldFragment* TerrainTile::getMetaWorldFragment(int level)
+{
+	for(std::vector<MetaWorldFragment*>::iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+	{
+		if(level == (*it)->getYLevel())
+			return *it;
+	}
+	return 0;
+}
+
+bool TerrainTile::isHeightfieldHidden() const
+{
+	return mTerrainRenderable && !mTerrainRenderable->getVisible();
+}
+
+bool TerrainTile::isHeightfieldReplaced() const
+{
+	return isHeightfieldHidden() || (mTerrainRenderable && !mTerrainRenderable->getHoles().empty());
+}
+
+bool TerrainTile::canCutHoles(IsoSurfaceBuilder *isb) const
+{
+	const OverhangTerrainOptions *opts = mTerrainRenderable->getOptions();
+	const DataGrid *dg = isb->getDataGrid();
+	size_t quads = opts->tileSize - 1;
+	return dg->getNumCellsX() == quads && dg->getNumCellsZ() == quads &&
+		Math::RealEqual(dg->getGridScale(), opts->scale.x, 1e-4) &&
+		Math::RealEqual(dg->getGridScale(), opts->scale.z, 1e-4);
+}
+
+size_t TerrainTile::getMemoryUsage() const
+{
+	size_t bytes = sizeof(TerrainTile) + sizeof(OverhangTerrainRenderable);
+	if(mTerrainRenderable)
+		bytes += mTerrainRenderable->getMemoryUsage();
+	bytes += mHeightDeltas.capacity()*sizeof(float);
+	for(std::vector<MetaWorldFragment*>::const_iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+		bytes += (*it)->getMemoryUsage();
+	return bytes;
+}
+
+unsigned long TerrainTile::getLastVisibleFrame() const
+{
+	unsigned long frame = mTerrainRenderable ? mTerrainRenderable->getLastVisibleFrame() : 0;
+	for(std::vector<MetaWorldFragment*>::const_iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+		frame = std::max(frame, (*it)->getLastVisibleFrame());
+	return frame;
+}
+
+void TerrainTile::_attachMetaWorldFragment(MetaWorldFragment *wf, const Vector3 &pos)
+{
+	mMetaWorldFragments.push_back(wf);
 	mMetaRenderables.push_back(wf->getIsoSurface());
 	SceneNode *child = mSceneNode->createChildSceneNode(pos);
 	child->attachObject(wf->getIsoSurface());
 	//child->showBoundingBox(true);
+}
 
-	// if meta object intersects terrain renderable
-	if(mTerrainRenderable->getBoundingBox().intersects(mo->getAABB())) {
+void TerrainTile::_hideHeightfield()
+{
+	if(!mTerrainRenderable->getVisible())
+		return;
+	// make terrain renderable invisible
+	mTerrainRenderable->setVisible(false);
 
-		// make terrain renderable invisible
-		mTerrainRenderable->setVisible(false);
+	// neighbours stitch their edges to the coarsest LOD now, which the fragments snap to
+	mTerrainRenderable->_notifySeamsChanged();
+	for(std::vector<MetaWorldFragment*>::iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+		(*it)->setVertexSnap(&mSeamSnap);
+}
 
-		//finally, a cheap hack to fix stitching. Simply force renderlevel to highest detail on surrounding tiles.
-		//mTerrainRenderable->setForcedRenderLevel(0);
-		for (int i = 0; i < 4; ++i) {
-			OverhangTerrainRenderable::Neighbor n =
-					OverhangTerrainRenderable::Neighbor(i);
-			OverhangTerrainRenderable *t = mTerrainRenderable->_getNeighbor(n);
-			if (t)
-				t->setForcedRenderLevel(0);
+void TerrainTile::_cutHeightfield(MetaWorldFragment *wf, const AxisAlignedBox &box, IsoSurfaceBuilder *isb)
+{
+	if(!canCutHoles(isb))
+	{
+		// if meta object intersects terrain renderable
+		if(mTerrainRenderable->getBoundingBox().intersects(box))
+		{
+			_hideHeightfield();
+			wf->setVertexSnap(&mSeamSnap);
 		}
+		return;
+	}
+	// Without the heightfield passing through, the fragment adds to it instead of replacing it
+	if(wf->getClassification() != MetaWorldFragment::FC_SURFACE)
+		return;
+	wf->setColumnMask(&mTerrainRenderable->getHoles());
+	wf->setVertexSnap(&mSeamSnap);
+	if(wf->carveColumns(box))
+		_updateHoles(wf, isb);
+}
+
+void TerrainTile::_updateHoles(MetaWorldFragment *skip, IsoSurfaceBuilder *isb)
+{
+	// skip may be a new fragment that is attached after its first update
+	std::vector<MetaWorldFragment*> frags(mMetaWorldFragments);
+	if(skip && std::find(frags.begin(), frags.end(), skip) == frags.end())
+		frags.push_back(skip);
+
+	std::vector<uchar> holes;
+	for(std::vector<MetaWorldFragment*>::iterator it = frags.begin(); it != frags.end(); ++it)
+	{
+		const std::vector<uchar>& carved = (*it)->getCarvedColumns();
+		if(carved.empty())
+			continue;
+		if(holes.empty())
+			holes.assign(carved.size(), 0);
+		for(size_t i = 0; i < carved.size(); ++i)
+			holes[i] |= carved[i];
+	}
+	if(!mTerrainRenderable->_setHoles(holes))
+		return;
+
+	std::vector<MetaWorldFragment*> added;
+	_addHoleFillers(skip, added);
+
+	for(std::vector<MetaWorldFragment*>::iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+	{
+		if(*it != skip)
+			(*it)->update(isb);
+	}
+	for(std::vector<MetaWorldFragment*>::iterator it = added.begin(); it != added.end(); ++it)
+	{
+		(*it)->update(isb);
+		_attachMetaWorldFragment(*it, (*it)->getPosition());
 	}
 }
 
+void TerrainTile::_addHoleFillers(MetaWorldFragment *skip, std::vector<MetaWorldFragment*>& added)
+{
+	if(mTerrainRenderable->getHoles().empty())
+		return;
 
+	// Every level the heightfield passes through needs a fragment to fill the holes
+	MetaHeightmap *probe = new MetaHeightmap(0, this, 0.2);
+	AxisAlignedBox band = probe->getAABB();
+	delete probe;
+	Real size = MetaWorldFragment::getSize();
+	const Vector3 &centre = getCenter();
+	int minLevel = int(Math::Floor(band.getMinimum().y / size));
+	int maxLevel = int(Math::Floor(band.getMaximum().y / size));
+	for(int level = minLevel; level <= maxLevel; ++level)
+	{
+		if(getMetaWorldFragment(level) || (skip && int(skip->getYLevel()) == level))
+			continue;
+		Vector3 pos(centre.x, size*level + 0.5*size, centre.z);
+		MetaWorldFragment *wf = new MetaWorldFragment(0, pos, level);
+		wf->addMetaObject(new MetaHeightmap(0, this, 0.2));
+		wf->setCarvedColumns(0);
+		wf->setColumnMask(&mTerrainRenderable->getHoles());
+		wf->setVertexSnap(&mSeamSnap);
+		added.push_back(wf);
+	}
+}
+
+void TerrainTile::bakeMetaWorldFragments(IsoSurfaceBuilder *isb)
+{
+	for(std::vector<MetaWorldFragment*>::iterator it = mMetaWorldFragments.begin(); it != mMetaWorldFragments.end(); ++it)
+		(*it)->bake(isb);
+}
 
 }///namespace Ogre
@@ -0,0 +1,168 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "ThreadPool.h"
+#include <boost/bind/bind.hpp>
+
+namespace Ogre
+{
+//-----------------------------------------------------------------------
+ThreadPool::ThreadPool(size_t numThreads)
+: mBusy(0), mStop(false)
+{
+	if (numThreads == 0)
+	{
+		size_t hw = boost::thread::hardware_concurrency();
+		numThreads = hw > 1 ? hw - 1 : 1;
+	}
+	for (size_t i = 0; i < numThreads; ++i)
+		mThreads.push_back(new boost::thread(boost::bind(&ThreadPool::run, this)));
+}
+//-----------------------------------------------------------------------
+ThreadPool::~ThreadPool()
+{
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		mStop = true;
+	}
+	mWork.notify_all();
+	for (size_t i = 0; i < mThreads.size(); ++i)
+	{
+		mThreads[i]->join();
+		delete mThreads[i];
+	}
+	mThreads.clear();
+}
+//-----------------------------------------------------------------------
+void ThreadPool::submit(const Task& task)
+{
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		mTasks.push_back(task);
+	}
+	mWork.notify_one();
+}
+//-----------------------------------------------------------------------
+void ThreadPool::waitIdle()
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	while (!mTasks.empty() || mBusy)
+		mIdle.wait(lock);
+}
+//-----------------------------------------------------------------------
+void ThreadPool::run()
+{
+	for (;;)
+	{
+		Task task;
+		{
+			boost::mutex::scoped_lock lock(mMutex);
+			while (mTasks.empty() && !mStop)
+				mWork.wait(lock);
+			// Drain the queue before stopping, queued work may be waited on
+			if (mTasks.empty())
+				return;
+			task = mTasks.front();
+			mTasks.pop_front();
+			++mBusy;
+		}
+		task();
+		{
+			boost::mutex::scoped_lock lock(mMutex);
+			--mBusy;
+			if (mTasks.empty() && !mBusy)
+				mIdle.notify_all();
+		}
+	}
+}
+//-----------------------------------------------------------------------
+void ThreadPool::runRange(boost::shared_ptr<Range> range)
+{
+	for (;;)
+	{
+		size_t begin, end;
+		{
+			boost::mutex::scoped_lock lock(range->mutex);
+			if (range->next >= range->end)
+				return;
+			begin = range->next;
+			end = std::min(begin + range->chunk, range->end);
+			range->next = end;
+		}
+		try
+		{
+			(*range->body)(begin, end);
+		}
+		catch (...)
+		{
+			// Keep the first error for the caller and drop the chunks nobody took yet
+			boost::mutex::scoped_lock lock(range->mutex);
+			if (!range->error)
+				range->error = boost::current_exception();
+			range->pending -= range->end - range->next;
+			range->next = range->end;
+		}
+		{
+			boost::mutex::scoped_lock lock(range->mutex);
+			range->pending -= end - begin;
+			if (!range->pending)
+				range->done.notify_all();
+		}
+	}
+}
+//-----------------------------------------------------------------------
+void ThreadPool::parallelFor(size_t begin, size_t end, const RangeTask& body, size_t grain)
+{
+	if (begin >= end)
+		return;
+	size_t count = end - begin;
+	size_t workers = mThreads.size() + 1;
+	// A few chunks per thread evens out uneven work
+	size_t chunk = std::max(grain, (count + 4*workers - 1) / (4*workers));
+	if (count <= chunk || mThreads.empty())
+	{
+		body(begin, end);
+		return;
+	}
+
+	boost::shared_ptr<Range> range(new Range);
+	range->body = &body;
+	range->next = begin;
+	range->end = end;
+	range->chunk = chunk;
+	range->pending = count;
+
+	size_t helpers = std::min(mThreads.size(), (count + chunk - 1) / chunk - 1);
+	for (size_t i = 0; i < helpers; ++i)
+		submit(boost::bind(&ThreadPool::runRange, range));
+	runRange(range);
+
+	// Helpers may still be running their last chunks, which use body
+	boost::mutex::scoped_lock lock(range->mutex);
+	while (range->pending)
+		range->done.wait(lock);
+	if (range->error)
+		boost::rethrow_exception(range->error);
+}
+
+}// namespace Ogre
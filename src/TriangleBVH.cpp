@@ -0,0 +1,245 @@
+/*
+-----------------------------------------------------------------------------
+This source file is part of the OverhangTerrainSceneManager
+Plugin for OGRE
+For the latest info, see http://www.ogre3d.org/
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free Software
+Foundation; either version 2 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along with
+this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+Place - Suite 330, Boston, MA 02111-1307, USA, or go to
+http://www.gnu.org/copyleft/lesser.txt.
+
+-----------------------------------------------------------------------------
+*/
+
+#include "TriangleBVH.h"
+#include <algorithm>
+
+namespace Ogre
+{
+namespace
+{
+	/// Orders triangles by their centroid along one axis.
+	struct CentroidLess
+	{
+		const std::vector<Vector3> *centroids;
+		int axis;
+
+		bool operator()(size_t a, size_t b) const
+		{
+			return (*centroids)[a][axis] < (*centroids)[b][axis];
+		}
+	};
+}
+
+void TriangleBVH::build(const uchar *positions, size_t vertexCount, size_t stride, 
+	const uint16 *indices, size_t indexCount)
+{
+	clear();
+	size_t numTriangles = indexCount/3;
+	if (!numTriangles)
+		return;
+
+	mVertices.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		const float *p = reinterpret_cast<const float*>(positions + i*stride);
+		mVertices[i] = Vector3(p[0], p[1], p[2]);
+	}
+
+	std::vector<Vector3> centroids(numTriangles);
+	std::vector<size_t> order(numTriangles);
+	for (size_t i = 0; i < numTriangles; ++i)
+	{
+		centroids[i] = (mVertices[indices[3*i]] + mVertices[indices[3*i + 1]] + mVertices[indices[3*i + 2]])/3;
+		order[i] = i;
+	}
+
+	// A binary tree with one triangle per leaf would have 2n - 1 nodes, 
+	// so references into the node vector stay valid while buildNode grows it
+	mNodes.reserve(2*numTriangles);
+	mNodes.push_back(Node());
+	buildNode(0, indices, order, centroids, 0, numTriangles);
+
+	mIndices.resize(3*numTriangles);
+	for (size_t i = 0; i < numTriangles; ++i)
+	{
+		mIndices[3*i] = indices[3*order[i]];
+		mIndices[3*i + 1] = indices[3*order[i] + 1];
+		mIndices[3*i + 2] = indices[3*order[i] + 2];
+	}
+}
+
+void TriangleBVH::buildNode(size_t node, const uint16 *indices, std::vector<size_t> &order, 
+	const std::vector<Vector3> &centroids, size_t first, size_t count)
+{
+	Node &n = mNodes[node];
+	if (count <= LEAF_SIZE)
+	{
+		n.lo = Vector3(Math::POS_INFINITY, Math::POS_INFINITY, Math::POS_INFINITY);
+		n.hi = -n.lo;
+		for (size_t i = first; i < first + count; ++i)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				n.lo.makeFloor(mVertices[indices[3*order[i] + k]]);
+				n.hi.makeCeil(mVertices[indices[3*order[i] + k]]);
+			}
+		}
+		n.first = uint32(first);
+		n.count = uint32(count);
+		return;
+	}
+
+	// Split at the median centroid along the axis the centroids spread most in
+	Vector3 lo = centroids[order[first]], hi = lo;
+	for (size_t i = first + 1; i < first + count; ++i)
+	{
+		lo.makeFloor(centroids[order[i]]);
+		hi.makeCeil(centroids[order[i]]);
+	}
+	Vector3 extent = hi - lo;
+	CentroidLess less;
+	less.centroids = &centroids;
+	less.axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+	size_t half = count/2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, less);
+
+	size_t left = mNodes.size();
+	n.first = uint32(left);
+	n.count = 0;
+	mNodes.push_back(Node());
+	mNodes.push_back(Node());
+	buildNode(left, indices, order, centroids, first, half);
+	buildNode(left + 1, indices, order, centroids, first + half, count - half);
+
+	mNodes[node].lo = mNodes[left].lo;
+	mNodes[node].hi = mNodes[left].hi;
+	mNodes[node].lo.makeFloor(mNodes[left + 1].lo);
+	mNodes[node].hi.makeCeil(mNodes[left + 1].hi);
+}
+
+void TriangleBVH::clear()
+{
+	mVertices.clear();
+	mIndices.clear();
+	mNodes.clear();
+}
+
+bool TriangleBVH::intersect(const Vector3 &origin, const Vector3 &dir, Real maxT, Real &t) const
+{
+	if (mNodes.empty())
+		return false;
+
+	// Median splits keep the depth at log2 of the triangle count, far below the stack size
+	size_t stack[64];
+	size_t top = 0;
+	stack[top++] = 0;
+	Real best = maxT;
+	bool hit = false;
+	while (top)
+	{
+		const Node &node = mNodes[stack[--top]];
+		Real ta = 0, tb = best;
+		if (!IntersectionTests::rayBox(origin, dir, node.lo, node.hi, ta, tb))
+			continue;
+
+		if (node.count)
+		{
+			for (size_t i = node.first; i < node.first + node.count; ++i)
+			{
+				Real u;
+				if (IntersectionTests::rayTriangle(origin, dir, mVertices[mIndices[3*i]], 
+					mVertices[mIndices[3*i + 1]], mVertices[mIndices[3*i + 2]], u) && u >= 0 && u <= best)
+				{
+					best = u;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, so the hits found there prune the other one
+		const Node &left = mNodes[node.first], &right = mNodes[node.first + 1];
+		Real la = 0, lb = best, ra = 0, rb = best;
+		bool hitLeft = IntersectionTests::rayBox(origin, dir, left.lo, left.hi, la, lb);
+		bool hitRight = IntersectionTests::rayBox(origin, dir, right.lo, right.hi, ra, rb);
+		if (hitLeft && hitRight)
+		{
+			stack[top++] = la <= ra ? node.first + 1 : node.first;
+			stack[top++] = la <= ra ? node.first : node.first + 1;
+		}
+		else if (hitLeft)
+			stack[top++] = node.first;
+		else if (hitRight)
+			stack[top++] = node.first + 1;
+	}
+	if (hit)
+		t = best;
+	return hit;
+}
+
+bool TriangleBVH::sweep(const IntersectionTests::Sweep &sweep, Real maxT, Real &t, Vector3 &normal) const
+{
+	if (mNodes.empty())
+		return false;
+
+	// The boxes are grown by the shape, otherwise as in intersect
+	size_t stack[64];
+	size_t top = 0;
+	stack[top++] = 0;
+	Real best = maxT;
+	bool hit = false;
+	while (top)
+	{
+		const Node &node = mNodes[stack[--top]];
+		Real ta = 0, tb = best;
+		if (!sweep.hitsBox(node.lo, node.hi, ta, tb))
+			continue;
+
+		if (node.count)
+		{
+			for (size_t i = node.first; i < node.first + node.count; ++i)
+			{
+				if (IntersectionTests::sweepTriangle(sweep, mVertices[mIndices[3*i]], 
+					mVertices[mIndices[3*i + 1]], mVertices[mIndices[3*i + 2]], best, best, normal))
+					hit = true;
+			}
+			continue;
+		}
+
+		const Node &left = mNodes[node.first], &right = mNodes[node.first + 1];
+		Real la = 0, lb = best, ra = 0, rb = best;
+		bool hitLeft = sweep.hitsBox(left.lo, left.hi, la, lb);
+		bool hitRight = sweep.hitsBox(right.lo, right.hi, ra, rb);
+		if (hitLeft && hitRight)
+		{
+			stack[top++] = la <= ra ? node.first + 1 : node.first;
+			stack[top++] = la <= ra ? node.first : node.first + 1;
+		}
+		else if (hitLeft)
+			stack[top++] = node.first;
+		else if (hitRight)
+			stack[top++] = node.first + 1;
+	}
+	if (hit)
+		t = best;
+	return hit;
+}
+
+size_t TriangleBVH::getMemoryUsage() const
+{
+	return mVertices.capacity()*sizeof(Vector3) + mIndices.capacity()*sizeof(uint16) + 
+		mNodes.capacity()*sizeof(Node);
+}
+
+}/// namespace Ogre